@@ -82,6 +82,49 @@ enum ucg_fault_tolerance_mode {
                                       success or failure to handle the fault.*/
 };
 
+/**
+ * @ingroup UCG_CONTEXT
+ * @brief Type of a reduction operation, as reported by the user.
+ *
+ * Reporting the type of a (predefined) reduction operation allows UCG to apply
+ * it natively on predefined data-types, instead of calling the user-provided
+ * reduction callback function (see reduce_cb_f in @ref ucg_params_t ).
+ */
+enum ucg_reduce_op_type {
+    UCG_REDUCE_OP_OTHER = 0, /**< Not any of the below (e.g. user-defined) */
+    UCG_REDUCE_OP_SUM,       /**< Summation (e.g. MPI_SUM) */
+    UCG_REDUCE_OP_PROD,      /**< Product (e.g. MPI_PROD) */
+    UCG_REDUCE_OP_MIN,       /**< Minimum (e.g. MPI_MIN) */
+    UCG_REDUCE_OP_MAX,       /**< Maximum (e.g. MPI_MAX) */
+    UCG_REDUCE_OP_LAND,      /**< Logical AND (e.g. MPI_LAND) */
+    UCG_REDUCE_OP_LOR,       /**< Logical OR (e.g. MPI_LOR) */
+    UCG_REDUCE_OP_LXOR,      /**< Logical XOR (e.g. MPI_LXOR) */
+    UCG_REDUCE_OP_BAND,      /**< Bitwise AND (e.g. MPI_BAND) */
+    UCG_REDUCE_OP_BOR,       /**< Bitwise OR (e.g. MPI_BOR) */
+    UCG_REDUCE_OP_BXOR,      /**< Bitwise XOR (e.g. MPI_BXOR) */
+    UCG_REDUCE_OP_MINLOC,    /**< Minimum and its index (e.g. MPI_MINLOC) */
+    UCG_REDUCE_OP_MAXLOC,    /**< Maximum and its index (e.g. MPI_MAXLOC) */
+    UCG_REDUCE_OP_LAST
+};
+
+/**
+ * @ingroup UCG_CONTEXT
+ * @brief Layout of a (value, index) pair data-type, as reported by the user.
+ *
+ * Each pair is laid out in memory as the C structure of its two members, e.g.
+ * "struct { double value; int index; }" for UCG_DATATYPE_PAIR_DOUBLE_INT - as
+ * used by MINLOC and MAXLOC reductions (see @ref ucg_reduce_op_type ).
+ */
+enum ucg_datatype_pair {
+    UCG_DATATYPE_PAIR_NONE = 0,   /**< Not a pair (of the types below) */
+    UCG_DATATYPE_PAIR_FLOAT_INT,  /**< e.g. MPI_FLOAT_INT */
+    UCG_DATATYPE_PAIR_DOUBLE_INT, /**< e.g. MPI_DOUBLE_INT */
+    UCG_DATATYPE_PAIR_LONG_INT,   /**< e.g. MPI_LONG_INT */
+    UCG_DATATYPE_PAIR_SHORT_INT,  /**< e.g. MPI_SHORT_INT */
+    UCG_DATATYPE_PAIR_2INT,       /**< e.g. MPI_2INT */
+    UCG_DATATYPE_PAIR_LAST
+};
+
 enum ucg_group_distance_type {
     UCG_GROUP_DISTANCE_TYPE_FIXED,    /**< Info form is a constant value */
     UCG_GROUP_DISTANCE_TYPE_ARRAY,    /**< Info form is a 1-D distance array */
@@ -172,8 +215,31 @@ typedef struct ucg_params {
         /* Check if the data-type is an integer (of any length) */
         int (*is_integer_f)(void *datatype, int *is_signed);
 
-        /* Check if the data-type is a floating-point (of any length) */
+        /* Check if the data-type is a real (not complex) floating-point */
         int (*is_floating_point_f)(void *datatype);
+
+        /*
+         * Check if a 2-byte floating-point data-type is bfloat16, rather than
+         * (IEEE) half-precision. Optional (may be NULL) if bfloat16 is unused.
+         */
+        int (*is_bfloat16_f)(void *datatype);
+
+        /*
+         * Get the layout of a (value, index) pair data-type, e.g. MPI_2INT
+         * (see @ref ucg_datatype_pair ), so that MINLOC and MAXLOC reductions
+         * on such pairs can be done without calling reduce_cb_f. Optional.
+         */
+        int (*get_pair_f)(void *datatype);
+
+        /*
+         * Describe "count" elements of a (non-contiguous) data-type as blocks
+         * of "blocklen" bytes, "stride" bytes apart, the first "displ" bytes
+         * into the buffer - e.g. MPI vectors, or the faces of a subarray.
+         * Should return 0, or non-zero if it can not be described this way.
+         * Optional (may be NULL), enables zero-copy for such data-types.
+         */
+        int (*get_vector_f)(void *datatype, int count, size_t *blocklen,
+                            size_t *blocks, ptrdiff_t *stride, ptrdiff_t *displ);
     } datatype;
 
     /* Information about reduction operations */
@@ -196,6 +262,13 @@ typedef struct ucg_params {
 
         /* Check if the reduction operation is commutative (e.g. MPI_MINLOC) */
         int (*is_commutative_f)(void *reduce_op);
+
+        /*
+         * Get the type of the reduction operation (@ref ucg_reduce_op_type),
+         * so that predefined operations on predefined data-types can be done
+         * without calling reduce_cb_f. Optional (may be NULL).
+         */
+        int (*get_type_f)(void *reduce_op);
     } reduce_op;
 
     /* Requested action upon completion (for non-blocking calls) */
@@ -19,6 +19,7 @@
 #include <ucs/datastruct/mpool.h>
 #include <ucs/datastruct/queue_types.h>
 #include <ucs/datastruct/list.h>
+#include <ucs/datastruct/khash.h>
 #include <ucs/type/spinlock.h>
 
 #define UCG_GROUP_FIRST_GROUP_ID (1)
@@ -26,7 +27,7 @@
 
 BEGIN_C_DECLS
 
-typedef uint8_t                   ucg_coll_id_t;  /* cyclic */
+typedef uint16_t                  ucg_coll_id_t;  /* cyclic */
 typedef uint8_t                   ucg_step_idx_t;
 typedef uint32_t                  ucg_offset_t;
 typedef void*                     ucg_plan_ctx_h;
@@ -100,18 +101,88 @@ typedef struct ucg_plan_params {
     uint8_t *am_id;      /**< Active-message ID dispenser */
 } ucg_plan_params_t;
 
+/*
+ * Cached operations are indexed by the "shape" of their (cache-line sized)
+ * parameters, meaning all the words except for the send and receive buffers.
+ * The buffers are re-bound when an operation is taken from the cache (see
+ * @ref ucg_builtin_update_op ). The hash folds each 64-bit word with its own
+ * multiplier, so the words are independent and the loop can be vectorized.
+ */
+#define UCG_PLAN_OP_PARAMS_SHAPE_MASK \
+    UINT64_MAX, 0 /* send.buffer */, UINT64_MAX, UINT64_MAX, \
+    UINT64_MAX, 0 /* recv.buffer */, UINT64_MAX, UINT64_MAX
+
+static UCS_F_ALWAYS_INLINE khint32_t
+ucg_plan_op_params_hash(const ucg_collective_params_t *params)
+{
+    static const uint64_t mask[] = { UCG_PLAN_OP_PARAMS_SHAPE_MASK };
+    static const uint64_t mult[] = {
+        0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full,
+        0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull,
+        0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull,
+        0x94d049bb133111ebull, 0xbf58476d1ce4e5b9ull
+    };
+
+    const uint64_t *word = (const uint64_t*)params;
+    uint64_t hash        = 0;
+    unsigned idx;
+
+    UCS_STATIC_ASSERT(sizeof(*params) == sizeof(mult));
+    UCS_STATIC_ASSERT(sizeof(*params) == sizeof(mask));
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_collective_params_t, send.buffer) ==
+                      1 * sizeof(uint64_t));
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_collective_params_t, recv.buffer) ==
+                      5 * sizeof(uint64_t));
+
+    for (idx = 0; idx < ucs_static_array_size(mult); idx++) {
+        hash ^= (word[idx] & mask[idx]) * mult[idx];
+    }
+
+    return (khint32_t)(hash ^ (hash >> 32));
+}
+
+static UCS_F_ALWAYS_INLINE int
+ucg_plan_op_params_equal(const ucg_collective_params_t *a,
+                         const ucg_collective_params_t *b)
+{
+    static const uint64_t mask[] = { UCG_PLAN_OP_PARAMS_SHAPE_MASK };
+
+    const uint64_t *a_word = (const uint64_t*)a;
+    const uint64_t *b_word = (const uint64_t*)b;
+    uint64_t diff          = 0;
+    unsigned idx;
+
+    for (idx = 0; idx < ucs_static_array_size(mask); idx++) {
+        diff |= (a_word[idx] ^ b_word[idx]) & mask[idx];
+    }
+
+    return diff == 0;
+}
+
+KHASH_INIT(ucg_plan_op, const ucg_collective_params_t*, struct ucg_op*, 1,
+           ucg_plan_op_params_hash, ucg_plan_op_params_equal)
+
 #define UCG_PLAN_INCAST_UNUSED ((uct_incast_cb_t)-1)
 typedef struct ucg_plan ucg_plan_t;
+typedef void (*ucg_plan_discard_f)(ucg_plan_t *plan);
 struct ucg_plan {
     /* Plan lookup - caching mechanism */
     ucg_collective_type_t    type;
     ucs_recursive_spinlock_t lock;
     ucs_list_link_t          op_head;   /**< List of requests following this plan */
+    khash_t(ucg_plan_op)     op_hash;   /**< Index of op_head, by parameters */
 
     /* For plans involving incast */
     uct_incast_cb_t          incast_cb;
     ucg_plan_t              *next_cb;
 
+    /* For other plans with the same root (fitting other parameters) */
+    ucg_plan_t              *next_root;
+    ucs_list_link_t          root_lru;  /**< group's LRU list of root plans
+                                             (only the first plan of a key) */
+    unsigned                 op_in_use; /**< ops created and not destroyed */
+    ucg_plan_discard_f       discard_f; /**< release the plan and its ops */
+
     /*  Attribute */
     int                      support_non_contiguous;
     int                      support_non_commutative;
@@ -159,6 +230,8 @@ struct ucg_op {
     ucg_collective_params_t   params;        /**< original parameters for it */
     /* Note: the params field must be 64-byte-aligned, for 512-bit SIMD ISA */
 
+    struct ucg_op            *hash_next;     /**< next cached op, same params */
+
     /* Component-specific request content */
     char                      priv[0];
 };
@@ -293,6 +366,14 @@ ucs_status_t ucg_plan_connect(ucg_group_h group,
                               uct_ep_h *ep_p, const uct_iface_attr_t **ep_attr_p,
                               uct_md_h *md_p, const uct_md_attr_t    **md_attr_p);
 
+/* Helper function for additional lanes (besides the one above) to a member */
+ucs_status_t ucg_plan_connect_rails(ucg_group_h group,
+                                    ucg_group_member_index_t group_idx,
+                                    unsigned max_rails, uct_ep_h *eps,
+                                    const uct_iface_attr_t **ep_attrs,
+                                    uct_md_h *mds, const uct_md_attr_t **md_attrs,
+                                    unsigned *rail_cnt_p);
+
 /* Helper function for selecting other planners - to be used as fall-back */
 ucs_status_t ucg_plan_choose(const ucg_collective_params_t *coll_params,
                              ucg_group_h group, ucg_plan_desc_t **desc_p,
@@ -25,7 +25,12 @@ ucs_config_field_t ucg_config_table[] = {
    ucs_offsetof(ucg_context_config_t, planners), UCS_CONFIG_TYPE_STRING_ARRAY},
 
   {"GROUP_OP_CACHE_SIZE", "32",
-   "How many operations can be stored in the per-group cache.\n",
+   "How many operations can be stored in the per-group cache. Beyond this\n"
+   "number the least-recently-used operations, which are not in use, are\n"
+   "discarded (releasing their buffers and memory registrations). This is also\n"
+   "how many plans are kept for rooted collectives with a non-zero root (one per\n"
+   "collective type, message size level and root) - beyond it the plans of the\n"
+   "least-recently-used root, with no operations in use, are discarded.\n",
    ucs_offsetof(ucg_context_config_t, group_cache_size_thresh), UCS_CONFIG_TYPE_UINT},
 
   {"COLL_IFACE_MEMBER_THRESH", "3",
@@ -417,6 +422,9 @@ ucs_status_t ucg_init_version(unsigned ucg_api_major_version,
        ucg_global_params.datatype.get_span_f          = ucs_empty_function_do_assert;
        ucg_global_params.datatype.is_integer_f        = ucs_empty_function_return_zero_int;
        ucg_global_params.datatype.is_floating_point_f = ucs_empty_function_return_zero_int;
+       ucg_global_params.datatype.get_vector_f        = ucs_empty_function_return_unsupported;
+       ucg_global_params.datatype.is_bfloat16_f       = ucs_empty_function_return_zero_int;
+       ucg_global_params.datatype.get_pair_f          = ucs_empty_function_return_zero_int;
     }
 
     if (!(params->field_mask & UCG_PARAM_FIELD_REDUCE_OP_CB)) {
@@ -424,6 +432,7 @@ ucs_status_t ucg_init_version(unsigned ucg_api_major_version,
        ucg_global_params.reduce_op.is_sum_f          = ucs_empty_function_return_zero_int;
        ucg_global_params.reduce_op.is_loc_expected_f = ucs_empty_function_return_zero_int;
        ucg_global_params.reduce_op.is_commutative_f  = ucs_empty_function_return_zero_int;
+       ucg_global_params.reduce_op.get_type_f        = ucs_empty_function_return_zero_int;
     }
 
 #ifndef HAVE_UCP_EXTENSIONS
@@ -16,7 +16,7 @@ typedef struct ucg_config {
     /** Array of planner names to use */
     ucs_config_names_array_t planners;
 
-    /** Up to how many operations should be cached in each group */
+    /** Up to how many operations should be cached in each group (LRU) */
     unsigned group_cache_size_thresh;
 
     /** Above how many group members should UCG preconnect all the topologies */
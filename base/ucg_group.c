@@ -26,8 +26,11 @@
 enum {
     UCG_GROUP_STAT_PLANS_CREATED,
     UCG_GROUP_STAT_PLANS_USED,
+    UCG_GROUP_STAT_PLANS_EVICTED,
 
     UCG_GROUP_STAT_OPS_CREATED,
+    UCG_GROUP_STAT_OPS_CACHED,
+    UCG_GROUP_STAT_OPS_EVICTED,
     UCG_GROUP_STAT_OPS_USED,
     UCG_GROUP_STAT_OPS_IMMEDIATE,
 
@@ -40,7 +43,10 @@ static ucs_stats_class_t ucg_group_stats_class = {
     .counter_names  = {
         [UCG_GROUP_STAT_PLANS_CREATED] = "plans_created",
         [UCG_GROUP_STAT_PLANS_USED]    = "plans_reused",
+        [UCG_GROUP_STAT_PLANS_EVICTED] = "plans_evicted",
         [UCG_GROUP_STAT_OPS_CREATED]   = "ops_created",
+        [UCG_GROUP_STAT_OPS_CACHED]    = "ops_cache_hits",
+        [UCG_GROUP_STAT_OPS_EVICTED]   = "ops_cache_evictions",
         [UCG_GROUP_STAT_OPS_USED]      = "ops_started",
         [UCG_GROUP_STAT_OPS_IMMEDIATE] = "ops_immediate"
     }
@@ -55,20 +61,95 @@ static ucs_stats_class_t ucg_group_stats_class = {
 #define UCG_GROUP_THREAD_CS_EXIT(_obj)
 #endif
 
-void ucg_init_group_cache(struct ucg_group *new_group)
+static void ucg_group_cache_op_unlink(ucg_plan_t *plan, ucg_op_t *op,
+                                      khiter_t hash_iter)
 {
-    new_group->cache_size = 0;
-    memset(new_group->cache_by_modifiers, 0, sizeof(new_group->cache_by_modifiers));
-    memset(new_group->cache_nonzero_root, 0, sizeof(new_group->cache_nonzero_root));
+    ucg_op_t **iter = &kh_val(&plan->op_hash, hash_iter);
+
+    /* ops with identical parameters are chained, most-recently-used first */
+    while (*iter != op) {
+        ucs_assert(*iter != NULL);
+        iter = &(*iter)->hash_next;
+    }
+    *iter = op->hash_next;
+
+    /* the key points inside the first op in the chain - so it may change */
+    iter = &kh_val(&plan->op_hash, hash_iter);
+    if (*iter == NULL) {
+        kh_del(ucg_plan_op, &plan->op_hash, hash_iter);
+    } else {
+        kh_key(&plan->op_hash, hash_iter) = &(*iter)->params;
+    }
+
+    ucs_list_del(&op->list);
+}
+
+static ucg_op_t *ucg_group_cache_op_find(ucg_plan_t *plan, khiter_t hash_iter,
+                                         const ucg_collective_params_t *params)
+{
+    ucg_op_t *op;
+    ucg_op_t *reusable = NULL;
+
+    /*
+     * Ops in the chain share the same "shape", but may differ in buffers: an
+     * exact buffer match needs no re-binding at all, so it is preferred over
+     * the most-recently-used op which can be re-bound to the new buffers.
+     */
+    for (op = kh_val(&plan->op_hash, hash_iter); op != NULL; op = op->hash_next) {
+        if (!ucg_builtin_op_can_reuse(plan, op, params)) {
+            continue;
+        }
+
+        if ((op->params.send.buffer == params->send.buffer) &&
+            (op->params.recv.buffer == params->recv.buffer)) {
+            return op;
+        }
+
+        if (reusable == NULL) {
+            reusable = op;
+        }
+    }
+
+    return reusable;
 }
 
-void ucg_init_group_root_used(struct ucg_group *new_group)
+static void ucg_group_cache_op_remove(ucg_plan_t *plan, ucg_op_t *op)
 {
-    unsigned rank;
-    /* Initalization of root_used */
-    for (rank = 0; rank < UCG_GROUP_MAX_ROOT_PARAM; rank++) {
-        new_group->root_used[rank] = (unsigned) -1;
+    khiter_t hash_iter = kh_get(ucg_plan_op, &plan->op_hash, &op->params);
+
+    ucs_assert(hash_iter != kh_end(&plan->op_hash));
+    ucg_group_cache_op_unlink(plan, op, hash_iter);
+}
+
+static ucs_status_t ucg_group_cache_op_add(ucg_plan_t *plan, ucg_op_t *op)
+{
+    int ret;
+    khiter_t hash_iter = kh_put(ucg_plan_op, &plan->op_hash, &op->params, &ret);
+
+    if (ucs_unlikely(ret == UCS_KH_PUT_FAILED)) {
+        return UCS_ERR_NO_MEMORY;
     }
+
+    op->hash_next = (ret == UCS_KH_PUT_KEY_PRESENT) ?
+                    kh_val(&plan->op_hash, hash_iter) : NULL;
+
+    kh_key(&plan->op_hash, hash_iter) = &op->params;
+    kh_val(&plan->op_hash, hash_iter) = op;
+
+    ucs_list_add_head(&plan->op_head, &op->list);
+    return UCS_OK;
+}
+
+KHASH_IMPL(ucg_group_root_plan, uint64_t, ucg_plan_t*, 1, kh_int64_hash_func,
+           kh_int64_hash_equal)
+
+void ucg_init_group_cache(struct ucg_group *new_group)
+{
+    new_group->cache_size = 0;
+    memset(new_group->cache_by_modifiers, 0, sizeof(new_group->cache_by_modifiers));
+    kh_init_inplace(ucg_group_root_plan, &new_group->cache_by_root);
+    ucs_list_head_init(&new_group->root_plan_lru);
+    new_group->root_plan_cnt = 0;
 }
 
 static inline ucs_status_t ucg_group_plan(ucg_group_h group,
@@ -109,11 +190,14 @@ static inline ucs_status_t ucg_group_plan(ucg_group_h group,
     }
 
     ucs_list_head_init(&plan->op_head);
+    kh_init_inplace(ucg_plan_op, &plan->op_hash);
 
-    plan->group_id = group->params.id;
-    plan->planner  = planner;
-    plan->group    = group;
-    *plan_p        = plan;
+    plan->group_id  = group->params.id;
+    plan->planner   = planner;
+    plan->group     = group;
+    plan->next_root = NULL;
+    plan->op_in_use = 0;
+    *plan_p         = plan;
 
     return UCS_OK;
 }
@@ -450,7 +534,6 @@ ucs_status_t ucg_group_create(ucp_worker_h worker,
     }
 
     ucg_init_group_cache(group);
-    ucg_init_group_root_used(group);
     ucs_list_add_tail(&ctx->groups_head, &group->list);
 
     *group_p = group;
@@ -485,10 +568,71 @@ ucs_status_t ucg_group_query(ucg_group_h group,
     return UCS_OK;
 }
 
+static unsigned ucg_group_cache_evict_lru(ucg_group_h group, ucg_plan_t *plan,
+                                          unsigned thresh)
+{
+    ucg_op_t *op;
+    unsigned evicted = 0;
+
+    /* Walk the plan and its incast variants, discarding one op from each */
+    for (; (plan != NULL) && (group->cache_size > thresh); plan = plan->next_cb) {
+        UCG_GROUP_THREAD_CS_ENTER(plan)
+
+        /* ucg_collective_destroy() puts ops at the head - the tail is LRU */
+        if (!ucs_list_is_empty(&plan->op_head)) {
+            op = ucs_list_tail(&plan->op_head, ucg_op_t, list);
+            ucg_group_cache_op_remove(plan, op);
+            op->discard_f(op);
+            group->cache_size--;
+            evicted++;
+        }
+
+        UCG_GROUP_THREAD_CS_EXIT(plan)
+    }
+
+    return evicted;
+}
+
 static ucs_status_t ucg_group_cache_cleanup(ucg_group_h group)
 {
-    // TODO: implement... otherwise cache might grow too big!
-    // TODO: use "op->discard_f(op);"
+    ucg_plan_t *plan;
+    unsigned idx, round_evicted, evicted = 0;
+    unsigned thresh = group->context->config.group_cache_size_thresh;
+
+    /*
+     * Each round takes the least-recently-used op out of every plan, so that
+     * no single collective type is drained while others keep stale entries.
+     * Only ops which were released by ucg_collective_destroy() are on those
+     * lists, so operations in flight are never discarded here.
+     */
+    while (group->cache_size > thresh) {
+        round_evicted = 0;
+
+        for (idx = 0; idx < UCG_GROUP_CACHE_MODIFIER_MASK; idx++) {
+            round_evicted += ucg_group_cache_evict_lru(group,
+                                                       group->cache_by_modifiers[idx],
+                                                       thresh);
+        }
+
+        kh_foreach_value(&group->cache_by_root, plan, {
+            for (; plan != NULL; plan = plan->next_root) {
+                round_evicted += ucg_group_cache_evict_lru(group, plan, thresh);
+            }
+        })
+
+        if (round_evicted == 0) {
+            break; /* the rest of the cached ops are currently in use */
+        }
+
+        evicted += round_evicted;
+    }
+
+    UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_OPS_EVICTED, evicted);
+
+    ucs_debug("group %p: evicted %u cached ops (%u remaining)", group,
+              evicted, group->cache_size);
+
+    group->is_cache_cleanup_due = 0;
     return UCS_OK;
 }
 
@@ -505,6 +649,8 @@ void ucg_group_destroy(ucg_group_h group)
 
     ucg_plan_group_destroy(group);
 
+    kh_destroy_inplace(ucg_group_root_plan, &group->cache_by_root);
+
     ucs_list_del(&group->list);
 
     UCG_GROUP_THREAD_CS_EXIT(group)
@@ -545,54 +691,160 @@ static int ucg_chk_noncontig_allreduce_plan(const ucg_collective_params_t *coll_
     }
 }
 
-void ucg_get_cache_plan(unsigned int message_size_level, unsigned int coll_root,
-                        ucg_group_h group, const ucg_collective_params_t *params,
-                        ucg_plan_t ***cache_plan)
+static int ucg_group_is_root_plan_usable(ucg_group_h group,
+                                         const ucg_collective_params_t *params,
+                                         const ucg_plan_t *plan)
 {
-    ucg_group_member_index_t root = params->send.type.root;
-
-    ucg_plan_t **plan_p = &group->cache_nonzero_root[message_size_level][coll_root];
-    ucg_plan_t *plan = *plan_p;
-    if (plan == NULL) {
-        *cache_plan = NULL;
-        return;
-    }
-
     if (params->recv.op && !ucg_global_params.reduce_op.is_commutative_f(params->recv.op) && !plan->support_non_commutative) {
-        *cache_plan = NULL;
-        return;
+        return 0;
     }
 
     if (params->recv.op && !ucg_global_params.reduce_op.is_commutative_f(params->recv.op) && params->send.count > 1
         && plan->is_ring_plan_topo_type) {
-        *cache_plan = NULL;
-        return;
+        return 0;
     }
 
     /* TODO: fix problem - only works for builtin...
     ucg_builtin_config_t *config = (ucg_builtin_config_t *)plan->planner->component->config;
     if (params->send.dtype > config->large_datatype_threshold && !plan->support_large_datatype) {
-        *cache_plan = NULL;
-        return;
+        return 0;
     }*/
 
     if (ucg_chk_noncontig_allreduce_plan(params, &group->params, plan)) {
-        *cache_plan = NULL;
-        return;
+        return 0;
     }
 
     if (plan->is_ring_plan_topo_type && ucg_is_segmented_allreduce(params)) {
-        *cache_plan = NULL;
-        return;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int ucg_group_root_plans_can_evict(const ucg_plan_t *plan)
+{
+    const ucg_plan_t *variant;
+
+    for (; plan != NULL; plan = plan->next_root) {
+        for (variant = plan; variant != NULL; variant = variant->next_cb) {
+            if (variant->op_in_use || (variant->discard_f == NULL)) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static void ucg_group_root_plans_discard(ucg_group_h group, ucg_plan_t *plan)
+{
+    ucg_plan_t *next_root, *next_cb;
+
+    ucs_list_del(&plan->root_lru);
+    group->root_plan_cnt--;
+
+    for (; plan != NULL; plan = next_root) {
+        next_root = plan->next_root;
+        for (; plan != NULL; plan = next_cb) {
+            next_cb           = plan->next_cb;
+            group->cache_size -= ucs_list_length(&plan->op_head);
+            plan->discard_f(plan);
+            UCS_STATS_UPDATE_COUNTER(group->stats,
+                                     UCG_GROUP_STAT_PLANS_EVICTED, 1);
+        }
+    }
+}
+
+/*
+ * Discard the plans (and cached ops) of the least-recently-used keys, until
+ * there are less than "thresh" of them - skipping those with ops in use, so
+ * that no op in flight (or held by the application) loses its plan, and those
+ * of planners which can not discard a single plan.
+ */
+static void ucg_group_cache_evict_root_plans(ucg_group_h group, unsigned thresh)
+{
+    ucs_list_link_t *link = group->root_plan_lru.prev;
+    ucg_plan_t *plan;
+    khiter_t iter;
+
+    while ((group->root_plan_cnt >= thresh) && (link != &group->root_plan_lru)) {
+        plan = ucs_container_of(link, ucg_plan_t, root_lru);
+        link = link->prev;
+        if (!ucg_group_root_plans_can_evict(plan)) {
+            continue;
+        }
+
+        /* the key is not kept in the plan - but there are only a few keys */
+        for (iter = kh_begin(&group->cache_by_root);
+             iter != kh_end(&group->cache_by_root); iter++) {
+            if (kh_exist(&group->cache_by_root, iter) &&
+                (kh_val(&group->cache_by_root, iter) == plan)) {
+                kh_del(ucg_group_root_plan, &group->cache_by_root, iter);
+                break;
+            }
+        }
+
+        ucg_group_root_plans_discard(group, plan);
     }
+}
 
-    if (plan != NULL && root != plan->type.root) {
-        *cache_plan = NULL;
-        return;
+static ucs_status_t ucg_group_get_root_plan(ucg_group_h group,
+                                            const ucg_collective_params_t *params,
+                                            unsigned message_size_level,
+                                            ucg_plan_t ***cache_plan,
+                                            ucg_plan_t ***root_plan)
+{
+    int ret;
+    khiter_t iter;
+    ucg_plan_t **plan_p;
+    ucg_group_member_index_t root = UCG_ROOT_RANK(params);
+    uint16_t modifiers            = UCG_PARAM_TYPE(params).modifiers;
+    uint64_t key                  = UCG_GROUP_ROOT_PLAN_KEY(modifiers &
+                                                            UCG_GROUP_CACHE_MODIFIER_MASK,
+                                                            message_size_level,
+                                                            root);
+
+    ucs_assert(root < UCS_BIT(UCG_GROUP_ROOT_PLAN_KEY_ROOT_BITS));
+
+    /* Note: the value pointer is only valid until the next insertion */
+    iter = kh_put(ucg_group_root_plan, &group->cache_by_root, key, &ret);
+    if (ucs_unlikely(ret == UCS_KH_PUT_FAILED)) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    plan_p = &kh_val(&group->cache_by_root, iter);
+    if (ret != UCS_KH_PUT_KEY_PRESENT) {
+        *plan_p = NULL;
+    }
+
+    /* Deleting other keys leaves this entry (and plan_p) where it is */
+    if (*plan_p == NULL) {
+        ucg_group_cache_evict_root_plans(group,
+                group->context->config.group_cache_size_thresh);
+    } else {
+        ucs_list_del(&(*plan_p)->root_lru);
+        ucs_list_add_head(&group->root_plan_lru, &(*plan_p)->root_lru);
+    }
+
+    *root_plan = plan_p;
+
+    /*
+     * A cached plan may not fit these parameters (e.g. a non-commutative
+     * operator), so the plans for this key are chained: the ops of each of
+     * them stay cached, and those still in flight return to a plan which
+     * ucg_group_cache_cleanup() can reach. A new plan is added at the tail.
+     */
+    while ((*plan_p != NULL) &&
+           !ucg_group_is_root_plan_usable(group, params, *plan_p)) {
+        plan_p = &(*plan_p)->next_root;
+    }
+
+    if (*plan_p != NULL) {
+        ucs_debug("select plan from cache: %p", *plan_p);
     }
 
-    ucs_debug("select plan from cache: %p", plan);
     *cache_plan = plan_p;
+    return UCS_OK;
 }
 
 void ucg_collective_create_choose_algorithm(unsigned msg_size, unsigned *message_size_level)
@@ -613,11 +865,11 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
         (group, params, coll), ucg_group_h group,
         const ucg_collective_params_t *params, ucg_coll_h *coll)
 {
-    int is_match;
     ucg_op_t *op;
     ucg_plan_t *plan;
+    khiter_t hash_iter;
     ucg_plan_t **plan_p;
-    unsigned coll_root;
+    ucg_plan_t **root_p = NULL;
     unsigned coll_mask;
     unsigned message_size_level;
     ucp_datatype_t send_dt;
@@ -634,9 +886,6 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
         coll_mask          = modifiers & UCG_GROUP_CACHE_MODIFIER_MASK;
         plan_p             = &group->cache_by_modifiers[coll_mask];
     } else {
-        /* find the plan of current root whether has been established */
-        // TODO: unsigned is_coll_root_found = 1;
-
         status = ucg_builtin_convert_datatype(params->send.dtype, &send_dt);
         if (ucs_unlikely(status != UCS_OK)) {
             return status;
@@ -648,16 +897,13 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
             return UCS_ERR_INVALID_PARAM;
         }
 
-        /* root cache has been not found */
-        if (root != group->root_used[root % UCG_GROUP_MAX_ROOT_PARAM]) {
-            group->root_used[root % UCG_GROUP_MAX_ROOT_PARAM] = root;
-            // TODO: is_coll_root_found = 0;
-        }
-
         ucg_collective_create_choose_algorithm(msg_size, &message_size_level);
 
-        coll_root = root % UCG_GROUP_MAX_ROOT_PARAM;
-        ucg_get_cache_plan(message_size_level, coll_root, group, params, &plan_p);
+        status = ucg_group_get_root_plan(group, params, message_size_level,
+                                         &plan_p, &root_p);
+        if (ucs_unlikely(status != UCS_OK)) {
+            return status;
+        }
     }
 
     /* */
@@ -689,29 +935,28 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
     if (ucs_likely(plan != NULL)) {
         UCG_GROUP_THREAD_CS_ENTER(plan)
 
-        ucs_list_for_each(op, &plan->op_head, list) {
-            /* we only need to compare the first 64 bytes of each set of cached
-             * parameters against the given one (checked during compile time) */
-            UCS_STATIC_ASSERT(sizeof(ucg_collective_params_t) ==
-                              UCS_SYS_CACHE_LINE_SIZE);
+        /* the parameters fit in one cache line, so hashing and comparing them
+         * (word by word, see @ref ucg_plan_op_params_equal ) stays cheap */
+        UCS_STATIC_ASSERT(sizeof(ucg_collective_params_t) ==
+                          UCS_SYS_CACHE_LINE_SIZE);
 
-#ifdef HAVE_UCP_EXTENSIONS
-#ifdef __AVX512F__
-            /* Only apply AVX512 to broadcast - otherwise risk CPU down-clocking! */
-            if (plan->my_index == 0) {
-#else
-            if (1) {
-#endif
-                is_match = ucs_cpu_cache_line_is_equal(params, &op->params);
-            } else
-#endif
-            is_match = (memcmp(params, &op->params, UCS_SYS_CACHE_LINE_SIZE) == 0);
-            if (is_match) { // TODO: && ucg_builtin_op_can_reuse(plan, op, params)) {
-                ucs_list_del(&op->list);
+        /* the lookup ignores the buffers, which are then re-bound in place */
+        hash_iter = kh_get(ucg_plan_op, &plan->op_hash, params);
+        if ((hash_iter != kh_end(&plan->op_hash)) &&
+            ((op = ucg_group_cache_op_find(plan, hash_iter, params)) != NULL)) {
+            ucg_group_cache_op_unlink(plan, op, hash_iter);
+
+            status = ucg_builtin_update_op(plan, op, params);
+            if (ucs_likely(status == UCS_OK)) {
                 UCG_GROUP_THREAD_CS_EXIT(plan);
-                status = UCS_OK;
+                UCS_STATS_UPDATE_COUNTER(group->stats,
+                                         UCG_GROUP_STAT_OPS_CACHED, 1);
                 goto op_found;
             }
+
+            /* e.g. failed to register the new buffer - create a new op */
+            op->discard_f(op);
+            group->cache_size--;
         }
 
         UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLANS_USED, 1);
@@ -727,6 +972,11 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
         }
 
         plan = *plan_p;
+        if (plan_p == root_p) {
+            /* the first plan for this root - the one the LRU order tracks */
+            ucs_list_add_head(&group->root_plan_lru, &plan->root_lru);
+            group->root_plan_cnt++;
+        }
 
         UCG_GROUP_THREAD_CS_ENTER(plan);
 
@@ -761,6 +1011,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
     }
 
 op_found:
+    plan->op_in_use++;
     *coll = op;
 
 out:
@@ -856,7 +1107,12 @@ void ucg_collective_destroy(ucg_coll_h coll)
 
     UCG_GROUP_THREAD_CS_ENTER(plan);
 
-    ucs_list_add_head(&plan->op_head, &op->list);
+    plan->op_in_use--;
+    if (ucs_unlikely(ucg_group_cache_op_add(plan, op) != UCS_OK)) {
+        ucs_warn("failed to cache a collective operation - discarding it");
+        op->discard_f(op);
+        plan->group->cache_size--;
+    }
 
     UCG_GROUP_THREAD_CS_EXIT(plan);
 }
@@ -22,13 +22,18 @@
 /* level number of categoried message size, 0 for short message size, 1 for mid-long message size */
 #define UCG_GROUP_MSG_SIZE_LEVEL 2
 
-/* max number of actual root rank used */
-#define UCG_GROUP_MAX_ROOT_PARAM 96
-
 #define UCG_ROOT_RANK(params) \
     ((params)->send.type.root)
 
+/* key for the plans of collectives with a non-zero root */
+#define UCG_GROUP_ROOT_PLAN_KEY_ROOT_BITS 40
+#define UCG_GROUP_ROOT_PLAN_KEY(_modifiers, _msg_size_level, _root) \
+    (((uint64_t)(_modifiers)      << (UCG_GROUP_ROOT_PLAN_KEY_ROOT_BITS + 8)) | \
+     ((uint64_t)(_msg_size_level) <<  UCG_GROUP_ROOT_PLAN_KEY_ROOT_BITS)      | \
+     ((uint64_t)(_root)))
+
 KHASH_TYPE(ucg_group_ep, ucg_group_member_index_t, ucp_ep_h)
+KHASH_TYPE(ucg_group_root_plan, uint64_t, ucg_plan_t*)
 
 typedef struct ucg_incast_ep_hash_by_cb {
     uct_incast_cb_t incast_cb;
@@ -66,18 +71,18 @@ typedef struct ucg_group {
      * for each collective type (e.g. Allreduce) there is a plan with a list of
      * operations. To re-use a past operation it must be available and match the
      * requested collective parameters. The cache size is a total across all
-     * collective types.
-     */
-    unsigned                 cache_size;
-    ucg_plan_t              *cache_by_modifiers[UCG_GROUP_CACHE_MODIFIER_MASK];
-    ucg_plan_t              *cache_nonzero_root[UCG_GROUP_MSG_SIZE_LEVEL]
-                                               [UCG_GROUP_MAX_ROOT_PARAM];
-
-    /*
-     * for root collective operations(e.g. Bcast), the parameter of root should be
-     * the criterion to decide whether plan has been found.
+     * collective types. Rooted collectives (e.g. Bcast) with a non-zero root
+     * are looked up by their modifiers, message size level and root, using
+     * @ref UCG_GROUP_ROOT_PLAN_KEY . There are at most as many such keys as
+     * ops in the cache: beyond that, the plans of the least-recently-used key
+     * (with no op in use) are discarded, together with their cached ops.
      */
-    unsigned                 root_used[UCG_GROUP_MAX_ROOT_PARAM];
+    unsigned                   cache_size;
+    ucg_plan_t                *cache_by_modifiers[UCG_GROUP_CACHE_MODIFIER_MASK];
+    khash_t(ucg_group_root_plan) cache_by_root;
+    ucs_list_link_t            root_plan_lru; /**< first plans of each key,
+                                                   most-recently-used first */
+    unsigned                   root_plan_cnt; /**< keys in cache_by_root */
 
     /* Group name for tracing and analysis */
     char                     name[UCG_GROUP_NAME_MAX];
@@ -90,8 +95,8 @@ const ucg_group_params_t* ucg_group_get_params(ucg_group_h group); /* for tests
 int ucg_builtin_op_can_reuse(const ucg_plan_t *plan, const ucg_op_t *op,
                              const ucg_collective_params_t *params);
 
-void ucg_builtin_update_op(const ucg_plan_t *plan, ucg_op_t *op,
-                           const ucg_collective_params_t *params);
+ucs_status_t ucg_builtin_update_op(const ucg_plan_t *plan, ucg_op_t *op,
+                                   const ucg_collective_params_t *params);
 
 int ucg_is_segmented_allreduce(const ucg_collective_params_t *coll_params);
 
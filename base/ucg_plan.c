@@ -9,7 +9,6 @@
 
 #include <ucg/api/ucg.h>
 #include <ucp/core/ucp_ep.inl>
-#include <ucp/core/ucp_ep.inl>
 #include <ucp/core/ucp_proxy_ep.h>
 #include <uct/base/uct_component.h>
 #include <ucs/config/parser.h>
@@ -678,6 +677,71 @@ ucs_status_t ucg_plan_connect(ucg_group_h group,
     return UCS_OK;
 }
 
+ucs_status_t ucg_plan_connect_rails(ucg_group_h group,
+                                    ucg_group_member_index_t group_idx,
+                                    unsigned max_rails, uct_ep_h *eps,
+                                    const uct_iface_attr_t **ep_attrs,
+                                    uct_md_h *mds, const uct_md_attr_t **md_attrs,
+                                    unsigned *rail_cnt_p)
+{
+    unsigned i;
+    ucp_ep_h ucp_ep;
+    uct_ep_h uct_ep;
+    ucs_status_t status;
+    ucp_lane_map_t used;
+    ucp_lane_index_t lane;
+    const uct_iface_attr_t *attr;
+    const ucp_ep_config_key_t *key;
+    ucp_lane_index_t lanes[2 * UCP_MAX_LANES];
+    unsigned rail_cnt = 0;
+
+    status = ucg_plan_connect_p2p(group, group_idx, &lane, &ucp_ep, &uct_ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* Consider the bandwidth lanes UCP has chosen - first for AM, then RMA */
+    key  = &ucp_ep_config(ucp_ep)->key;
+    used = UCS_BIT(lane);
+    for (i = 0; i < UCP_MAX_LANES; i++) {
+        lanes[i]                 = key->am_bw_lanes[i];
+        lanes[i + UCP_MAX_LANES] = key->rma_bw_lanes[i];
+    }
+
+    for (i = 0; (i < 2 * UCP_MAX_LANES) && (rail_cnt < max_rails); i++) {
+        lane = lanes[i];
+        if ((lane == UCP_NULL_LANE) || (used & UCS_BIT(lane))) {
+            continue;
+        }
+
+        used |= UCS_BIT(lane);
+        attr  = ucp_ep_get_iface_attr(ucp_ep, lane);
+        if (!(attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY)) {
+            continue; /* fragments are sent as active messages */
+        }
+
+        do {
+            uct_ep = ucp_ep_get_lane(ucp_ep, lane);
+            status = ucg_plan_await_lane_connection(group->worker, ucp_ep, lane,
+                                                    uct_ep);
+        } while (status == UCS_INPROGRESS);
+
+        if (status != UCS_OK) {
+            ucs_debug("lane %u to peer #%u is not used as a rail: %s", lane,
+                      group_idx, ucs_status_string(status));
+            continue;
+        }
+
+        eps[rail_cnt]        = uct_ep;
+        ep_attrs[rail_cnt]   = attr;
+        mds[rail_cnt]        = ucp_ep_md(ucp_ep, lane);
+        md_attrs[rail_cnt++] = ucp_ep_md_attr(ucp_ep, lane);
+    }
+
+    *rail_cnt_p = rail_cnt;
+    return UCS_OK;
+}
+
 ucp_worker_h ucg_plan_get_group_worker(ucg_group_h group)
 {
     return group->worker;
@@ -5,7 +5,11 @@
 
 #include <string.h>
 #include <ucs/arch/atomic.h>
+#include <ucs/arch/cpu.h>
+#include <ucs/time/time.h>
 #include <ucs/profile/profile.h>
+#include <ucs/memory/rcache.h>
+#include <ucm/api/ucm.h>
 #include <ucp/core/ucp_request.inl>
 #include <ucg/api/ucg_plan_component.h>
 
@@ -16,6 +20,9 @@
 #ifndef UCS_MEMUNITS_INF
 #define UCS_MEMUNITS_INF UCS_CONFIG_MEMUNITS_INF
 #endif
+#ifndef UCS_MEMUNITS_AUTO
+#define UCS_MEMUNITS_AUTO UCS_CONFIG_MEMUNITS_AUTO
+#endif
 
 #ifdef HAVE_UCP_EXTENSIONS
 #define CONDITIONAL_NULL ,NULL
@@ -61,6 +68,80 @@ static ucs_config_field_t ucg_builtin_config_table[] = {
     {"BCOPY_TO_ZCOPY_OPT", "1", "Switch for optimization from bcopy to zcopy",
      ucs_offsetof(ucg_builtin_config_t, bcopy_to_zcopy_opt), UCS_CONFIG_TYPE_UINT},
 
+    {"ZCOPY_THRESH", "auto", "Smallest send operation to use zero-copy. If set to \"auto\",\n"
+     "it is estimated per transport from its overhead and bandwidth, the cost of\n"
+     "memory registration and the local memory copy bandwidth",
+     ucs_offsetof(ucg_builtin_config_t, zcopy_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"ZCOPY_CALIBRATE", "n", "Measure the memory copy bandwidth and registration cost (once per\n"
+     "memory domain) for the \"auto\" zero-copy threshold, instead of using the\n"
+     "values reported by the transports",
+     ucs_offsetof(ucg_builtin_config_t, zcopy_calibrate), UCS_CONFIG_TYPE_BOOL},
+
+    {"REG_CACHE", "y", "Keep the registrations of user buffers for zero-copy and one-sided sends\n"
+     "in a cache (per memory domain), shared by all collective operations and\n"
+     "invalidated as the memory is released",
+     ucs_offsetof(ucg_builtin_config_t, reg_cache), UCS_CONFIG_TYPE_BOOL},
+
+    {"REG_CACHE_MAX_SIZE", "inf", "Total size of the registrations kept in the cache, beyond which the\n"
+     "least recently used ones (no longer in use) are released",
+     ucs_offsetof(ucg_builtin_config_t, reg_cache_max_size), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"MAX_RAILS", "2", "Largest number of lanes (e.g. network devices) to a single peer, across\n"
+     "which the fragments of large zero-copy sends are striped - according to\n"
+     "the bandwidth of each lane (max. 4)",
+     ucs_offsetof(ucg_builtin_config_t, max_rails), UCS_CONFIG_TYPE_UINT},
+
+    {"BCAST_SEGMENT_SIZE", "auto", "Size of the segments a large broadcast is split into, so that\n"
+     "tree waypoints forward each one as soon as it arrives. If set to \"auto\",\n"
+     "it is derived from the message size, the depth of the tree and the\n"
+     "per-message overhead and bandwidth of the transport. \"inf\" disables it",
+     ucs_offsetof(ucg_builtin_config_t, bcast_segment), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"RING_SEGMENT_SIZE", "auto", "Size of the segments each chunk of a ring allreduce is split into, so\n"
+     "that every segment is reduced while the next one is received, and sent on\n"
+     "as soon as it has been reduced. If set to \"auto\", the largest buffer-copy\n"
+     "message of the transport is used",
+     ucs_offsetof(ucg_builtin_config_t, ring_segment), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"INCAST_CREDITS", "0", "Number of fragments each member may send up a fan-in tree (towards a\n"
+     "reduce or gather root) before its parent grants it more, as it consumes them.\n"
+     "This bounds the memory a root of many members uses for messages arriving\n"
+     "before it is ready for them. \"0\" disables this flow-control",
+     ucs_offsetof(ucg_builtin_config_t, incast_credits), UCS_CONFIG_TYPE_UINT},
+
+    {"RNDV_GET_THRESH", "inf", "Smallest broadcast or scatter (per member) for which the root only sends\n"
+     "the address and remote key of its buffer, so that each member reads the\n"
+     "data at its own pace and only reports back once it has - instead of the\n"
+     "root pushing the data to every member. \"inf\" disables it",
+     ucs_offsetof(ucg_builtin_config_t, rndv_get_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"REDUCE_WIDEN", "n", "Accumulate half-precision (fp16 and bfloat16) summations and products\n"
+     "at the waypoints of fan-in trees in single-precision, rounding only the partial\n"
+     "result sent onwards - rather than after adding each child's contribution.\n"
+     "Ignored for recursive (e.g. recursive doubling) and ring algorithms, where every\n"
+     "member calculates the result and all must round it the same way",
+     ucs_offsetof(ucg_builtin_config_t, reduce_widen), UCS_CONFIG_TYPE_BOOL},
+
+    {"REDUCE_THREADS", "0", "Number of helper threads splitting very large reductions with the calling\n"
+     "thread (see REDUCE_THREADS_THRESH). Helpers run on the other cores this process\n"
+     "may run on, preferring those on the caller's NUMA node. \"0\" disables them",
+     ucs_offsetof(ucg_builtin_config_t, reduce_threads), UCS_CONFIG_TYPE_UINT},
+
+    {"REDUCE_THREADS_THRESH", "4m", "Smallest reduction (in bytes) split among the reduction helper threads",
+     ucs_offsetof(ucg_builtin_config_t, reduce_threads_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"REDUCE_THREADS_CHUNK", "256k", "Size of the parts a reduction is split into for the helper threads,\n"
+     "each taking one at a time - best fitting in the caches of a single core",
+     ucs_offsetof(ucg_builtin_config_t, reduce_threads_chunk), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"STREAM_COPY_THRESH", "auto", "Smallest total size of the send and receive buffers of an operation for its\n"
+     "local copies (e.g. the alltoall shuffles) to be made with non-temporal\n"
+     "stores, which bypass the caches rather than evict the application's data\n"
+     "from them. Reductions always use regular stores. If set to \"auto\", half\n"
+     "the size of the last-level cache is used. \"inf\" disables it",
+     ucs_offsetof(ucg_builtin_config_t, stream_copy_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
     // max_short_max threshold change from 256 to 200 to avoid hang problem within rc_x device.
     /* max_am_inline size may be different(dc is 2046 or 186) on mlx dc&rc devices when ppn > 32,
        this may result in erroneous result or hang problem because of mixture use of am_short_one
@@ -80,9 +161,28 @@ static ucs_config_field_t ucg_builtin_config_table[] = {
     {"LARGE_DATATYPE_THRESHOLD", "32", "Large datatype threshold",
      ucs_offsetof(ucg_builtin_config_t, large_datatype_threshold), UCS_CONFIG_TYPE_UINT},
 
-    {"RESEND_TIMER_TICK", "100ms", "Resolution for (async) resend timer",
+    {"RESEND_TIMER_TICK", "100ms", "Resolution for (async) resend timer, a fallback in case\n"
+     "the transport does not call back once it can send again",
      ucs_offsetof(ucg_builtin_config_t, resend_timer_tick), UCS_CONFIG_TYPE_TIME},
 
+    {"CONCURRENT_OPS", "16", "Initial number of slots for outstanding collectives (per group)",
+     ucs_offsetof(ucg_builtin_config_t, concurrent_ops), UCS_CONFIG_TYPE_UINT},
+
+    {"MAX_CONCURRENT_OPS", "128", "Number of slots the per-group window may grow up to,\n"
+     "before further collectives are deferred until a slot is released\n"
+     "(max. 128, unless extended headers are used)",
+     ucs_offsetof(ucg_builtin_config_t, max_concurrent_ops), UCS_CONFIG_TYPE_UINT},
+
+    {"MAX_RETAINED_DESCS", "256", "Number of transport receive descriptors a group may hold on to, for\n"
+     "messages arriving ahead of their step - beyond it such messages are copied",
+     ucs_offsetof(ucg_builtin_config_t, max_retained_descs), UCS_CONFIG_TYPE_UINT},
+
+    {"HEADER_EXT", "auto", "Use extended message headers (8 more bytes per message),\n"
+     "lifting the limits on step count, buffer size and MAX_CONCURRENT_OPS.\n"
+     "If set to \"auto\", only groups with more members (or a wider window)\n"
+     "than the compact header can address would use them",
+     ucs_offsetof(ucg_builtin_config_t, header_ext), UCS_CONFIG_TYPE_ON_OFF_AUTO},
+
 #if ENABLE_FAULT_TOLERANCE
     {"FT_TIMER_TICK", "100ms", "Resolution for (async) fault-tolerance timer",
      ucs_offsetof(ucg_builtin_config_t, ft_timer_tick), UCS_CONFIG_TYPE_TIME},
@@ -104,15 +204,17 @@ struct ucg_builtin_algorithm ucg_algo = {
     .feature_flag = UCG_ALGORITHM_SUPPORT_COMMON_FEATURE,
 };
 
+KHASH_MAP_INIT_INT64(ucg_builtin_rails, ucg_builtin_plan_rails_t*)
+
 struct ucg_builtin_group_ctx {
     /*
-     * The following is the key structure of a group - an array of outstanding
+     * The following is the key structure of a group - a window of outstanding
      * collective operations, one slot per operation. Messages for future ops
      * may be stored in a slot before the operation actually starts.
      *
-     * TODO: support more than this amount of concurrent operations...
+     * Note: must remain the first member (see UCG_BUILTIN_OP_GET_WINDOW).
      */
-    ucg_builtin_comp_slot_t   slots[UCG_BUILTIN_MAX_CONCURRENT_OPS];
+    ucg_builtin_comp_window_t window;
 
     /* Mostly control-path, from here on */
     ucg_builtin_ctx_t        *bctx;          /**< global context */
@@ -122,8 +224,10 @@ struct ucg_builtin_group_ctx {
     const ucg_group_params_t *group_params;  /**< the original group parameters */
     ucg_group_member_index_t  host_proc_cnt; /**< Number of intra-node processes */
     ucg_group_id_t            group_id;      /**< Group identifier */
+    uint8_t                   header_length; /**< incl. the extended header */
     ucs_list_link_t           plan_head;     /**< list of plans (for cleanup) */
     ucs_ptr_array_t           faults;        /**< flexible array of faulty members */
+    khash_t(ucg_builtin_rails) rails;        /**< extra lanes, by phase endpoint */
     int                       timer_id;      /**< Async. progress timer ID */
 #if ENABLE_FAULT_TOLERANCE
     int                       ft_timer_id;   /**< Fault-tolerance timer ID */
@@ -170,13 +274,30 @@ enum ucg_builtin_plan_topology_type ucg_builtin_choose_type(enum ucg_collective_
     return UCG_PLAN_TREE_FANIN_FANOUT;
 }
 
-UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
-                 (ctx, data, length, am_flags),
-                 void *ctx, void *data, size_t length, unsigned am_flags)
+static UCS_F_ALWAYS_INLINE void
+ucg_builtin_msg_store(ucg_builtin_group_ctx_t *gctx,
+                      ucg_builtin_comp_slot_t *slot, ucs_ptr_array_t *msg_array,
+                      uint32_t msg_key, ucp_recv_desc_t *rdesc)
+{
+    if (slot == NULL) {
+        /* The group does not exist yet, so neither do its slots */
+        (void) ucs_ptr_array_insert(msg_array, rdesc);
+    } else {
+        ucs_queue_push(ucg_builtin_comp_window_queue(&gctx->window, slot,
+                                                     msg_key),
+                       &rdesc->tag_frag_queue);
+    }
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+ucg_builtin_am_handler_common(void *ctx, void *data, size_t length,
+                              unsigned am_flags, int is_ext)
 {
     int is_shifted;
+    int can_retain;
     int data_offset;
     int is_unexpected;
+    uint32_t msg_key;
     ucs_status_t status;
     ucp_worker_h worker;
     ucp_recv_desc_t *rdesc;
@@ -188,11 +309,14 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
     ucg_builtin_comp_slot_t *slot;
     ucg_builtin_group_ctx_t *gctx;
     ucg_builtin_header_t header;
+    ucg_builtin_header_ext_t ext;
     ucg_builtin_ctx_t *bctx = ctx;
+    size_t header_length    = sizeof(header) + (is_ext ? sizeof(ext) : 0);
 
-    ucs_assert(length >= sizeof(header));
+    ucs_assert(length >= header_length);
     header.header = ((ucg_builtin_header_t*)data)->header;
     ucs_assert(header.header != 0); /* group_id >= UCG_GROUP_FIRST_GROUP_ID */
+    ext.header    = is_ext ? ((ucg_builtin_header_ext_t*)data)[1].header : 0;
 
     /* Find the Group context, based on the ID received in the header */
     group_id = header.group_id;
@@ -204,16 +328,29 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
                 UCS_PTR_ARRAY_LOCKED_FLAG_KEEP_LOCK_IF_NOT_FOUND, (void**)&gctx))) {
         /* Find the slot to be used, based on the ID received in the header */
         ucg_coll_id_t coll_id = header.msg.coll_id;
-        slot = &gctx->slots[coll_id % UCG_BUILTIN_MAX_CONCURRENT_OPS];
-        ucs_assert((slot->req.expecting.coll_id != coll_id) ||
+        if (is_ext) {
+            coll_id |= (ucg_coll_id_t)ext.msg_hi.coll_id <<
+                       UCG_BUILTIN_HEADER_EXT_SHIFT;
+        }
+
+        ucs_assert(gctx->window.am_id == (is_ext ? bctx->am_id_ext :
+                                                   bctx->am_id));
+        slot = ucg_builtin_comp_window_slot(&gctx->window, coll_id);
+        ucs_assert((slot->req.expecting.coll_id != header.msg.coll_id) ||
                    (slot->req.expecting.step_idx <= header.msg.step_idx));
 
         /* Consume the message if it fits the current collective and step index */
-        if (ucs_likely(header.msg.local_id == slot->req.expecting.local_id) ||
+        if (ucs_likely((header.msg.local_id == slot->req.expecting.local_id) &&
+                       (!is_ext || (ext.msg_hi.local_id ==
+                                    slot->req.expecting_hi.local_id))) ||
             ucs_unlikely(slot->req.flags & UCG_BUILTIN_REQUEST_FLAG_HANDLE_OOO)) {
             /* Make sure the packet indeed belongs to the collective currently on */
-            data    = ((ucg_builtin_header_t*)data) + 1;
-            length -= sizeof(ucg_builtin_header_t);
+            if (is_ext) {
+                slot->req.offset_hi = ext.remote_offset_hi;
+            }
+
+            data    = UCS_PTR_BYTE_OFFSET(data, header_length);
+            length -= header_length;
 
             ucs_trace_req("ucg_builtin_am_handler CB: coll_id %u step_idx %u pending %u",
                           header.msg.coll_id, header.msg.step_idx, slot->req.pending);
@@ -225,13 +362,28 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
         }
 
         is_unexpected = 0;
-        msg_array     = &slot->messages;
+        can_retain    = (gctx->window.desc_budget > 0);
+        msg_array     = NULL;
+        msg_key       = UCG_BUILTIN_MSG_KEY(header.msg.local_id, is_ext ?
+                                            ext.msg_hi.local_id : 0);
 #ifdef HAVE_UCT_COLLECTIVES
         cnt           = (am_flags & UCT_CB_PARAM_FLAG_STRIDE) ?
                         (gctx->group_params->member_count - 1) : 0;
 #else
         cnt           = 1;
 #endif
+
+        if (
+#ifdef HAVE_UCT_COLLECTIVES
+            !(am_flags & (UCT_CB_PARAM_FLAG_STRIDE | UCT_CB_PARAM_FLAG_SHIFTED)) &&
+#endif
+            ucg_builtin_step_place_early(&slot->req, header, ext, is_ext,
+                                         UCS_PTR_BYTE_OFFSET(data, header_length),
+                                         length - header_length)) {
+            /* A later step of the running collective - written in-place */
+            return UCS_OK;
+        }
+
         ucs_trace_req("ucg_builtin_am_handler STORE: group_id %u "
                       "coll_id %u expected_id %u step_idx %u expected_idx %u",
                       header.group_id, header.msg.coll_id, slot->req.expecting.coll_id,
@@ -250,6 +402,9 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
         ucs_assert((am_flags & UCT_CB_PARAM_FLAG_STRIDE) == 0);
 #endif
         cnt           = 1;
+        can_retain    = 1;
+        slot          = NULL;
+        msg_key       = 0;
         is_unexpected = 1;
         tmp_array     = UCS_ALLOC_CHECK(sizeof(*msg_array), "unexpected group");
         ucs_ptr_array_init(tmp_array, "unexpected group messages");
@@ -268,18 +423,34 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
 #endif
 
     if (ucs_likely((am_flags & UCT_CB_PARAM_FLAG_DESC) && (cnt == 1))) {
+        if (ucs_unlikely(!can_retain)) {
+            /* Over the budget - copy, so the transport gets its descriptor back */
+            status = ucp_recv_desc_init(bctx->worker, data, length, 0,
+                                        am_flags & ~UCT_CB_PARAM_FLAG_DESC,
+                                        0, 0, 0, bctx->worker->am.alignment,
+                                        &rdesc);
+            if (ucs_likely(!UCS_STATUS_IS_ERR(status))) {
+                ucg_builtin_msg_store(gctx, slot, msg_array, msg_key, rdesc);
+            }
+            goto handled;
+        }
+
+        /* Keep the transport's descriptor, instead of copying the payload */
         rdesc                      = ((ucp_recv_desc_t*)data) - 1;
         rdesc->length              = length;
         rdesc->release_desc_offset = UCP_WORKER_HEADROOM_PRIV_SIZE;
         rdesc->flags               = UCP_RECV_DESC_FLAG_UCT_DESC;
-        (void) ucs_ptr_array_insert(msg_array, rdesc);
+        ucg_builtin_msg_store(gctx, slot, msg_array, msg_key, rdesc);
+        if (!is_unexpected) {
+            gctx->window.desc_budget--;
+        }
 
         status = UCS_INPROGRESS;
         goto handled;
     }
 
     /* Strided short messages might come with the header set only in item #0 */
-    data_offset = (am_flags & UCT_CB_PARAM_FLAG_DESC) ? 0 : sizeof(header);
+    data_offset = (am_flags & UCT_CB_PARAM_FLAG_DESC) ? 0 : header_length;
     worker      = bctx->worker;
     length     -= data_offset;
     idx         = 0;
@@ -294,10 +465,13 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
 
         if (data_offset) {
             ((ucg_builtin_header_t*)(rdesc + 1))->header = header.header;
+            if (is_ext) {
+                ((ucg_builtin_header_ext_t*)(rdesc + 1))[1].header = ext.header;
+            }
         }
 
         /* Store the message pointer (the relevant step hasn't been reached) */
-        (void) ucs_ptr_array_insert(msg_array, rdesc);
+        ucg_builtin_msg_store(gctx, slot, msg_array, msg_key, rdesc);
 
         /* Skip to next chuck of data (STRIDE-only) */
         data = UCS_PTR_BYTE_OFFSET(data, length);
@@ -311,6 +485,20 @@ handled:
     return status;
 }
 
+UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
+                 (ctx, data, length, am_flags),
+                 void *ctx, void *data, size_t length, unsigned am_flags)
+{
+    return ucg_builtin_am_handler_common(ctx, data, length, am_flags, 0);
+}
+
+UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler_ext,
+                 (ctx, data, length, am_flags),
+                 void *ctx, void *data, size_t length, unsigned am_flags)
+{
+    return ucg_builtin_am_handler_common(ctx, data, length, am_flags, 1);
+}
+
 static void ucg_builtin_msg_dump(void *arg, uct_am_trace_type_t type,
                                  uint8_t id, const void *data, size_t length,
                                  char *buffer, size_t max)
@@ -321,6 +509,22 @@ static void ucg_builtin_msg_dump(void *arg, uct_am_trace_type_t type,
              (uint64_t)header->remote_offset, length - sizeof(*header));
 }
 
+static void ucg_builtin_msg_dump_ext(void *arg, uct_am_trace_type_t type,
+                                     uint8_t id, const void *data, size_t length,
+                                     char *buffer, size_t max)
+{
+    const ucg_builtin_header_t *header  = (const ucg_builtin_header_t*)data;
+    const ucg_builtin_header_ext_t *ext = (const ucg_builtin_header_ext_t*)
+                                          (header + 1);
+    snprintf(buffer, max, "COLLECTIVE [coll_id %u step_idx %u offset %lu length %lu]",
+             (unsigned)ucg_builtin_header_coll_id(header, 1),
+             (unsigned)header->msg.step_idx |
+             ((unsigned)ext->msg_hi.step_idx << UCG_BUILTIN_HEADER_EXT_SHIFT),
+             (uint64_t)header->remote_offset |
+             ((uint64_t)ext->remote_offset_hi << 32),
+             length - sizeof(*header) - sizeof(*ext));
+}
+
 static ucs_status_t ucg_builtin_query(ucg_plan_desc_t *descs,
                                       unsigned *desc_cnt_p)
 {
@@ -336,11 +540,60 @@ static ucs_status_t ucg_builtin_query(ucg_plan_desc_t *descs,
     return status;
 }
 
+/*
+ * Finds the size of the last-level cache, i.e. the highest level listed for
+ * the first core in sysfs - or 0 if it is unknown.
+ */
+static size_t ucg_builtin_get_llc_size(void)
+{
+    char path[64];
+    FILE *file;
+    int index, level, max_level = 0;
+    size_t size, llc_size = 0;
+
+    for (index = 0; ; index++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        file = fopen(path, "r");
+        if (file == NULL) {
+            break;
+        }
+
+        if (fscanf(file, "%d", &level) != 1) {
+            level = 0;
+        }
+        fclose(file);
+
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+
+        if ((fscanf(file, "%zuK", &size) == 1) && (level >= max_level)) {
+            max_level = level;
+            llc_size  = size * UCS_KBYTE;
+        }
+        fclose(file);
+    }
+
+    return llc_size;
+}
+
 static ucs_status_t ucg_builtin_init_plan_config(ucg_builtin_config_t *config)
 {
+    size_t llc_size;
+
     config->cache_size = CACHE_SIZE;
     config->pipelining = 0;
 
+    if (config->stream_copy_thresh == UCS_MEMUNITS_AUTO) {
+        llc_size = ucg_builtin_get_llc_size();
+        config->stream_copy_thresh = (llc_size > 0) ? (llc_size / 2) :
+                                     UCS_MEMUNITS_INF;
+    }
+
     /* K-nomial tree algorithm require all K vaule is bigger than 1 */
     if (config->bmtree.degree_inter_fanout <= 1 || config->bmtree.degree_inter_fanin <= 1 ||
         config->bmtree.degree_intra_fanout <= 1 || config->bmtree.degree_intra_fanin <= 1) {
@@ -366,12 +619,149 @@ ucg_builtin_calc_host_proc_cnt(const ucg_group_params_t *group_params)
     return ucg_group_count_ppx(group_params, UCG_GROUP_MEMBER_DISTANCE_HOST, NULL);
 }
 
+/*
+ * Decide whether the group uses extended headers. The decision only depends on
+ * the configuration and the group size, so all the members reach the same one
+ * without exchanging any messages. Above this many members a ring may take
+ * more steps than the compact (8-bit) step index can tell apart.
+ */
+#define UCG_BUILTIN_HEADER_COMPACT_MAX_MEMBERS (128)
+
+static int ucg_builtin_use_header_ext(const ucg_builtin_config_t *config,
+                                      const ucg_group_params_t *group_params)
+{
+    switch (config->header_ext) {
+    case UCS_CONFIG_ON:
+        return 1;
+
+    case UCS_CONFIG_OFF:
+        if (config->max_concurrent_ops > UCG_BUILTIN_MAX_CONCURRENT_OPS) {
+            ucs_warn("BUILTIN_MAX_CONCURRENT_OPS is limited to %u without "
+                     "extended headers", (unsigned)UCG_BUILTIN_MAX_CONCURRENT_OPS);
+        }
+        return 0;
+
+    default:
+        return (config->max_concurrent_ops > UCG_BUILTIN_MAX_CONCURRENT_OPS) ||
+               (group_params->member_count >
+                UCG_BUILTIN_HEADER_COMPACT_MAX_MEMBERS);
+    }
+}
+
+/*
+ * A request waiting on the pending queue of the endpoint it ran out of
+ * resources on, to be resent as soon as that endpoint can send again - so the
+ * resend does not have to wait for the (much coarser) timer. It is allocated
+ * apart from the request, so that the request's slot can be released while
+ * the transport still holds on to this (see ucg_builtin_comp_window_cleanup).
+ */
+struct ucg_builtin_resend {
+    uct_pending_req_t      super;
+    uct_ep_h               ep;      /**< whose pending queue this is on */
+    uct_ep_h               last_ep; /**< where the last attempt ran out */
+    ucg_builtin_request_t *req;     /**< NULL once the request is released */
+};
+
+static ucs_status_t ucg_builtin_req_resend_cb(uct_pending_req_t *self);
+
+/*
+ * Take a request off the resend queue and resend it right away, rather than
+ * upon the next progress (or timer) - e.g. once the transport can send again,
+ * or once the parent has granted it the credits it ran out of. Returns whether
+ * it was waiting to be resent at all.
+ */
+int ucg_builtin_req_resend(ucg_builtin_request_t *req)
+{
+    ucg_builtin_group_ctx_t *gctx = req->op->gctx;
+
+    UCS_ASYNC_BLOCK(&gctx->worker->async);
+    if (!(req->flags & UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED)) {
+        UCS_ASYNC_UNBLOCK(&gctx->worker->async);
+        return 0;
+    }
+
+    ucs_queue_remove(&gctx->resend_head, &req->resend_queue);
+    req->flags &= ~UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED;
+    UCS_ASYNC_UNBLOCK(&gctx->worker->async);
+
+    (void) ucg_builtin_step_execute(req, req->step->am_header);
+    return 1;
+}
+
+static void ucg_builtin_req_resend_wait(ucg_builtin_request_t *req, uct_ep_h ep)
+{
+    ucg_builtin_resend_t *resend = ucs_malloc(sizeof(*resend),
+                                              "ucg_builtin_resend");
+    if (resend == NULL) {
+        return; /* the resend queue (and its timer) would do */
+    }
+
+    resend->super.func = ucg_builtin_req_resend_cb;
+    resend->ep         = ep;
+    resend->last_ep    = ep;
+    resend->req        = req;
+
+    if (uct_ep_pending_add(ep, &resend->super, 0) != UCS_OK) {
+        ucs_free(resend); /* it can already send - progress will resend it */
+        return;
+    }
+
+    req->resend = resend;
+    req->flags |= UCG_BUILTIN_REQUEST_FLAG_RESEND_PENDING;
+}
+
+/*
+ * Called by the transport, from within its progress. The request may have
+ * been resent by then, from the resend queue, in which case there is nothing
+ * left to do. If the resend runs out of resources again - it either stays on
+ * this endpoint's queue, or moves to that of the endpoint it ran out on.
+ */
+static ucs_status_t ucg_builtin_req_resend_cb(uct_pending_req_t *self)
+{
+    ucg_builtin_group_ctx_t *gctx;
+    ucg_builtin_resend_t *resend = ucs_derived_of(self, ucg_builtin_resend_t);
+    ucg_builtin_request_t *req   = resend->req;
+
+    if (req == NULL) {
+        ucs_free(resend);
+        return UCS_OK;
+    }
+
+    gctx            = req->op->gctx;
+    resend->last_ep = resend->ep;
+    if (ucg_builtin_req_resend(req) &&
+        (req->flags & UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED) &&
+        (resend->last_ep == resend->ep)) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    UCS_ASYNC_BLOCK(&gctx->worker->async);
+    req->flags &= ~UCG_BUILTIN_REQUEST_FLAG_RESEND_PENDING;
+    req->resend = NULL;
+    if (req->flags & UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED) {
+        ucg_builtin_req_resend_wait(req, resend->last_ep);
+    }
+    UCS_ASYNC_UNBLOCK(&gctx->worker->async);
+
+    ucs_free(resend);
+    return UCS_OK;
+}
+
 void ucg_builtin_req_enqueue_resend(ucg_builtin_group_ctx_t *gctx,
-                                    ucg_builtin_request_t *req)
+                                    ucg_builtin_request_t *req,
+                                    uct_ep_h ep)
 {
     UCS_ASYNC_BLOCK(&gctx->worker->async);
 
     ucs_queue_push(&gctx->resend_head, &req->resend_queue);
+    req->flags |= UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED;
+
+    /* Ask the transport to call back as soon as it can send again */
+    if (!(req->flags & UCG_BUILTIN_REQUEST_FLAG_RESEND_PENDING)) {
+        ucg_builtin_req_resend_wait(req, ep);
+    } else {
+        req->resend->last_ep = ep; /* checked by ucg_builtin_req_resend_cb */
+    }
 
     UCS_ASYNC_UNBLOCK(&gctx->worker->async);
 }
@@ -386,6 +776,7 @@ void ucg_builtin_async_resend(ucg_builtin_group_ctx_t *gctx)
     ucs_queue_splice(&resent, &gctx->resend_head);
 
     ucs_queue_for_each_extract(req, &resent, resend_queue, 1==1) {
+        req->flags &= ~UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED;
         (void) ucg_builtin_step_execute(req, req->step->am_header);
     }
 }
@@ -402,6 +793,293 @@ static void ucg_builtin_async_check(int id, ucs_event_set_types_t events, void *
     ucg_builtin_async_resend(gctx);
 }
 
+static ucg_builtin_comp_slot_t*
+ucg_builtin_comp_slot_alloc(const ucg_builtin_comp_window_t *window)
+{
+    ucg_builtin_comp_slot_t *slot;
+
+    if (ucs_posix_memalign((void**)&slot, UCS_SYS_CACHE_LINE_SIZE,
+                           sizeof(*slot), "builtin slot")) {
+        return NULL;
+    }
+
+    slot->req.expecting.local_id = 0;
+    slot->req.flags              = window->slot_flags;
+    slot->req.am_id              = window->am_id;
+    kh_init_inplace(ucg_builtin_msg, &slot->messages);
+
+    return slot;
+}
+
+static ucs_status_t ucg_builtin_comp_window_init(ucg_builtin_comp_window_t *window,
+                                                 const ucg_builtin_config_t *config,
+                                                 uint16_t am_id, int is_ext)
+{
+    unsigned i, slot_cnt, max_cnt;
+
+    max_cnt  = ucs_min(ucs_roundup_pow2(ucs_max(config->max_concurrent_ops, 1)),
+                       is_ext ? UCG_BUILTIN_MAX_CONCURRENT_OPS_EXT :
+                                UCG_BUILTIN_MAX_CONCURRENT_OPS);
+    slot_cnt = ucs_min(ucs_roundup_pow2(ucs_max(config->concurrent_ops, 1)),
+                       max_cnt);
+
+    window->am_id       = am_id;
+    window->slot_flags  = is_ext ? UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT : 0;
+    window->desc_budget = config->max_retained_descs;
+    window->slots      = ucs_malloc(slot_cnt * sizeof(*window->slots),
+                                    "builtin slot window");
+    if (window->slots == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < slot_cnt; i++) {
+        window->slots[i] = ucg_builtin_comp_slot_alloc(window);
+        if (window->slots[i] == NULL) {
+            goto err_free_slots;
+        }
+    }
+
+    window->mask        = slot_cnt - 1;
+    window->max_mask    = max_cnt - 1;
+    window->progress_id = UCS_CALLBACKQ_ID_NULL;
+    ucs_queue_head_init(&window->pending);
+    ucs_queue_head_init(&window->overflow);
+
+    return UCS_OK;
+
+err_free_slots:
+    while (i--) {
+        kh_destroy_inplace(ucg_builtin_msg, &window->slots[i]->messages);
+        ucs_free(window->slots[i]);
+    }
+    ucs_free(window->slots);
+    return UCS_ERR_NO_MEMORY;
+}
+
+/*
+ * Double the amount of slots. Each existing slot is either kept in place or
+ * moved to its "twin" (index + old count) according to the coll_id it is
+ * currently serving, and the stored messages which now belong to the other
+ * slot of the pair are moved there. Only pointers to slots are moved, so the
+ * requests inside them (referenced by the transports) stay where they are.
+ */
+static ucs_status_t ucg_builtin_comp_window_grow(ucg_builtin_group_ctx_t *gctx)
+{
+    unsigned i;
+    khiter_t iter;
+    ucp_recv_desc_t *rdesc;
+    ucs_queue_head_t *queue;
+    ucg_builtin_header_t *header;
+    ucg_builtin_comp_slot_t **slots;
+    ucg_builtin_comp_slot_t *slot, *twin, *target;
+
+    ucg_builtin_comp_window_t *window = &gctx->window;
+    unsigned old_cnt                  = window->mask + 1;
+    unsigned new_mask                 = (old_cnt << 1) - 1;
+    int is_ext                        = window->slot_flags &
+                                        UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT;
+
+    ucs_assert(window->mask < window->max_mask);
+
+    slots = ucs_malloc((new_mask + 1) * sizeof(*slots), "builtin slot window");
+    if (slots == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < old_cnt; i++) {
+        slots[i + old_cnt] = ucg_builtin_comp_slot_alloc(window);
+        if (slots[i + old_cnt] == NULL) {
+            while (i--) {
+                kh_destroy_inplace(ucg_builtin_msg, &slots[i + old_cnt]->messages);
+                ucs_free(slots[i + old_cnt]);
+            }
+            ucs_free(slots);
+            return UCS_ERR_NO_MEMORY;
+        }
+    }
+
+    UCS_ASYNC_BLOCK(&gctx->worker->async);
+
+    for (i = 0; i < old_cnt; i++) {
+        slot = window->slots[i];
+        twin = slots[i + old_cnt];
+        if ((slot->req.expecting.local_id != 0) &&
+            (ucg_builtin_req_coll_id(&slot->req) & old_cnt)) {
+            slots[i]           = twin;
+            slots[i + old_cnt] = slot;
+        } else {
+            slots[i]           = slot;
+        }
+
+        /* All the messages queued under one key share the same coll_id */
+        for (iter = kh_begin(&slot->messages);
+             iter != kh_end(&slot->messages); iter++) {
+            if (!kh_exist(&slot->messages, iter)) {
+                continue;
+            }
+
+            queue  = &kh_val(&slot->messages, iter);
+            rdesc  = ucs_queue_head_elem_non_empty(queue, ucp_recv_desc_t,
+                                                   tag_frag_queue);
+            header = (ucg_builtin_header_t*)(rdesc + 1);
+            target = slots[ucg_builtin_header_coll_id(header, is_ext) & new_mask];
+            if (target != slot) {
+                ucg_builtin_comp_window_splice(window, target,
+                        kh_key(&slot->messages, iter), queue);
+                kh_del(ucg_builtin_msg, &slot->messages, iter);
+            }
+        }
+    }
+
+    ucs_free(window->slots);
+    window->slots = slots;
+    window->mask  = new_mask;
+
+    UCS_ASYNC_UNBLOCK(&gctx->worker->async);
+
+    ucs_debug("group #%u: grew the collective window to %u slots",
+              gctx->group_id, new_mask + 1);
+
+    return UCS_OK;
+}
+
+static unsigned ucg_builtin_comp_window_progress(void *arg)
+{
+    ucs_queue_head_t deferred;
+    ucg_builtin_op_t *op;
+    ucg_builtin_comp_slot_t *slot;
+
+    unsigned count                    = 0;
+    ucg_builtin_group_ctx_t *gctx     = arg;
+    ucg_builtin_comp_window_t *window = &gctx->window;
+
+    ucs_queue_head_init(&deferred);
+    ucs_queue_splice(&deferred, &window->pending);
+
+    while (!ucs_queue_is_empty(&deferred)) {
+        op   = ucs_container_of(ucs_queue_pull_non_empty(&deferred),
+                                ucg_builtin_op_t, super.queue);
+        slot = ucg_builtin_comp_window_slot(window, op->pending_id);
+        if (slot->req.expecting.local_id != 0) {
+            ucs_queue_push(&window->pending, &op->super.queue);
+            continue;
+        }
+
+        /* Errors are reported through the request, as with async. sends */
+        (void) ucg_builtin_op_resume(op, slot);
+        count++;
+    }
+
+    if (ucs_queue_is_empty(&window->pending)) {
+        uct_worker_progress_unregister_safe(gctx->worker->uct,
+                                            &window->progress_id);
+    }
+
+    return count;
+}
+
+ucs_status_t ucg_builtin_comp_window_defer(ucg_builtin_group_ctx_t *gctx,
+                                           ucg_builtin_op_t *op,
+                                           ucg_coll_id_t coll_id,
+                                           void *request)
+{
+    ucg_builtin_comp_slot_t *slot;
+    ucg_builtin_comp_window_t *window = &gctx->window;
+
+    op->pending_id        = coll_id;
+    op->super.pending_req = request;
+
+    /* Widen the window, if allowed, so the operation can start right away */
+    while ((window->mask < window->max_mask) &&
+           (ucg_builtin_comp_window_grow(gctx) == UCS_OK)) {
+        slot = ucg_builtin_comp_window_slot(window, coll_id);
+        if (slot->req.expecting.local_id == 0) {
+            return ucg_builtin_op_resume(op, slot);
+        }
+    }
+
+    ucs_trace_req("deferring collective #%u on group #%u (%u slots in use)",
+                  (unsigned)coll_id, gctx->group_id, window->mask + 1);
+
+    /* Start it later, once the worker's progress finds its slot available */
+    op->current = NULL;
+    ucs_queue_push(&window->pending, &op->super.queue);
+    uct_worker_progress_register_safe(gctx->worker->uct,
+                                      ucg_builtin_comp_window_progress, gctx,
+                                      0, &window->progress_id);
+
+    return UCS_INPROGRESS;
+}
+
+static void ucg_builtin_comp_window_cleanup(ucg_builtin_group_ctx_t *gctx)
+{
+    unsigned i;
+    khiter_t iter;
+    ucp_recv_desc_t *rdesc;
+    ucs_queue_head_t *queue;
+    ucg_builtin_comp_slot_t *slot;
+    ucg_builtin_comp_window_t *window = &gctx->window;
+
+    uct_worker_progress_unregister_safe(gctx->worker->uct, &window->progress_id);
+    if (!ucs_queue_is_empty(&window->pending)) {
+        ucs_warn("Some deferred collective operations were never started "
+                 "(Group #%u)", gctx->group_id);
+    }
+
+    /* Cleanup left-over messages and outstanding operations */
+    ucg_builtin_comp_window_retry(window);
+    if (!ucs_queue_is_empty(&window->overflow)) {
+        ucs_warn("Some stored collective messages were never consumed "
+                 "(Group #%u)", gctx->group_id);
+        ucs_queue_for_each_extract(rdesc, &window->overflow, tag_frag_queue, 1) {
+#ifdef HAVE_UCP_EXTENSIONS
+            if (!(rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC_SHARED))
+#endif
+            ucg_builtin_release_comp_desc(window, rdesc, NULL);
+        }
+    }
+
+    for (i = 0; i <= window->mask; i++) {
+        slot = window->slots[i];
+        if (slot->req.expecting.local_id != 0) {
+            ucs_warn("Collective operation #%u has been left incomplete (Group #%u)",
+                    ucg_builtin_req_coll_id(&slot->req), gctx->group_id);
+        }
+
+        for (iter = kh_begin(&slot->messages);
+             iter != kh_end(&slot->messages); iter++) {
+            if (!kh_exist(&slot->messages, iter)) {
+                continue;
+            }
+
+            queue = &kh_val(&slot->messages, iter);
+            ucs_queue_for_each_extract(rdesc, queue, tag_frag_queue, 1) {
+                ucs_warn("Collective operation #%u still has a pending message for"
+                         "step #%u (Group #%u)",
+                         ((ucg_builtin_header_t*)(rdesc + 1))->msg.coll_id,
+                         ((ucg_builtin_header_t*)(rdesc + 1))->msg.step_idx,
+                         ((ucg_builtin_header_t*)(rdesc + 1))->group_id);
+#ifdef HAVE_UCP_EXTENSIONS
+                /* No UCT interface information, we can't release if it's shared */
+                if (!(rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC_SHARED))
+#endif
+                ucg_builtin_release_comp_desc(window, rdesc, NULL);
+            }
+        }
+        kh_destroy_inplace(ucg_builtin_msg, &slot->messages);
+
+        if (ucs_unlikely(slot->req.flags &
+                         UCG_BUILTIN_REQUEST_FLAG_RESEND_PENDING)) {
+            /* The transport still holds the resend - which finds no request */
+            slot->req.resend->req = NULL;
+        }
+
+        ucs_free(slot);
+    }
+
+    ucs_free(window->slots);
+}
+
 #if ENABLE_FAULT_TOLERANCE
 static void ucg_builtin_async_ft(int id, ucs_event_set_types_t events, void *arg)
 {
@@ -426,7 +1104,12 @@ static void ucg_builtin_async_ft(int id, ucs_event_set_types_t events, void *arg
 
 static unsigned ucg_builtin_op_progress(ucg_coll_h op)
 {
-    ucg_builtin_op_t *builtin_op        = (ucg_builtin_op_t*)op;
+    ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t*)op;
+    if (ucs_unlikely(builtin_op->current == NULL)) {
+        /* Deferred - the worker starts it once a slot becomes available */
+        return ucp_worker_progress(builtin_op->gctx->worker);
+    }
+
     ucg_builtin_op_step_t *current_step = *(builtin_op->current);
     uct_iface_progress_func_t progress  = current_step->uct_progress;
 
@@ -453,8 +1136,13 @@ static ucs_status_t ucg_builtin_init(ucg_plan_ctx_h pctx,
                                      ucg_plan_config_t *config)
 {
     ucg_builtin_ctx_t *bctx = pctx;
-    bctx->am_id             = *params->am_id;
-    ++*params->am_id;
+    bctx->am_id             = (*params->am_id)++;
+    bctx->am_id_ext         = (*params->am_id)++;
+    bctx->calibrated        = NULL;
+    bctx->calibrated_cnt    = 0;
+    bctx->rcaches           = NULL;
+    bctx->rcache_cnt        = 0;
+    bctx->reduce_pool       = NULL;
 
 #if ENABLE_FAULT_TOLERANCE
     if (ucg_params.fault.mode > UCG_FAULT_IS_FATAL) {
@@ -473,19 +1161,50 @@ static ucs_status_t ucg_builtin_init(ucg_plan_ctx_h pctx,
         return status;
     }
 
+    if (bctx->config.reduce_threads > 0) {
+        status = ucg_builtin_reduce_pool_create(bctx->config.reduce_threads,
+                                                bctx->config.reduce_threads_chunk,
+                                                bctx->config.reduce_threads_thresh,
+                                                &bctx->reduce_pool);
+        if (status != UCS_OK) {
+            ucs_warn("reductions will not use helper threads");
+            bctx->reduce_pool = NULL;
+        }
+    }
+
     ucs_ptr_array_locked_init(&bctx->group_by_id, "builtin_group_table");
     ucs_ptr_array_locked_init(&bctx->unexpected, "builtin_unexpected_table");
 
-    return ucg_context_set_am_handler(pctx, bctx->am_id,
-                                      ucg_builtin_am_handler,
-                                      ucg_builtin_msg_dump);
+    status = ucg_context_set_am_handler(pctx, bctx->am_id,
+                                        ucg_builtin_am_handler,
+                                        ucg_builtin_msg_dump);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    return ucg_context_set_am_handler(pctx, bctx->am_id_ext,
+                                      ucg_builtin_am_handler_ext,
+                                      ucg_builtin_msg_dump_ext);
 }
 
 static void ucg_builtin_finalize(ucg_plan_ctx_h pctx)
 {
+    unsigned i;
     ucg_builtin_ctx_t *bctx = pctx;
     ucs_ptr_array_locked_cleanup(&bctx->unexpected);
     ucs_ptr_array_locked_cleanup(&bctx->group_by_id);
+    ucs_free(bctx->calibrated);
+
+    for (i = 0; i < bctx->rcache_cnt; i++) {
+        if (bctx->rcaches[i].rcache != NULL) {
+            ucs_rcache_destroy(bctx->rcaches[i].rcache);
+        }
+    }
+    ucs_free(bctx->rcaches);
+
+    if (bctx->reduce_pool != NULL) {
+        ucg_builtin_reduce_pool_destroy(bctx->reduce_pool);
+    }
 }
 
 static ucs_status_t ucg_builtin_create(ucg_plan_ctx_h pctx,
@@ -517,6 +1236,7 @@ static ucs_status_t ucg_builtin_create(ucg_plan_ctx_h pctx,
 
     ucs_list_head_init(&gctx->plan_head);
     ucs_queue_head_init(&gctx->resend_head);
+    kh_init_inplace(ucg_builtin_rails, &gctx->rails);
     ucs_assert_always(((uintptr_t)gctx % UCS_SYS_CACHE_LINE_SIZE) == 0);
 
     ucs_time_t interval = ucs_time_from_sec(bctx->config.resend_timer_tick);
@@ -539,12 +1259,15 @@ static ucs_status_t ucg_builtin_create(ucg_plan_ctx_h pctx,
 
     /* Initialize collective operation slots, incl. already pending messages */
     unsigned i;
-    for (i = 0; i < UCG_BUILTIN_MAX_CONCURRENT_OPS; i++) {
-        ucg_builtin_comp_slot_t *slot = &gctx->slots[i];
-        slot->req.expecting.local_id  = 0;
-        slot->req.am_id               = bctx->am_id;
-
-        ucs_ptr_array_init(&slot->messages, "builtin messages");
+    int is_ext = ucg_builtin_use_header_ext(&bctx->config, params);
+    gctx->header_length = sizeof(ucg_builtin_header_t) +
+                          (is_ext ? sizeof(ucg_builtin_header_ext_t) : 0);
+    status = ucg_builtin_comp_window_init(&gctx->window, &bctx->config,
+                                          is_ext ? bctx->am_id_ext : bctx->am_id,
+                                          is_ext);
+    if (status != UCS_OK) {
+        ucg_context_unset_async_timer(async, gctx->timer_id);
+        return status;
     }
 
     /* Only now, when the slots and message arrays are ready, it "goes live" */
@@ -559,13 +1282,20 @@ static ucs_status_t ucg_builtin_create(ucg_plan_ctx_h pctx,
 
         ucp_recv_desc_t *rdesc;
         ucg_builtin_header_t *header;
+        ucg_builtin_comp_slot_t *slot;
         ucs_ptr_array_for_each(rdesc, i, unexpected) {
             ucs_ptr_array_remove(unexpected, i);
 
             header = (ucg_builtin_header_t*)(rdesc + 1);
             ucs_assert(header->group_id >= UCG_GROUP_FIRST_GROUP_ID);
-            ucs_ptr_array_insert(&gctx->slots[header->msg.coll_id].messages,
-                                 rdesc);
+            slot = ucg_builtin_comp_window_slot(&gctx->window,
+                    ucg_builtin_header_coll_id(header, is_ext));
+            ucs_queue_push(ucg_builtin_comp_window_queue(&gctx->window, slot,
+                                   ucg_builtin_header_msg_key(header, is_ext)),
+                           &rdesc->tag_frag_queue);
+            if (rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC) {
+                gctx->window.desc_budget--; /* may go negative */
+            }
         }
 
         ucs_ptr_array_cleanup(unexpected);
@@ -594,6 +1324,8 @@ static void ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan)
         ucg_builtin_op_discard(ucs_list_extract_head(op_head, ucg_op_t, list));
     }
 
+    kh_destroy_inplace(ucg_plan_op, &plan->super.op_hash);
+
 #if ENABLE_MT
     ucs_recursive_spinlock_destroy(&plan->super.lock);
 #endif
@@ -604,37 +1336,19 @@ static void ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan)
     ucs_free(plan);
 }
 
+static void ucg_builtin_discard_plan(ucg_plan_t *plan)
+{
+    ucg_builtin_destroy_plan(ucs_derived_of(plan, ucg_builtin_plan_t));
+}
+
 static void ucg_builtin_destroy(ucg_group_ctx_h ctx)
 {
-    unsigned i, j;
+    ucg_builtin_plan_rails_t *rails;
     ucg_builtin_group_ctx_t *gctx = ctx;
 
     ucg_context_unset_async_timer(&gctx->worker->async, gctx->timer_id);
 
-    /* Cleanup left-over messages and outstanding operations */
-    for (i = 0; i < UCG_BUILTIN_MAX_CONCURRENT_OPS; i++) {
-        ucg_builtin_comp_slot_t *slot = &gctx->slots[i];
-        if (slot->req.expecting.local_id != 0) {
-            ucs_warn("Collective operation #%u has been left incomplete (Group #%u)",
-                    gctx->slots[i].req.expecting.coll_id, gctx->group_id);
-        }
-
-        ucp_recv_desc_t *rdesc;
-        ucs_ptr_array_for_each(rdesc, j, &slot->messages) {
-            ucs_warn("Collective operation #%u still has a pending message for"
-                     "step #%u (Group #%u)",
-                     ((ucg_builtin_header_t*)(rdesc + 1))->msg.coll_id,
-                     ((ucg_builtin_header_t*)(rdesc + 1))->msg.step_idx,
-                     ((ucg_builtin_header_t*)(rdesc + 1))->group_id);
-#ifdef HAVE_UCP_EXTENSIONS
-            /* No UCT interface information, we can't release if it's shared */
-            if (!(rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC_SHARED))
-#endif
-            ucp_recv_desc_release(rdesc CONDITIONAL_NULL);
-            ucs_ptr_array_remove(&slot->messages, j);
-        }
-        ucs_ptr_array_cleanup(&slot->messages);
-    }
+    ucg_builtin_comp_window_cleanup(gctx);
 
     /* Cleanup plans created for this group */
     while (!ucs_list_is_empty(&gctx->plan_head)) {
@@ -643,6 +1357,11 @@ static void ucg_builtin_destroy(ucg_group_ctx_h ctx)
                                                        list));
     }
 
+    kh_foreach_value(&gctx->rails, rails, {
+        ucs_free(rails);
+    });
+    kh_destroy_inplace(ucg_builtin_rails, &gctx->rails);
+
     /* Remove the group from the global storage array */
     ucg_builtin_ctx_t *bctx = gctx->bctx;
     ucs_ptr_array_locked_remove(&bctx->group_by_id, gctx->group_id);
@@ -650,13 +1369,43 @@ static void ucg_builtin_destroy(ucg_group_ctx_h ctx)
     /* Note: gctx is freed as part of the group object itself */
 }
 
-void ucg_builtin_release_comp_desc(ucg_builtin_comp_desc_t *desc)
+void ucg_builtin_comp_window_retry(ucg_builtin_comp_window_t *window)
 {
-    if (desc->super.flags == UCT_CB_PARAM_FLAG_DESC) {
-        uct_iface_release_desc(desc);
-    } else {
-        ucs_mpool_put_inline(desc);
+    ucp_recv_desc_t *rdesc;
+    ucs_queue_head_t *queue;
+    ucg_builtin_header_t *header;
+    int is_ext = window->slot_flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT;
+
+    while (!ucs_queue_is_empty(&window->overflow)) {
+        rdesc  = ucs_queue_head_elem_non_empty(&window->overflow,
+                                               ucp_recv_desc_t, tag_frag_queue);
+        header = (ucg_builtin_header_t*)(rdesc + 1);
+        queue  = ucg_builtin_comp_slot_queue(ucg_builtin_comp_window_slot(window,
+                         ucg_builtin_header_coll_id(header, is_ext)),
+                         ucg_builtin_header_msg_key(header, is_ext));
+        if (queue == NULL) {
+            return; /* still out of memory - the next lookup tries again */
+        }
+
+        ucs_queue_pull_non_empty(&window->overflow);
+        ucs_queue_push(queue, &rdesc->tag_frag_queue);
+    }
+}
+
+void ucg_builtin_release_comp_desc(ucg_builtin_comp_window_t *window,
+                                   ucp_recv_desc_t *rdesc, uct_iface_h iface)
+{
+    if (rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC) {
+        window->desc_budget++;
     }
+
+    ucp_recv_desc_release(rdesc
+#ifdef HAVE_UCP_EXTENSIONS
+#ifdef UCS_MEMUNITS_INF /* Backport to UCX v1.6.0 */
+                          , iface
+#endif
+#endif
+                          );
 }
 
 void ucg_builtin_plan_decision_in_unsupport_allreduce_case_check_msg_size(const size_t msg_size)
@@ -768,7 +1517,7 @@ void ucg_builtin_allreduce_decision_fixed(const size_t msg_size,
                                           enum ucg_builtin_allreduce_algorithm *allreduce_algo_decision)
 {
     ucp_datatype_t send_dt;
-    ucg_global_params.datatype.convert_f(coll_params->send.dtype, &send_dt); //TODO: check success
+    ucg_builtin_convert_datatype(coll_params->send.dtype, &send_dt); //TODO: check success
     unsigned is_large_datatype = (ucp_dt_length(send_dt, 1, NULL, NULL) >
                                   large_datatype_threshold);
     unsigned is_non_commutative = (UCG_PARAM_OP(coll_params) != NULL) &&
@@ -1160,39 +1909,40 @@ void ucg_builtin_non_commutative_operation(const ucg_group_params_t *group_param
 int ucg_builtin_op_can_reuse(const ucg_plan_t *plan, const ucg_op_t *op,
                              const ucg_collective_params_t *params)
 {
-    ucp_datatype_t send_dtype = UCP_DATATYPE_CONTIG;
-    ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t *)op;
-
-    if (builtin_op->send_dt) {
+    const ucg_builtin_op_t *builtin_op = ucs_derived_of(op, ucg_builtin_op_t);
+    const ucg_builtin_op_step_t *step  = &builtin_op->steps[0];
+    const ucg_collective_params_t *old = &op->params;
+    void *in_place                     = ucg_global_params.mpi_in_place;
+
+    /* The buffers are not part of the cache key, but the way they overlap is */
+    if (((params->send.buffer == in_place) != (old->send.buffer == in_place)) ||
+        ((params->send.buffer == params->recv.buffer) !=
+         (old->send.buffer == old->recv.buffer))) {
         return 0;
     }
 
-    if (params->send.count > 0) {
-        ucg_global_params.datatype.convert_f(params->send.dtype, &send_dtype);
-        if (!UCP_DT_IS_CONTIG(send_dtype)) {
+    /* Remote keys and addresses have already been exchanged for the old ones */
+    do {
+        if (step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SEND_PUT_ZCOPY |
+                           UCG_BUILTIN_OP_STEP_FLAG_SEND_GET_ZCOPY |
+                           UCG_BUILTIN_OP_STEP_FLAG_WRITE_REMOTE_ADDR)) {
             return 0;
         }
-    }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
 
     return 1;
 }
 
-void ucg_builtin_update_op(const ucg_plan_t *plan, ucg_op_t *op,
-                           const ucg_collective_params_t *params)
+ucs_status_t ucg_builtin_update_op(const ucg_plan_t *plan, ucg_op_t *op,
+                                   const ucg_collective_params_t *params)
 {
-    ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t *)op;
-
-    builtin_op->send_dt = 0;
-    builtin_op->recv_dt = 0;
-    if (params->send.count > 0) {
-        ucg_global_params.datatype.convert_f(params->send.dtype,
-                                             &builtin_op->send_dt);
+    /* Same shape and same buffers - nothing to re-bind, remote keys included */
+    if ((op->params.send.buffer == params->send.buffer) &&
+        (op->params.recv.buffer == params->recv.buffer)) {
+        return UCS_OK;
     }
 
-    if (params->recv.count > 0) {
-        ucg_global_params.datatype.convert_f(params->recv.dtype,
-                                             &builtin_op->recv_dt);
-    }
+    return ucg_builtin_op_rebind(ucs_derived_of(op, ucg_builtin_op_t), params);
 }
 
 int ucg_is_noncontig_allreduce(const ucg_group_params_t *group_params,
@@ -1202,7 +1952,7 @@ int ucg_is_noncontig_allreduce(const ucg_group_params_t *group_params,
 
     if ((coll_params->send.type.modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) &&
         (coll_params->send.count > 0)) {
-        ucg_global_params.datatype.convert_f(coll_params->send.dtype, &ucp_datatype);
+        ucg_builtin_convert_datatype(coll_params->send.dtype, &ucp_datatype);
         if (!UCP_DT_IS_CONTIG(ucp_datatype)) {
             ucs_debug("allreduce non-contiguous datatype");
             return 1;
@@ -1494,6 +2244,7 @@ static ucs_status_t ucg_builtin_plan(ucg_group_ctx_h ctx,
 
     plan->super.incast_cb = incast_cb;
     plan->super.next_cb   = NULL;
+    plan->super.discard_f = ucg_builtin_discard_plan;
 
     ucs_list_head_init(&plan->super.op_head);
 
@@ -1514,10 +2265,12 @@ static ucs_status_t ucg_builtin_plan(ucg_group_ctx_h ctx,
             ucg_is_noncontig_allreduce(builtin_ctx->group_params, params);
     plan->super.is_ring_plan_topo_type = (plan_topo_type == UCG_PLAN_RING);
 
-    plan->gctx      = builtin_ctx;
-    plan->config    = config;
-    plan->am_id     = builtin_ctx->bctx->am_id;
-    *plan_p         = (ucg_plan_t*)plan;
+    plan->gctx          = builtin_ctx;
+    plan->config        = config;
+    plan->reduce_pool   = builtin_ctx->bctx->reduce_pool;
+    plan->am_id         = builtin_ctx->window.am_id;
+    plan->header_length = builtin_ctx->header_length;
+    *plan_p             = (ucg_plan_t*)plan;
 
     return UCS_OK;
 }
@@ -1525,7 +2278,9 @@ static ucs_status_t ucg_builtin_plan(ucg_group_ctx_h ctx,
 void  ucg_builtin_set_phase_thresh_max_short(ucg_builtin_group_ctx_t *ctx,
                                              ucg_builtin_plan_phase_t *phase)
 {
-    if (phase->iface_attr->cap.am.max_short < sizeof(ucg_builtin_header_t)) {
+    /* Short sends carry just the compact header (see ucg_builtin_step_send_flags) */
+    if ((phase->iface_attr->cap.am.max_short < sizeof(ucg_builtin_header_t)) ||
+        (ctx->header_length > sizeof(ucg_builtin_header_t))) {
         phase->send_thresh.max_short_one = 0;
     } else {
         phase->send_thresh.max_short_one = phase->iface_attr->cap.am.max_short - sizeof(ucg_builtin_header_t);
@@ -1671,6 +2426,14 @@ void ucg_builtin_print_flags(ucg_builtin_op_step_t *step, uint32_t op_flags)
         printf("multiple message (zero-copy)");
         break;
 
+    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_FORWARD:
+        printf("multiple messages (forwarded)");
+        break;
+
+    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_CREDITED:
+        printf("multiple messages (credited, %u per grant)", step->credit_batch);
+        break;
+
     case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET:
         printf("multiple fragments");
         break;
@@ -1880,27 +2643,368 @@ static void ucg_builtin_print(ucg_plan_t *plan,
     }
 }
 
+static ucs_status_t ucg_builtin_rcache_mem_reg_cb(void *context,
+                                                  ucs_rcache_t *rcache,
+                                                  void *arg,
+                                                  ucs_rcache_region_t *rregion,
+                                                  uint16_t flags)
+{
+    ucg_builtin_rcache_region_t *region =
+            ucs_derived_of(rregion, ucg_builtin_rcache_region_t);
+
+    return uct_md_mem_reg((uct_md_h)context, (void*)region->super.super.start,
+                          region->super.super.end - region->super.super.start,
+                          UCT_MD_MEM_ACCESS_ALL, &region->memh);
+}
+
+static void ucg_builtin_rcache_mem_dereg_cb(void *context, ucs_rcache_t *rcache,
+                                            ucs_rcache_region_t *rregion)
+{
+    ucg_builtin_rcache_region_t *region =
+            ucs_derived_of(rregion, ucg_builtin_rcache_region_t);
+
+    uct_md_mem_dereg((uct_md_h)context, region->memh);
+}
+
+static void ucg_builtin_rcache_dump_region_cb(void *context,
+                                              ucs_rcache_t *rcache,
+                                              ucs_rcache_region_t *rregion,
+                                              char *buf, size_t max)
+{
+    ucg_builtin_rcache_region_t *region =
+            ucs_derived_of(rregion, ucg_builtin_rcache_region_t);
+
+    snprintf(buf, max, "memh %p", region->memh);
+}
+
+static ucs_rcache_ops_t ucg_builtin_rcache_ops = {
+    .mem_reg     = ucg_builtin_rcache_mem_reg_cb,
+    .mem_dereg   = ucg_builtin_rcache_mem_dereg_cb,
+    .dump_region = ucg_builtin_rcache_dump_region_cb
+};
+
+/*
+ * Registrations are reference-counted, and kept (up to REG_CACHE_MAX_SIZE,
+ * least recently used released first) after the last user is done - so an
+ * operation created for a buffer used before finds it already registered.
+ * Memory events (e.g. munmap) remove the affected regions from the cache.
+ */
+static ucs_rcache_t* ucg_builtin_rcache_get(ucg_builtin_ctx_t *bctx, uct_md_h md,
+                                            const uct_md_attr_t *md_attr)
+{
+    unsigned i;
+    ucs_status_t status;
+    ucs_rcache_params_t params;
+    ucg_builtin_rcache_t *rcaches;
+
+    if (!bctx->config.reg_cache || !(md_attr->cap.flags & UCT_MD_FLAG_REG)) {
+        return NULL;
+    }
+
+    for (i = 0; i < bctx->rcache_cnt; i++) {
+        if (bctx->rcaches[i].md == md) {
+            return bctx->rcaches[i].rcache;
+        }
+    }
+
+    rcaches = ucs_realloc(bctx->rcaches, (bctx->rcache_cnt + 1) *
+                          sizeof(*rcaches), "builtin_rcaches");
+    if (rcaches == NULL) {
+        return NULL;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.region_struct_size = sizeof(ucg_builtin_rcache_region_t);
+    params.alignment          = UCS_PGT_ADDR_ALIGN;
+    params.max_alignment      = ucs_get_page_size();
+    params.ucm_events         = UCM_EVENT_VM_UNMAPPED |
+                                UCM_EVENT_MEM_TYPE_FREE;
+    params.ucm_event_priority = 1000;
+    params.ops                = &ucg_builtin_rcache_ops;
+    params.context            = md;
+    params.flags              = 0;
+#ifdef HAVE_UCS_RCACHE_MAX_SIZE
+    params.max_regions        = ULONG_MAX;
+    params.max_size           = bctx->config.reg_cache_max_size;
+#endif
+
+    bctx->rcaches        = rcaches;
+    rcaches             += bctx->rcache_cnt++;
+    rcaches->md          = md;
+    status               = ucs_rcache_create(&params, "ucg_builtin",
+                                             ucs_stats_get_root(),
+                                             &rcaches->rcache);
+    if (status != UCS_OK) {
+        /* e.g. no memory hooks are installed - register every time instead */
+        ucs_debug("failed to create a registration cache for %s: %s",
+                  md_attr->component_name, ucs_status_string(status));
+        rcaches->rcache = NULL;
+    }
+
+    return rcaches->rcache;
+}
+
+ucs_status_t ucg_builtin_mem_reg(uct_md_h md, ucs_rcache_t *rcache,
+                                 void *address, size_t length, int prot,
+                                 uct_mem_h *memh_p,
+                                 ucs_rcache_region_t **region_p)
+{
+    ucs_status_t status;
+
+    if (rcache == NULL) {
+        *region_p = NULL;
+        return uct_md_mem_reg(md, address, length, UCT_MD_MEM_ACCESS_ALL,
+                              memh_p);
+    }
+
+#ifdef HAVE_UCS_RCACHE_GET_ALIGNMENT
+    status = ucs_rcache_get(rcache, address, length, UCS_PGT_ADDR_ALIGN, prot,
+                            NULL, region_p);
+#else
+    status = ucs_rcache_get(rcache, address, length, prot, NULL, region_p);
+#endif
+    if (status == UCS_OK) {
+        *memh_p = ucs_derived_of(*region_p, ucg_builtin_rcache_region_t)->memh;
+    }
+
+    return status;
+}
+
+void ucg_builtin_mem_dereg(uct_md_h md, ucs_rcache_t *rcache, uct_mem_h memh,
+                           ucs_rcache_region_t *region)
+{
+    if (region != NULL) {
+        ucs_rcache_region_put(rcache, region);
+    } else {
+        uct_md_mem_dereg(md, memh);
+    }
+}
+
+const ucg_builtin_plan_rails_t* ucg_builtin_get_rails(ucg_builtin_group_ctx_t *gctx,
+                                                      uct_ep_h ep)
+{
+    khiter_t iter = kh_get(ucg_builtin_rails, &gctx->rails, (uintptr_t)ep);
+
+    return (iter == kh_end(&gctx->rails)) ? NULL : kh_val(&gctx->rails, iter);
+}
+
 static uct_iface_t mock_iface;
 static uct_iface_attr_t mock_ep_attr;
 static uct_ep_t mock_ep = { .iface = &mock_iface };
 
+/*
+ * The registration cost is fitted as a line through two sizes: one page, and
+ * one large enough for the per-byte part to dominate (and for the copy to
+ * stream past the caches). test/bench_zcopy_thresh compares the threshold it
+ * leads to against the crossover actually measured.
+ */
+#define UCG_BUILTIN_CALIBRATE_SMALL (4096)
+#define UCG_BUILTIN_CALIBRATE_LARGE (4 * UCS_MBYTE)
+#define UCG_BUILTIN_CALIBRATE_ITERS (16)
+
+static double ucg_builtin_calibrate_reg_time(uct_md_h md, void *buffer,
+                                             size_t length)
+{
+    unsigned i;
+    uct_mem_h memh;
+    ucs_time_t start;
+
+    /* Repeated registrations hit the registration cache (if the md has one) */
+    start = ucs_get_time();
+    for (i = 0; i < UCG_BUILTIN_CALIBRATE_ITERS; i++) {
+        if (uct_md_mem_reg(md, buffer, length, UCT_MD_MEM_ACCESS_ALL,
+                           &memh) != UCS_OK) {
+            return -1.0;
+        }
+        uct_md_mem_dereg(md, memh);
+    }
+
+    return ucs_time_to_sec(ucs_get_time() - start) / UCG_BUILTIN_CALIBRATE_ITERS;
+}
+
+static const ucg_builtin_zcopy_model_t*
+ucg_builtin_calibrate_zcopy(ucg_builtin_ctx_t *bctx, uct_md_h md)
+{
+    unsigned i;
+    ucs_time_t start;
+    double small_time, large_time;
+    ucg_builtin_zcopy_model_t *model;
+    void *src, *dst;
+
+    for (i = 0; i < bctx->calibrated_cnt; i++) {
+        if (bctx->calibrated[i].md == md) {
+            return &bctx->calibrated[i];
+        }
+    }
+
+    src = ucs_malloc(UCG_BUILTIN_CALIBRATE_LARGE, "zcopy calibration src");
+    dst = ucs_malloc(UCG_BUILTIN_CALIBRATE_LARGE, "zcopy calibration dst");
+    if ((src == NULL) || (dst == NULL)) {
+        goto err_free;
+    }
+
+    memset(src, 0, UCG_BUILTIN_CALIBRATE_LARGE);
+    memcpy(dst, src, UCG_BUILTIN_CALIBRATE_LARGE); /* warm-up */
+
+    start = ucs_get_time();
+    for (i = 0; i < UCG_BUILTIN_CALIBRATE_ITERS; i++) {
+        memcpy(dst, src, UCG_BUILTIN_CALIBRATE_LARGE);
+    }
+    large_time = ucs_time_to_sec(ucs_get_time() - start);
+
+    model = ucs_realloc(bctx->calibrated, (bctx->calibrated_cnt + 1) *
+                        sizeof(*model), "zcopy calibration");
+    if ((large_time <= 0) || (model == NULL)) {
+        goto err_free;
+    }
+
+    bctx->calibrated = model;
+    model            = &bctx->calibrated[bctx->calibrated_cnt];
+    model->md        = md;
+    model->copy_bw   = (double)UCG_BUILTIN_CALIBRATE_LARGE *
+                       UCG_BUILTIN_CALIBRATE_ITERS / large_time;
+
+    small_time = ucg_builtin_calibrate_reg_time(md, src,
+                                                UCG_BUILTIN_CALIBRATE_SMALL);
+    large_time = ucg_builtin_calibrate_reg_time(md, src,
+                                                UCG_BUILTIN_CALIBRATE_LARGE);
+    if ((small_time < 0) || (large_time < 0)) {
+        goto err_free;
+    }
+
+    model->reg_cost.m = ucs_max(large_time - small_time, 0) /
+                        (UCG_BUILTIN_CALIBRATE_LARGE -
+                         UCG_BUILTIN_CALIBRATE_SMALL);
+    model->reg_cost.c = ucs_max(small_time - (model->reg_cost.m *
+                                              UCG_BUILTIN_CALIBRATE_SMALL), 0);
+    bctx->calibrated_cnt++;
+
+    ucs_debug("zcopy calibration: copy %.1f MB/s, registration %.3f us + "
+              "%.6f us/KB", model->copy_bw / UCS_MBYTE,
+              model->reg_cost.c * 1e6, model->reg_cost.m * 1e6 * UCS_KBYTE);
+
+    ucs_free(dst);
+    ucs_free(src);
+    return model;
+
+err_free:
+    ucs_warn("failed to calibrate the zero-copy threshold - using estimates");
+    ucs_free(dst);
+    ucs_free(src);
+    return NULL;
+}
+
+static double ucg_builtin_send_time(const ucg_builtin_plan_phase_t *phase,
+                                    const ucg_builtin_zcopy_model_t *model,
+                                    double bandwidth, size_t max_frag,
+                                    size_t length, int is_zcopy)
+{
+    size_t frags = (length + max_frag - 1) / max_frag;
+    double time  = (frags * phase->iface_attr->overhead) + (length / bandwidth);
+
+    if (is_zcopy) {
+        return time + ucs_linear_func_apply(model->reg_cost, length);
+    }
+
+    return time + (length / model->copy_bw);
+}
+
+/*
+ * Find the smallest message for which zero-copy is estimated to be faster
+ * than buffer-copy: both pay the per-fragment overhead and the wire time, but
+ * buffer-copy also copies the data while zero-copy registers it. The md's
+ * reported registration cost already reflects its registration cache (if it
+ * has one), and so does the measured one - which is what ops re-triggered
+ * with the same buffers would typically pay.
+ */
+static size_t ucg_builtin_calc_zcopy_thresh(ucg_builtin_group_ctx_t *ctx,
+                                            ucg_builtin_plan_phase_t *phase)
+{
+    size_t low, high, mid;
+    ucg_builtin_zcopy_model_t reported;
+    const ucg_builtin_zcopy_model_t *model = NULL;
+    const uct_iface_attr_t *attr           = phase->iface_attr;
+    size_t max_bcopy                       = attr->cap.am.max_bcopy -
+                                             ctx->header_length;
+    size_t max_zcopy                       = attr->cap.am.max_zcopy -
+                                             ctx->header_length;
+    size_t max_reg                         = ucs_min(phase->md_attr->cap.max_reg,
+                                                     UCS_BIT(40));
+    double bandwidth                       = attr->bandwidth.dedicated +
+                                             (attr->bandwidth.shared /
+                                              ucs_max(ctx->host_proc_cnt, 1));
+
+    if ((bandwidth <= 0) || (max_bcopy == 0) || (max_zcopy == 0)) {
+        return UCS_MEMUNITS_INF;
+    }
+
+    if (ctx->bctx->config.zcopy_calibrate) {
+        model = ucg_builtin_calibrate_zcopy(ctx->bctx, phase->md);
+    }
+
+    if (model == NULL) {
+        reported.md       = phase->md;
+        reported.copy_bw  = ucs_cpu_get_memcpy_bw();
+        reported.reg_cost = phase->md_attr->reg_cost;
+        model             = &reported;
+    }
+
+#define UCG_BUILTIN_IS_ZCOPY_FASTER(_length) \
+    (ucg_builtin_send_time(phase, model, bandwidth, max_zcopy, _length, 1) < \
+     ucg_builtin_send_time(phase, model, bandwidth, max_bcopy, _length, 0))
+
+    /* Find the first power of two where zero-copy wins, then narrow it down */
+    for (high = 1; !UCG_BUILTIN_IS_ZCOPY_FASTER(high); high <<= 1) {
+        if (high >= max_reg) {
+            return UCS_MEMUNITS_INF;
+        }
+    }
+
+    low = high >> 1;
+    while (high - low > 1) {
+        mid = low + ((high - low) >> 1);
+        if (UCG_BUILTIN_IS_ZCOPY_FASTER(mid)) {
+            high = mid;
+        } else {
+            low  = mid;
+        }
+    }
+
+#undef UCG_BUILTIN_IS_ZCOPY_FASTER
+    return high;
+}
+
+static void ucg_builtin_set_phase_thresh_zcopy(ucg_builtin_group_ctx_t *ctx,
+                                               ucg_builtin_plan_phase_t *phase)
+{
+    if (!(phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY)) {
+        phase->send_thresh.zcopy_thresh = UCS_MEMUNITS_INF;
+    } else if (ctx->bctx->config.zcopy_thresh != UCS_MEMUNITS_AUTO) {
+        phase->send_thresh.zcopy_thresh = ctx->bctx->config.zcopy_thresh;
+    } else {
+        phase->send_thresh.zcopy_thresh = ucg_builtin_calc_zcopy_thresh(ctx,
+                                                                        phase);
+    }
+}
 
 void  ucg_builtin_set_phase_thresh_max_bcopy_zcopy(ucg_builtin_group_ctx_t *ctx,
                                                    ucg_builtin_plan_phase_t *phase)
 {
-    phase->send_thresh.max_bcopy_one = phase->iface_attr->cap.am.max_bcopy - sizeof(ucg_builtin_header_t);
+    phase->send_thresh.max_bcopy_one = phase->iface_attr->cap.am.max_bcopy - ctx->header_length;
     phase->send_thresh.max_bcopy_max = ctx->bctx->config.bcopy_max_tx;
     if (phase->md_attr->cap.max_reg && (phase->md_attr->cap.flags & UCT_MD_FLAG_NEED_MEMH)) {
         if (phase->send_thresh.max_bcopy_one > phase->send_thresh.max_bcopy_max) {
             phase->send_thresh.max_bcopy_one = phase->send_thresh.max_bcopy_max;
         }
-        phase->send_thresh.max_zcopy_one = phase->iface_attr->cap.am.max_zcopy - sizeof(ucg_builtin_header_t);
+        phase->send_thresh.max_zcopy_one = phase->iface_attr->cap.am.max_zcopy - ctx->header_length;
     } else {
         phase->send_thresh.max_zcopy_one = phase->send_thresh.max_bcopy_max = UCS_MEMUNITS_INF;
     }
 
     phase->send_thresh.max_bcopy_one -= phase->send_thresh.max_bcopy_one % DATATYPE_ALIGN;
     phase->send_thresh.max_zcopy_one -= phase->send_thresh.max_zcopy_one % DATATYPE_ALIGN;
+
+    ucg_builtin_set_phase_thresh_zcopy(ctx, phase);
 }
 
 void  ucg_builtin_set_phase_thresholds(ucg_builtin_group_ctx_t *ctx,
@@ -1910,6 +3014,10 @@ void  ucg_builtin_set_phase_thresholds(ucg_builtin_group_ctx_t *ctx,
     ucg_builtin_set_phase_thresh_max_bcopy_zcopy(ctx, phase);
 
     phase->send_thresh.md_attr_cap_max_reg = (phase->md_attr->cap.flags & UCT_MD_FLAG_NEED_MEMH) ? phase->md_attr->cap.max_reg : 0;
+    phase->send_thresh.credits     = 0; /* see ucg_builtin_set_phase_credits */
+    phase->recv_thresh.credits     = 0;
+    phase->send_thresh.get_thresh  = UCS_MEMUNITS_INF; /* ... and _pull */
+    phase->recv_thresh.get_thresh  = UCS_MEMUNITS_INF;
     phase->send_thresh.initialized = 1;
 
     if (!phase->recv_thresh.initialized) {
@@ -1918,18 +3026,158 @@ void  ucg_builtin_set_phase_thresholds(ucg_builtin_group_ctx_t *ctx,
         phase->recv_thresh.max_bcopy_one = phase->send_thresh.max_bcopy_one;
         phase->recv_thresh.max_bcopy_max = phase->send_thresh.max_bcopy_max;
         phase->recv_thresh.max_zcopy_one = phase->send_thresh.max_zcopy_one;
+        phase->recv_thresh.zcopy_thresh  = phase->send_thresh.zcopy_thresh;
         phase->recv_thresh.md_attr_cap_max_reg = phase->send_thresh.md_attr_cap_max_reg;
         phase->recv_thresh.initialized = 1;
     }
 }
 
+/*
+ * Called for the phases of a fan-in tree, once connected: the members sending
+ * up the tree may only have so many fragments unaccounted for by their parent,
+ * which grants more as it consumes them (see @ref UCG_BUILTIN_OFFSET_CREDIT_GRANT ).
+ * Both ends of a phase must agree on this, so it only depends on the method and
+ * the configuration - each member in the tree is either a sender, a receiver,
+ * or both (waypoints).
+ */
+void ucg_builtin_set_phase_credits(ucg_builtin_group_ctx_t *ctx,
+                                   ucg_builtin_plan_phase_t *phase)
+{
+    unsigned credits = ctx->bctx->config.incast_credits;
+
+#ifdef HAVE_UCT_COLLECTIVES
+    if (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_INCAST) {
+        return; /* the transport does the fan-in on its own */
+    }
+#endif
+
+    switch (phase->method) {
+    case UCG_PLAN_METHOD_SEND_TERMINAL:
+    case UCG_PLAN_METHOD_SEND_TO_SM_ROOT:
+        phase->send_thresh.credits = credits;
+        break;
+
+    case UCG_PLAN_METHOD_REDUCE_WAYPOINT:
+    case UCG_PLAN_METHOD_GATHER_WAYPOINT:
+        phase->send_thresh.credits = credits;
+        /* no break */
+    case UCG_PLAN_METHOD_REDUCE_TERMINAL:
+    case UCG_PLAN_METHOD_GATHER_TERMINAL:
+    case UCG_PLAN_METHOD_RECV_TERMINAL:
+        phase->recv_thresh.credits = credits;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Called for the phases of a fan-out tree (broadcast or scatter), once
+ * connected: above the threshold, the root of the phase offers its buffer to
+ * be read by the members, rather than send it (see
+ * @ref UCG_BUILTIN_OFFSET_RNDV_OFFER ). Receivers take either, so only the
+ * root's choice matters - but waypoints must not forward an offered message
+ * as it arrives, since it arrives all at once.
+ */
+void ucg_builtin_set_phase_pull(ucg_builtin_group_ctx_t *ctx,
+                                ucg_builtin_plan_phase_t *phase)
+{
+    size_t thresh = ctx->bctx->config.rndv_get_thresh;
+
+    if (!(phase->iface_attr->cap.flags & UCT_IFACE_FLAG_GET_ZCOPY) ||
+        !(phase->md_attr->cap.flags & UCT_MD_FLAG_REG)) {
+        return;
+    }
+
+    switch (phase->method) {
+    case UCG_PLAN_METHOD_SEND_TERMINAL:
+    case UCG_PLAN_METHOD_SCATTER_TERMINAL:
+        phase->send_thresh.get_thresh = thresh;
+        break;
+
+    case UCG_PLAN_METHOD_BCAST_WAYPOINT:
+    case UCG_PLAN_METHOD_SCATTER_WAYPOINT:
+    case UCG_PLAN_METHOD_RECV_TERMINAL:
+        phase->recv_thresh.get_thresh = thresh;
+        break;
+
+    default:
+        break;
+    }
+}
+
 void ucg_builtin_log_phase_info(ucg_builtin_plan_phase_t *phase, ucg_group_member_index_t idx)
 {
-    ucs_debug("phase create: %p, dest %u, short_one %zu, short_max %zu, bcopy_one %zu, bcopy_max %zu, zcopy_one %zu, max_reg %zu",
-               phase, idx, phase->send_thresh.max_short_one, phase->send_thresh.max_short_max, phase->send_thresh.max_bcopy_one, phase->send_thresh.max_bcopy_max, phase->send_thresh.max_zcopy_one, phase->md_attr->cap.max_reg);
+    ucs_debug("phase create: %p, dest %u, short_one %zu, short_max %zu, bcopy_one %zu, bcopy_max %zu, zcopy_one %zu, zcopy_thresh %zu, max_reg %zu",
+               phase, idx, phase->send_thresh.max_short_one, phase->send_thresh.max_short_max, phase->send_thresh.max_bcopy_one, phase->send_thresh.max_bcopy_max, phase->send_thresh.max_zcopy_one, phase->send_thresh.zcopy_thresh, phase->md_attr->cap.max_reg);
 }
 
 
+/*
+ * Look for more lanes to this peer (typically other network devices), so that
+ * large fragments could be striped across them. Failing that is not an error -
+ * the phase's own endpoint is still used for everything.
+ */
+static void ucg_builtin_connect_rails(ucg_builtin_group_ctx_t *ctx,
+                                      ucg_group_member_index_t idx, uct_ep_h ep)
+{
+    int ret;
+    khiter_t iter;
+    unsigned i, cnt;
+    ucs_status_t status;
+    ucg_builtin_plan_rail_t *lane;
+    ucg_builtin_plan_rails_t *rails;
+    uct_ep_h eps[UCG_BUILTIN_MAX_RAILS - 1];
+    uct_md_h mds[UCG_BUILTIN_MAX_RAILS - 1];
+    const uct_md_attr_t *md_attrs[UCG_BUILTIN_MAX_RAILS - 1];
+    const uct_iface_attr_t *iface_attrs[UCG_BUILTIN_MAX_RAILS - 1];
+    unsigned max_rails = ucs_min(ctx->bctx->config.max_rails,
+                                 UCG_BUILTIN_MAX_RAILS);
+
+    if ((max_rails < 2) ||
+        (kh_get(ucg_builtin_rails, &ctx->rails, (uintptr_t)ep) !=
+         kh_end(&ctx->rails))) {
+        return;
+    }
+
+    status = ucg_plan_connect_rails(ctx->group, idx, max_rails - 1, eps,
+                                    iface_attrs, mds, md_attrs, &cnt);
+    if (status != UCS_OK) {
+        return;
+    }
+
+    if (cnt == 0) {
+        rails = NULL; /* so that the next phase would not look again */
+    } else {
+        rails = ucs_malloc(sizeof(*rails), "builtin_plan_rails");
+        if (rails == NULL) {
+            return;
+        }
+
+        rails->ep  = ep;
+        rails->cnt = cnt;
+        for (i = 0; i < cnt; i++) {
+            lane             = &rails->lanes[i];
+            lane->ep         = eps[i];
+            lane->md         = mds[i];
+            lane->md_attr    = md_attrs[i];
+            lane->iface_attr = iface_attrs[i];
+            lane->rcache     = ucg_builtin_rcache_get(ctx->bctx, mds[i],
+                                                      md_attrs[i]);
+        }
+    }
+
+    iter = kh_put(ucg_builtin_rails, &ctx->rails, (uintptr_t)ep, &ret);
+    if (ret == -1) {
+        ucs_free(rails);
+        return;
+    }
+
+    kh_val(&ctx->rails, iter) = rails;
+    ucs_debug("peer #%u is reachable over %u lane(s)", idx, cnt + 1);
+}
+
 ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
                                  ucg_group_member_index_t idx,
                                  ucg_builtin_plan_phase_t *phase,
@@ -1967,6 +3215,7 @@ ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
         phase->host_proc_cnt                   = 0;
         phase->iface_attr                      = &mock_ep_attr;
         phase->md                              = NULL;
+        phase->rcache                          = NULL;
 
         if (phase_ep_index == UCG_BUILTIN_CONNECT_SINGLE_EP) {
             phase->single_ep = &mock_ep;
@@ -1984,6 +3233,11 @@ ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
         return status;
     }
 
+    phase->rcache = ucg_builtin_rcache_get(ctx->bctx, phase->md, phase->md_attr);
+    if (!flags) {
+        ucg_builtin_connect_rails(ctx, idx, ep);
+    }
+
 #if ENABLE_FAULT_TOLERANCE
     /* Send information about any faults that may have happened */
     status = ucg_ft_propagate(ctx->group, ctx->group_params, ep);
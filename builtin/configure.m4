@@ -3,4 +3,17 @@
 # See file LICENSE for terms.
 #
 
-AC_CONFIG_FILES([src/ucg/builtin/Makefile])
\ No newline at end of file
+#
+# Detect compiler support for AVX-512 BF16 (used by bfloat16 reductions)
+#
+AC_MSG_CHECKING([for AVX-512 BF16 support])
+AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include <immintrin.h>]
+                                    [__attribute__((target("avx512f,avx512bf16")))]
+                                    [__m256bh cvt(__m512 v) { return _mm512_cvtneps_pbh(v); }]],
+                                   [[return __builtin_cpu_supports("avx512bf16");]])],
+                  [AC_MSG_RESULT([yes])
+                   AC_DEFINE([HAVE_AVX512_BF16], [1],
+                             [Can the compiler target AVX-512 BF16 instructions])],
+                  [AC_MSG_RESULT([no])])
+
+AC_CONFIG_FILES([src/ucg/builtin/Makefile])
@@ -15,6 +15,19 @@ static void UCS_F_ALWAYS_INLINE
 ucg_builtin_comp_last_step_cb(ucg_builtin_request_t *req, ucs_status_t status)
 {
     ucg_builtin_op_t *op = req->op;
+    ucg_builtin_op_step_t *step;
+
+    if (ucs_unlikely(status != UCS_OK)) {
+        /* Drop whatever was written in advance for the steps not reached */
+        step = req->step;
+        do {
+            step->early_arrivals = 0;
+            if (step->rma != NULL) {
+                step->rma->ready_key   = 0;
+                step->rma->is_put_done = 0;
+            }
+        } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+    }
 
     if (ucs_unlikely(op->flags & UCG_BUILTIN_OP_FLAG_FINALIZE_MASK)) {
         ucg_builtin_op_finalize_by_flags(op);
@@ -76,30 +89,34 @@ ucg_builtin_comp_step_cb(ucg_builtin_request_t *req)
 
     ucg_builtin_comp_ft_end_step(next_step - 1);
 
-    ucs_assert(next_step->iter_offset == 0);
+    /* Unless some of its fragments were already sent ahead (by the ring) */
+    ucs_assert((next_step->iter_offset == 0) ||
+               (prev_step->comp_criteria ==
+                UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_FORWARD));
     ucs_assert(next_step->iter_ep == 0);
 
     return ucg_builtin_step_execute(req, header);
 }
 
 static void UCS_F_ALWAYS_INLINE
-ucg_builtin_comp_gather(uint8_t *recv_buffer, uint64_t offset, uint8_t *data,
-                        size_t per_rank_length, size_t length,
-                        ucg_group_member_index_t root)
+ucg_builtin_comp_gather(ucg_builtin_op_t *op, uint8_t *recv_buffer,
+                        uint64_t offset, uint8_t *data, size_t per_rank_length,
+                        size_t length, ucg_group_member_index_t root)
 {
     size_t my_offset = per_rank_length * root; // TODO: fix... likely broken
     if ((offset > my_offset) ||
         (offset + length <= my_offset)) {
-        memcpy(recv_buffer + offset, data, length);
+        ucg_builtin_memcpy(op, recv_buffer + offset, data, length);
         return;
     }
 
     /* The write would overlap with my own contribution to gather */
     size_t first_part = offset + length - my_offset;
     recv_buffer += offset;
-    memcpy(recv_buffer, data, first_part);
+    ucg_builtin_memcpy(op, recv_buffer, data, first_part);
     data += first_part;
-    memcpy(recv_buffer + first_part + length, data, length - first_part);
+    ucg_builtin_memcpy(op, recv_buffer + first_part + length, data,
+                       length - first_part);
 
     // TODO: replace with SIMD like _mm256_i64gather_epi64 whenever possible
     // TODO: for reduction - combine a reduce SIMD, e.g. _mm512_reduce_add_pd
@@ -138,9 +155,79 @@ ucg_builtin_comp_send_check_frag_by_offset(ucg_builtin_request_t *req,
 
 static ucg_builtin_op_step_t*
 ucg_builtin_find_step_by_header(ucg_builtin_request_t *req,
-                                ucg_builtin_header_t header)
+                                ucg_builtin_header_t header,
+                                ucg_step_idx_t step_idx_hi)
 {
-    return NULL; // TODO: implement...
+    /* Only the current step (yet to start receiving) or those following it */
+    ucg_builtin_op_step_t *step = req->step;
+    do {
+        if ((step->am_header.msg.step_idx == header.msg.step_idx) &&
+            (step->am_header_ext.msg_hi.step_idx == step_idx_hi)) {
+            return step;
+        }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
+    return NULL;
+}
+
+/*
+ * A message for a later step of the collective currently running in this slot
+ * can be written directly into that step's receive buffer, instead of being
+ * stored until the step starts - as long as the step simply writes incoming
+ * data (see @ref ucg_builtin_op_set_placeable ). The arrival is recorded per
+ * chunk (fragment, or message otherwise), and credited once the step starts.
+ * Returns 0 if the message should be stored as before.
+ */
+static int UCS_F_ALWAYS_INLINE
+ucg_builtin_step_place_early(ucg_builtin_request_t *req,
+                             ucg_builtin_header_t header,
+                             ucg_builtin_header_ext_t ext, int is_ext,
+                             const void *data, size_t length)
+{
+    uint64_t offset;
+    uint64_t chunk_bit;
+    ucg_builtin_op_step_t *step;
+
+    if ((req->expecting.local_id == 0) || /* slot is idle (or just starting) */
+        (req->expecting.coll_id != header.msg.coll_id) ||
+        (is_ext && (req->expecting_hi.coll_id != ext.msg_hi.coll_id)) ||
+        (length == 0) ||
+        ucg_builtin_header_is_rma_ready(header.remote_offset, is_ext,
+                                        ext.remote_offset_hi) ||
+        ucg_builtin_header_is_rndv_offer(header.remote_offset, is_ext,
+                                         ext.remote_offset_hi)) {
+        return 0;
+    }
+
+    step = ucg_builtin_find_step_by_header(req, header,
+                                           is_ext ? ext.msg_hi.step_idx : 0);
+    if ((step == NULL) || !step->is_placeable) {
+        return 0;
+    }
+
+    offset = header.remote_offset;
+    if (is_ext) {
+        offset |= (uint64_t)ext.remote_offset_hi << 32;
+    }
+
+    if (offset + length > step->buffer_length) {
+        return 0;
+    }
+
+    chunk_bit = offset / ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) ?
+                          step->fragment_length : length);
+    if (chunk_bit >= UCG_BUILTIN_EARLY_ARRIVALS_MAX) {
+        return 0;
+    }
+
+    chunk_bit = UCS_BIT(chunk_bit);
+    if (step->early_arrivals & chunk_bit) {
+        return 0; /* can't tell both apart - keep the second one for later */
+    }
+
+    ucg_builtin_memcpy(req->op, step->recv_buffer + offset, data, length);
+    step->early_arrivals |= chunk_bit;
+    return 1;
 }
 
 static ucs_status_t UCS_F_ALWAYS_INLINE
@@ -168,12 +255,19 @@ ucg_builtin_step_recv_handle_chunk(enum ucg_builtin_op_step_comp_aggregation ag,
         break;
 
     case UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE_OOO:
-        ooo_step = ucg_builtin_find_step_by_header(req, header);
+        ooo_step = ucg_builtin_find_step_by_header(req, header,
+                                                   req->expecting_hi.step_idx);
+        ucs_assert(ooo_step != NULL);
         dst      = ooo_step->recv_buffer + header.remote_offset;
         /* no break */
     case UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE:
         op = req->op;
-        if (is_dt_packed) {
+        if (is_dt_packed && (op->recv_vector.blocklen != 0)) {
+            ucg_builtin_dt_vector_scatter(op, &op->recv_vector,
+                                          op->super.params.recv.buffer,
+                                          header.remote_offset, src, length);
+            status = UCS_OK;
+        } else if (is_dt_packed) {
             ucs_assert(ucp_dt_length(op->recv_dt, 0, NULL, op->recv_unpack) ==
                        req->step->dtype_length);
 
@@ -188,17 +282,18 @@ ucg_builtin_step_recv_handle_chunk(enum ucg_builtin_op_step_comp_aggregation ag,
                            req->step->buffer_length);
             }
 
-            memcpy(dst, src, length);
+            ucg_builtin_memcpy(op, dst, src, length);
             status = UCS_OK;
         }
         break;
 
     case UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_GATHER:
         op = req->op;
-        ucg_builtin_comp_gather(req->step->recv_buffer, header.remote_offset,
-                                src, ucg_builtin_step_length(req->step,
-                                                             &op->super.params,
-                                                             0), length,
+        ucg_builtin_comp_gather(op, req->step->recv_buffer,
+                                header.remote_offset, src,
+                                ucg_builtin_step_length(req->step,
+                                                        &op->super.params, 0),
+                                length,
                                 UCG_PARAM_TYPE(&req->op->super.params).root);
         status = UCS_OK;
         break;
@@ -272,6 +367,11 @@ ucg_builtin_step_recv_handle_chunk(enum ucg_builtin_op_step_comp_aggregation ag,
         is_swap = (aggregation ==                                              \
                    UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_REDUCE_SWAP);            \
                                                                                \
+        if (_is_buf_long) {                                                    \
+            /* the upper bits of the offset came in the extended header */     \
+            dest_buffer += (uint64_t)req->offset_hi << 32;                     \
+        }                                                                      \
+                                                                               \
         if (_is_fragmented) {                                                  \
            chunk_size = step->buffer_length - header.remote_offset;            \
            if (_is_len_packed) {                                               \
@@ -291,7 +391,7 @@ ucg_builtin_step_recv_handle_chunk(enum ucg_builtin_op_step_comp_aggregation ag,
                                                                                \
         if (_is_batched && (am_flags & UCT_CB_PARAM_FLAG_STRIDE)) {            \
             header.remote_offset *= chunk_size;                                \
-            length += sizeof(ucg_builtin_header_t);                            \
+            length += ucg_builtin_header_length(req);                          \
                                                                                \
             for (index = 0; index < step->batch_cnt; index++, data += length) {\
                 status = ucg_builtin_step_recv_handle_chunk(aggregation,       \
@@ -378,6 +478,26 @@ recv_handle_error:
     if (ucs_unlikely(req->pending != (num)))
     /* note: not really likely, but we optimize for the positive case */
 
+static void UCS_F_ALWAYS_INLINE
+ucg_builtin_step_recv_comp_action(ucg_builtin_request_t *req,
+                                  ucg_builtin_op_step_t *step)
+{
+    /* Act according to the requested completion action */
+    switch (step->comp_action) {
+    case UCG_BUILTIN_OP_STEP_COMP_OP:
+        ucg_builtin_comp_last_step_cb(req, UCS_OK);
+        break;
+
+    case UCG_BUILTIN_OP_STEP_COMP_STEP:
+        (void) ucg_builtin_comp_step_cb(req);
+        break;
+
+    case UCG_BUILTIN_OP_STEP_COMP_SEND:
+        (void) ucg_builtin_step_execute(req, step->am_header);
+        break;
+    }
+}
+
 static int UCS_F_ALWAYS_INLINE
 ucg_builtin_step_recv_handle_comp(ucg_builtin_request_t *req,
                                   ucg_builtin_header_t header)
@@ -404,29 +524,31 @@ ucg_builtin_step_recv_handle_comp(ucg_builtin_request_t *req,
         }
         break;
 
-    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET:
-        if (!ucg_builtin_comp_send_check_frag_by_offset(req, header.remote_offset, 1)) {
+    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_FORWARD:
+        UCG_IF_STILL_PENDING(req, 0, 1) {
+            ucg_builtin_step_send_ahead(req, header.remote_offset);
             return 0;
         }
         break;
-    }
-
 
-    /* Act according to the requested completion action */
-    switch (step->comp_action) {
-    case UCG_BUILTIN_OP_STEP_COMP_OP:
-        ucg_builtin_comp_last_step_cb(req, UCS_OK);
-        break;
-
-    case UCG_BUILTIN_OP_STEP_COMP_STEP:
-        (void) ucg_builtin_comp_step_cb(req);
+    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_CREDITED:
+        UCG_IF_STILL_PENDING(req, 0, 1) {
+            if (((step->credit_total - req->pending) % step->credit_batch) == 0) {
+                ucg_builtin_step_grant_credits(req, header);
+            }
+            return 0;
+        }
         break;
 
-    case UCG_BUILTIN_OP_STEP_COMP_SEND:
-        (void) ucg_builtin_step_execute(req, step->am_header);
+    case UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET:
+        if (!ucg_builtin_comp_send_check_frag_by_offset(req, header.remote_offset, 1)) {
+            return 0;
+        }
         break;
     }
 
+
+    ucg_builtin_step_recv_comp_action(req, step);
     return 1;
 }
 
@@ -434,6 +556,34 @@ static int UCS_F_ALWAYS_INLINE
 ucg_builtin_step_recv_cb(ucg_builtin_request_t *req, ucg_builtin_header_t header,
                          uint8_t *data, size_t length, unsigned am_flags_ext)
 {
+    if (ucg_builtin_header_is_rma_ready(header.remote_offset,
+            req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT, req->offset_hi)) {
+        /* Too late for this step's data - but not for the next collective */
+        if ((req->step->rma != NULL) &&
+            (header.msg.step_idx == req->step->am_header.msg.step_idx)) {
+            ucg_builtin_step_rma_accept(req->step, data, length);
+        }
+        return 0;
+    }
+
+    if (ucg_builtin_header_is_credit_grant(header.remote_offset,
+            req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT, req->offset_hi)) {
+        /* A send which ran out of credits resumes now, not upon a resend */
+        ucg_builtin_op_step_t *step = req->step;
+        int is_blocked              = (step->credits == 0);
+        step->credits              += step->credit_window;
+        if (is_blocked) {
+            (void) ucg_builtin_req_resend(req);
+        }
+        return 0;
+    }
+
+    if (ucg_builtin_header_is_rndv_offer(header.remote_offset,
+            req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT, req->offset_hi)) {
+        /* The step is done once the offered data has been read */
+        return ucg_builtin_step_rndv_get(req, header, data, length);
+    }
+
     ucg_builtin_step_recv_handle_data(req, header, data, length, am_flags_ext);
 
     if (ucs_unlikely(am_flags_ext & UCT_CB_PARAM_FLAG_LAST)) {
@@ -443,109 +593,166 @@ ucg_builtin_step_recv_cb(ucg_builtin_request_t *req, ucg_builtin_header_t header
     return ucg_builtin_step_recv_handle_comp(req, header);
 }
 
+static int UCS_F_ALWAYS_INLINE
+ucg_builtin_step_credit_early(ucg_builtin_request_t *req,
+                              ucg_builtin_header_t header)
+{
+    ucg_builtin_op_step_t *step = req->step;
+    unsigned arrived            = ucs_popcount(step->early_arrivals);
+
+    step->early_arrivals = 0;
+
+    /* The last one goes through the completion check, as if it just arrived */
+    ucs_assert(req->pending >= arrived);
+    req->pending -= arrived - 1;
+    return ucg_builtin_step_recv_handle_comp(req, header);
+}
+
 ucs_status_t static UCS_F_ALWAYS_INLINE
 ucg_builtin_step_check_pending(ucg_builtin_comp_slot_t *slot,
                                ucg_builtin_op_step_t *step,
                                ucg_builtin_header_t expected)
 {
     /* Check pending incoming messages - invoke the callback on each one */
-    void *msg;
     size_t length;
     int is_batch;
     int is_step_done;
-    unsigned msg_index;
+    khiter_t iter;
+    uint32_t msg_key;
     unsigned mock_flag;
     ucp_recv_desc_t *rdesc;
+    ucs_queue_head_t matched;
     ucg_builtin_header_t *header;
+    ucg_builtin_header_step_t expected_hi;
+    ucg_builtin_comp_window_t *window;
 
     uint16_t local_id            = expected.msg.local_id;
+    int is_ext                   = slot->req.flags &
+                                   UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT;
+    size_t header_length         = ucg_builtin_header_length(&slot->req);
+    expected_hi.coll_id          = slot->req.expecting_hi.coll_id;
+    expected_hi.step_idx         = step->am_header_ext.msg_hi.step_idx;
     step->am_header.msg.local_id = local_id;
     slot->req.expecting.local_id = local_id;
+    slot->req.expecting_hi       = expected_hi;
 
     ucs_assert(local_id != 0);
 
-    if (ucs_ptr_array_is_empty(&slot->messages)) {
+    /* Account for messages already written in-place, before this step began */
+    if (ucs_unlikely(step->early_arrivals != 0) &&
+        ucg_builtin_step_credit_early(&slot->req, expected)) {
+        return (slot->req.expecting.local_id == 0) ? UCS_OK : UCS_INPROGRESS;
+    }
+
+    window = UCG_BUILTIN_OP_GET_WINDOW(slot->req.op->gctx);
+    if (ucs_unlikely(!ucs_queue_is_empty(&window->overflow))) {
+        ucg_builtin_comp_window_retry(window);
+    }
+
+    if (ucs_likely(kh_size(&slot->messages) == 0)) {
         return UCS_INPROGRESS;
     }
 
+    /* Only the messages sent for this very step (of this collective) */
+    msg_key = UCG_BUILTIN_MSG_KEY(local_id, is_ext ? expected_hi.local_id : 0);
+    iter = kh_get(ucg_builtin_msg, &slot->messages, msg_key);
+    if (iter == kh_end(&slot->messages)) {
+        return UCS_INPROGRESS;
+    }
+
+    /* Detach the queue (next call may lead here recursively) */
+    ucs_queue_head_init(&matched);
+    ucs_queue_splice(&matched, &kh_val(&slot->messages, iter));
+    kh_del(ucg_builtin_msg, &slot->messages, iter);
+
     mock_flag = 0;
     is_batch  = step->comp_flags & UCG_BUILTIN_OP_STEP_COMP_FLAG_BATCHED_DATA;
 
-    ucs_ptr_array_for_each(msg, msg_index, &slot->messages) {
-        rdesc  = (ucp_recv_desc_t*)msg;
+    while (!ucs_queue_is_empty(&matched)) {
+        rdesc  = ucs_queue_pull_elem_non_empty(&matched, ucp_recv_desc_t,
+                                               tag_frag_queue);
         header = (ucg_builtin_header_t*)(rdesc + 1);
-        ucs_assert((header->msg.coll_id  != slot->req.expecting.coll_id) ||
-                   (header->msg.step_idx >= slot->req.expecting.step_idx));
-        /*
-         * Note: stored message coll_id can be either larger or smaller than
-         * the one currently handled - due to coll_id wrap-around.
-         */
-
-        if (ucs_likely(header->msg.local_id == local_id)) {
-            /* Remove the packet (next call may lead here recursively) */
-            ucs_ptr_array_remove(&slot->messages, msg_index);
-
-            /* we need this in place in case we skip to the next step */
-            slot->req.expecting.local_id = local_id;
-
-            /* Handle this "waiting" packet, possibly completing the step */
-            if (((rdesc->flags & UCT_CB_PARAM_FLAG_DESC) == 0) &&
-                 (step->comp_criteria <= UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SINGLE_MESSAGE)) {
-                               /* can be UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SEND */
-                mock_flag = UCT_CB_PARAM_FLAG_LAST;
+        ucs_assert(ucg_builtin_header_msg_key(header, is_ext) == msg_key);
+
+        /* we need this in place in case we skip to the next step */
+        slot->req.expecting.local_id = local_id;
+        slot->req.expecting_hi       = expected_hi;
+        if (is_ext) {
+            slot->req.offset_hi      =
+                ((ucg_builtin_header_ext_t*)(header + 1))->remote_offset_hi;
+        }
+
+        if (ucg_builtin_header_is_rma_ready(header->remote_offset, is_ext,
+                                            slot->req.offset_hi)) {
+            /* Not taken by the send of this step - kept for the next one */
+            if (step->rma != NULL) {
+                ucg_builtin_step_rma_accept(step,
+                        (uint8_t*)UCS_PTR_BYTE_OFFSET(header, header_length),
+                        rdesc->length - header_length);
             }
+            ucg_builtin_release_comp_desc(UCG_BUILTIN_OP_GET_WINDOW(slot->req.op->gctx),
+                                          rdesc, step->uct_iface);
+            continue;
+        }
 
-            if (is_batch) {
-                /* At the time of arrival the length was not known, since the
-                 * batches are padded in memory - so we grab the information
-                 * from the step (information specified by local invocation) */
-                length = ucg_builtin_step_length(step,
-                                                 &slot->req.op->super.params,
-                                                 0);
-
-                if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) {
-                    if (header->remote_offset + step->fragment_length >= length) {
-                        /* Last fragment */
-                        ucs_assert(length > header->remote_offset);
-                        length = length - header->remote_offset;
-                    } else {
-                        /* Ordinary fragment */
-                        length = step->fragment_length;
-                    }
-                }
+        /* Handle this "waiting" packet, possibly completing the step */
+        if (((rdesc->flags & UCT_CB_PARAM_FLAG_DESC) == 0) &&
+             (step->comp_criteria <= UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SINGLE_MESSAGE)) {
+                           /* can be UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SEND */
+            mock_flag = UCT_CB_PARAM_FLAG_LAST;
+        }
 
-                ucs_assert(length <= (rdesc->length - sizeof(ucg_builtin_header_t)));
-            } else {
-                length = rdesc->length - sizeof(ucg_builtin_header_t);
+        if (is_batch) {
+            /* At the time of arrival the length was not known, since the
+             * batches are padded in memory - so we grab the information
+             * from the step (information specified by local invocation) */
+            length = ucg_builtin_step_length(step,
+                                             &slot->req.op->super.params,
+                                             0);
+
+            if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) {
+                if (header->remote_offset + step->fragment_length >= length) {
+                    /* Last fragment */
+                    ucs_assert(length > header->remote_offset);
+                    length = length - header->remote_offset;
+                } else {
+                    /* Ordinary fragment */
+                    length = step->fragment_length;
+                }
             }
 
-            is_step_done = ucg_builtin_step_recv_cb(&slot->req, *header,
-                                                    (uint8_t*)(header + 1),
-                                                    length, mock_flag);
+            ucs_assert(length <= (rdesc->length - header_length));
+        } else {
+            length = rdesc->length - header_length;
+        }
+
+        is_step_done = ucg_builtin_step_recv_cb(&slot->req, *header,
+                (uint8_t*)UCS_PTR_BYTE_OFFSET(header, header_length),
+                length, mock_flag);
 
-            /* Dispose of the packet, according to its allocation */
-            ucp_recv_desc_release(rdesc
-#ifdef HAVE_UCP_EXTENSIONS
-#ifdef UCS_MEMUNITS_INF /* Backport to UCX v1.6.0 */
-                    , slot->req.step->uct_iface
-#endif
-#endif
-                    );
+        /* Dispose of the packet, according to its allocation */
+        ucg_builtin_release_comp_desc(UCG_BUILTIN_OP_GET_WINDOW(slot->req.op->gctx),
+                                      rdesc, slot->req.step->uct_iface);
 
-            /* If the step has indeed completed - check the entire operation */
-            if (is_step_done) {
-                goto step_done;
-            }
+        /* If the step has indeed completed - check the entire operation */
+        if (is_step_done) {
+            goto step_done;
         }
     }
 
+    /* Note: the header only matters to criteria which never set mock_flag */
     if ((mock_flag != 0) &&
-        (ucg_builtin_step_recv_handle_comp(&slot->req, *header))) {
+        (ucg_builtin_step_recv_handle_comp(&slot->req, expected))) {
         goto step_done;
     }
 
     return UCS_INPROGRESS;
 
 step_done:
+    if (ucs_unlikely(!ucs_queue_is_empty(&matched))) {
+        /* Keep whatever was left unhandled, as it was */
+        ucg_builtin_comp_window_splice(window, slot, msg_key, &matched);
+    }
+
     return (slot->req.expecting.local_id == 0) ? UCS_OK : UCS_INPROGRESS;
 }
@@ -24,7 +24,7 @@ ucg_builtin_init_scatter(ucg_builtin_op_t *op)
     size_t offset               = length * plan->super.my_index;
 
     if (dst != src) {
-        memcpy(dst, src + offset, length);
+        ucg_builtin_memcpy(op, dst, src + offset, length);
     }
 }
 
@@ -33,8 +33,9 @@ ucg_builtin_init_gather_terminal(ucg_builtin_op_t *op)
 {
     ucg_builtin_op_step_t *step = &op->steps[0];
     size_t len = step->buffer_length;
-    memcpy(step->recv_buffer + (UCG_PARAM_TYPE(&op->super.params).root * len),
-           step->send_buffer, len);
+    ucg_builtin_memcpy(op, step->recv_buffer +
+                       (UCG_PARAM_TYPE(&op->super.params).root * len),
+                       step->send_buffer, len);
     ucs_assert((step->flags & UCG_BUILTIN_OP_STEP_FLAG_TEMP_BUFFER_USED) == 0);
 }
 
@@ -42,10 +43,28 @@ static void UCS_F_ALWAYS_INLINE
 ucg_builtin_init_gather_waypoint(ucg_builtin_op_t *op)
 {
     ucg_builtin_op_step_t *step = &op->steps[0];
-    memcpy(step->recv_buffer, step->send_buffer, step->buffer_length);
+    ucg_builtin_memcpy(op, step->recv_buffer, step->send_buffer,
+                       step->buffer_length);
     ucs_assert(step->flags & UCG_BUILTIN_OP_STEP_FLAG_TEMP_BUFFER_USED);
 }
 
+/*
+ * Ring steps reduce into (and send from) a chunk of the receive buffer each,
+ * so the whole of it is initialized before the first step - rather than just
+ * the part the first step uses, as done for the other reductions.
+ */
+static void UCS_F_ALWAYS_INLINE
+ucg_builtin_init_ring(ucg_builtin_op_t *op)
+{
+    ucg_collective_params_t *params = &op->super.params;
+
+    if ((params->send.buffer != params->recv.buffer) &&
+        (params->send.buffer != ucg_global_params.mpi_in_place)) {
+        memcpy(params->recv.buffer, params->send.buffer,
+               ucp_dt_length(op->recv_dt, params->recv.count, NULL, NULL));
+    }
+}
+
 /* Alltoall Bruck phase 1/3: shuffle the data */
 static void UCS_F_ALWAYS_INLINE
 ucg_builtin_init_alltoall(ucg_builtin_op_t *op)
@@ -58,9 +77,9 @@ ucg_builtin_init_alltoall(ucg_builtin_op_t *op)
 
     /* Shuffle data: rank i displaces all data blocks "i blocks" upwards */
     for(ii=0; ii < nProcs; ii++){
-        memcpy(step->send_buffer + bsize * ii,
-               step->recv_buffer + bsize * ((ii + my_idx) % nProcs),
-               bsize);
+        ucg_builtin_memcpy(op, step->send_buffer + bsize * ii,
+                           step->recv_buffer + bsize * ((ii + my_idx) % nProcs),
+                           bsize);
     }
 }
 
@@ -92,9 +111,9 @@ ucg_builtin_finalize_alltoall(ucg_builtin_op_t *op)
 
     /* Shuffle data: rank i displaces all data blocks up by i+1 blocks and inverts vector */
     for(ii = 0; ii < nProcs; ii++){
-        memcpy(step->send_buffer + bsize * ii,
-               step->recv_buffer + bsize * (nProcs - 1 - ii),
-               bsize);
+        ucg_builtin_memcpy(op, step->send_buffer + bsize * ii,
+                           step->recv_buffer + bsize * (nProcs - 1 - ii),
+                           bsize);
     }
 }
 
@@ -140,7 +159,8 @@ ucg_builtin_finalize_alltoall(ucg_builtin_op_t *op)
             send_buffer = op->super.params.send.buffer;                        \
             if (ucs_likely(step->recv_buffer != send_buffer)) { /* TODO: FIX */ \
                 buffer_length = ucg_builtin_step_length(step, params, 0);      \
-                memcpy(step->recv_buffer, send_buffer, buffer_length);         \
+                ucg_builtin_memcpy(op, step->recv_buffer, send_buffer,         \
+                                   buffer_length);                             \
             }                                                                  \
         }                                                                      \
                                                                                \
@@ -291,6 +311,10 @@ op_error:
 static ucs_status_t UCS_F_ALWAYS_INLINE
 ucg_builtin_op_init_by_flags(ucg_builtin_op_t *op, ucg_coll_id_t coll_id)
 {
+    if (ucs_unlikely(op->flags & UCG_BUILTIN_OP_FLAG_RING)) {
+        ucg_builtin_init_ring(op);
+    }
+
     return ucg_builtin_op_do_by_flags(op, 1, coll_id);
 }
 
@@ -307,14 +331,9 @@ ucg_builtin_op_get_dt(void *dtype, size_t *dt_len_p, int *is_contig_p,
 
     ucp_datatype_t ucp_dt;
 
-    if (ucs_unlikely(dtype == NULL)) {
-        ucp_dt = ucp_dt_make_contig(1);
-    } else {
-        ucs_status_t status = ucg_global_params.datatype.convert_f(dtype,
-                                                                   &ucp_dt);
-        if (ucs_unlikely(status != UCS_OK)) {
-            return status;
-        }
+    ucs_status_t status = ucg_builtin_convert_datatype(dtype, &ucp_dt);
+    if (ucs_unlikely(status != UCS_OK)) {
+        return status;
     }
 
     int is_dt_contig = UCP_DT_IS_CONTIG(ucp_dt);
@@ -337,6 +356,117 @@ ucg_builtin_op_get_dt(void *dtype, size_t *dt_len_p, int *is_contig_p,
     return UCS_OK;
 }
 
+/*
+ * Check whether the application describes "count" elements of this (non-
+ * contiguous) datatype as a vector, which is only of use if the blocks follow
+ * each other in the buffer (as they do in the packed data) without overlap.
+ */
+int ucg_builtin_dt_get_vector(void *dtype, int count, size_t dt_len,
+                              ucg_builtin_dt_vector_t *vector)
+{
+    vector->blocklen = 0;
+
+    if ((ucg_global_params.datatype.get_vector_f == NULL) || (count <= 0) ||
+        ucg_global_params.datatype.get_vector_f(dtype, count, &vector->blocklen,
+                                                &vector->blocks,
+                                                &vector->stride,
+                                                &vector->displ)) {
+        vector->blocklen = 0;
+        return 0;
+    }
+
+    if ((vector->blocklen == 0) || (vector->displ < 0) ||
+        (vector->blocks * vector->blocklen != dt_len * count) ||
+        ((vector->blocks > 1) &&
+         (vector->stride < (ptrdiff_t)vector->blocklen))) {
+        ucs_debug("datatype %p is not an ascending vector, packing it instead",
+                  dtype);
+        vector->blocklen = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_op_buffers_overlap(const uint8_t *first, size_t first_length,
+                               const uint8_t *second, size_t second_length)
+{
+    return (first < second + second_length) && (second < first + first_length);
+}
+
+/*
+ * A step which only writes incoming data into its receive buffer may have it
+ * written before the step starts (see @ref ucg_builtin_step_place_early ),
+ * unless the same memory is still used by a preceding step - or by its own
+ * send, which has not happened yet at that time. Buffers are compared by
+ * address, so this has to be re-evaluated whenever they change.
+ */
+int ucg_builtin_op_step_can_place(ucg_builtin_op_t *op,
+                                  ucg_builtin_op_step_t *step)
+{
+    size_t send_length;
+    ucg_builtin_op_step_t *prev = &op->steps[0];
+    int can_place               =
+            !(op->flags & UCG_BUILTIN_OP_FLAG_NON_CONTIGUOUS) &&
+            (step->comp_aggregation == UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE) &&
+            ((step->comp_flags & (UCG_BUILTIN_OP_STEP_COMP_FLAG_BATCHED_DATA    |
+                                  UCG_BUILTIN_OP_STEP_COMP_FLAG_PACKED_LENGTH   |
+                                  UCG_BUILTIN_OP_STEP_COMP_FLAG_PACKED_DATATYPE |
+                                  UCG_BUILTIN_OP_STEP_COMP_FLAG_LONG_BUFFERS)) == 0) &&
+            ((step->comp_criteria == UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SINGLE_MESSAGE) ||
+             (step->comp_criteria == UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES)) &&
+            (step->comp_action != UCG_BUILTIN_OP_STEP_COMP_SEND) &&
+            ((step->flags & (UCG_BUILTIN_OP_STEP_FLAG_PIPELINED         |
+                             UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND   |
+                             UCG_BUILTIN_OP_STEP_FLAG_RECV_BEFORE_SEND1 |
+                             UCG_BUILTIN_OP_STEP_FLAG_RECV1_BEFORE_SEND)) ==
+             UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND);
+
+    while (can_place) {
+        if (prev->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_VARIADIC) {
+            return 0; /* extent is not known in advance */
+        }
+
+        send_length = prev->buffer_length;
+        if (prev->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED) {
+            send_length *= prev->phase->ep_cnt;
+        }
+
+        if (ucg_builtin_op_buffers_overlap(step->recv_buffer,
+                                           step->buffer_length,
+                                           prev->pack_source ?
+                                           prev->pack_source :
+                                           prev->send_buffer,
+                                           send_length) ||
+            ((prev != step) &&
+             ucg_builtin_op_buffers_overlap(step->recv_buffer,
+                                            step->buffer_length,
+                                            prev->recv_buffer,
+                                            prev->buffer_length))) {
+            return 0;
+        }
+
+        if (prev++ == step) {
+            break;
+        }
+    }
+
+    return can_place;
+}
+
+/* Note: the first step is always running by the time any message arrives */
+static void ucg_builtin_op_set_placeable(ucg_builtin_op_t *op)
+{
+    ucg_builtin_op_step_t *step = &op->steps[0];
+
+    do {
+        step->early_arrivals = 0;
+        step->is_placeable   = (step != &op->steps[0]) &&
+                               ucg_builtin_op_step_can_place(op, step);
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+}
+
 ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
                                    const ucg_collective_params_t *params,
                                    ucg_op_t **new_op)
@@ -359,6 +489,7 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
     op->recv_dt                          = 0;
     op->super.reduce_full_f              = NULL;
     op->super.reduce_frag_f              = NULL;
+    op->widened                          = NULL;
 
     /* obtain UCX datatypes corresponding to the extenral datatypes passed */
     if (params->send.count > 0) {
@@ -377,6 +508,13 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
         }
     }
 
+    /* Non-contiguous data may be received straight into its blocks */
+    op->recv_vector.blocklen = 0;
+    if (!is_recv_dt_contig) {
+        (void)ucg_builtin_dt_get_vector(params->recv.dtype, params->recv.count,
+                                        recv_dt_len, &op->recv_vector);
+    }
+
     /* copy the parameters aside, and use those from now on */
     memcpy(&op->super.params, params, sizeof(*params));
     params = &op->super.params;
@@ -487,9 +625,28 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
         goto op_cleanup;
     }
 
+    ucg_builtin_op_set_placeable(op);
+
+    /* Split very large reductions among helper threads, if there are any */
+    ucg_builtin_reduce_parallelize(op, builtin_plan->reduce_pool, recv_dt_len);
+
+    /* Stream the local copies of ops which would otherwise flush the cache */
+    if ((op->super.reduce_full_f == NULL) &&
+        ((params->send.count * send_dt_len) + (params->recv.count * recv_dt_len)
+         >= builtin_plan->config->stream_copy_thresh)) {
+        op->flags |= UCG_BUILTIN_OP_FLAG_STREAM_COPY;
+    }
+
     UCS_STATIC_ASSERT(sizeof(ucg_builtin_header_t) <= UCP_WORKER_HEADROOM_PRIV_SIZE);
     UCS_STATIC_ASSERT(sizeof(ucg_builtin_header_t) == sizeof(uint64_t));
 
+    /* the "--- N bytes ---" marks in the definition of a step */
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_builtin_op_step_t, iter_ep)      == 4);
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_builtin_op_step_t, phase)        == 8);
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_builtin_op_step_t, am_header)    == 32);
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_builtin_op_step_t, uct_progress) == 64);
+    UCS_STATIC_ASSERT(ucs_offsetof(ucg_builtin_op_step_t, bcopy)        == 128);
+
     op->super.trigger_f = ucg_builtin_op_trigger;
     op->super.discard_f = ucg_builtin_op_discard;
     op->super.compreq_f = ucg_global_params.completion.coll_comp_cb_f;
@@ -509,41 +666,165 @@ void ucg_builtin_op_discard(ucg_op_t *op)
     ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t*)op;
     ucg_builtin_op_step_t *step = &builtin_op->steps[0];
     do {
+        if (step->rma != NULL) {
+            ucg_builtin_step_rma_discard(step);
+        }
+
         if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) {
-            uct_md_mem_dereg(step->uct_md, step->zcopy.memh);
+            if (step->zcopy.memh != UCT_MEM_HANDLE_NULL) {
+                ucg_builtin_step_zcopy_dereg(step);
+            }
             uct_rkey_release(step->zcopy.cmpt, &step->zcopy.rkey);
+            ucs_free(step->rails);
         }
 
         if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_TEMP_BUFFER_USED) {
             ucs_free(step->recv_buffer);
         }
 
+        if (step->pack_source != NULL) {
+            ucs_free(step->send_buffer);
+        }
+
         if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) {
             ucs_free((void*)step->fragment_pending);
         }
     } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
 
+    ucs_free(builtin_op->widened);
     ucs_mpool_put_inline(op);
 }
 
-#define UCG_BUILTIN_OP_GET_SLOT_PTR(_gctx, _slot_id) \
-    UCS_PTR_BYTE_OFFSET(_gctx, _slot_id * sizeof(ucg_builtin_comp_slot_t))
+/*
+ * Every buffer of a step is one of these (and nothing else):
+ * 1. The send or receive buffer given by the application, as is.
+ * 2. A chunk inside the application's receive buffer - only for ring steps,
+ *    see @ref ucg_builtin_step_ring_chunks (the ring starts by copying the
+ *    send buffer there, so the chunks never point into the send buffer).
+ * 3. A temporary buffer, owned by the operation (and re-used as is).
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_op_step_is_ring(const ucg_builtin_op_step_t *step)
+{
+    return (step->phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING) ||
+           (step->phase->method == UCG_PLAN_METHOD_ALLGATHER_RING);
+}
 
-ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
-                                    ucg_coll_id_t coll_id,
-                                    void *request)
+static UCS_F_ALWAYS_INLINE uint8_t*
+ucg_builtin_op_rebind_buffer(uint8_t *buffer, int is_ring,
+                             const ucg_collective_params_t *old_params,
+                             const ucg_collective_params_t *new_params)
 {
-    /* Allocate a "slot" for this operation, from a per-group array of slots */
-    ucg_builtin_op_t *builtin_op  = (ucg_builtin_op_t*)op;
-    unsigned slot_idx             = coll_id % UCG_BUILTIN_MAX_CONCURRENT_OPS;
-    ucg_builtin_group_ctx_t *gctx = builtin_op->gctx;
-    ucg_builtin_comp_slot_t *slot = UCG_BUILTIN_OP_GET_SLOT_PTR(gctx, slot_idx);
+    uint8_t *old_recv = (uint8_t*)old_params->recv.buffer;
 
-    if (ucs_unlikely(slot->req.expecting.local_id != 0)) {
-        ucs_error("UCG Builtin planner exceeded its concurrent collectives limit.");
-        return UCS_ERR_NO_RESOURCE;
+    /* Ring chunks keep their offset inside the receive buffer */
+    if (is_ring) {
+        return (uint8_t*)new_params->recv.buffer + (buffer - old_recv);
+    }
+
+    /* Receive first - in case both are the same buffer, which is kept so */
+    if (buffer == old_recv) {
+        return (uint8_t*)new_params->recv.buffer;
+    }
+
+    if (buffer == (uint8_t*)old_params->send.buffer) {
+        return (uint8_t*)new_params->send.buffer;
     }
 
+    /* Otherwise this is a temporary buffer, owned by the operation itself */
+    return buffer;
+}
+
+ucs_status_t ucg_builtin_op_rebind(ucg_builtin_op_t *op,
+                                   const ucg_collective_params_t *params)
+{
+    int is_ring;
+    int is_offered;
+    ucs_status_t status;
+    uint8_t *send_buffer;
+    uint8_t *recv_buffer;
+    ucg_builtin_step_rma_t *rma;
+    ucg_builtin_op_step_t *step         = &op->steps[0];
+    ucg_collective_params_t *old_params = &op->super.params;
+
+    /*
+     * The operation was cached with parameters of the same "shape", so only
+     * the buffers need to change: the steps keep their transports, fragment
+     * sizes and callbacks, and the datatype (un)packing state is started from
+     * op->super.params upon trigger, so it follows the new buffers as well.
+     */
+    do {
+        is_offered  = 0;
+        recv_buffer = step->recv_buffer;
+        if ((step->rma != NULL) && step->rma->is_offered) {
+            is_offered = 1;
+            ucg_builtin_step_rma_discard(step);
+        }
+
+        is_ring           = ucg_builtin_op_step_is_ring(step);
+        ucs_assert(!is_ring || (step->pack_source == NULL));
+        send_buffer       = ucg_builtin_op_rebind_buffer(step->send_buffer,
+                                                         is_ring, old_params,
+                                                         params);
+        step->recv_buffer = ucg_builtin_op_rebind_buffer(step->recv_buffer,
+                                                         is_ring, old_params,
+                                                         params);
+        if (step->pack_source != NULL) {
+            step->pack_source = ucg_builtin_op_rebind_buffer(step->pack_source,
+                                                             is_ring,
+                                                             old_params, params);
+        }
+
+        if ((send_buffer != step->send_buffer) &&
+            (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY)) {
+            /* zero-copy sends need the new buffer registered instead */
+            ucg_builtin_step_zcopy_dereg(step);
+            step->send_buffer = send_buffer;
+            status            = ucg_builtin_step_zcopy_prep(step, params);
+            if (ucs_unlikely(status != UCS_OK)) {
+                step->zcopy.memh   = UCT_MEM_HANDLE_NULL;
+                step->zcopy.region = NULL;
+                return status;
+            }
+        }
+
+        step->send_buffer = send_buffer;
+
+        /* ... and so do the offers to read it (see ucg_builtin_step_rndv_offer_prep) */
+        if (is_offered) {
+            status = ucg_builtin_step_rndv_offer_prep(step);
+            if (ucs_unlikely(status != UCS_OK)) {
+                return status;
+            }
+        }
+
+        /* The peer keeps its buffer, but gets our new one before writing */
+        rma = step->rma;
+        if ((rma != NULL) && !is_offered) {
+            rma->ready_key   = 0;
+            rma->is_put_done = 0;
+            if ((rma->recv_memh != UCT_MEM_HANDLE_NULL) &&
+                (step->recv_buffer != recv_buffer)) {
+                ucg_builtin_mem_dereg(step->phase->md, step->phase->rcache,
+                                      rma->recv_memh, rma->recv_region);
+                rma->recv_memh     = UCT_MEM_HANDLE_NULL;
+                rma->recv_region   = NULL;
+                rma->is_advertised = 0;
+                ucg_builtin_step_rma_recv_prep(op, step);
+            }
+        }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
+    ucg_builtin_op_set_placeable(op);
+
+    memcpy(old_params, params, sizeof(*params));
+    return UCS_OK;
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+ucg_builtin_op_start(ucg_builtin_op_t *builtin_op, ucg_builtin_comp_slot_t *slot,
+                     ucg_coll_id_t coll_id, void *request)
+{
     /* Initialize the request structure, located inside the selected slot s*/
     ucg_builtin_request_t *builtin_req = &slot->req;
     builtin_req->op                    = builtin_op;
@@ -553,6 +834,7 @@ ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
     ucg_builtin_header_t header        = first_step->am_header;
     builtin_req->comp_req              = request;
     builtin_op->current                = &builtin_req->step;
+    builtin_op->widened_step           = NULL;
 
     /* Sanity checks */
     ucs_assert(first_step->am_header.msg.step_idx != 0);
@@ -560,12 +842,40 @@ ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
     ucs_assert(first_step->iter_ep == 0);
     ucs_assert(request != NULL);
 
+    /* Start the first step, which may actually complete the entire operation */
+    header.msg.coll_id               = coll_id;
+    builtin_req->expecting_hi.coll_id = coll_id >> UCG_BUILTIN_HEADER_EXT_SHIFT;
+    return ucg_builtin_step_execute(builtin_req, header);
+}
+
+ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
+                                    ucg_coll_id_t coll_id,
+                                    void *request)
+{
+    /* Allocate a "slot" for this operation, from a per-group window of slots */
+    ucg_builtin_op_t *builtin_op  = (ucg_builtin_op_t*)op;
+    ucg_builtin_group_ctx_t *gctx = builtin_op->gctx;
+    ucg_builtin_comp_slot_t *slot =
+            ucg_builtin_comp_window_slot(UCG_BUILTIN_OP_GET_WINDOW(gctx), coll_id);
+
     ucs_status_t status = ucg_builtin_op_init_by_flags(builtin_op, coll_id);
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
     }
 
-    /* Start the first step, which may actually complete the entire operation */
-    header.msg.coll_id = coll_id;
-    return ucg_builtin_step_execute(builtin_req, header);
+    if (ucs_unlikely(slot->req.expecting.local_id != 0)) {
+        /* Either grow the window or wait for this slot to become available */
+        return ucg_builtin_comp_window_defer(gctx, builtin_op, coll_id,
+                                             request);
+    }
+
+    return ucg_builtin_op_start(builtin_op, slot, coll_id, request);
+}
+
+ucs_status_t ucg_builtin_op_resume(ucg_builtin_op_t *op,
+                                   ucg_builtin_comp_slot_t *slot)
+{
+    ucs_assert(slot->req.expecting.local_id == 0);
+
+    return ucg_builtin_op_start(op, slot, op->pending_id, op->super.pending_req);
 }
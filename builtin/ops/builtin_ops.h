@@ -15,6 +15,8 @@
 #include <ucp/dt/dt.h>
 #include <ucp/core/ucp_request.h>
 #include <ucs/datastruct/ptr_array.h>
+#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/queue.h>
 
 #ifndef HAVE_UCP_EXTENSIONS
 #define UCT_COLL_DTYPE_MODE_BITS (0)
@@ -44,7 +46,7 @@ extern ucg_plan_component_t ucg_builtin_component;
 
 typedef union ucg_builtin_header_step {
     struct {
-        ucg_coll_id_t  coll_id;
+        uint8_t        coll_id; /* low bits of the (wider) ucg_coll_id_t */
         ucg_step_idx_t step_idx;
     };
     uint16_t local_id;
@@ -59,6 +61,25 @@ typedef union ucg_builtin_header {
     uint64_t header;
 } ucg_builtin_header_t;
 
+/*
+ * Groups which exceed the limits of the compact header above (e.g. more than
+ * 256 steps, buffers over 4GB or a window of slots wider than the 8-bit
+ * collective ID allows) use extended headers: the compact header is followed
+ * by this word, carrying the upper bits of each field. Extended headers are
+ * sent with a separate Active Message ID, so the receiver can tell them apart
+ * before even looking up the group.
+ */
+typedef union ucg_builtin_header_ext {
+    struct {
+        ucg_builtin_header_step_t msg_hi;           /* upper coll_id/step_idx */
+        uint16_t                  reserved;
+        uint32_t                  remote_offset_hi; /* upper remote_offset */
+    };
+    uint64_t header;
+} ucg_builtin_header_ext_t;
+
+#define UCG_BUILTIN_HEADER_EXT_SHIFT (8) /* bits of coll_id/step_idx sent */
+
 /*
  * The builtin operation
  */
@@ -124,7 +145,9 @@ enum ucg_builtin_op_step_comp_criteria {
     UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SINGLE_MESSAGE,
     UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES,
     UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_ZCOPY,
-    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET
+    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET,
+    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_FORWARD,
+    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_CREDITED
 }; /* Note: only 3 bits are allocated for this field in ucg_builtin_op_step_t */
 
 enum ucg_builtin_op_step_comp_action {
@@ -136,6 +159,7 @@ enum ucg_builtin_op_step_comp_action {
 /* Definitions of several callback functions, used during an operation */
 typedef struct ucg_builtin_op ucg_builtin_op_t;
 typedef struct ucg_builtin_request ucg_builtin_request_t;
+typedef struct ucg_builtin_resend ucg_builtin_resend_t;
 typedef void         (*ucg_builtin_op_init_cb_t)  (ucg_builtin_op_t *op,
                                                    ucg_coll_id_t coll_id);
 typedef void         (*ucg_builtin_op_fini_cb_t)  (ucg_builtin_op_t *op);
@@ -146,6 +170,65 @@ typedef struct ucg_builtin_zcomp {
     ucg_builtin_request_t     *req;
 } ucg_builtin_zcomp_t;
 
+/*
+ * A non-contiguous datatype the application describes as a vector (see
+ * ucg_params_t.datatype.get_vector_f ): the packed data is made of "blocks"
+ * blocks of "blocklen" bytes each, "stride" bytes apart, the first one "displ"
+ * bytes into the buffer. Such data is zero-copied from an IOV entry per block,
+ * and received by copying into those blocks directly.
+ */
+#define UCG_BUILTIN_DT_VECTOR_MAX_IOV (16) /* per message, at most */
+typedef struct ucg_builtin_dt_vector {
+    size_t                     blocklen; /* 0 unless described as a vector */
+    size_t                     blocks;
+    ptrdiff_t                  stride;
+    ptrdiff_t                  displ;
+} ucg_builtin_dt_vector_t;
+
+/*
+ * One-sided (RMA) state of a step (see @ref ucg_builtin_optimize_am_to_rma ):
+ * as a receiver - its receive buffer, registered for the peer to write into
+ * (or to read the peer's offered data into, see @ref ucg_builtin_step_rndv_get ),
+ * and as a sender - the peer's receive buffer, as last advertised by the peer
+ * (or its own send buffer, offered to the peers to read from).
+ */
+typedef struct ucg_builtin_step_rma {
+    uct_component_h            cmpt;          /* unpacks the peer's key */
+    size_t                     rkey_size;     /* size of a packed remote key */
+    uct_mem_h                  recv_memh;     /* own receive buffer, or NULL */
+    ucs_rcache_region_t       *recv_region;   /* cached registration, if any */
+    uct_mem_h                  send_memh;     /* own send buffer, if offered */
+    ucs_rcache_region_t       *send_region;   /* cached registration, if any */
+    uint32_t                   ready_key;     /* message key the peer is ready
+                                                 for (see UCG_BUILTIN_MSG_KEY) */
+    uint8_t                    can_put;       /* may send data by a put */
+    uint8_t                    is_advertised; /* peer has the current receive
+                                                 buffer (or knows there's none) */
+    uint8_t                    has_peer_rkey; /* is peer_rkey unpacked */
+    uint8_t                    is_put_done;   /* put sent, notification not */
+    uint8_t                    is_offered;    /* send buffer is registered */
+    uint64_t                   peer_addr;     /* peer's receive buffer */
+    uct_rkey_bundle_t          peer_rkey;     /* peer's receive buffer key */
+    uint8_t                    rkeys[0];      /* own key (packed), then peer's */
+} ucg_builtin_step_rma_t;
+
+/*
+ * Lanes the fragments of a zero-copy send are striped across (see
+ * @ref ucg_builtin_step_rails_create ): fragment #i goes over the lane at
+ * schedule[i % UCG_BUILTIN_RAIL_SCHEDULE], lane 0 being the step's own endpoint
+ * (and step->zcopy.memh), in proportion to the bandwidth of each lane.
+ */
+#define UCG_BUILTIN_RAIL_SCHEDULE (16)
+typedef struct ucg_builtin_step_rails {
+    uint8_t                        cnt;       /* lanes, incl. the step's own */
+    uint8_t                        schedule[UCG_BUILTIN_RAIL_SCHEDULE];
+    const ucg_builtin_plan_rail_t *lanes[UCG_BUILTIN_MAX_RAILS]; /* [0] unused */
+    uct_mem_h                      memh[UCG_BUILTIN_MAX_RAILS];
+    ucs_rcache_region_t           *region[UCG_BUILTIN_MAX_RAILS];
+    uct_ep_h                       eps[];     /* lanes 1..cnt-1, per endpoint */
+} ucg_builtin_step_rails_t;
+
+/* The "--- N bytes ---" marks below are checked in ucg_builtin_op_create() */
 typedef struct ucg_builtin_op_step {
     enum ucg_builtin_op_step_flags            flags            :19;
     enum ucg_builtin_op_step_comp_flags       comp_flags       :5;
@@ -158,9 +241,12 @@ typedef struct ucg_builtin_op_step {
     uint8_t                    iter_ep;     /* iterator, somewhat volatile */
 #define UCG_BUILTIN_OFFSET_PIPELINE_READY   ((ucg_offset_t)-1)
 #define UCG_BUILTIN_OFFSET_PIPELINE_PENDING ((ucg_offset_t)-2)
+#define UCG_BUILTIN_OFFSET_RMA_READY        ((ucg_offset_t)-3) /* in headers */
+#define UCG_BUILTIN_OFFSET_CREDIT_GRANT     ((ucg_offset_t)-4) /* in headers */
+#define UCG_BUILTIN_OFFSET_RNDV_OFFER       ((ucg_offset_t)-5) /* in headers */
     /* TODO: consider modifying "send_buffer" and removing iter_offset */
 
-    uint8_t                    reserved;
+    uint8_t                    is_placeable; /* may be written before it starts */
     uint8_t                    ep_cnt;
     uint8_t                    batch_cnt;
 
@@ -197,6 +283,9 @@ typedef struct ucg_builtin_op_step {
     int                       *var_counts;
     int                       *var_displs;
     uct_md_h                   uct_md;
+    ucg_builtin_header_ext_t   am_header_ext;   /* only for extended headers */
+
+    /* --- 128 bytes --- */
 
     /* Send-type-specific fields */
     union {
@@ -207,12 +296,30 @@ typedef struct ucg_builtin_op_step {
         } bcopy;
         struct {
             uct_mem_h            memh;   /* Data buffer memory handle */
+            ucs_rcache_region_t *region; /* cached registration, if any */
             uct_component_h      cmpt;   /* which component registered the memory */
             ucg_builtin_zcomp_t  zcomp;  /* completion context for UCT zcopy */
             uint64_t             raddr;  /* remote address (from previous step) */
             uct_rkey_bundle_t    rkey;   /* remote key (from previous step) */
+            ucg_builtin_dt_vector_t vector; /* send buffer layout, if strided */
         } zcopy;
     };
+
+    /* Messages written in-place before this step has started (see
+     * @ref ucg_builtin_step_place_early ), by the index of their chunk */
+#define UCG_BUILTIN_EARLY_ARRIVALS_MAX (64)
+    uint64_t                   early_arrivals;
+
+    ucg_builtin_step_rma_t    *rma;             /* NULL unless one-sided */
+    ucg_builtin_step_rails_t  *rails;           /* NULL unless multi-rail */
+    uint8_t                   *pack_source;     /* NULL unless packed once */
+
+    /* Fan-in flow-control (see @ref ucg_builtin_set_phase_credits ) */
+#define UCG_BUILTIN_CREDITS_OFF ((uint32_t)-1)
+    uint32_t                   credits;         /* fragments I may still send */
+    uint32_t                   credit_window;   /* fragments sent per grant */
+    uint32_t                   credit_batch;    /* fragments received per grant */
+    uint32_t                   credit_total;    /* fragments received in total */
 } UCS_S_PACKED UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE) ucg_builtin_op_step_t;
 
 enum ucg_builtin_op_flags {
@@ -233,7 +340,13 @@ enum ucg_builtin_op_flags {
     UCG_BUILTIN_OP_FLAG_SEND_PACK       = UCS_BIT(10),
     UCG_BUILTIN_OP_FLAG_SEND_UNPACK     = UCS_BIT(11),
     UCG_BUILTIN_OP_FLAG_RECV_PACK       = UCS_BIT(12),
-    UCG_BUILTIN_OP_FLAG_RECV_UNPACK     = UCS_BIT(13)
+    UCG_BUILTIN_OP_FLAG_RECV_UNPACK     = UCS_BIT(13),
+
+    /* Ring steps each reduce a chunk in place (see ucg_builtin_init_ring) */
+    UCG_BUILTIN_OP_FLAG_RING            = UCS_BIT(14),
+
+    /* Local copies use streaming stores (see ucg_builtin_memcpy) */
+    UCG_BUILTIN_OP_FLAG_STREAM_COPY     = UCS_BIT(15)
 };
 
 /* Below are the flags relevant for step completion, a.k.a. op finalize stage */
@@ -243,7 +356,10 @@ enum ucg_builtin_op_flags {
                                            UCG_BUILTIN_OP_FLAG_NON_CONTIGUOUS)
 
 enum ucg_builtin_request_flags {
-    UCG_BUILTIN_REQUEST_FLAG_HANDLE_OOO = UCS_BIT(0)
+    UCG_BUILTIN_REQUEST_FLAG_HANDLE_OOO     = UCS_BIT(0),
+    UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT     = UCS_BIT(1),
+    UCG_BUILTIN_REQUEST_FLAG_RESEND_QUEUED  = UCS_BIT(2), /* in resend_head */
+    UCG_BUILTIN_REQUEST_FLAG_RESEND_PENDING = UCS_BIT(3)  /* on a UCT endpoint */
 };
 
 struct ucg_builtin_op {
@@ -259,8 +375,15 @@ struct ucg_builtin_op {
     ucp_dt_state_t          *send_unpack; /**< send datatype - unpack state */
     ucp_dt_state_t          *recv_pack;   /**< recv datatype - pack state */
     ucp_dt_state_t          *recv_unpack; /**< recv datatype - unpack state */
+    ucg_builtin_dt_vector_t  recv_vector; /**< recv datatype - if a vector */
+    float                   *widened;     /**< single-precision partial result */
+    ucg_builtin_op_step_t   *widened_step;/**< step the above is valid for */
+    ucg_op_reduce_frag_f     reduce_chunk_f; /**< reducer split among threads */
+    size_t                   reduce_dt_len;  /**< element size for splitting */
+    ucg_builtin_reduce_pool_t *reduce_pool;  /**< reduction helper threads */
 
     ucg_builtin_group_ctx_t *gctx;        /**< builtin-group context pointer */
+    ucg_coll_id_t            pending_id;  /**< coll_id of a deferred trigger */
     ucg_builtin_op_step_t    steps[];     /**< steps required to complete the operation */
 } UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE);
 
@@ -277,17 +400,141 @@ struct ucg_builtin_request {
     ucg_builtin_op_t         *op;           /**< operation currently running */
     void                     *comp_req;     /**< completion status is written here */
     ucs_queue_elem_t          resend_queue; /**< membership in the resend queue */
+    ucg_builtin_resend_t     *resend;       /**< resend once the endpoint can */
+    ucg_builtin_header_step_t expecting_hi; /**< upper bits (extended headers) */
+    uint32_t                  offset_hi;    /**< upper offset of the last packet */
 };
 
+/*
+ * Messages arriving before their step has started are stored in per-step
+ * queues, hashed by the local ID (incl. the upper bits of extended headers)
+ * they were sent with - so starting a step only touches its own messages.
+ * The queues are chained through the queue element of the UCP receive
+ * descriptor, unused otherwise for these messages. Only non-empty queues are
+ * kept in the hash, so their tail pointers remain valid when it is resized.
+ */
+KHASH_MAP_INIT_INT(ucg_builtin_msg, ucs_queue_head_t)
+
+#define UCG_BUILTIN_MSG_KEY(_local_id, _local_id_hi) \
+    ((uint32_t)(_local_id) | ((uint32_t)(_local_id_hi) << 16))
+
 /*
  * Incoming messages are processed for one of the collective operations
  * currently outstanding - arranged as a window (think: TCP) of slots.
  */
 typedef struct ucg_builtin_comp_slot {
-    ucg_builtin_request_t req;
-    ucs_ptr_array_t       messages;
+    ucg_builtin_request_t    req;
+    khash_t(ucg_builtin_msg) messages; /**< stored messages, by step */
 } UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE) ucg_builtin_comp_slot_t;
 
+static UCS_F_ALWAYS_INLINE uint32_t
+ucg_builtin_header_msg_key(const ucg_builtin_header_t *header, int is_ext)
+{
+    return UCG_BUILTIN_MSG_KEY(header->msg.local_id, !is_ext ? 0 :
+            ((const ucg_builtin_header_ext_t*)(header + 1))->msg_hi.local_id);
+}
+
+/*
+ * Find (or create) the queue of stored messages for a given key - or return
+ * NULL if the hash could not grow for it (see @ref ucg_builtin_comp_window_queue ).
+ */
+static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
+ucg_builtin_comp_slot_queue(ucg_builtin_comp_slot_t *slot, uint32_t key)
+{
+    int ret;
+    ucs_queue_head_t *queue;
+    khiter_t iter = kh_put(ucg_builtin_msg, &slot->messages, key, &ret);
+
+    if (ucs_unlikely(ret == UCS_KH_PUT_FAILED)) {
+        return NULL;
+    }
+
+    queue = &kh_val(&slot->messages, iter);
+    if (ret != UCS_KH_PUT_KEY_PRESENT) {
+        ucs_queue_head_init(queue);
+    }
+
+    return queue;
+}
+
+/*
+ * The window of slots starts at BUILTIN_CONCURRENT_OPS slots, and doubles
+ * (up to BUILTIN_MAX_CONCURRENT_OPS) whenever a trigger finds its slot still
+ * taken. Once it can grow no more, such triggers are deferred to the pending
+ * queue, and started from the worker's progress as soon as their slot frees.
+ * Slots are allocated separately, so growing never moves a request in use.
+ */
+typedef struct ucg_builtin_comp_window {
+    ucg_builtin_comp_slot_t **slots;       /**< indexed by (coll_id & mask) */
+    unsigned                  mask;        /**< current slot count, minus one */
+    unsigned                  max_mask;    /**< maximal slot count, minus one */
+    ucs_queue_head_t          pending;     /**< ops deferred for a busy slot */
+    ucs_queue_head_t          overflow;    /**< stored messages no slot could
+                                                take (out of memory) */
+    uct_worker_cb_id_t        progress_id; /**< drains the pending queue */
+    uint16_t                  am_id;       /**< active message ID of the slots */
+    uint16_t                  slot_flags;  /**< initial request flags of slots */
+    int                       desc_budget; /**< transport descriptors we may
+                                                still hold (for stored messages) */
+} ucg_builtin_comp_window_t;
+
+/* Note: the window of slots is the first member of ucg_builtin_group_ctx_t */
+#define UCG_BUILTIN_OP_GET_WINDOW(_gctx) ((ucg_builtin_comp_window_t*)(_gctx))
+
+static UCS_F_ALWAYS_INLINE ucg_builtin_comp_slot_t*
+ucg_builtin_comp_window_slot(ucg_builtin_comp_window_t *window,
+                             ucg_coll_id_t coll_id)
+{
+    return window->slots[coll_id & window->mask];
+}
+
+/*
+ * The queue to store messages for a given key in: the slot's own - or, if its
+ * hash can not grow (out of memory), the window's overflow queue. Messages are
+ * not lost this way, but wait there for @ref ucg_builtin_comp_window_retry to
+ * move them to their slot - so while any do, so do all the later ones, which
+ * keeps them in the order of arrival.
+ */
+static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
+ucg_builtin_comp_window_queue(ucg_builtin_comp_window_t *window,
+                              ucg_builtin_comp_slot_t *slot, uint32_t key)
+{
+    ucs_queue_head_t *queue;
+
+    if (ucs_likely(ucs_queue_is_empty(&window->overflow)) &&
+        ucs_likely((queue = ucg_builtin_comp_slot_queue(slot, key)) != NULL)) {
+        return queue;
+    }
+
+    return &window->overflow;
+}
+
+/*
+ * Give stored messages of a given key (which arrived before any of those in
+ * the overflow queue) back to their slot - or, if out of memory, put them at
+ * the front of the overflow queue, still ahead of the later ones.
+ */
+static UCS_F_ALWAYS_INLINE void
+ucg_builtin_comp_window_splice(ucg_builtin_comp_window_t *window,
+                               ucg_builtin_comp_slot_t *slot, uint32_t key,
+                               ucs_queue_head_t *messages)
+{
+    ucs_queue_head_t *queue = ucg_builtin_comp_slot_queue(slot, key);
+
+    if (ucs_likely(queue != NULL)) {
+        ucs_queue_splice(queue, messages);
+    } else {
+        ucs_queue_splice(messages, &window->overflow);
+        ucs_queue_splice(&window->overflow, messages);
+    }
+}
+
+/*
+ * Move the messages from the overflow queue to their slots, for as long as
+ * memory allows - called before stored messages are looked for.
+ */
+void ucg_builtin_comp_window_retry(ucg_builtin_comp_window_t *window);
+
 typedef struct ucg_builtin_comp_desc {
     ucp_recv_desc_t      super;
     char                 padding[UCP_WORKER_HEADROOM_PRIV_SIZE];
@@ -295,12 +542,49 @@ typedef struct ucg_builtin_comp_desc {
     char                 data[0];
 } ucg_builtin_comp_desc_t;
 
+/*
+ * Release a stored message once consumed - returning the descriptor to the
+ * transport (or to the worker's pool, in case the message was copied).
+ */
+void ucg_builtin_release_comp_desc(ucg_builtin_comp_window_t *window,
+                                   ucp_recv_desc_t *rdesc, uct_iface_h iface);
+
+/*
+ * The costs which determine whether copying or registering a send buffer is
+ * cheaper (see @ref ucg_builtin_set_phase_thresh_zcopy ), per memory domain.
+ */
+typedef struct ucg_builtin_zcopy_model {
+    uct_md_h          md;       /**< memory domain these were measured on */
+    double            copy_bw;  /**< memory copy bandwidth, in bytes/second */
+    ucs_linear_func_t reg_cost; /**< registration time, in seconds */
+} ucg_builtin_zcopy_model_t;
+
+/*
+ * User buffers are registered through a cache per memory domain, shared by all
+ * the groups (see @ref ucg_builtin_mem_reg ).
+ */
+typedef struct ucg_builtin_rcache {
+    uct_md_h          md;       /**< memory domain registering the buffers */
+    ucs_rcache_t     *rcache;   /**< NULL if it could not be created */
+} ucg_builtin_rcache_t;
+
+typedef struct ucg_builtin_rcache_region {
+    ucs_rcache_region_t super;
+    uct_mem_h           memh;   /**< registration of the entire region */
+} ucg_builtin_rcache_region_t;
+
 typedef struct ucg_builtin_ctx {
-    ucs_ptr_array_locked_t group_by_id;
-    uint16_t               am_id;
-    ucp_worker_h           worker;
-    ucs_ptr_array_locked_t unexpected;
-    ucg_builtin_config_t   config;
+    ucs_ptr_array_locked_t     group_by_id;
+    uint16_t                   am_id;
+    uint16_t                   am_id_ext;  /**< for extended headers */
+    ucp_worker_h               worker;
+    ucs_ptr_array_locked_t     unexpected;
+    ucg_builtin_config_t       config;
+    ucg_builtin_zcopy_model_t *calibrated; /**< measured, per memory domain */
+    unsigned                   calibrated_cnt;
+    ucg_builtin_rcache_t      *rcaches;    /**< registration caches, per md */
+    unsigned                   rcache_cnt;
+    ucg_builtin_reduce_pool_t *reduce_pool; /**< helper threads, or NULL */
 } ucg_builtin_ctx_t;
 
 
@@ -328,9 +612,21 @@ ucs_status_t ucg_builtin_step_create_rkey_bcast(ucg_builtin_plan_t *plan,
 ucs_status_t ucg_builtin_step_execute(ucg_builtin_request_t *req,
                                       ucg_builtin_header_t header);
 
+void ucg_builtin_step_send_ahead(ucg_builtin_request_t *req,
+                                 ucg_offset_t offset);
+
+void ucg_builtin_step_grant_credits(ucg_builtin_request_t *req,
+                                    ucg_builtin_header_t header);
+
+int ucg_builtin_step_rndv_get(ucg_builtin_request_t *req,
+                              ucg_builtin_header_t header,
+                              const uint8_t *offer, size_t length);
+
 ucs_status_t ucg_builtin_step_zcopy_prep(ucg_builtin_op_step_t *step,
                                          const ucg_collective_params_t *params);
 
+void ucg_builtin_step_zcopy_dereg(ucg_builtin_op_step_t *step);
+
 ucs_status_t ucg_builtin_step_select_packers(const ucg_collective_params_t *params,
                                              size_t send_dt_len,
                                              int is_send_dt_contig,
@@ -345,25 +641,102 @@ ucs_status_t ucg_builtin_step_select_reducers(void *dtype, void *reduce_op,
                                               ucg_op_reduce_frag_f
                                               *selected_reduce_frag_f);
 
+size_t ucg_builtin_reduce_pair_extent(void *dtype);
+
+int ucg_builtin_reduce_loc_is_native(void *dtype, void *reduce_op);
+
+const char* ucg_builtin_reduce_select_isa(unsigned isa, void *dtype,
+                                          void *reduce_op, size_t dtype_len,
+                                          ucg_op_reduce_full_f *reduce_full_f,
+                                          ucg_op_reduce_frag_f *reduce_frag_f);
+
+ucs_status_t ucg_builtin_convert_datatype(void *param_datatype,
+                                          ucp_datatype_t *ucp_datatype);
+
+ucs_status_t ucg_builtin_reduce_pool_create(unsigned thread_cnt, size_t chunk,
+                                            size_t thresh,
+                                            ucg_builtin_reduce_pool_t **pool_p);
+
+void ucg_builtin_reduce_pool_destroy(ucg_builtin_reduce_pool_t *pool);
+
+size_t ucg_builtin_reduce_pool_thresh(const ucg_builtin_reduce_pool_t *pool);
+
+int ucg_builtin_reduce_pool_run(ucg_builtin_reduce_pool_t *pool,
+                                ucg_op_reduce_frag_f reduce_f, ucg_op_t *op,
+                                uint8_t *dst, uint8_t *src, size_t length,
+                                size_t dt_len);
+
+void ucg_builtin_reduce_parallelize(ucg_builtin_op_t *op,
+                                    ucg_builtin_reduce_pool_t *pool,
+                                    size_t dt_len);
+
 
 ucs_status_t ucg_builtin_op_create (ucg_plan_t *plan,
                                     const ucg_collective_params_t *params,
                                     ucg_op_t **op);
 
+int ucg_builtin_dt_get_vector(void *dtype, int count, size_t dt_len,
+                              ucg_builtin_dt_vector_t *vector);
+
 ucs_status_t ucg_builtin_op_consider_optimization(ucg_builtin_op_t *op,
                                                   ucg_builtin_config_t *config);
 
+int ucg_builtin_op_step_can_place(ucg_builtin_op_t *op,
+                                  ucg_builtin_op_step_t *step);
+
+ucs_status_t ucg_builtin_step_rma_advertise(ucg_builtin_request_t *req,
+                                            ucg_builtin_op_step_t *step,
+                                            ucg_builtin_header_t header);
+
+void ucg_builtin_step_rma_recv_prep(ucg_builtin_op_t *op,
+                                    ucg_builtin_op_step_t *step);
+
+void ucg_builtin_step_rma_accept(ucg_builtin_op_step_t *step,
+                                 const uint8_t *info, size_t length);
+
+ucg_builtin_step_rma_t *ucg_builtin_step_rma_create(ucg_builtin_op_step_t *step,
+                                                    int can_put);
+
+ucs_status_t ucg_builtin_step_rndv_offer_prep(ucg_builtin_op_step_t *step);
+
+void ucg_builtin_step_rma_discard(ucg_builtin_op_step_t *step);
+
 ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
                                     ucg_coll_id_t coll_id,
                                     void *request);
 
+ucs_status_t ucg_builtin_op_resume(ucg_builtin_op_t *op,
+                                   ucg_builtin_comp_slot_t *slot);
+
+ucs_status_t ucg_builtin_comp_window_defer(ucg_builtin_group_ctx_t *gctx,
+                                           ucg_builtin_op_t *op,
+                                           ucg_coll_id_t coll_id,
+                                           void *request);
+
 void ucg_builtin_op_discard(ucg_op_t *op);
 
+ucs_status_t ucg_builtin_op_rebind(ucg_builtin_op_t *op,
+                                   const ucg_collective_params_t *params);
+
 void ucg_builtin_op_finalize_by_flags(ucg_builtin_op_t *op);
 
 
+ucs_status_t ucg_builtin_mem_reg(uct_md_h md, ucs_rcache_t *rcache,
+                                 void *address, size_t length, int prot,
+                                 uct_mem_h *memh_p,
+                                 ucs_rcache_region_t **region_p);
+
+void ucg_builtin_mem_dereg(uct_md_h md, ucs_rcache_t *rcache, uct_mem_h memh,
+                           ucs_rcache_region_t *region);
+
+const ucg_builtin_plan_rails_t* ucg_builtin_get_rails(ucg_builtin_group_ctx_t *gctx,
+                                                      uct_ep_h ep);
+
 void ucg_builtin_req_enqueue_resend(ucg_builtin_group_ctx_t *gctx,
-                                    ucg_builtin_request_t *req);
+                                    ucg_builtin_request_t *req,
+                                    uct_ep_h ep);
+
+int ucg_builtin_req_resend(ucg_builtin_request_t *req);
 
 int ucg_is_noncontig_allreduce(const ucg_group_params_t *group_params,
                                const ucg_collective_params_t *coll_params);
@@ -377,6 +750,116 @@ void ucg_builtin_print_pack_cb_name(uct_pack_callback_t pack_single_cb);
 
 void ucg_builtin_print_flags(ucg_builtin_op_step_t *step, uint32_t op_flags);
 
+static UCS_F_ALWAYS_INLINE size_t
+ucg_builtin_header_length(ucg_builtin_request_t *req)
+{
+    return sizeof(ucg_builtin_header_t) +
+           ((req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT) ?
+            sizeof(ucg_builtin_header_ext_t) : 0);
+}
+
+static UCS_F_ALWAYS_INLINE uint64_t
+ucg_builtin_step_header_ext(ucg_builtin_request_t *req,
+                            ucg_builtin_op_step_t *step)
+{
+    ucg_builtin_header_ext_t ext = step->am_header_ext;
+    ext.msg_hi.coll_id           = req->expecting_hi.coll_id;
+    return ext.header;
+}
+
+/*
+ * The collective ID of a (stored) message - including the upper bits carried
+ * by the extended header, if one follows.
+ */
+static UCS_F_ALWAYS_INLINE ucg_coll_id_t
+ucg_builtin_header_coll_id(const ucg_builtin_header_t *header, int is_ext)
+{
+    const ucg_builtin_header_ext_t *ext;
+
+    if (ucs_likely(!is_ext)) {
+        return header->msg.coll_id;
+    }
+
+    ext = (const ucg_builtin_header_ext_t*)(header + 1);
+    return header->msg.coll_id |
+           ((ucg_coll_id_t)ext->msg_hi.coll_id << UCG_BUILTIN_HEADER_EXT_SHIFT);
+}
+
+/*
+ * Whether a message only advertises its sender's receive buffer, to be written
+ * (see @ref ucg_builtin_step_rma_advertise ) - rather than carry data, at an
+ * offset no (compact header's) buffer could reach.
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_header_is_rma_ready(ucg_offset_t remote_offset, int is_ext,
+                                uint32_t remote_offset_hi)
+{
+    return ucs_unlikely(remote_offset == UCG_BUILTIN_OFFSET_RMA_READY) &&
+           (!is_ext || (remote_offset_hi == UINT32_MAX));
+}
+
+/*
+ * Whether a message only grants its receiver more fragments to send up a
+ * fan-in tree (see @ref ucg_builtin_step_grant_credits ) - rather than carry data.
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_header_is_credit_grant(ucg_offset_t remote_offset, int is_ext,
+                                   uint32_t remote_offset_hi)
+{
+    return ucs_unlikely(remote_offset == UCG_BUILTIN_OFFSET_CREDIT_GRANT) &&
+           (!is_ext || (remote_offset_hi == UINT32_MAX));
+}
+
+/*
+ * Whether a message offers its receiver to read the data from the sender's
+ * memory (see @ref ucg_builtin_step_rndv_offer_prep ) - rather than carry it.
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_header_is_rndv_offer(ucg_offset_t remote_offset, int is_ext,
+                                 uint32_t remote_offset_hi)
+{
+    return ucs_unlikely(remote_offset == UCG_BUILTIN_OFFSET_RNDV_OFFER) &&
+           (!is_ext || (remote_offset_hi == UINT32_MAX));
+}
+
+/*
+ * The payload of such an offer: where the data is, and the (packed) remote
+ * key to read it with.
+ */
+typedef struct ucg_builtin_rndv_offer {
+    uint64_t                   address;
+    uint64_t                   length;
+    uint8_t                    rkey[0];
+} UCS_S_PACKED ucg_builtin_rndv_offer_t;
+
+static UCS_F_ALWAYS_INLINE ucg_coll_id_t
+ucg_builtin_req_coll_id(const ucg_builtin_request_t *req)
+{
+    return req->expecting.coll_id |
+           ((ucg_coll_id_t)req->expecting_hi.coll_id << UCG_BUILTIN_HEADER_EXT_SHIFT);
+}
+
+/*
+ * Write the header (compact or extended) of an outgoing message, and return
+ * its length - the payload should follow right after it.
+ */
+static UCS_F_ALWAYS_INLINE size_t
+ucg_builtin_step_pack_header(ucg_builtin_request_t *req,
+                             ucg_builtin_op_step_t *step, void *dest)
+{
+    uint64_t *header = (uint64_t*)dest;
+    header[0]        = step->am_header.header;
+
+    ucs_assert(header[0] != 0);
+
+    if (ucs_likely(!(req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT))) {
+        return sizeof(ucg_builtin_header_t);
+    }
+
+    header[1] = ucg_builtin_step_header_ext(req, step);
+    return sizeof(ucg_builtin_header_t) + sizeof(ucg_builtin_header_ext_t);
+}
+
 /*
  * Macros to generate the headers of all bcopy packing callback functions.
  */
@@ -432,16 +915,118 @@ ucg_builtin_step_length(ucg_builtin_op_step_t *step,
     return step->buffer_length;
 }
 
+/* The extent of the memory a vector datatype occupies (to be registered) */
+static UCS_F_ALWAYS_INLINE size_t
+ucg_builtin_dt_vector_span(const ucg_builtin_dt_vector_t *vector)
+{
+    return vector->displ + (vector->blocks - 1) * vector->stride +
+           vector->blocklen;
+}
+
+/*
+ * Check whether every message of (up to) "length" bytes of the packed data of
+ * a vector datatype, each starting where the previous one ended, fits in as
+ * many IOV entries as the transport takes - one per block it covers. Messages
+ * of whole blocks are aligned to them, otherwise each may start mid-block.
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_dt_vector_fits(const ucg_builtin_dt_vector_t *vector,
+                           size_t length, size_t max_iov)
+{
+    size_t iovcnt = (length / vector->blocklen) +
+                    (((length % vector->blocklen) != 0) ? 2 : 0);
+
+    return ucs_min(iovcnt, vector->blocks) <=
+           ucs_min(max_iov, UCG_BUILTIN_DT_VECTOR_MAX_IOV);
+}
+
+/*
+ * Describe a range of the packed data of a vector datatype as IOV entries, one
+ * per block (or part of one) it covers - rather than a single strided entry,
+ * which not every transport supports. The range is expected to fit (see
+ * @ref ucg_builtin_dt_vector_fits ). Returns the number of entries.
+ */
+static UCS_F_ALWAYS_INLINE unsigned
+ucg_builtin_dt_vector_iov(const ucg_builtin_dt_vector_t *vector,
+                          uint8_t *buffer, size_t offset, size_t length,
+                          uct_mem_h memh, uct_iov_t *iov)
+{
+    unsigned iovcnt = 0;
+    size_t skip     = offset % vector->blocklen;
+    uint8_t *block  = buffer + vector->displ +
+                      (offset / vector->blocklen) * vector->stride;
+
+    while (length) {
+        ucs_assert(iovcnt < UCG_BUILTIN_DT_VECTOR_MAX_IOV);
+        iov[iovcnt].buffer = block + skip;
+        iov[iovcnt].length = ucs_min(length, vector->blocklen - skip);
+        iov[iovcnt].memh   = memh;
+        iov[iovcnt].stride = 0;
+        iov[iovcnt].count  = 1;
+        length            -= iov[iovcnt].length;
+        block             += vector->stride;
+        skip               = 0;
+        iovcnt++;
+    }
+
+    return iovcnt;
+}
+
+/*
+ * Local copies of an op touching more data than BUILTIN_STREAM_COPY_THRESH
+ * (decided once, on its creation) bypass the caches: the copied data is not
+ * likely to be used again soon - while the application data it would evict
+ * from the (last-level) cache probably is. Reductions never stream, since their
+ * output is read again right away - by the next step or the next send.
+ */
+void ucg_builtin_memcpy_stream(void *dst, const void *src, size_t length);
+
+static UCS_F_ALWAYS_INLINE void
+ucg_builtin_memcpy(ucg_builtin_op_t *op, void *dst, const void *src,
+                   size_t length)
+{
+    if (ucs_likely(!(op->flags & UCG_BUILTIN_OP_FLAG_STREAM_COPY))) {
+        memcpy(dst, src, length);
+    } else {
+        ucg_builtin_memcpy_stream(dst, src, length);
+    }
+}
+
+/* Copy a range of the packed data of a vector datatype into its blocks */
+static UCS_F_ALWAYS_INLINE void
+ucg_builtin_dt_vector_scatter(ucg_builtin_op_t *op,
+                              const ucg_builtin_dt_vector_t *vector,
+                              uint8_t *buffer, size_t offset,
+                              const uint8_t *src, size_t length)
+{
+    size_t chunk;
+    size_t skip  = offset % vector->blocklen;
+    uint8_t *dst = buffer + vector->displ + skip +
+                   (offset / vector->blocklen) * vector->stride;
+
+    while (length) {
+        chunk   = ucs_min(length, vector->blocklen - skip);
+        ucg_builtin_memcpy(op, dst, src, chunk);
+        src    += chunk;
+        length -= chunk;
+        dst    += vector->stride - skip;
+        skip    = 0;
+    }
+}
+
 /*
- * This number sets the number of slots available for collective operations.
+ * This number caps the window of slots available for collective operations.
  * Each operation occupies a slot, so no more than this number of collectives
- * can take place at the same time. The slot is determined by the collective
- * operation id (ucg_coll_id_t) - modulo this constant. Translating "coll_id"
- * to slot# happens on every incoming packet, so this constant is best kept
- * determinable at compile time, and set to a power of 2 (<= 64, to fit into
- * the resend bit-field).
+ * can take place at the same time - the rest are deferred. The slot is
+ * determined by the collective operation id (ucg_coll_id_t) - modulo the
+ * (power of 2) window size. Only the low bits of "coll_id" are sent in the
+ * header, so the window is kept to half their range: a message for an op one
+ * window ahead never carries the ID of the op still holding that slot. With
+ * extended headers the entire "coll_id" is sent, so the window can be wider.
  */
-#define UCG_BUILTIN_MAX_CONCURRENT_OPS (16)
+#define UCG_BUILTIN_COLL_ID_HEADER_BITS    (8)
+#define UCG_BUILTIN_MAX_CONCURRENT_OPS     UCS_BIT(UCG_BUILTIN_COLL_ID_HEADER_BITS - 1)
+#define UCG_BUILTIN_MAX_CONCURRENT_OPS_EXT UCS_BIT(sizeof(ucg_coll_id_t) * 8 - 1)
 
 END_C_DECLS
 
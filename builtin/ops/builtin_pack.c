@@ -8,10 +8,57 @@
 
 #include <ucs/arch/atomic.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
 #ifndef HAVE_UCT_COLLECTIVES
 #define UCT_PACK_CALLBACK_REDUCE ((uintptr_t)-1)
 #endif
 
+#define UCG_BUILTIN_STREAM_PREFETCH_DISTANCE (512) /* bytes ahead of the copy */
+
+/*
+ * Copies with non-temporal (streaming) stores, which write the destination
+ * straight to memory rather than allocate it in the caches. The source is
+ * prefetched into the closest cache level only (NTA), for the same reason.
+ * Outside x86 (e.g. on Arm) this is a regular copy.
+ */
+void ucg_builtin_memcpy_stream(void *dst, const void *src, size_t length)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    uint8_t *d       = dst;
+    const uint8_t *s = src;
+    size_t head      = ucs_min(length, (-(uintptr_t)d) & 15);
+    __m128i v0, v1, v2, v3;
+
+    /* Streaming stores must be aligned, so the head is copied as usual */
+    memcpy(d, s, head);
+    d      += head;
+    s      += head;
+    length -= head;
+
+    for (; length >= 64; d += 64, s += 64, length -= 64) {
+        _mm_prefetch((const char*)s + UCG_BUILTIN_STREAM_PREFETCH_DISTANCE,
+                     _MM_HINT_NTA);
+        v0 = _mm_loadu_si128((const __m128i*)s);
+        v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d,        v0);
+        _mm_stream_si128((__m128i*)(d + 16), v1);
+        _mm_stream_si128((__m128i*)(d + 32), v2);
+        _mm_stream_si128((__m128i*)(d + 48), v3);
+    }
+
+    /* Order the streaming stores before anything that follows the copy */
+    _mm_sfence();
+    memcpy(d, s, length);
+#else
+    memcpy(dst, src, length);
+#endif
+}
+
 #define UCG_BUILTIN_PACKER_NAME(_modifier, _mode) \
     ucg_builtin_step_am_bcopy_pack ## _modifier ## _mode
 
@@ -41,19 +88,19 @@ ucg_builtin_atomic_reduce_part(ucg_builtin_request_t *req,
 }
 
 #define UCG_BUILTIN_PACK_CB(_offset, _length) { \
-    ucg_builtin_header_t *header = (ucg_builtin_header_t*)dest; \
     ucg_builtin_request_t *req   = (ucg_builtin_request_t*)arg; \
     ucg_builtin_op_step_t *step  = req->step; \
     size_t buffer_length         = (_length); \
-    header->header               = step->am_header.header; \
+    size_t header_length         = ucg_builtin_step_pack_header(req, step, \
+                                                                dest); \
     \
-    ucs_assert(header->header != 0); \
     ucs_assert(((uintptr_t)arg & UCT_PACK_CALLBACK_REDUCE) == 0); \
     ucs_assert((_offset) + buffer_length <= step->buffer_length); \
     \
-    memcpy(header + 1, step->send_buffer + (_offset), buffer_length); \
+    ucg_builtin_memcpy(req->op, UCS_PTR_BYTE_OFFSET(dest, header_length), \
+                       step->send_buffer + (_offset), buffer_length); \
     \
-    return sizeof(*header) + buffer_length; \
+    return header_length + buffer_length; \
 }
 
 UCG_BUILTIN_PACKER_DECLARE(_, single)
@@ -71,12 +118,14 @@ UCG_BUILTIN_PACK_CB(step->iter_offset, step->buffer_length - step->iter_offset)
                                         ^ UCT_PACK_CALLBACK_REDUCE); \
         ucg_builtin_op_step_t *step  = req->step; \
         ucg_builtin_header_t *header = (ucg_builtin_header_t*)dest; \
+        size_t header_length         = ucg_builtin_header_length(req); \
         \
         ucs_assert(header->header != 0); \
         ucs_assert(header->header == step->am_header.header); \
         \
-        return sizeof(*header) + ucg_builtin_atomic_reduce_ ## _part \
-                (req, step->send_buffer + (_offset), header + 1, (_length)); \
+        return header_length + ucg_builtin_atomic_reduce_ ## _part \
+                (req, step->send_buffer + (_offset), \
+                 UCS_PTR_BYTE_OFFSET(dest, header_length), (_length)); \
     } else { \
         UCG_BUILTIN_PACK_CB((_offset), (_length)) \
     } \
@@ -173,20 +222,21 @@ UCG_BUILTIN_PACKER_DECLARE(_atomic_multiple_, 64)
 UCG_BUILTIN_ATOMIC_MULTIPLE_PACK_CB(64)
 
 #define UCG_BUILTIN_DATATYPE_PACK_CB(_offset, _length) { \
-    ucg_builtin_header_t *header = (ucg_builtin_header_t*)dest; \
     ucg_builtin_request_t *req   = (ucg_builtin_request_t*)arg; \
     ucg_builtin_op_t *op         = req->op; \
     ucp_dt_generic_t *dt_gen     = ucp_dt_to_generic(op->send_dt); \
     void *dt_state               = op->send_pack; \
     ucg_builtin_op_step_t *step  = req->step; \
     size_t buffer_length         = (_length); \
-    header->header               = step->am_header.header; \
+    size_t header_length         = ucg_builtin_step_pack_header(req, step, \
+                                                                dest); \
     \
     ucs_assert(((uintptr_t)arg & UCT_PACK_CALLBACK_REDUCE) == 0); \
     \
-    dt_gen->ops.pack(dt_state, (_offset), header + 1, buffer_length); \
+    dt_gen->ops.pack(dt_state, (_offset), \
+                     UCS_PTR_BYTE_OFFSET(dest, header_length), buffer_length); \
     \
-    return sizeof(*header) + buffer_length; \
+    return header_length + buffer_length; \
 }
 
 UCG_BUILTIN_PACKER_DECLARE(_datatype_, single)
@@ -199,6 +249,33 @@ UCG_BUILTIN_PACKER_DECLARE(_datatype_, part)
 UCG_BUILTIN_DATATYPE_PACK_CB(step->iter_offset, step->buffer_length -
                                                 step->iter_offset)
 
+/*
+ * Rather than the data, offer the peer to read it: where it is, and the key to
+ * it (see @ref ucg_builtin_step_rndv_offer_prep ).
+ */
+UCG_BUILTIN_PACKER_DECLARE(_rndv_, offer)
+{
+    ucg_builtin_request_t *req        = (ucg_builtin_request_t*)arg;
+    ucg_builtin_op_step_t *step       = req->step;
+    const ucg_builtin_step_rma_t *rma = step->rma;
+    ucg_builtin_header_t *header      = (ucg_builtin_header_t*)dest;
+    size_t header_length              = ucg_builtin_step_pack_header(req, step,
+                                                                     dest);
+    ucg_builtin_rndv_offer_t *offer   = UCS_PTR_BYTE_OFFSET(dest,
+                                                            header_length);
+
+    header->remote_offset = UCG_BUILTIN_OFFSET_RNDV_OFFER;
+    if (header_length > sizeof(*header)) {
+        ((ucg_builtin_header_ext_t*)(header + 1))->remote_offset_hi = UINT32_MAX;
+    }
+
+    offer->address = (uintptr_t)(step->send_buffer + step->iter_offset);
+    offer->length  = step->buffer_length;
+    memcpy(offer->rkey, rma->rkeys, rma->rkey_size);
+
+    return header_length + sizeof(*offer) + rma->rkey_size;
+}
+
 ucs_status_t
 ucg_builtin_step_select_packers(const ucg_collective_params_t *params,
                                 size_t send_dt_len, int is_send_dt_contig,
@@ -253,7 +330,12 @@ ucg_builtin_step_select_packers(const ucg_collective_params_t *params,
     int is_variadic   = (UCG_PARAM_TYPE(params).modifiers &
                          UCG_GROUP_COLLECTIVE_MODIFIER_VARIADIC);
 
-    if (!is_send_dt_contig) {
+    if ((step->rma != NULL) && step->rma->is_offered) {
+        /* Never fragmented - only the offer itself is sent */
+        step->bcopy.pack_full_cb   = NULL;
+        step->bcopy.pack_part_cb   = NULL;
+        step->bcopy.pack_single_cb = UCG_BUILTIN_PACKER_NAME(_rndv_, offer);
+    } else if (!is_send_dt_contig) {
         step->bcopy.pack_full_cb   = UCG_BUILTIN_PACKER_NAME(_datatype_, full);
         step->bcopy.pack_part_cb   = UCG_BUILTIN_PACKER_NAME(_datatype_, part);
         step->bcopy.pack_single_cb = UCG_BUILTIN_PACKER_NAME(_datatype_, single);
@@ -298,5 +380,7 @@ void ucg_builtin_print_pack_cb_name(uct_pack_callback_t pack_single_cb)
         printf("reduction callback");
     } else if (pack_single_cb == UCG_BUILTIN_PACKER_NAME(_, single)) {
         printf("memory copy");
+    } else if (pack_single_cb == UCG_BUILTIN_PACKER_NAME(_rndv_, offer)) {
+        printf("offer to read (address and remote key)");
     }
 }
@@ -7,6 +7,10 @@
 
 #include "ucp/dt/dt_contig.h" /* no braces since that header isn't installed */
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
 static void UCS_F_ALWAYS_INLINE
 ucg_builtin_mpi_reduce(void *mpi_op, void *src, void *dst,
                        int dcount, void* mpi_datatype)
@@ -52,19 +56,721 @@ static void ucg_builtin_step_full_sum_float_2(uint8_t *dst, uint8_t *src,
     ((float*)dst)[1] += ((float*)src)[1];
 }
 
-static void ucg_builtin_step_frag_sum_float(uint8_t *dst, uint8_t *src,
-                                            size_t frag_len, ucg_op_t *op)
+/*
+ * Native reducers for predefined operations on predefined data-types.
+ *
+ * Each kernel is a plain loop, which the compiler vectorizes for the
+ * instruction-set it is built for. On x86_64 the same loops are built for
+ * several instruction-sets (using the "target" function attribute), and the
+ * best one supported by this CPU is chosen once the reduction is selected.
+ * Integers are added and multiplied as unsigned (at least as wide as unsigned
+ * int), so that overflows wrap around rather than invoke undefined behavior.
+ *
+ * Half-precision (IEEE fp16) and bfloat16 elements are converted to single-
+ * precision, reduced, and rounded back (to nearest even) - which gives the
+ * same result as native half-precision arithmetic would. Where available,
+ * fp16 is converted by F16C/AVX-512 instructions, and bfloat16 (the upper half
+ * of a single-precision number) is rounded back by AVX-512 BF16 ones - without
+ * those, rounding it (NaNs included) keeps the loop from being vectorized. The
+ * BF16 instructions flush sub-normal results to zero, so vectors with any of
+ * those are rounded as before, keeping the results of all variants identical.
+ *
+ * MINLOC and MAXLOC operate on (value, index) pairs, laid out as C structures,
+ * and keep the lowest index among equal values - as MPI requires. Pairs which
+ * include padding (e.g. double and int) are reduced in this layout as well,
+ * padding included (see @ref ucg_builtin_reduce_pair_extent ).
+ */
+enum ucg_builtin_reduce_dtype {
+    UCG_BUILTIN_REDUCE_DTYPE_INT8 = 0,
+    UCG_BUILTIN_REDUCE_DTYPE_INT16,
+    UCG_BUILTIN_REDUCE_DTYPE_INT32,
+    UCG_BUILTIN_REDUCE_DTYPE_INT64,
+    UCG_BUILTIN_REDUCE_DTYPE_UINT8,
+    UCG_BUILTIN_REDUCE_DTYPE_UINT16,
+    UCG_BUILTIN_REDUCE_DTYPE_UINT32,
+    UCG_BUILTIN_REDUCE_DTYPE_UINT64,
+    UCG_BUILTIN_REDUCE_DTYPE_FLOAT,
+    UCG_BUILTIN_REDUCE_DTYPE_DOUBLE,
+    UCG_BUILTIN_REDUCE_DTYPE_HALF,
+    UCG_BUILTIN_REDUCE_DTYPE_BFLOAT16,
+    UCG_BUILTIN_REDUCE_DTYPE_FLOAT_INT,
+    UCG_BUILTIN_REDUCE_DTYPE_DOUBLE_INT,
+    UCG_BUILTIN_REDUCE_DTYPE_LONG_INT,
+    UCG_BUILTIN_REDUCE_DTYPE_SHORT_INT,
+    UCG_BUILTIN_REDUCE_DTYPE_2INT,
+    UCG_BUILTIN_REDUCE_DTYPE_LAST
+};
+
+enum ucg_builtin_reduce_isa {
+    UCG_BUILTIN_REDUCE_ISA_GENERIC = 0,
+#if defined(__x86_64__) && defined(__GNUC__)
+    UCG_BUILTIN_REDUCE_ISA_SSE42,
+    UCG_BUILTIN_REDUCE_ISA_AVX2,
+    UCG_BUILTIN_REDUCE_ISA_AVX512,
+#ifdef HAVE_AVX512_BF16
+    UCG_BUILTIN_REDUCE_ISA_AVX512BF16,
+#endif
+#endif
+    UCG_BUILTIN_REDUCE_ISA_LAST
+};
+
+typedef struct ucg_builtin_reducer {
+    ucg_op_reduce_full_f full_f;
+    ucg_op_reduce_frag_f frag_f;
+} ucg_builtin_reducer_t;
+
+#define UCG_BUILTIN_REDUCE_PAIR_TYPE(_dt) ucg_builtin_reduce_pair_##_dt##_t
+#define UCG_BUILTIN_REDUCE_PAIR_DECLARE(_dt, _vtype) \
+    typedef struct { \
+        _vtype value; \
+        int    index; \
+    } UCG_BUILTIN_REDUCE_PAIR_TYPE(_dt);
+
+UCG_BUILTIN_REDUCE_PAIR_DECLARE(float_int,  float)
+UCG_BUILTIN_REDUCE_PAIR_DECLARE(double_int, double)
+UCG_BUILTIN_REDUCE_PAIR_DECLARE(long_int,   long)
+UCG_BUILTIN_REDUCE_PAIR_DECLARE(short_int,  short)
+UCG_BUILTIN_REDUCE_PAIR_DECLARE(2int,       int)
+
+typedef union ucg_builtin_reduce_fp32 {
+    uint32_t u;
+    float    f;
+} ucg_builtin_reduce_fp32_t;
+
+static UCS_F_ALWAYS_INLINE float ucg_builtin_half_to_float(uint16_t h)
+{
+    ucg_builtin_reduce_fp32_t magic = { .u = 113 << 23 };
+    ucg_builtin_reduce_fp32_t o;
+    uint32_t exp;
+
+    o.u  = (uint32_t)(h & 0x7fff) << 13; /* exponent and mantissa */
+    exp  = o.u & 0x0f800000;
+    o.u += (127 - 15) << 23;             /* re-bias the exponent */
+
+    if (exp == 0x0f800000) {
+        o.u += (128 - 16) << 23;         /* Inf or NaN */
+    } else if (exp == 0) {
+        o.u += 1 << 23;                  /* sub-normal - renormalize */
+        o.f -= magic.f;
+    }
+
+    o.u |= (uint32_t)(h & 0x8000) << 16;
+    return o.f;
+}
+
+static UCS_F_ALWAYS_INLINE uint16_t ucg_builtin_float_to_half(float value)
+{
+    ucg_builtin_reduce_fp32_t magic = { .u = ((127 - 15) + (23 - 10) + 1) << 23 };
+    ucg_builtin_reduce_fp32_t f     = { .f = value };
+    uint32_t sign                   = f.u & 0x80000000;
+    uint32_t o;
+
+    f.u ^= sign;
+    if (f.u >= ((127 + 16) << 23)) {
+        o = (f.u > (255 << 23)) ? 0x7e00 : 0x7c00; /* overflow, Inf or NaN */
+    } else if (f.u < (113 << 23)) {
+        f.f += magic.f;                            /* sub-normal or zero */
+        o    = f.u - magic.u;
+    } else {
+        o    = (f.u + ((uint32_t)(15 - 127) << 23) + 0xfff +
+                ((f.u >> 13) & 1)) >> 13;          /* round to nearest even */
+    }
+
+    return (uint16_t)(o | (sign >> 16));
+}
+
+static UCS_F_ALWAYS_INLINE float ucg_builtin_bfloat16_to_float(uint16_t b)
+{
+    ucg_builtin_reduce_fp32_t o = { .u = (uint32_t)b << 16 };
+    return o.f;
+}
+
+static UCS_F_ALWAYS_INLINE uint16_t ucg_builtin_float_to_bfloat16(float value)
+{
+    ucg_builtin_reduce_fp32_t f = { .f = value };
+
+    return (uint16_t)(((f.u & 0x7fffffff) > 0x7f800000) ?
+                      ((f.u >> 16) | 0x40) : /* keep NaNs (quiet) */
+                      ((f.u + 0x7fff + ((f.u >> 16) & 1)) >> 16));
+}
+
+/*
+ * Narrow unsigned types would be promoted to (signed) int, so "1u *" widens
+ * them to unsigned int first - and leaves the wider and floating-point types
+ * as they are (-0.0 included).
+ */
+#define UCG_BUILTIN_REDUCE_SUM(_utype, _d, _s) \
+    ((_utype)((1u * (_utype)(_d)) + (_utype)(_s)))
+#define UCG_BUILTIN_REDUCE_PROD(_utype, _d, _s) \
+    ((_utype)((1u * (_utype)(_d)) * (_utype)(_s)))
+#define UCG_BUILTIN_REDUCE_MIN(_utype, _d, _s)  (((_s) < (_d)) ? (_s) : (_d))
+#define UCG_BUILTIN_REDUCE_MAX(_utype, _d, _s)  (((_s) > (_d)) ? (_s) : (_d))
+#define UCG_BUILTIN_REDUCE_LAND(_utype, _d, _s) ((_d) && (_s))
+#define UCG_BUILTIN_REDUCE_LOR(_utype, _d, _s)  ((_d) || (_s))
+#define UCG_BUILTIN_REDUCE_LXOR(_utype, _d, _s) ((!(_d)) != (!(_s)))
+#define UCG_BUILTIN_REDUCE_BAND(_utype, _d, _s) ((_d) & (_s))
+#define UCG_BUILTIN_REDUCE_BOR(_utype, _d, _s)  ((_d) | (_s))
+#define UCG_BUILTIN_REDUCE_BXOR(_utype, _d, _s) ((_d) ^ (_s))
+
+#define UCG_BUILTIN_REDUCE_LOOP(_OP, _type, _utype, _dst, _src, _count) { \
+    _type *restrict d       = (_type*)(_dst); \
+    const _type *restrict s = (const _type*)(_src); \
+    size_t i, cnt           = (_count); \
+    for (i = 0; i < cnt; i++) { \
+        d[i] = (_type)UCG_BUILTIN_REDUCE_##_OP(_utype, d[i], s[i]); \
+    } \
+}
+
+/* Vectorized fp16 conversions go first, leaving "i" at the remainder */
+#define UCG_BUILTIN_REDUCE_PS256_SUM(_d, _s)  _mm256_add_ps(_d, _s)
+#define UCG_BUILTIN_REDUCE_PS256_PROD(_d, _s) _mm256_mul_ps(_d, _s)
+#define UCG_BUILTIN_REDUCE_PS256_MIN(_d, _s)  _mm256_min_ps(_s, _d)
+#define UCG_BUILTIN_REDUCE_PS256_MAX(_d, _s)  _mm256_max_ps(_s, _d)
+#define UCG_BUILTIN_REDUCE_PS512_SUM(_d, _s)  _mm512_add_ps(_d, _s)
+#define UCG_BUILTIN_REDUCE_PS512_PROD(_d, _s) _mm512_mul_ps(_d, _s)
+#define UCG_BUILTIN_REDUCE_PS512_MIN(_d, _s)  _mm512_min_ps(_s, _d)
+#define UCG_BUILTIN_REDUCE_PS512_MAX(_d, _s)  _mm512_max_ps(_s, _d)
+
+#define UCG_BUILTIN_REDUCE_VEC_half_GENERIC(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_VEC_half_SSE42(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_VEC_half_AVX2(_OP, _d, _s, _i, _cnt) \
+    for (; (_i) + 8 <= (_cnt); (_i) += 8) { \
+        __m256 vd = _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)((_d) + (_i)))); \
+        __m256 vs = _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)((_s) + (_i)))); \
+        _mm_storeu_si128((__m128i*)((_d) + (_i)), \
+                         _mm256_cvtps_ph(UCG_BUILTIN_REDUCE_PS256_##_OP(vd, vs), \
+                                         _MM_FROUND_TO_NEAREST_INT)); \
+    }
+#define UCG_BUILTIN_REDUCE_VEC_half_AVX512(_OP, _d, _s, _i, _cnt) \
+    for (; (_i) + 16 <= (_cnt); (_i) += 16) { \
+        __m512 vd = _mm512_cvtph_ps(_mm256_loadu_si256((__m256i*)((_d) + (_i)))); \
+        __m512 vs = _mm512_cvtph_ps(_mm256_loadu_si256((__m256i*)((_s) + (_i)))); \
+        _mm256_storeu_si256((__m256i*)((_d) + (_i)), \
+                            _mm512_cvtps_ph(UCG_BUILTIN_REDUCE_PS512_##_OP(vd, vs), \
+                                            _MM_FROUND_TO_NEAREST_INT)); \
+    }
+#define UCG_BUILTIN_REDUCE_VEC_half_AVX512BF16 UCG_BUILTIN_REDUCE_VEC_half_AVX512
+#define UCG_BUILTIN_REDUCE_VEC_bfloat16_GENERIC(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_VEC_bfloat16_SSE42(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_VEC_bfloat16_AVX2(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_VEC_bfloat16_AVX512(_OP, _d, _s, _i, _cnt)
+#define UCG_BUILTIN_REDUCE_BF16_LOAD512(_ptr) \
+    _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32( \
+            _mm256_loadu_si256((__m256i*)(_ptr))), 16))
+#define UCG_BUILTIN_REDUCE_VEC_bfloat16_AVX512BF16(_OP, _d, _s, _i, _cnt) \
+    for (; (_i) + 16 <= (_cnt); (_i) += 16) { \
+        __m512 vr = UCG_BUILTIN_REDUCE_PS512_##_OP( \
+                        UCG_BUILTIN_REDUCE_BF16_LOAD512((_d) + (_i)), \
+                        UCG_BUILTIN_REDUCE_BF16_LOAD512((_s) + (_i))); \
+        __m512i vu = _mm512_castps_si512(vr); \
+        __m256i vb = (__m256i)_mm512_cvtneps_pbh(vr); \
+        __mmask16 sub = _mm512_mask_testn_epi32_mask( \
+                            _mm512_test_epi32_mask(vu, \
+                                                   _mm512_set1_epi32(0x007fffff)), \
+                            vu, _mm512_set1_epi32(0x7f800000)); \
+        if (ucs_unlikely(sub != 0)) { \
+            vu = _mm512_add_epi32(vu, _mm512_add_epi32(_mm512_set1_epi32(0x7fff), \
+                     _mm512_and_si512(_mm512_srli_epi32(vu, 16), \
+                                      _mm512_set1_epi32(1)))); \
+            vb = _mm256_mask_blend_epi16(sub, vb, \
+                     _mm512_cvtepi32_epi16(_mm512_srli_epi32(vu, 16))); \
+        } \
+        _mm256_storeu_si256((__m256i*)((_d) + (_i)), vb); \
+    }
+
+#define UCG_BUILTIN_REDUCE_LOOP_F16(_isa, _OP, _dt, _load, _store, _dst, _src, \
+                                    _count) { \
+    uint16_t *restrict d       = (uint16_t*)(_dst); \
+    const uint16_t *restrict s = (const uint16_t*)(_src); \
+    size_t i = 0, cnt          = (_count); \
+    UCG_BUILTIN_REDUCE_VEC_##_dt##_##_isa(_OP, d, s, i, cnt) \
+    for (; i < cnt; i++) { \
+        d[i] = _store(UCG_BUILTIN_REDUCE_##_OP(float, _load(d[i]), \
+                                               _load(s[i]))); \
+    } \
+}
+
+/* Whether to take the (value, index) pair from the source, instead */
+#define UCG_BUILTIN_REDUCE_MINLOC(_d, _s) \
+    (((_s).value < (_d).value) | \
+     (((_s).value == (_d).value) & ((_s).index < (_d).index)))
+#define UCG_BUILTIN_REDUCE_MAXLOC(_d, _s) \
+    (((_s).value > (_d).value) | \
+     (((_s).value == (_d).value) & ((_s).index < (_d).index)))
+
+#define UCG_BUILTIN_REDUCE_LOOP_PAIR(_OP, _type, _dst, _src, _count) { \
+    _type *restrict d       = (_type*)(_dst); \
+    const _type *restrict s = (const _type*)(_src); \
+    size_t i, cnt           = (_count); \
+    int take; \
+    for (i = 0; i < cnt; i++) { \
+        take       = UCG_BUILTIN_REDUCE_##_OP(d[i], s[i]); \
+        d[i].value = take ? s[i].value : d[i].value; \
+        d[i].index = take ? s[i].index : d[i].index; \
+    } \
+}
+
+#define UCG_BUILTIN_REDUCER_NAME(_kind, _op, _dt, _isa) \
+    ucg_builtin_reduce_##_kind##_##_op##_##_dt##_##_isa
+
+#define UCG_BUILTIN_REDUCER_DECLARE(_isa, _attr, _op, _OP, _dt, _DT, _type, \
+                                    _utype) \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(full, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP(_OP, _type, _utype, dst, src, \
+                                op->params.recv.count) \
+    } \
+    \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   size_t frag_len, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP(_OP, _type, _utype, dst, src, \
+                                frag_len / sizeof(_type)) \
+    }
+
+#define UCG_BUILTIN_REDUCER_DECLARE_F16(_isa, _attr, _op, _OP, _dt, _DT, \
+                                        _load, _store) \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(full, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP_F16(_isa, _OP, _dt, _load, _store, dst, src, \
+                                    op->params.recv.count) \
+    } \
+    \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   size_t frag_len, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP_F16(_isa, _OP, _dt, _load, _store, dst, src, \
+                                    frag_len / sizeof(uint16_t)) \
+    }
+
+#define UCG_BUILTIN_REDUCER_DECLARE_PAIR(_isa, _attr, _op, _OP, _dt, _DT, \
+                                         _type, _unused) \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(full, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP_PAIR(_OP, _type, dst, src, \
+                                     op->params.recv.count) \
+    } \
+    \
+    static _attr void \
+    UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, _isa)(uint8_t *dst, uint8_t *src, \
+                                                   size_t frag_len, \
+                                                   ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCE_LOOP_PAIR(_OP, _type, dst, src, \
+                                     frag_len / sizeof(_type)) \
+    }
+
+#define UCG_BUILTIN_REDUCER_ENTRY(_isa, _attr, _op, _OP, _dt, _DT, _type, \
+                                  _utype) \
+    [UCG_BUILTIN_REDUCE_DTYPE_##_DT] = { \
+        .full_f = UCG_BUILTIN_REDUCER_NAME(full, _op, _dt, _isa), \
+        .frag_f = UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, _isa) \
+    },
+
+#define UCG_BUILTIN_REDUCE_FOREACH_INT(_macro, _isa, _attr, _op, _OP) \
+    _macro(_isa, _attr, _op, _OP, int8,   INT8,   int8_t,   uint8_t) \
+    _macro(_isa, _attr, _op, _OP, int16,  INT16,  int16_t,  uint16_t) \
+    _macro(_isa, _attr, _op, _OP, int32,  INT32,  int32_t,  uint32_t) \
+    _macro(_isa, _attr, _op, _OP, int64,  INT64,  int64_t,  uint64_t) \
+    _macro(_isa, _attr, _op, _OP, uint8,  UINT8,  uint8_t,  uint8_t) \
+    _macro(_isa, _attr, _op, _OP, uint16, UINT16, uint16_t, uint16_t) \
+    _macro(_isa, _attr, _op, _OP, uint32, UINT32, uint32_t, uint32_t) \
+    _macro(_isa, _attr, _op, _OP, uint64, UINT64, uint64_t, uint64_t)
+
+#define UCG_BUILTIN_REDUCE_FOREACH_ALL(_macro, _isa, _attr, _op, _OP) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(_macro, _isa, _attr, _op, _OP) \
+    _macro(_isa, _attr, _op, _OP, float,  FLOAT,  float,    float) \
+    _macro(_isa, _attr, _op, _OP, double, DOUBLE, double,   double)
+
+#define UCG_BUILTIN_REDUCE_FOREACH_F16(_macro, _isa, _attr, _op, _OP) \
+    _macro(_isa, _attr, _op, _OP, half,     HALF, \
+           ucg_builtin_half_to_float,     ucg_builtin_float_to_half) \
+    _macro(_isa, _attr, _op, _OP, bfloat16, BFLOAT16, \
+           ucg_builtin_bfloat16_to_float, ucg_builtin_float_to_bfloat16)
+
+#define UCG_BUILTIN_REDUCE_FOREACH_PAIR(_macro, _isa, _attr, _op, _OP) \
+    _macro(_isa, _attr, _op, _OP, float_int,  FLOAT_INT, \
+           UCG_BUILTIN_REDUCE_PAIR_TYPE(float_int),  ) \
+    _macro(_isa, _attr, _op, _OP, double_int, DOUBLE_INT, \
+           UCG_BUILTIN_REDUCE_PAIR_TYPE(double_int), ) \
+    _macro(_isa, _attr, _op, _OP, long_int,   LONG_INT, \
+           UCG_BUILTIN_REDUCE_PAIR_TYPE(long_int),   ) \
+    _macro(_isa, _attr, _op, _OP, short_int,  SHORT_INT, \
+           UCG_BUILTIN_REDUCE_PAIR_TYPE(short_int),  ) \
+    _macro(_isa, _attr, _op, _OP, 2int,       2INT, \
+           UCG_BUILTIN_REDUCE_PAIR_TYPE(2int),       )
+
+#define UCG_BUILTIN_REDUCE_FOREACH_ARITH(_macro, _isa, _attr, _op, _OP) \
+    UCG_BUILTIN_REDUCE_FOREACH_ALL(_macro, _isa, _attr, _op, _OP) \
+    UCG_BUILTIN_REDUCE_FOREACH_F16(_macro, _isa, _attr, _op, _OP)
+
+/* MPI allows arithmetic operations on any type, but logical and bitwise
+ * operations only on integers - so those are left for reduce_cb_f */
+#define UCG_BUILTIN_REDUCE_DECLARE_ALL(_isa, _attr) \
+    UCG_BUILTIN_REDUCE_FOREACH_ALL(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, sum,  SUM) \
+    UCG_BUILTIN_REDUCE_FOREACH_ALL(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, prod, PROD) \
+    UCG_BUILTIN_REDUCE_FOREACH_ALL(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, min,  MIN) \
+    UCG_BUILTIN_REDUCE_FOREACH_ALL(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, max,  MAX) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, land, LAND) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, lor,  LOR) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, lxor, LXOR) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, band, BAND) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, bor,  BOR) \
+    UCG_BUILTIN_REDUCE_FOREACH_INT(UCG_BUILTIN_REDUCER_DECLARE, _isa, _attr, bxor, BXOR) \
+    UCG_BUILTIN_REDUCE_FOREACH_F16(UCG_BUILTIN_REDUCER_DECLARE_F16, _isa, _attr, sum,  SUM) \
+    UCG_BUILTIN_REDUCE_FOREACH_F16(UCG_BUILTIN_REDUCER_DECLARE_F16, _isa, _attr, prod, PROD) \
+    UCG_BUILTIN_REDUCE_FOREACH_F16(UCG_BUILTIN_REDUCER_DECLARE_F16, _isa, _attr, min,  MIN) \
+    UCG_BUILTIN_REDUCE_FOREACH_F16(UCG_BUILTIN_REDUCER_DECLARE_F16, _isa, _attr, max,  MAX) \
+    UCG_BUILTIN_REDUCE_FOREACH_PAIR(UCG_BUILTIN_REDUCER_DECLARE_PAIR, _isa, _attr, minloc, MINLOC) \
+    UCG_BUILTIN_REDUCE_FOREACH_PAIR(UCG_BUILTIN_REDUCER_DECLARE_PAIR, _isa, _attr, maxloc, MAXLOC)
+
+#define UCG_BUILTIN_REDUCE_TABLE_OP(_isa, _attr, _op, _OP, _foreach) \
+    [UCG_REDUCE_OP_##_OP] = { \
+        _foreach(UCG_BUILTIN_REDUCER_ENTRY, _isa, _attr, _op, _OP) \
+    },
+
+#define UCG_BUILTIN_REDUCE_TABLE(_isa) \
+    [UCG_BUILTIN_REDUCE_ISA_##_isa] = { \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , sum,  SUM,  UCG_BUILTIN_REDUCE_FOREACH_ARITH) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , prod, PROD, UCG_BUILTIN_REDUCE_FOREACH_ARITH) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , min,  MIN,  UCG_BUILTIN_REDUCE_FOREACH_ARITH) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , max,  MAX,  UCG_BUILTIN_REDUCE_FOREACH_ARITH) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , land, LAND, UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , lor,  LOR,  UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , lxor, LXOR, UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , band, BAND, UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , bor,  BOR,  UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , bxor, BXOR, UCG_BUILTIN_REDUCE_FOREACH_INT) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , minloc, MINLOC, UCG_BUILTIN_REDUCE_FOREACH_PAIR) \
+        UCG_BUILTIN_REDUCE_TABLE_OP(_isa, , maxloc, MAXLOC, UCG_BUILTIN_REDUCE_FOREACH_PAIR) \
+    },
+
+UCG_BUILTIN_REDUCE_DECLARE_ALL(GENERIC, )
+#if defined(__x86_64__) && defined(__GNUC__)
+UCG_BUILTIN_REDUCE_DECLARE_ALL(SSE42,
+                               __attribute__((target("sse4.2"))))
+UCG_BUILTIN_REDUCE_DECLARE_ALL(AVX2,
+                               __attribute__((target("avx2,f16c"))))
+UCG_BUILTIN_REDUCE_DECLARE_ALL(AVX512,
+                               __attribute__((target("avx512f,avx512bw,avx512vl,f16c"))))
+#ifdef HAVE_AVX512_BF16
+UCG_BUILTIN_REDUCE_DECLARE_ALL(AVX512BF16,
+                               __attribute__((target("avx512f,avx512bw,avx512vl,avx512bf16,f16c"))))
+#endif
+#endif
+
+static const ucg_builtin_reducer_t
+ucg_builtin_reducers[UCG_BUILTIN_REDUCE_ISA_LAST]
+                    [UCG_REDUCE_OP_LAST]
+                    [UCG_BUILTIN_REDUCE_DTYPE_LAST] = {
+    UCG_BUILTIN_REDUCE_TABLE(GENERIC)
+#if defined(__x86_64__) && defined(__GNUC__)
+    UCG_BUILTIN_REDUCE_TABLE(SSE42)
+    UCG_BUILTIN_REDUCE_TABLE(AVX2)
+    UCG_BUILTIN_REDUCE_TABLE(AVX512)
+#ifdef HAVE_AVX512_BF16
+    UCG_BUILTIN_REDUCE_TABLE(AVX512BF16)
+#endif
+#endif
+};
+
+/*
+ * Optionally (see BUILTIN_REDUCE_WIDEN), 16-bit floating-point reductions at
+ * the waypoints of a fan-in tree accumulate the contributions of all children
+ * in single-precision, rather than round the partial result after each one.
+ * The receive buffer still holds the (rounded) partial result at all times,
+ * while the op keeps its single-precision counterpart, set from the receive
+ * buffer on the first reduction of each step. Fan-in trees are the only case
+ * where this is safe: other methods (e.g. recursive doubling) calculate the
+ * result on every member, and they would not all get the same result.
+ */
+static float* ucg_builtin_reduce_widened(ucg_op_t *op, uint8_t *dst,
+                                         size_t count, float (*load)(uint16_t))
 {
-    float *f_src = (float*)src;
-    float *f_dst = (float*)dst;
-    float *limit = (float*)(dst + frag_len);
+    ucg_builtin_op_t *builtin_op = ucs_derived_of(op, ucg_builtin_op_t);
+    ucg_builtin_op_step_t *step  = *builtin_op->current;
+    size_t total                 = step->buffer_length / sizeof(uint16_t);
+    size_t offset, i;
+
+    if (((step->phase->method != UCG_PLAN_METHOD_REDUCE_WAYPOINT) &&
+         (step->phase->method != UCG_PLAN_METHOD_REDUCE_TERMINAL)) ||
+        ((uintptr_t)dst < (uintptr_t)step->recv_buffer) ||
+        (total > op->params.recv.count)) {
+        return NULL;
+    }
+
+    offset = (dst - step->recv_buffer) / sizeof(uint16_t);
+    if (offset + count > total) {
+        return NULL;
+    }
 
-    do {
-        *f_dst += *f_src;
-        f_dst++;
-    } while (f_dst < limit);
+    if (builtin_op->widened == NULL) {
+        builtin_op->widened = ucs_malloc(op->params.recv.count * sizeof(float),
+                                         "ucg_builtin_reduce_widened");
+        if (builtin_op->widened == NULL) {
+            return NULL;
+        }
+    }
+
+    if (builtin_op->widened_step != step) {
+        for (i = 0; i < total; i++) {
+            builtin_op->widened[i] = load(((uint16_t*)step->recv_buffer)[i]);
+        }
+        builtin_op->widened_step = step;
+    }
+
+    return builtin_op->widened + offset;
 }
 
+#define UCG_BUILTIN_REDUCER_DECLARE_WIDENED(_op, _OP, _dt, _load, _store) \
+    static void \
+    UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, widened)(uint8_t *dst, \
+                                                      uint8_t *src, \
+                                                      size_t frag_len, \
+                                                      ucg_op_t *op) \
+    { \
+        size_t i, cnt              = frag_len / sizeof(uint16_t); \
+        float *restrict w          = ucg_builtin_reduce_widened(op, dst, cnt, \
+                                                                _load); \
+        uint16_t *restrict d       = (uint16_t*)dst; \
+        const uint16_t *restrict s = (const uint16_t*)src; \
+        \
+        if (w == NULL) { \
+            UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, GENERIC)(dst, src, \
+                                                              frag_len, op); \
+            return; \
+        } \
+        \
+        for (i = 0; i < cnt; i++) { \
+            w[i] = UCG_BUILTIN_REDUCE_##_OP(float, w[i], _load(s[i])); \
+            d[i] = _store(w[i]); \
+        } \
+    } \
+    \
+    static void \
+    UCG_BUILTIN_REDUCER_NAME(full, _op, _dt, widened)(uint8_t *dst, \
+                                                      uint8_t *src, \
+                                                      ucg_op_t *op) \
+    { \
+        UCG_BUILTIN_REDUCER_NAME(frag, _op, _dt, widened)(dst, src, \
+                op->params.recv.count * sizeof(uint16_t), op); \
+    }
+
+UCG_BUILTIN_REDUCER_DECLARE_WIDENED(sum,  SUM,  half, ucg_builtin_half_to_float,
+                                    ucg_builtin_float_to_half)
+UCG_BUILTIN_REDUCER_DECLARE_WIDENED(prod, PROD, half, ucg_builtin_half_to_float,
+                                    ucg_builtin_float_to_half)
+UCG_BUILTIN_REDUCER_DECLARE_WIDENED(sum,  SUM,  bfloat16,
+                                    ucg_builtin_bfloat16_to_float,
+                                    ucg_builtin_float_to_bfloat16)
+UCG_BUILTIN_REDUCER_DECLARE_WIDENED(prod, PROD, bfloat16,
+                                    ucg_builtin_bfloat16_to_float,
+                                    ucg_builtin_float_to_bfloat16)
+
+static enum ucg_builtin_reduce_isa ucg_builtin_reduce_get_isa(void)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+#ifdef HAVE_AVX512_BF16
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bf16")) {
+        return UCG_BUILTIN_REDUCE_ISA_AVX512BF16;
+    }
+#endif
+
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl")) {
+        return UCG_BUILTIN_REDUCE_ISA_AVX512;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        return UCG_BUILTIN_REDUCE_ISA_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        return UCG_BUILTIN_REDUCE_ISA_SSE42;
+    }
+#endif
+    return UCG_BUILTIN_REDUCE_ISA_GENERIC;
+}
+
+static const char *ucg_builtin_reduce_isa_names[UCG_BUILTIN_REDUCE_ISA_LAST] = {
+    [UCG_BUILTIN_REDUCE_ISA_GENERIC] = "generic",
+#if defined(__x86_64__) && defined(__GNUC__)
+    [UCG_BUILTIN_REDUCE_ISA_SSE42]   = "sse4.2",
+    [UCG_BUILTIN_REDUCE_ISA_AVX2]    = "avx2",
+    [UCG_BUILTIN_REDUCE_ISA_AVX512]  = "avx512",
+#ifdef HAVE_AVX512_BF16
+    [UCG_BUILTIN_REDUCE_ISA_AVX512BF16] = "avx512bf16",
+#endif
+#endif
+};
+
+size_t ucg_builtin_reduce_pair_extent(void *dtype)
+{
+    if ((dtype == NULL) || (ucg_global_params.datatype.get_pair_f == NULL)) {
+        return 0;
+    }
+
+    switch (ucg_global_params.datatype.get_pair_f(dtype)) {
+    case UCG_DATATYPE_PAIR_FLOAT_INT:
+        return sizeof(UCG_BUILTIN_REDUCE_PAIR_TYPE(float_int));
+    case UCG_DATATYPE_PAIR_DOUBLE_INT:
+        return sizeof(UCG_BUILTIN_REDUCE_PAIR_TYPE(double_int));
+    case UCG_DATATYPE_PAIR_LONG_INT:
+        return sizeof(UCG_BUILTIN_REDUCE_PAIR_TYPE(long_int));
+    case UCG_DATATYPE_PAIR_SHORT_INT:
+        return sizeof(UCG_BUILTIN_REDUCE_PAIR_TYPE(short_int));
+    case UCG_DATATYPE_PAIR_2INT:
+        return sizeof(UCG_BUILTIN_REDUCE_PAIR_TYPE(2int));
+    default:
+        return 0;
+    }
+}
+
+static int ucg_builtin_reduce_get_dtype(void *dtype, size_t dtype_len,
+                                        enum ucg_builtin_reduce_dtype *dt_p)
+{
+    int is_signed;
+
+    if ((dtype_len > 0) && (ucg_builtin_reduce_pair_extent(dtype) == dtype_len)) {
+        switch (ucg_global_params.datatype.get_pair_f(dtype)) {
+        case UCG_DATATYPE_PAIR_FLOAT_INT:
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_FLOAT_INT;
+            return 1;
+        case UCG_DATATYPE_PAIR_DOUBLE_INT:
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_DOUBLE_INT;
+            return 1;
+        case UCG_DATATYPE_PAIR_LONG_INT:
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_LONG_INT;
+            return 1;
+        case UCG_DATATYPE_PAIR_SHORT_INT:
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_SHORT_INT;
+            return 1;
+        case UCG_DATATYPE_PAIR_2INT:
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_2INT;
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    if (ucg_global_params.datatype.is_integer_f(dtype, &is_signed)) {
+        switch (dtype_len) {
+        case sizeof(uint8_t):
+            *dt_p = is_signed ? UCG_BUILTIN_REDUCE_DTYPE_INT8 :
+                                UCG_BUILTIN_REDUCE_DTYPE_UINT8;
+            return 1;
+        case sizeof(uint16_t):
+            *dt_p = is_signed ? UCG_BUILTIN_REDUCE_DTYPE_INT16 :
+                                UCG_BUILTIN_REDUCE_DTYPE_UINT16;
+            return 1;
+        case sizeof(uint32_t):
+            *dt_p = is_signed ? UCG_BUILTIN_REDUCE_DTYPE_INT32 :
+                                UCG_BUILTIN_REDUCE_DTYPE_UINT32;
+            return 1;
+        case sizeof(uint64_t):
+            *dt_p = is_signed ? UCG_BUILTIN_REDUCE_DTYPE_INT64 :
+                                UCG_BUILTIN_REDUCE_DTYPE_UINT64;
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    if (ucg_global_params.datatype.is_floating_point_f(dtype)) {
+        switch (dtype_len) {
+        case sizeof(float):
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_FLOAT;
+            return 1;
+        case sizeof(double):
+            *dt_p = UCG_BUILTIN_REDUCE_DTYPE_DOUBLE;
+            return 1;
+        case sizeof(uint16_t):
+            *dt_p = ((ucg_global_params.datatype.is_bfloat16_f != NULL) &&
+                     ucg_global_params.datatype.is_bfloat16_f(dtype)) ?
+                    UCG_BUILTIN_REDUCE_DTYPE_BFLOAT16 :
+                    UCG_BUILTIN_REDUCE_DTYPE_HALF;
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+static enum ucg_reduce_op_type ucg_builtin_reduce_get_op(void *reduce_op)
+{
+    int type;
+
+    if (ucg_global_params.reduce_op.get_type_f != NULL) {
+        type = ucg_global_params.reduce_op.get_type_f(reduce_op);
+        if ((type > UCG_REDUCE_OP_OTHER) && (type < UCG_REDUCE_OP_LAST)) {
+            return (enum ucg_reduce_op_type)type;
+        }
+    }
+
+    return ucg_global_params.reduce_op.is_sum_f(reduce_op) ?
+           UCG_REDUCE_OP_SUM : UCG_REDUCE_OP_OTHER;
+}
+
+int ucg_builtin_reduce_loc_is_native(void *dtype, void *reduce_op)
+{
+    enum ucg_builtin_reduce_dtype dt;
+
+    return ucg_builtin_reduce_get_dtype(dtype,
+                                        ucg_builtin_reduce_pair_extent(dtype),
+                                        &dt) &&
+           (ucg_builtin_reducers[UCG_BUILTIN_REDUCE_ISA_GENERIC]
+                                [ucg_builtin_reduce_get_op(reduce_op)]
+                                [dt].full_f != NULL);
+}
+
+/*
+ * Get the native reducers of a given instruction-set variant, by its index
+ * (the generic one first, the best this CPU supports last) - rather than the
+ * best one, as @ref ucg_builtin_step_select_reducers does. This is meant for
+ * tests and benchmarks, comparing the variants to each other. Returns the name
+ * of the variant, or NULL past the last one this CPU supports. The reducers
+ * are set to NULL if the operation on this datatype is left for reduce_cb_f.
+ */
+const char* ucg_builtin_reduce_select_isa(unsigned isa, void *dtype,
+                                          void *reduce_op, size_t dtype_len,
+                                          ucg_op_reduce_full_f *reduce_full_f,
+                                          ucg_op_reduce_frag_f *reduce_frag_f)
+{
+    const ucg_builtin_reducer_t *reducer;
+    enum ucg_builtin_reduce_dtype dt;
+
+    if (isa > ucg_builtin_reduce_get_isa()) {
+        return NULL;
+    }
+
+    *reduce_full_f = NULL;
+    *reduce_frag_f = NULL;
+    if (ucg_builtin_reduce_get_dtype(dtype, dtype_len, &dt)) {
+        reducer        = &ucg_builtin_reducers[isa]
+                                              [ucg_builtin_reduce_get_op(reduce_op)]
+                                              [dt];
+        *reduce_full_f = reducer->full_f;
+        *reduce_frag_f = reducer->frag_f;
+    }
+
+    return ucg_builtin_reduce_isa_names[isa];
+}
 
 ucs_status_t ucg_builtin_step_select_reducers(void *dtype, void *reduce_op,
                                               int is_contig, size_t dtype_len,
@@ -77,26 +783,56 @@ ucs_status_t ucg_builtin_step_select_reducers(void *dtype, void *reduce_op,
 {
     ucg_op_reduce_full_f reduce_full_chosen = ucg_builtin_mpi_reduce_single;
     ucg_op_reduce_frag_f reduce_frag_chosen = ucg_builtin_mpi_reduce_fragment;
+    const ucg_builtin_reducer_t *reducer;
+    enum ucg_builtin_reduce_dtype dt;
+    enum ucg_reduce_op_type op_type;
 
-    /* This is just an example... */
-    if (is_contig && (dtype_len == sizeof(float)) &&
-        ucg_global_params.reduce_op.is_sum_f(reduce_op) &&
-        ucg_global_params.datatype.is_floating_point_f(dtype)) {
-        reduce_frag_chosen = ucg_builtin_step_frag_sum_float;
-
-        switch (dtype_cnt) {
-        case 1:
-            reduce_full_chosen = ucg_builtin_step_full_sum_float_1;
-            break;
-        case 2:
-            reduce_full_chosen = ucg_builtin_step_full_sum_float_2;
-            break;
-        default:
-            break;
+    if (is_contig && ucg_builtin_reduce_get_dtype(dtype, dtype_len, &dt)) {
+        op_type = ucg_builtin_reduce_get_op(reduce_op);
+        reducer = &ucg_builtin_reducers[ucg_builtin_reduce_get_isa()]
+                                       [op_type][dt];
+
+        /* Not every operation applies to every type (e.g. BAND on floats) */
+        if (reducer->full_f != NULL) {
+            reduce_full_chosen = reducer->full_f;
+            reduce_frag_chosen = reducer->frag_f;
+        }
+
+        /* Accumulate in single-precision, where it is safe (see above) */
+        if (config->reduce_widen && (dt == UCG_BUILTIN_REDUCE_DTYPE_HALF)) {
+            if (op_type == UCG_REDUCE_OP_SUM) {
+                reduce_full_chosen = ucg_builtin_reduce_full_sum_half_widened;
+                reduce_frag_chosen = ucg_builtin_reduce_frag_sum_half_widened;
+            } else if (op_type == UCG_REDUCE_OP_PROD) {
+                reduce_full_chosen = ucg_builtin_reduce_full_prod_half_widened;
+                reduce_frag_chosen = ucg_builtin_reduce_frag_prod_half_widened;
+            }
+        } else if (config->reduce_widen &&
+                   (dt == UCG_BUILTIN_REDUCE_DTYPE_BFLOAT16)) {
+            if (op_type == UCG_REDUCE_OP_SUM) {
+                reduce_full_chosen = ucg_builtin_reduce_full_sum_bfloat16_widened;
+                reduce_frag_chosen = ucg_builtin_reduce_frag_sum_bfloat16_widened;
+            } else if (op_type == UCG_REDUCE_OP_PROD) {
+                reduce_full_chosen = ucg_builtin_reduce_full_prod_bfloat16_widened;
+                reduce_frag_chosen = ucg_builtin_reduce_frag_prod_bfloat16_widened;
+            }
         }
-    }
 
-    // TODO: implement more specific reducers... maybe use uct_mm_incast_ep_am_short_func_arr?
+        /* Avoid the loop for the (latency-sensitive) shortest reductions */
+        if ((op_type == UCG_REDUCE_OP_SUM) &&
+            (dt == UCG_BUILTIN_REDUCE_DTYPE_FLOAT)) {
+            switch (dtype_cnt) {
+            case 1:
+                reduce_full_chosen = ucg_builtin_step_full_sum_float_1;
+                break;
+            case 2:
+                reduce_full_chosen = ucg_builtin_step_full_sum_float_2;
+                break;
+            default:
+                break;
+            }
+        }
+    }
 
     *selected_reduce_full_f = reduce_full_chosen;
     *selected_reduce_frag_f = reduce_frag_chosen;
@@ -111,3 +847,58 @@ ucs_status_t ucg_builtin_step_select_reducers(void *dtype, void *reduce_op,
 
     return UCS_OK;
 }
+
+/*
+ * Optionally (see BUILTIN_REDUCE_THREADS), very large reductions are split
+ * among helper threads (see builtin_reduce_pool.c). Ops which may be split
+ * get these reducers instead, which pass the selected ones on to the helpers.
+ */
+static void ucg_builtin_reduce_parallel_frag(uint8_t *dst, uint8_t *src,
+                                             size_t frag_len, ucg_op_t *op)
+{
+    ucg_builtin_op_t *builtin_op = ucs_derived_of(op, ucg_builtin_op_t);
+
+    if (!ucg_builtin_reduce_pool_run(builtin_op->reduce_pool,
+                                     builtin_op->reduce_chunk_f, op, dst, src,
+                                     frag_len, builtin_op->reduce_dt_len)) {
+        builtin_op->reduce_chunk_f(dst, src, frag_len, op);
+    }
+}
+
+static void ucg_builtin_reduce_parallel_full(uint8_t *dst, uint8_t *src,
+                                             ucg_op_t *op)
+{
+    ucg_builtin_op_t *builtin_op = ucs_derived_of(op, ucg_builtin_op_t);
+
+    ucg_builtin_reduce_parallel_frag(dst, src, op->params.recv.count *
+                                     builtin_op->reduce_dt_len, op);
+}
+
+void ucg_builtin_reduce_parallelize(ucg_builtin_op_t *op,
+                                    ucg_builtin_reduce_pool_t *pool,
+                                    size_t dt_len)
+{
+    ucg_op_reduce_frag_f frag_f = op->super.reduce_frag_f;
+
+    /*
+     * Only the native reducers may be split: the MPI callback might not be
+     * thread-safe, and the widened ones keep per-op state (see above).
+     */
+    if ((pool == NULL) || (op->super.reduce_full_f == NULL) ||
+        (frag_f == NULL) || (dt_len == 0) ||
+        (op->super.params.recv.count * dt_len <
+         ucg_builtin_reduce_pool_thresh(pool)) ||
+        (frag_f == ucg_builtin_mpi_reduce_fragment) ||
+        (frag_f == ucg_builtin_reduce_frag_sum_half_widened) ||
+        (frag_f == ucg_builtin_reduce_frag_prod_half_widened) ||
+        (frag_f == ucg_builtin_reduce_frag_sum_bfloat16_widened) ||
+        (frag_f == ucg_builtin_reduce_frag_prod_bfloat16_widened)) {
+        return;
+    }
+
+    op->reduce_chunk_f      = frag_f;
+    op->reduce_dt_len       = dt_len;
+    op->reduce_pool         = pool;
+    op->super.reduce_full_f = ucg_builtin_reduce_parallel_full;
+    op->super.reduce_frag_f = ucg_builtin_reduce_parallel_frag;
+}
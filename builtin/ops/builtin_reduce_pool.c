@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for sched_getcpu() and pthread_setaffinity_np() */
+#endif
+
+#include "builtin_ops.h"
+
+#include <ucs/arch/atomic.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+
+/*
+ * Optionally (see BUILTIN_REDUCE_THREADS), very large reductions are split
+ * into chunks, roughly the size of a core's caches, which the calling thread
+ * and a few helper threads take one at a time until none are left. Helpers run
+ * on the other cores this process may run on - those on the caller's NUMA
+ * node first - and sleep on a condition variable between reductions. Only one
+ * reduction uses the helpers at a time: others (e.g. from other workers) are
+ * done by their calling thread alone, as if there were no helpers at all.
+ */
+struct ucg_builtin_reduce_pool {
+    pthread_mutex_t      lock;        /**< protects the fields below */
+    pthread_cond_t       start;       /**< signaled when a reduction starts */
+    pthread_cond_t       done;        /**< signaled by the last helper */
+    pthread_mutex_t      busy;        /**< held by the thread splitting work */
+    uint64_t             generation;  /**< reductions started so far */
+    unsigned             running;     /**< helpers yet to finish this one */
+    int                  is_stopping; /**< set when the pool is destroyed */
+    size_t               chunk;       /**< configured chunk size (in bytes) */
+    size_t               thresh;      /**< smallest reduction to split */
+
+    /* The reduction currently split among the threads */
+    ucg_op_reduce_frag_f reduce_f;    /**< reduces each chunk */
+    ucg_op_t            *op;          /**< passed on to reduce_f */
+    uint8_t             *dst;         /**< reduction destination */
+    uint8_t             *src;         /**< reduction source */
+    size_t               length;      /**< reduction size (in bytes) */
+    size_t               job_chunk;   /**< chunk size, whole elements only */
+    volatile uint64_t    next;        /**< offset of the next chunk to take */
+
+    unsigned             thread_cnt;  /**< helper thread count */
+    pthread_t            threads[];   /**< helper threads */
+};
+
+static void ucg_builtin_reduce_pool_work(ucg_builtin_reduce_pool_t *pool)
+{
+    uint64_t offset;
+
+    while ((offset = ucs_atomic_fadd64(&pool->next, pool->job_chunk)) <
+           pool->length) {
+        pool->reduce_f(pool->dst + offset, pool->src + offset,
+                       ucs_min(pool->job_chunk, pool->length - offset),
+                       pool->op);
+    }
+}
+
+static void* ucg_builtin_reduce_pool_thread(void *arg)
+{
+    ucg_builtin_reduce_pool_t *pool = arg;
+    uint64_t generation             = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while ((pool->generation == generation) && !pool->is_stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+
+        if (pool->is_stopping) {
+            break;
+        }
+
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        ucg_builtin_reduce_pool_work(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+size_t ucg_builtin_reduce_pool_thresh(const ucg_builtin_reduce_pool_t *pool)
+{
+    return pool->thresh;
+}
+
+/*
+ * Split a reduction among the calling thread and the helpers, and return once
+ * it is done. Returns 0 (and does nothing) if the reduction is too small to
+ * be worth splitting, or if the helpers are busy with another one - in which
+ * case the caller should do it alone.
+ */
+int ucg_builtin_reduce_pool_run(ucg_builtin_reduce_pool_t *pool,
+                                ucg_op_reduce_frag_f reduce_f, ucg_op_t *op,
+                                uint8_t *dst, uint8_t *src, size_t length,
+                                size_t dt_len)
+{
+    if ((length < pool->thresh) || (pthread_mutex_trylock(&pool->busy) != 0)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->reduce_f  = reduce_f;
+    pool->op        = op;
+    pool->dst       = dst;
+    pool->src       = src;
+    pool->length    = length;
+    pool->job_chunk = ucs_max(pool->chunk - (pool->chunk % dt_len), dt_len);
+    pool->next      = 0;
+    pool->running   = pool->thread_cnt;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    ucg_builtin_reduce_pool_work(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->busy);
+    return 1;
+}
+
+static int ucg_builtin_reduce_cpu_node(int cpu)
+{
+    char path[64];
+    struct dirent *entry;
+    DIR *dir;
+    int node = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    while ((node < 0) && ((entry = readdir(dir)) != NULL)) {
+        if (sscanf(entry->d_name, "node%d", &node) != 1) {
+            node = -1;
+        }
+    }
+
+    closedir(dir);
+    return node;
+}
+
+/*
+ * Lists the cores helper threads may run on: those this process may run on,
+ * except for the caller's own core, starting with the caller's NUMA node.
+ */
+static unsigned ucg_builtin_reduce_pool_cpus(int *cpus, unsigned max_cnt)
+{
+    int cpu, is_local, self = sched_getcpu();
+    int node                = (self < 0) ? -1 :
+                              ucg_builtin_reduce_cpu_node(self);
+    unsigned cnt            = 0;
+    cpu_set_t mask;
+
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+        return 0;
+    }
+
+    for (is_local = 1; is_local >= 0; is_local--) {
+        for (cpu = 0; (cpu < CPU_SETSIZE) && (cnt < max_cnt); cpu++) {
+            if (!CPU_ISSET(cpu, &mask) || (cpu == self)) {
+                continue;
+            }
+
+            if ((node >= 0) &&
+                ((ucg_builtin_reduce_cpu_node(cpu) == node) != is_local)) {
+                continue;
+            }
+
+            cpus[cnt++] = cpu;
+        }
+
+        if (node < 0) {
+            break; /* no NUMA information - the first pass took them all */
+        }
+    }
+
+    return cnt;
+}
+
+ucs_status_t ucg_builtin_reduce_pool_create(unsigned thread_cnt, size_t chunk,
+                                            size_t thresh,
+                                            ucg_builtin_reduce_pool_t **pool_p)
+{
+    ucg_builtin_reduce_pool_t *pool;
+    unsigned i, cpu_cnt;
+    cpu_set_t cpu_mask;
+    int *cpus;
+
+    ucs_assert(thread_cnt > 0);
+
+    pool = ucs_calloc(1, sizeof(*pool) + (thread_cnt * sizeof(pthread_t)),
+                      "ucg_builtin_reduce_pool");
+    if (pool == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    cpus = ucs_malloc(thread_cnt * sizeof(*cpus), "ucg_builtin_reduce_cpus");
+    if (cpus == NULL) {
+        ucs_free(pool);
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->busy, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->chunk  = ucs_max(chunk, 1);
+    pool->thresh = thresh;
+
+    cpu_cnt = ucg_builtin_reduce_pool_cpus(cpus, thread_cnt);
+    if (cpu_cnt < thread_cnt) {
+        ucs_warn("only %u other cores available for %u reduction threads",
+                 cpu_cnt, thread_cnt);
+    }
+
+    for (i = 0; i < thread_cnt; i++) {
+        if (pthread_create(&pool->threads[i], NULL,
+                           ucg_builtin_reduce_pool_thread, pool) != 0) {
+            ucs_error("failed to create a reduction thread");
+            pool->thread_cnt = i;
+            ucg_builtin_reduce_pool_destroy(pool);
+            ucs_free(cpus);
+            return UCS_ERR_IO_ERROR;
+        }
+
+        /* Extra threads (beyond the available cores) are left unbound */
+        if (i < cpu_cnt) {
+            CPU_ZERO(&cpu_mask);
+            CPU_SET(cpus[i], &cpu_mask);
+            if (pthread_setaffinity_np(pool->threads[i], sizeof(cpu_mask),
+                                       &cpu_mask) != 0) {
+                ucs_debug("failed to bind a reduction thread to core %d",
+                         cpus[i]);
+            }
+        }
+    }
+
+    pool->thread_cnt = thread_cnt;
+    ucs_free(cpus);
+    *pool_p = pool;
+    return UCS_OK;
+}
+
+void ucg_builtin_reduce_pool_destroy(ucg_builtin_reduce_pool_t *pool)
+{
+    unsigned i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->is_stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->thread_cnt; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->busy);
+    pthread_mutex_destroy(&pool->lock);
+    ucs_free(pool);
+}
@@ -3,8 +3,11 @@
  * See file LICENSE for terms.
  */
 
+#include <math.h>
 #include <stddef.h>
+#include <sys/mman.h>
 #include <ucs/sys/compiler_def.h>
+#include <uct/base/uct_md.h> /* for the component of a memory domain */
 
 #include "builtin_ops.h"
 #include "builtin_comp_step.inl"
@@ -40,13 +43,169 @@ static void ucg_builtin_step_am_zcopy_comp_step_check_cb(uct_completion_t *self
 ucs_status_t ucg_builtin_step_zcopy_prep(ucg_builtin_op_step_t *step,
                                          const ucg_collective_params_t *params)
 {
+    unsigned lane;
+    ucs_status_t status;
+    const ucg_builtin_plan_rail_t *rail;
+    ucg_builtin_step_rails_t *rails = step->rails;
+    size_t length                   = (step->zcopy.vector.blocklen != 0) ?
+                                      ucg_builtin_dt_vector_span(&step->zcopy.vector) :
+                                      ucg_builtin_step_length(step, params, 1);
+
     step->zcopy.zcomp.comp.count = step->fragments_total;
     step->zcopy.zcomp.comp.func  = ucg_builtin_step_am_zcopy_comp_step_check_cb;
 
     /* Register the buffer, creating a memory handle used in zero-copy sends */
-    return uct_md_mem_reg(step->uct_md, step->send_buffer,
-                          ucg_builtin_step_length(step, params, 1),
-                          UCT_MD_MEM_ACCESS_ALL, &step->zcopy.memh);
+    status = ucg_builtin_mem_reg(step->phase->md, step->phase->rcache,
+                                 step->send_buffer, length, PROT_READ,
+                                 &step->zcopy.memh, &step->zcopy.region);
+    if (ucs_likely((status != UCS_OK) || (rails == NULL))) {
+        return status;
+    }
+
+    /* ... and with every other lane the fragments are striped across */
+    for (lane = 1; lane < rails->cnt; lane++) {
+        rail   = rails->lanes[lane];
+        status = ucg_builtin_mem_reg(rail->md, rail->rcache, step->send_buffer,
+                                     length, PROT_READ, &rails->memh[lane],
+                                     &rails->region[lane]);
+        if (status != UCS_OK) {
+            rails->cnt = lane; /* so that only those registered are released */
+            ucg_builtin_step_zcopy_dereg(step);
+            ucs_free(rails);
+            step->rails = NULL;
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+void ucg_builtin_step_zcopy_dereg(ucg_builtin_op_step_t *step)
+{
+    unsigned lane;
+    const ucg_builtin_plan_rail_t *rail;
+    ucg_builtin_step_rails_t *rails = step->rails;
+
+    ucg_builtin_mem_dereg(step->phase->md, step->phase->rcache,
+                          step->zcopy.memh, step->zcopy.region);
+
+    if (rails != NULL) {
+        for (lane = 1; lane < rails->cnt; lane++) {
+            rail = rails->lanes[lane];
+            ucg_builtin_mem_dereg(rail->md, rail->rcache, rails->memh[lane],
+                                  rails->region[lane]);
+        }
+    }
+}
+
+/*
+ * Stripe the fragments of a large zero-copy send across all the lanes to each
+ * peer (see @ref ucg_builtin_connect_rails ). The send buffer is registered
+ * once per lane, so every peer of this step must be reachable over the same
+ * memory domains - which is typically the case (e.g. one lane per device).
+ */
+static void ucg_builtin_step_rails_create(ucg_builtin_plan_t *plan,
+                                          ucg_builtin_op_step_t *step)
+{
+    double total;
+    unsigned ep_idx, lane, best, slot, cnt;
+    ucg_builtin_step_rails_t *rails;
+    const uct_iface_attr_t *attr;
+    const ucg_builtin_plan_rail_t *rail;
+    const ucg_builtin_plan_rails_t *first, *peer;
+    double bw[UCG_BUILTIN_MAX_RAILS], credit[UCG_BUILTIN_MAX_RAILS];
+    uint8_t sel[UCG_BUILTIN_MAX_RAILS];
+    ucg_builtin_plan_phase_t *phase = step->phase;
+    unsigned host_proc_cnt          = ucs_max(phase->host_proc_cnt, 1);
+
+    if ((plan->gctx == NULL) || (step->zcopy.vector.blocklen != 0) ||
+        (step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED |
+                        UCG_BUILTIN_OP_STEP_FLAG_SEND_VARIADIC))) {
+        return;
+    }
+
+    first = ucg_builtin_get_rails(plan->gctx, (phase->ep_cnt == 1) ?
+                                  phase->single_ep : phase->multi_eps[0]);
+    if (first == NULL) {
+        return;
+    }
+
+    /* Only lanes which can take a whole fragment, and register the buffer */
+    attr  = phase->iface_attr;
+    bw[0] = attr->bandwidth.dedicated + (attr->bandwidth.shared / host_proc_cnt);
+    total = bw[0];
+    cnt   = 1;
+    for (lane = 0; lane < first->cnt; lane++) {
+        rail = &first->lanes[lane];
+        attr = rail->iface_attr;
+        if ((attr->cap.am.max_zcopy >= step->fragment_length +
+                                       plan->header_length) &&
+            (attr->cap.am.max_hdr >= plan->header_length) &&
+            (rail->md_attr->cap.flags & UCT_MD_FLAG_REG) &&
+            (rail->md_attr->cap.max_reg >= step->buffer_length)) {
+            bw[cnt]    = attr->bandwidth.dedicated +
+                         (attr->bandwidth.shared / host_proc_cnt);
+            total     += bw[cnt];
+            sel[cnt++] = lane;
+        }
+    }
+
+    if ((cnt == 1) || (bw[0] <= 0)) {
+        return;
+    }
+
+    rails = ucs_malloc(sizeof(*rails) +
+                       (phase->ep_cnt * (cnt - 1) * sizeof(uct_ep_h)),
+                       "builtin_step_rails");
+    if (rails == NULL) {
+        return;
+    }
+
+    for (ep_idx = 0; ep_idx < phase->ep_cnt; ep_idx++) {
+        peer = (ep_idx == 0) ? first :
+               ucg_builtin_get_rails(plan->gctx, phase->multi_eps[ep_idx]);
+        if ((peer == NULL) || (peer->cnt != first->cnt)) {
+            goto no_striping;
+        }
+
+        for (lane = 1; lane < cnt; lane++) {
+            if (peer->lanes[sel[lane]].md != first->lanes[sel[lane]].md) {
+                goto no_striping;
+            }
+
+            rails->eps[(ep_idx * (cnt - 1)) + lane - 1] =
+                    peer->lanes[sel[lane]].ep;
+        }
+    }
+
+    /* Interleave the lanes, each getting its share of the fragments */
+    for (lane = 0; lane < cnt; lane++) {
+        credit[lane] = 0;
+        if (lane > 0) {
+            rails->lanes[lane] = &first->lanes[sel[lane]];
+        }
+    }
+
+    for (slot = 0; slot < UCG_BUILTIN_RAIL_SCHEDULE; slot++) {
+        for (lane = 0, best = 0; lane < cnt; lane++) {
+            credit[lane] += bw[lane];
+            if (credit[lane] > credit[best]) {
+                best = lane;
+            }
+        }
+
+        credit[best]         -= total;
+        rails->schedule[slot] = best;
+    }
+
+    rails->cnt  = cnt;
+    step->rails = rails;
+    ucs_debug("step #%u stripes its fragments across %u lanes",
+              step->am_header.msg.step_idx, cnt);
+    return;
+
+no_striping:
+    ucs_free(rails);
 }
 
 static ucs_status_t ucg_builtin_optimize_am_bcopy_to_zcopy(ucg_builtin_op_t *op)
@@ -54,11 +213,13 @@ static ucs_status_t ucg_builtin_optimize_am_bcopy_to_zcopy(ucg_builtin_op_t *op)
     /* This function was called because we want to "upgrade" a bcopy-send to
      * zcopy, by way of memory registration (costly, but hopefully worth it) */
     ucs_status_t status;
+    ucg_builtin_plan_t *plan;
     ucg_builtin_op_step_t *step;
     ucg_step_idx_t step_idx = 0;
     do {
         step = &op->steps[step_idx++];
         if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) &&
+            !(step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) &&
             (step->phase->md_attr->cap.max_reg > step->buffer_length)) {
             status = ucg_builtin_step_zcopy_prep(step, &op->super.params);
             if (status != UCS_OK) {
@@ -77,29 +238,328 @@ static ucs_status_t ucg_builtin_optimize_am_bcopy_to_zcopy(ucg_builtin_op_t *op)
         }
     } while (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
 
-    return UCS_OK;
+    /* Zero-copy sends may later be replaced by one-sided ones, as well */
+    plan = ucs_derived_of(op->super.plan, ucg_builtin_plan_t);
+    return ucg_builtin_op_consider_optimization(op, plan->config);
 
 bcopy_to_zcopy_cleanup:
     while (step_idx--) {
         if (step->zcopy.memh) {
-            uct_md_mem_dereg(step->uct_md, step->zcopy.memh);
+            ucg_builtin_step_zcopy_dereg(step);
         }
     }
     return status;
 }
 
+static ucs_status_t ucg_builtin_no_optimization(ucg_builtin_op_t *op)
+{
+    return UCS_OK;
+}
+
+/*
+ * A step may be sent its data by a one-sided write if nothing before it uses
+ * its receive buffer (so it could be written any time during the collective),
+ * and it receives from the same (single) peer it sends to - which is where
+ * the address and key of that buffer are sent.
+ */
+static int ucg_builtin_step_rma_can_recv(ucg_builtin_op_t *op,
+                                         ucg_builtin_op_step_t *step)
+{
+    ucg_builtin_plan_phase_t *phase = step->phase;
+
+    /* Only where the peer also sends to us (see ucg_builtin_step_rma_is_ready) */
+    switch (phase->method) {
+    case UCG_PLAN_METHOD_REDUCE_RECURSIVE:
+    case UCG_PLAN_METHOD_NEIGHBOR:
+        break;
+
+    default:
+        return 0;
+    }
+
+    return ((step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT |
+                            UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED)) ==
+            UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT) &&
+           (phase->md_attr->cap.flags & UCT_MD_FLAG_REG) &&
+           (phase->md_attr->cap.max_reg >= step->buffer_length) &&
+           (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_BCOPY) &&
+           (phase->iface_attr->cap.am.max_bcopy >=
+            sizeof(ucg_builtin_header_t) + sizeof(ucg_builtin_header_ext_t) +
+            sizeof(uint64_t) + phase->md_attr->rkey_packed_size) &&
+           ucg_builtin_op_step_can_place(op, step);
+}
+
+/* The data is put, followed by an empty message (see ucg_builtin_step_rma_put) */
+static int ucg_builtin_step_rma_can_send(ucg_builtin_op_t *op,
+                                         ucg_builtin_op_step_t *step)
+{
+    const uct_iface_attr_t *iface_attr = step->phase->iface_attr;
+
+    return ((step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT |
+                            UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY   |
+                            UCG_BUILTIN_OP_STEP_FLAG_SEND_VARIADIC   |
+                            UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED      |
+                            UCG_BUILTIN_OP_STEP_FLAG_WRITE_REMOTE_ADDR)) ==
+            (UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT |
+             UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY)) &&
+           (iface_attr->cap.flags & UCT_IFACE_FLAG_PUT_ZCOPY) &&
+           (iface_attr->cap.flags & UCT_IFACE_FLAG_AM_SHORT) &&
+           (iface_attr->cap.put.max_zcopy >=
+            ucg_builtin_step_length(step, &op->super.params, 1)) &&
+           ((step->zcopy.vector.blocklen == 0) ||
+            ucg_builtin_dt_vector_fits(&step->zcopy.vector,
+                                       ucg_builtin_step_length(step,
+                                               &op->super.params, 1),
+                                       iface_attr->cap.put.max_iov)) &&
+           (iface_attr->cap.am.max_short >= sizeof(ucg_builtin_header_t) +
+                                            sizeof(ucg_builtin_header_ext_t));
+}
+
+ucg_builtin_step_rma_t *ucg_builtin_step_rma_create(ucg_builtin_op_step_t *step,
+                                                    int can_put)
+{
+    size_t rkey_size            = step->phase->md_attr->rkey_packed_size;
+    ucg_builtin_step_rma_t *rma = UCS_ALLOC_CHECK(sizeof(*rma) + (2 * rkey_size),
+                                                  "builtin_step_rma");
+
+    rma->cmpt          = step->uct_md->component;
+    rma->rkey_size     = rkey_size;
+    rma->recv_memh     = UCT_MEM_HANDLE_NULL;
+    rma->recv_region   = NULL;
+    rma->send_memh     = UCT_MEM_HANDLE_NULL;
+    rma->send_region   = NULL;
+    rma->ready_key     = 0;
+    rma->can_put       = can_put;
+    rma->is_advertised = 1; /* nothing to advertise yet */
+    rma->has_peer_rkey = 0;
+    rma->is_put_done   = 0;
+    rma->is_offered    = 0;
+    step->rma          = rma;
+
+    return rma;
+}
+
+/*
+ * Register the receive buffer of a step for the peer to write into, and have
+ * it advertised the next time the step sends. If it can't be registered - the
+ * peer is told to stop writing into the one it was given before, if any.
+ */
+void ucg_builtin_step_rma_recv_prep(ucg_builtin_op_t *op,
+                                    ucg_builtin_op_step_t *step)
+{
+    ucs_status_t status;
+    ucg_builtin_step_rma_t *rma = step->rma;
+
+    ucs_assert(rma->recv_memh == UCT_MEM_HANDLE_NULL);
+
+    status = ucg_builtin_mem_reg(step->phase->md, step->phase->rcache,
+                                 step->recv_buffer, step->buffer_length,
+                                 PROT_READ | PROT_WRITE, &rma->recv_memh,
+                                 &rma->recv_region);
+    if (status == UCS_OK) {
+        status = uct_md_mkey_pack(step->uct_md, rma->recv_memh, rma->rkeys);
+        if (status != UCS_OK) {
+            ucg_builtin_mem_dereg(step->phase->md, step->phase->rcache,
+                                  rma->recv_memh, rma->recv_region);
+            rma->recv_memh   = UCT_MEM_HANDLE_NULL;
+            rma->recv_region = NULL;
+        }
+    }
+
+    if (status != UCS_OK) {
+        ucs_debug("step #%u receive buffer not registered for RMA: %s",
+                  step->am_header.msg.step_idx, ucs_status_string(status));
+        if (rma->is_advertised) {
+            return; /* the peer has none to stop writing into */
+        }
+    }
+
+    rma->is_advertised = 0;
+}
+
+/*
+ * Once a collective has been repeated enough (on all ranks, for "symmetric"
+ * collectives), steps receiving large messages register their receive buffer
+ * and send its address and remote key to the peer - once, as long as the
+ * buffer stays the same (see @ref ucg_builtin_step_rma_advertise ). The peer then
+ * writes its data there directly, rather than send it as an active message to
+ * be copied, but only once this step's own data (of the same collective) has
+ * arrived from us: the peer could otherwise be a collective ahead, writing into
+ * a buffer still in use (e.g. read by the application). Since both sides send
+ * in such steps, this needs no messages of its own - whichever side starts
+ * the step last writes, and the other sends as before.
+ */
 static ucs_status_t ucg_builtin_optimize_am_to_rma(ucg_builtin_op_t *op)
 {
-    // TODO: implement, especially important for "symmetric" collectives, where
-    //       all ranks run a persistent collective and thus can re-use rkeys...
+    int can_send;
+    int can_recv;
+    ucg_builtin_step_rma_t *rma;
+    ucg_builtin_op_step_t *step = &op->steps[0];
+
+    op->optm_cb = ucg_builtin_no_optimization;
+
+    do {
+        can_send = ucg_builtin_step_rma_can_send(op, step);
+        can_recv = ucg_builtin_step_rma_can_recv(op, step);
+        if ((step->rma != NULL) || (!can_send && !can_recv)) {
+            continue;
+        }
+
+        rma = ucg_builtin_step_rma_create(step, can_send);
+        if (can_recv) {
+            ucg_builtin_step_rma_recv_prep(op, step);
+        }
+
+        if (!can_send && (rma->recv_memh == UCT_MEM_HANDLE_NULL)) {
+            ucg_builtin_step_rma_discard(step);
+        }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
     return UCS_OK;
 }
 
-static ucs_status_t ucg_builtin_no_optimization(ucg_builtin_op_t *op)
+typedef struct ucg_builtin_rma_advert {
+    uint64_t                     header[2];
+    size_t                       header_length;
+    const ucg_builtin_op_step_t *step;
+} ucg_builtin_rma_advert_t;
+
+static size_t ucg_builtin_rma_advert_pack(void *dest, void *arg)
+{
+    ucg_builtin_rma_advert_t *advert = (ucg_builtin_rma_advert_t*)arg;
+    const ucg_builtin_step_rma_t *rma = advert->step->rma;
+    uint64_t recv_addr                = (uintptr_t)advert->step->recv_buffer;
+    uint8_t *iter                     = (uint8_t*)dest;
+
+    memcpy(iter, advert->header, advert->header_length);
+    iter += advert->header_length;
+    if (rma->recv_memh == UCT_MEM_HANDLE_NULL) {
+        return advert->header_length; /* no buffer (anymore) */
+    }
+
+    memcpy(iter, &recv_addr, sizeof(recv_addr));
+    iter += sizeof(recv_addr);
+    memcpy(iter, rma->rkeys, rma->rkey_size);
+
+    return advert->header_length + sizeof(recv_addr) + rma->rkey_size;
+}
+
+/*
+ * Sent by a step right before its own data, so that on the endpoint the advert
+ * always precedes it (see ucg_builtin_step_rma_is_ready) - until the peer has
+ * the current receive buffer. If it can't be sent, neither is the data: the
+ * step is resent later, as if the data itself had failed.
+ */
+ucs_status_t ucg_builtin_step_rma_advertise(ucg_builtin_request_t *req,
+                                            ucg_builtin_op_step_t *step,
+                                            ucg_builtin_header_t header)
 {
+    ssize_t packed;
+    ucg_builtin_header_ext_t ext;
+    ucg_builtin_rma_advert_t advert;
+
+    header.remote_offset = UCG_BUILTIN_OFFSET_RMA_READY;
+    ext.header           = ucg_builtin_step_header_ext(req, step);
+    ext.remote_offset_hi = UINT32_MAX;
+
+    advert.header[0]     = header.header;
+    advert.header[1]     = ext.header;
+    advert.header_length = ucg_builtin_header_length(req);
+    advert.step          = step;
+
+    packed = uct_ep_am_bcopy(step->phase->single_ep, req->am_id,
+                             ucg_builtin_rma_advert_pack, &advert, 0);
+    if (ucs_unlikely(packed < 0)) {
+        ucs_trace_req("step #%u receive buffer not advertised: %s",
+                      step->am_header.msg.step_idx,
+                      ucs_status_string((ucs_status_t)packed));
+        return (ucs_status_t)packed;
+    }
+
+    step->rma->is_advertised = 1;
     return UCS_OK;
 }
 
+/*
+ * The root of a large broadcast (or scatter) may only send the address and the
+ * remote key of its buffer, rather than the data (see
+ * @ref ucg_builtin_set_phase_pull ): each member then reads its part when
+ * ready, all at once, and reports back with an empty message once it has (see
+ * @ref ucg_builtin_step_rndv_get ). The buffer stays registered for as long as
+ * the step uses it, so the key is only packed once.
+ */
+ucs_status_t ucg_builtin_step_rndv_offer_prep(ucg_builtin_op_step_t *step)
+{
+    ucs_status_t status;
+    ucg_builtin_step_rma_t *rma = ucg_builtin_step_rma_create(step, 0);
+    size_t length               = step->buffer_length *
+                                  ((step->flags &
+                                    UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED) ?
+                                   step->ep_cnt : 1);
+
+    status = ucg_builtin_mem_reg(step->phase->md, step->phase->rcache,
+                                 step->send_buffer, length, PROT_READ,
+                                 &rma->send_memh, &rma->send_region);
+    if (status == UCS_OK) {
+        rma->is_offered = 1;
+        status          = uct_md_mkey_pack(step->uct_md, rma->send_memh,
+                                           rma->rkeys);
+    }
+
+    if (status != UCS_OK) {
+        ucg_builtin_step_rma_discard(step);
+    }
+
+    return status;
+}
+
+/* Whether the data of this step is offered to be read, rather than sent */
+static int ucg_builtin_step_rndv_can_offer(ucg_builtin_plan_phase_t *phase,
+                                           const ucg_collective_params_t *params,
+                                           ucg_builtin_op_step_t *step,
+                                           int is_send_dt_contig,
+                                           size_t header_length)
+{
+    size_t length = step->buffer_length *
+                    ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED) ?
+                     phase->ep_cnt : 1);
+
+    return ((phase->method == UCG_PLAN_METHOD_SEND_TERMINAL) ||
+            (phase->method == UCG_PLAN_METHOD_SCATTER_TERMINAL)) &&
+           is_send_dt_contig &&
+           (step->buffer_length >= phase->send_thresh.get_thresh) &&
+           !(UCG_PARAM_TYPE(params).modifiers &
+             (UCG_GROUP_COLLECTIVE_MODIFIER_VARIADIC |
+              UCG_GROUP_COLLECTIVE_MODIFIER_AGGREGATE |
+              UCG_GROUP_COLLECTIVE_MODIFIER_CONCATENATE)) &&
+           (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_BCOPY) &&
+           (phase->iface_attr->cap.am.max_bcopy >= header_length +
+            sizeof(ucg_builtin_rndv_offer_t) + phase->md_attr->rkey_packed_size) &&
+           (phase->md_attr->cap.max_reg >= length);
+}
+
+void ucg_builtin_step_rma_discard(ucg_builtin_op_step_t *step)
+{
+    ucg_builtin_step_rma_t *rma = step->rma;
+
+    if (rma->recv_memh != UCT_MEM_HANDLE_NULL) {
+        ucg_builtin_mem_dereg(step->phase->md, step->phase->rcache,
+                              rma->recv_memh, rma->recv_region);
+    }
+
+    if (rma->is_offered) {
+        ucg_builtin_mem_dereg(step->phase->md, step->phase->rcache,
+                              rma->send_memh, rma->send_region);
+    }
+
+    if (rma->has_peer_rkey) {
+        uct_rkey_release(rma->cmpt, &rma->peer_rkey);
+    }
+
+    ucs_free(rma);
+    step->rma = NULL;
+}
+
 ucs_status_t ucg_builtin_op_consider_optimization(ucg_builtin_op_t *op,
                                                   ucg_builtin_config_t *config)
 {
@@ -118,7 +578,9 @@ ucs_status_t ucg_builtin_op_consider_optimization(ucg_builtin_op_t *op,
          */
         if ((config->bcopy_to_zcopy_opt) &&
             (!op->send_dt) &&
+            !(op->flags & UCG_BUILTIN_OP_FLAG_RING) &&
             (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) &&
+            !(step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) &&
             (step->phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY) &&
             (step->phase->md_attr->cap.flags & UCT_MD_FLAG_NEED_MEMH) &&
             (step->phase->md_attr->cap.max_reg > ucg_builtin_step_length(step,
@@ -131,7 +593,8 @@ ucs_status_t ucg_builtin_op_consider_optimization(ucg_builtin_op_t *op,
         }
 
         if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
-            (step->flags & UCG_GROUP_COLLECTIVE_MODIFIER_SYMMETRIC) &&
+            (UCG_PARAM_TYPE(params).modifiers &
+             UCG_GROUP_COLLECTIVE_MODIFIER_SYMMETRIC) &&
             (step->phase->md_attr->cap.max_reg > ucg_builtin_step_length(step,
                                                                          params,
                                                                          1))) {
@@ -168,9 +631,171 @@ static enum ucg_builtin_op_step_flags ucg_builtin_step_method_flags[] = {
     [UCG_PLAN_METHOD_ALLGATHER_BRUCK]  = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND,
     [UCG_PLAN_METHOD_PAIRWISE]         = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND |
                                          UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED,
-    [UCG_PLAN_METHOD_NEIGHBOR]         = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND
+    [UCG_PLAN_METHOD_NEIGHBOR]         = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND,
+    [UCG_PLAN_METHOD_REDUCE_SCATTER_RING] = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND,
+    [UCG_PLAN_METHOD_ALLGATHER_RING]   = UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND
 };
 
+#define UCG_BUILTIN_BCAST_MODIFIERS (UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE |\
+                                     UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST)
+
+#define UCG_BUILTIN_BCAST_MODIFIERS_MASK (UCG_BUILTIN_BCAST_MODIFIERS |\
+        UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_DESTINATION |\
+        UCG_GROUP_COLLECTIVE_MODIFIER_AGGREGATE          |\
+        UCG_GROUP_COLLECTIVE_MODIFIER_CONCATENATE        |\
+        UCG_GROUP_COLLECTIVE_MODIFIER_VARIADIC)
+
+/*
+ * A broadcast down a tree of depth D, split into segments of size s, takes
+ * about (S/s + D - 1) * (o + s/B) to reach the deepest leaf - if waypoints
+ * forward each segment as soon as it arrives. This is minimal for
+ * s = sqrt(S * o * B / (D - 1)). All the members of the tree must agree on
+ * the segment size, whatever their datatype or role, so it is only derived
+ * from values they share: the parameters of the collective, the configuration
+ * and the group size - and like the fragment size itself, the attributes of
+ * the transport, assuming the same one is used on every hop of this phase.
+ * Returns zero if the message is not to be segmented (beyond the transport's
+ * own fragmentation).
+ */
+static size_t ucg_builtin_step_bcast_segment(const ucg_builtin_plan_t *plan,
+                                             const ucg_builtin_plan_phase_t *phase,
+                                             const ucg_collective_params_t *params,
+                                             size_t dt_len, size_t header_length)
+{
+    unsigned depth;
+    size_t segment;
+    double bandwidth;
+    ucg_group_member_index_t reach;
+    const uct_iface_attr_t *attr = phase->iface_attr;
+    size_t length                = dt_len * params->send.count;
+    size_t config                = plan->config->bcast_segment;
+    size_t max_segment           = attr->cap.am.max_bcopy - header_length;
+    unsigned inter_degree        = ucg_algo.kmtree ?
+                                   plan->config->bmtree.degree_inter_fanout : 2;
+    unsigned intra_degree        = ucg_algo.kmtree_intra ?
+                                   plan->config->bmtree.degree_intra_fanout : 2;
+
+    if (((UCG_PARAM_TYPE(params).modifiers & UCG_BUILTIN_BCAST_MODIFIERS_MASK) !=
+         UCG_BUILTIN_BCAST_MODIFIERS) || (length == 0) ||
+        (config == UCS_MEMUNITS_INF) ||
+        !(attr->cap.flags & UCT_IFACE_FLAG_AM_BCOPY) ||
+        (attr->cap.am.max_bcopy <= header_length)) {
+        return 0;
+    }
+
+    switch (phase->method) {
+    case UCG_PLAN_METHOD_SEND_TERMINAL:
+    case UCG_PLAN_METHOD_BCAST_WAYPOINT:
+    case UCG_PLAN_METHOD_RECV_TERMINAL:
+        break;
+
+    default:
+        return 0;
+    }
+
+#ifdef HAVE_UCT_COLLECTIVES
+    if (attr->cap.flags & UCT_IFACE_FLAG_BCAST) {
+        return 0; /* the transport forwards it on its own */
+    }
+#endif
+
+    if (config != UCS_MEMUNITS_AUTO) {
+        segment = config;
+    } else {
+        /* The deeper of the two trees, so segments are rather too small */
+        for (depth = 0, reach = 1; reach < plan->super.group_size; depth++) {
+            reach *= ucs_max(ucs_min(inter_degree, intra_degree), 2);
+        }
+
+        /* Not divided by the processes per host - which hosts may differ in */
+        bandwidth = attr->bandwidth.dedicated + attr->bandwidth.shared;
+        if ((depth < 2) || (bandwidth <= 0)) {
+            return 0;
+        }
+
+        segment = (size_t)sqrt(length * attr->overhead * bandwidth /
+                               (depth - 1));
+    }
+
+    /* Each segment is sent as a single fragment, by whichever send is used */
+    if (attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY) {
+        max_segment = ucs_min(max_segment,
+                              attr->cap.am.max_zcopy - header_length);
+    }
+
+    segment  = ucs_min(segment, max_segment);
+    segment -= segment % dt_len;
+    if (segment == 0) {
+        return 0;
+    }
+
+    return (segment < length) ? segment : 0;
+}
+
+/*
+ * A ring splits the buffer into a chunk per member (the first ones one element
+ * larger, if it does not divide evenly). In each of the first P-1 steps every
+ * member sends a chunk to the next one and reduces the chunk it receives from
+ * the previous one into its own, so that each ends up with one chunk fully
+ * reduced - which the last P-1 steps pass around the ring. Either way, step #k
+ * sends the chunk received in step #k-1, so the offsets in the messages are
+ * relative to the start of the chunk (and so are the step's buffers).
+ */
+static ucs_status_t
+ucg_builtin_step_ring_chunks(const ucg_builtin_plan_t *plan,
+                             const ucg_builtin_plan_phase_t *phase,
+                             const ucg_collective_params_t *params,
+                             size_t dt_len, int is_dt_contig,
+                             ucg_builtin_op_step_t *step,
+                             size_t *send_length, size_t *recv_length)
+{
+    ucg_group_member_index_t members    = plan->super.group_size;
+    ucg_group_member_index_t shift      = phase->step_index % members;
+    ucg_group_member_index_t send_chunk = (plan->super.my_index + members +
+                                           1 - shift) % members;
+    ucg_group_member_index_t recv_chunk = (plan->super.my_index + members -
+                                           shift) % members;
+    size_t quotient                     = params->send.count / members;
+    size_t remainder                    = params->send.count % members;
+    int8_t *buffer                      = (int8_t*)params->recv.buffer;
+
+    if (!is_dt_contig || (quotient == 0)) {
+        ucs_error("ring allreduce requires a contiguous datatype and at least "
+                  "one element per member");
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    step->send_buffer   = buffer + dt_len * (send_chunk * quotient +
+                                             ucs_min(send_chunk, remainder));
+    step->recv_buffer   = buffer + dt_len * (recv_chunk * quotient +
+                                             ucs_min(recv_chunk, remainder));
+    step->buffer_length = dt_len * (quotient + (remainder > 0));
+    *send_length        = dt_len * (quotient + (send_chunk < remainder));
+    *recv_length        = dt_len * (quotient + (recv_chunk < remainder));
+    return UCS_OK;
+}
+
+/*
+ * Ring chunks are always buffer-copied in segments, so that each can be sent
+ * on as soon as it has been reduced (see @ref ucg_builtin_step_send_ahead ).
+ * Smaller segments leave less of the reduction and transfer of a chunk
+ * exposed, at the cost of more messages - and for chunks of size C the
+ * optimum, about sqrt(C * o * B), is typically above the largest buffer-copy
+ * message of the transport anyway. Hence it is the default, and also the cap
+ * (test/bench_ring compares it with smaller segments).
+ */
+static size_t ucg_builtin_step_ring_segment(const ucg_builtin_plan_t *plan,
+                                            size_t dt_len)
+{
+    size_t config = plan->config->ring_segment;
+
+    if ((config == UCS_MEMUNITS_AUTO) || (config == UCS_MEMUNITS_INF)) {
+        return SIZE_MAX;
+    }
+
+    return ucs_max(config - (config % dt_len), dt_len);
+}
+
 static inline ucs_status_t
 ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
                             ucg_builtin_plan_phase_t *phase,
@@ -179,6 +804,8 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
                             uct_coll_dtype_mode_t mode,
 #endif
                             size_t dt_len, int is_dt_contig,
+                            const ucg_builtin_dt_vector_t *dt_vector,
+                            size_t header_length, size_t segment,
                             uint64_t *send_flag)
 {
     size_t length      = step->buffer_length;
@@ -187,6 +814,8 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
     int supports_bcopy = (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_BCOPY);
     int supports_zcopy = (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY);
 #else
+    /* Vectors are zero-copied from an IOV entry per block (if they fit) */
+    int is_dt_iov      = is_dt_contig || (dt_vector->blocklen != 0);
     int supports_short = is_dt_contig &&
                          (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_SHORT) &&
                         ((phase->iface_attr->cap.coll_mode.short_flags & UCS_BIT(mode)) ||
@@ -194,7 +823,7 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
     int supports_bcopy = (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_BCOPY) &&
                         ((phase->iface_attr->cap.coll_mode.bcopy_flags & UCS_BIT(mode)) ||
                          (mode == UCT_COLL_DTYPE_MODE_PADDED));
-    int supports_zcopy = is_dt_contig &&
+    int supports_zcopy = is_dt_iov &&
                          (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_AM_ZCOPY) &&
                         ((phase->iface_attr->cap.coll_mode.zcopy_flags & UCS_BIT(mode)) ||
                          (mode == UCT_COLL_DTYPE_MODE_PADDED));
@@ -203,6 +832,21 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
                (phase->iface_attr->cap.am.coll_mode_flags & mode));
 #endif
 
+    /* The UCT short-send header is 64-bit, so extended headers won't fit */
+    supports_short = supports_short &&
+                     (header_length == sizeof(ucg_builtin_header_t));
+
+    /* Segmented broadcasts are sent a segment per fragment - zero-copied
+     * from the root, but buffer-copied by waypoints, which forward each one
+     * from the receive buffer as soon as it arrives (and so are all the peers
+     * of a waypoint, from which their fragment count must not differ) */
+    if (segment != 0) {
+        supports_short = supports_short && !supports_bcopy;
+        if (phase->method == UCG_PLAN_METHOD_BCAST_WAYPOINT) {
+            supports_zcopy = 0;
+        }
+    }
+
     /*
      * Short messages
      */
@@ -247,10 +891,20 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
      * Large messages (zero-copy sends)
      */
     if (supports_zcopy) {
-        size_t zcopy_threshold = 100000; // TODO: need to calculate the threshold!
-        if (length > zcopy_threshold) {
-            size_t max_zcopy = phase->iface_attr->cap.am.max_zcopy - sizeof(ucg_builtin_header_t);
-            ucs_assert(phase->iface_attr->cap.am.max_zcopy > sizeof(ucg_builtin_header_t));
+        if (length >= phase->send_thresh.zcopy_thresh) {
+            size_t max_zcopy = phase->iface_attr->cap.am.max_zcopy - header_length;
+            ucs_assert(phase->iface_attr->cap.am.max_zcopy > header_length);
+            if (segment != 0) {
+                max_zcopy = ucs_min(max_zcopy, segment);
+            }
+            if (ucs_unlikely(dt_vector->blocklen != 0) &&
+                !ucg_builtin_dt_vector_fits(dt_vector, (length <= max_zcopy) ?
+                                            length : max_zcopy -
+                                            (max_zcopy % dt_len),
+                                            phase->iface_attr->cap.am.max_iov)) {
+                /* Too many blocks per message - pack them instead (below) */
+                goto send_flags_bcopy;
+            }
             if (ucs_likely(length <= max_zcopy)) {
                 /* ZCopy send - single message */
                 *send_flag            = UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY;
@@ -271,6 +925,7 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
         }
     }
 
+send_flags_bcopy:
     if (ucs_unlikely(!supports_bcopy)) {
         ucs_error("collective not supported by any transport type");
         return UCS_ERR_UNSUPPORTED;
@@ -279,8 +934,12 @@ ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
     /*
      * Medium messages (buffer-copy)
      */
-    size_t max_bcopy = phase->iface_attr->cap.am.max_bcopy - sizeof(ucg_builtin_header_t);
-    ucs_assert(phase->iface_attr->cap.am.max_bcopy > sizeof(ucg_builtin_header_t));
+    size_t max_bcopy = phase->iface_attr->cap.am.max_bcopy - header_length;
+    ucs_assert(phase->iface_attr->cap.am.max_bcopy > header_length);
+    if (segment != 0) {
+        max_bcopy = ucs_min(max_bcopy, segment);
+    }
+
     if (ucs_likely(length <= max_bcopy)) {
         /* BCopy send - single message */
         *send_flag            = UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY;
@@ -320,6 +979,14 @@ ucs_status_t ucg_builtin_convert_datatype(void *param_datatype, ucp_datatype_t *
             ucs_error("Datatype conversion callback failed");
             return UCS_ERR_INVALID_PARAM;
         }
+
+        /* (value, index) pairs with padding are sent as is, and reduced so */
+        if (!UCP_DT_IS_CONTIG(*ucp_datatype)) {
+            size_t pair_extent = ucg_builtin_reduce_pair_extent(param_datatype);
+            if (pair_extent > 0) {
+                *ucp_datatype = ucp_dt_make_contig(pair_extent);
+            }
+        }
     } else {
         *ucp_datatype = (ucp_datatype_t)param_datatype;
     }
@@ -352,6 +1019,15 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_t *plan,
     ucs_assert_always(plan->super.group_id >= UCG_GROUP_FIRST_GROUP_ID);
     ucs_assert_always(phase->host_proc_cnt < (typeof(step->batch_cnt))-1);
 
+    /* Larger step indexes can only be told apart with extended headers */
+    int is_ext = (plan->header_length > sizeof(ucg_builtin_header_t));
+    if (ucs_unlikely(!is_ext &&
+                     (phase->step_index > (ucg_step_idx_t)-1))) {
+        ucs_error("step #%u exceeds the compact header, set "
+                  "BUILTIN_HEADER_EXT=on", (unsigned)phase->step_index);
+        return UCS_ERR_EXCEEDS_LIMIT;
+    }
+
     /* See note after ucg_builtin_step_send_flags() call */
     *zcopy_step_skip = 0;
 zcopy_redo:
@@ -363,9 +1039,19 @@ zcopy_redo:
     step->am_header.group_id      = plan->super.group_id;
     step->am_header.msg.step_idx  = phase->step_index;
     step->am_header.remote_offset = 0;
+    step->am_header_ext.header    = 0;
+    step->am_header_ext.msg_hi.step_idx =
+            phase->step_index >> UCG_BUILTIN_HEADER_EXT_SHIFT;
     step->iter_ep                 = 0;
     step->iter_offset             = 0;
     step->fragment_pending        = NULL;
+    step->rma                     = NULL;
+    step->rails                   = NULL;
+    step->pack_source             = NULL;
+    step->credits                 = UCG_BUILTIN_CREDITS_OFF;
+    step->credit_window           = UCG_BUILTIN_CREDITS_OFF;
+    step->credit_batch            = 0;
+    step->credit_total            = 0;
     step->buffer_length           = send_dt_len * params->send.count;
     step->recv_buffer             = (int8_t*)params->recv.buffer;
     step->uct_md                  = phase->md;
@@ -388,6 +1074,45 @@ zcopy_redo:
                             (int8_t*)params->send.buffer;
     }
 
+    /* Ring steps only send and receive a chunk of the buffer */
+    size_t segment;
+    size_t ring_send_length;
+    size_t ring_recv_length;
+    int is_ring = (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING) ||
+                  (phase->method == UCG_PLAN_METHOD_ALLGATHER_RING);
+    if (is_ring) {
+        status = ucg_builtin_step_ring_chunks(plan, phase, params, send_dt_len,
+                                              is_send_dt_contig, step,
+                                              &ring_send_length,
+                                              &ring_recv_length);
+        if (ucs_unlikely(status != UCS_OK)) {
+            return status;
+        }
+
+        segment = ucg_builtin_step_ring_segment(plan, send_dt_len);
+    } else {
+        segment = ucg_builtin_step_bcast_segment(plan, phase, params,
+                                                 send_dt_len,
+                                                 plan->header_length);
+    }
+
+    /* The same data sent to several peers is packed only once, and then sent
+     * as if it was contiguous (see ucg_builtin_step_pack_once) */
+    int is_packed_once = !is_send_dt_contig && (params->send.count > 0) &&
+                         (phase->ep_cnt > 1) &&
+                         !(step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SEND_STRIDED |
+                                          UCG_BUILTIN_OP_STEP_FLAG_RECV_BEFORE_SEND1)) &&
+                         !(modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_VARIADIC);
+
+    /* Data which is not packed (once or per fragment) may be a vector - this
+     * only depends on the datatype, so that all the peers agree on zero-copy */
+    ucg_builtin_dt_vector_t dt_vector = { .blocklen = 0 };
+    if (!is_send_dt_contig && !is_packed_once &&
+        !(modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_VARIADIC)) {
+        (void)ucg_builtin_dt_get_vector(params->send.dtype, params->send.count,
+                                        send_dt_len, &dt_vector);
+    }
+
     uint64_t send_flags;
     int is_concat = modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_CONCATENATE;
 #ifdef HAVE_UCT_COLLECTIVES
@@ -409,7 +1134,10 @@ zcopy_redo:
 #else
     status = ucg_builtin_step_send_flags(step, phase, params,
 #endif
-                                         send_dt_len, is_send_dt_contig, &send_flags);
+                                         send_dt_len,
+                                         is_send_dt_contig || is_packed_once,
+                                         &dt_vector, plan->header_length,
+                                         segment, &send_flags);
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
     }
@@ -431,6 +1159,26 @@ zcopy_redo:
         goto zcopy_redo;
     }
 
+    /* Large broadcasts and scatters may be read by the members instead */
+    int is_offered = ucg_builtin_step_rndv_can_offer(phase, params, step,
+                                                     is_send_dt_contig,
+                                                     plan->header_length);
+    if (is_offered) {
+        status = ucg_builtin_step_rndv_offer_prep(step);
+        if (status == UCS_OK) {
+            /* A single offer to each member, which each reports back on */
+            send_flags            = UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY;
+            step->uct_send        = step->uct_iface->ops.ep_am_bcopy;
+            step->fragment_length = step->buffer_length;
+            step->fragments_total = phase->ep_cnt;
+            step->flags          |= UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND;
+        } else {
+            ucs_debug("step #%u send buffer not registered to be read: %s",
+                      phase->step_index, ucs_status_string(status));
+            is_offered = 0;
+        }
+    }
+
     step->comp_flags = 0;
 #ifdef HAVE_UCT_COLLECTIVES
     if (phase->iface_attr->cap.flags & UCT_IFACE_FLAG_INCAST) {
@@ -445,14 +1193,31 @@ zcopy_redo:
     if (is_fragmented) {
         step->flags           |= UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED;
         step->comp_flags      |= UCG_BUILTIN_OP_STEP_COMP_FLAG_FRAGMENTED_DATA;
-        step->fragment_pending = (uint8_t*)UCS_ALLOC_CHECK(sizeof(phase->ep_cnt),
-                                                           "ucg_builtin_step_pipelining");
     }
 
     if ((step->buffer_length * plan->super.group_size) > (ucg_offset_t)-1) {
         step->comp_flags |= UCG_BUILTIN_OP_STEP_COMP_FLAG_LONG_BUFFERS;
     }
 
+    /*
+     * The sends were planned for the largest chunk, which all the members
+     * agree on - but each step sends (and receives) a chunk of its own size.
+     * Incoming data is always reduced fragment-wise, since chunks are smaller
+     * than the "count" of the collective.
+     */
+    if (is_ring) {
+        if (is_fragmented) {
+            step->fragments_total = ring_recv_length / step->fragment_length +
+                                    ((ring_recv_length % step->fragment_length) > 0);
+        } else {
+            step->fragment_length = step->buffer_length;
+            step->fragments_total = 1;
+        }
+
+        step->buffer_length  = ring_send_length;
+        step->comp_flags    |= UCG_BUILTIN_OP_STEP_COMP_FLAG_FRAGMENTED_DATA;
+    }
+
     /* Do any special assignment w.r.t. the src/dst buffers in this step */
     int is_send            = 0;
     int is_recv            = 0;
@@ -523,9 +1288,17 @@ zcopy_redo:
             step->send_buffer = step->recv_buffer;
         }
 
-        if (is_fragmented) {
-            step->flags |= UCG_BUILTIN_OP_STEP_FLAG_PIPELINED;
-            is_pipelined = 1;
+        /* Broadcast waypoints forward each fragment once it has arrived -
+         * unless the root may offer it to be read, all at once, instead */
+        if (is_fragmented && (phase->ep_cnt > 1) && !is_packed_once &&
+            (phase->method == UCG_PLAN_METHOD_BCAST_WAYPOINT) &&
+            !(send_flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
+            (step->buffer_length < phase->recv_thresh.get_thresh)) {
+            step->flags           |= UCG_BUILTIN_OP_STEP_FLAG_PIPELINED;
+            step->fragment_pending = (uint8_t*)UCS_ALLOC_CHECK(
+                    step->fragments_total / phase->ep_cnt,
+                    "ucg_builtin_step_pipelining");
+            is_pipelined           = 1;
         }
         break;
 
@@ -550,11 +1323,18 @@ zcopy_redo:
         *op_flags |= UCG_BUILTIN_OP_FLAG_ALLTOALL;
         break;
 
+    case UCG_PLAN_METHOD_REDUCE_SCATTER_RING:
+        is_reduction = 1;
+        /* no break */
+    case UCG_PLAN_METHOD_ALLGATHER_RING:
+        is_send = 1;
+        is_recv = 1;
+        *op_flags |= UCG_BUILTIN_OP_FLAG_RING;
+        break;
+
     case UCG_PLAN_METHOD_PAIRWISE:
     case UCG_PLAN_METHOD_ALLGATHER_BRUCK:
     case UCG_PLAN_METHOD_ALLGATHER_RECURSIVE:
-    case UCG_PLAN_METHOD_REDUCE_SCATTER_RING:
-    case UCG_PLAN_METHOD_ALLGATHER_RING:
         return UCS_ERR_UNSUPPORTED;
     }
 
@@ -571,12 +1351,17 @@ zcopy_redo:
             // TODO: set UCG_GROUP_COLLECTIVE_MODIFIER_AGGREGATE_STABLE instead
         }
 
-        if (ucg_global_params.reduce_op.is_loc_expected_f(UCG_PARAM_OP(params))) {
-            ucs_error("Cannot perform reductions: MPI's MINLOC/MAXLOC unsupported");
+        if (ucg_global_params.reduce_op.is_loc_expected_f(UCG_PARAM_OP(params)) &&
+            !ucg_builtin_reduce_loc_is_native(params->recv.dtype,
+                                              UCG_PARAM_OP(params))) {
+            ucs_error("Cannot perform reductions: MPI's MINLOC/MAXLOC unsupported "
+                      "for this datatype");
             return UCS_ERR_UNSUPPORTED;
         }
 
-        *op_flags |= UCG_BUILTIN_OP_FLAG_REDUCE;
+        if (!is_ring) {
+            *op_flags |= UCG_BUILTIN_OP_FLAG_REDUCE;
+        }
     }
 
     if (is_recv && !is_recv_dt_contig) {
@@ -584,10 +1369,17 @@ zcopy_redo:
     }
 
     if (is_send) {
+        if (is_packed_once) {
+            step->pack_source = step->send_buffer;
+            step->send_buffer = (uint8_t*)UCS_ALLOC_CHECK(step->buffer_length,
+                                                          "ucg_builtin_pack_once");
+        }
+
         /* packer callback selection */
         if (send_flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) {
             status = ucg_builtin_step_select_packers(params, send_dt_len,
-                                                     is_send_dt_contig, step);
+                                                     is_send_dt_contig ||
+                                                     is_packed_once, step);
             if (ucs_unlikely(status != UCS_OK)) {
                 return status;
             }
@@ -631,11 +1423,12 @@ zcopy_redo:
     if (is_reduction) {
         /* Select the right reduction callback */
         if (is_send) {
-            ucs_assert(phase->method == UCG_PLAN_METHOD_REDUCE_WAYPOINT);
+            ucs_assert((phase->method == UCG_PLAN_METHOD_REDUCE_WAYPOINT) ||
+                       (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING));
             status = ucg_builtin_step_select_reducers(params->send.dtype,
                                                       UCG_PARAM_OP(params),
-                                                      send_dt_len,
                                                       is_send_dt_contig,
+                                                      send_dt_len,
                                                       params->send.count,
                                                       plan->config,
                                                       selected_reduce_full_f,
@@ -643,8 +1436,8 @@ zcopy_redo:
         } else {
             status = ucg_builtin_step_select_reducers(params->recv.dtype,
                                                       UCG_PARAM_OP(params),
-                                                      recv_dt_len,
                                                       is_recv_dt_contig,
+                                                      recv_dt_len,
                                                       params->recv.count,
                                                       plan->config,
                                                       selected_reduce_full_f,
@@ -663,12 +1456,51 @@ zcopy_redo:
         /* TODO: remove this restriction */
 #endif
         /* Assume my peers have a higher rank/index for offset calculation */
-        step->am_header.remote_offset = plan->super.my_index * step->buffer_length;
+        uint64_t offset = (uint64_t)plan->super.my_index * step->buffer_length;
+        if (ucs_unlikely((offset >> 32) && !is_ext)) {
+            ucs_error("gather offset exceeds the compact header, set "
+                      "BUILTIN_HEADER_EXT=on");
+            return UCS_ERR_EXCEEDS_LIMIT;
+        }
+
+        step->am_header.remote_offset        = (uint32_t)offset;
+        step->am_header_ext.remote_offset_hi = (uint32_t)(offset >> 32);
     }
 
     /* memory registration (using the memory registration cache) */
     int is_zcopy = (send_flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY);
+
+    /*
+     * Zero-copy sends gather the blocks of a vector themselves, be it from the
+     * application's send buffer - or its receive buffer, once the data has
+     * been received there (unpacked). Temporary buffers hold packed data.
+     */
+    step->zcopy.vector.blocklen = 0;
+    if (is_zcopy && (dt_vector.blocklen != 0)) {
+        if ((void*)step->send_buffer == params->send.buffer) {
+            step->zcopy.vector = dt_vector;
+        } else if (((void*)step->send_buffer == params->recv.buffer) &&
+                   !is_recv_dt_contig &&
+                   ucg_builtin_dt_get_vector(params->recv.dtype,
+                                             params->recv.count, recv_dt_len,
+                                             &step->zcopy.vector) &&
+                   !ucg_builtin_dt_vector_fits(&step->zcopy.vector,
+                                               is_fragmented ?
+                                               step->fragment_length :
+                                               step->buffer_length,
+                                               phase->iface_attr->cap.am.max_iov)) {
+            /* Same datatype signature, but more blocks per message */
+            ucs_error("step #%u: receive datatype has too many blocks to be "
+                      "sent from", phase->step_index);
+            return UCS_ERR_UNSUPPORTED;
+        }
+    }
+
     if (is_zcopy) {
+        if (is_send && is_fragmented) {
+            ucg_builtin_step_rails_create(plan, step);
+        }
+
         status = ucg_builtin_step_zcopy_prep(step, params);
         if (ucs_unlikely(status != UCS_OK)) {
             return status;
@@ -680,7 +1512,8 @@ zcopy_redo:
         step->flags |= UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP;
     }
 
-    if (is_barrier || !(step->flags & UCG_BUILTIN_STEP_RECV_FLAGS)) {
+    if (is_barrier || is_offered ||
+        !(step->flags & UCG_BUILTIN_STEP_RECV_FLAGS)) {
         step->comp_aggregation = UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_NOP;
     } else if ((send_flags & UCT_IFACE_FLAG_AM_ZCOPY) && (zcopy_step_skip)) {
         step->comp_aggregation = UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_REMOTE_KEY;
@@ -698,6 +1531,8 @@ zcopy_redo:
             step->comp_aggregation = UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_REDUCE;
         }
         ucs_assert(params->recv.count > 0);
+    } else if (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING) {
+        step->comp_aggregation = UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_REDUCE;
     } else {
         step->comp_aggregation = UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE;
     }
@@ -718,16 +1553,46 @@ zcopy_redo:
             step->comp_criteria =
                     UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SINGLE_MESSAGE;
         }
+    } else if (is_pipelined) {
+        step->comp_criteria =
+                UCG_BUILTIN_OP_STEP_COMP_CRITERIA_BY_FRAGMENT_OFFSET;
     } else {
         step->comp_criteria = is_zcopy ?
                 UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_ZCOPY :
                 UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES;
     }
 
+    /* The next ring step sends what this one receives - as it arrives */
+    if (is_ring && is_fragmented && !is_zcopy && !is_last) {
+        step->comp_criteria =
+                UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_FORWARD;
+    }
+
     if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND) == 0) {
         step->comp_criteria = UCG_BUILTIN_OP_STEP_COMP_CRITERIA_SEND;
     }
 
+    /*
+     * Fan-in flow-control: only for fragments sent one by one, so that both
+     * ends count the same ones (see @ref ucg_builtin_set_phase_credits ).
+     */
+    if (is_fragmented && !is_zcopy && !is_pipelined) {
+        if (is_send && phase->send_thresh.credits) {
+            step->credits       = phase->send_thresh.credits;
+            step->credit_window = phase->send_thresh.credits;
+        }
+
+        if (phase->recv_thresh.credits && (step->comp_criteria ==
+             UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES)) {
+            unsigned senders    = phase->ep_cnt - ((step->flags &
+                                  UCG_BUILTIN_OP_STEP_FLAG_RECV_BEFORE_SEND1) != 0);
+            step->credit_batch  = phase->recv_thresh.credits * senders;
+            step->credit_total  = (step->fragments_total / phase->ep_cnt) * senders;
+            step->comp_criteria =
+                    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_CREDITED;
+        }
+    }
+
     /* Choose the completion action to be taken by the incoming AM handler */
     step->comp_action = is_last ? UCG_BUILTIN_OP_STEP_COMP_OP :
                                   UCG_BUILTIN_OP_STEP_COMP_STEP;
@@ -739,6 +1604,10 @@ zcopy_redo:
     }
 
     *flags = step->flags; // TODO: handle case with UCT_COLL_TYPE_PACK/UNPACK
+    if (is_offered) {
+        /* The reports received carry no data for the next step to use */
+        *flags &= ~UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND;
+    }
     return UCS_OK;
 }
 
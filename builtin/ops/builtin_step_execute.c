@@ -4,6 +4,7 @@
  */
 
 #include <string.h>
+#include <sys/mman.h>
 #include <ucs/arch/atomic.h>
 #include <ucs/profile/profile.h>
 
@@ -80,6 +81,26 @@ ucg_builtin_step_am_short_rkey(ucg_builtin_request_t *req,
                                             buffer, length);
 }
 
+/*
+ * A step sending up a fan-in tree may only send so many fragments before its
+ * parent grants it more (see @ref ucg_builtin_step_grant_credits ). Running out
+ * of those is handled just like running out of transport resources, except the
+ * grant itself resends the request (see @ref ucg_builtin_req_resend ).
+ */
+static UCS_F_ALWAYS_INLINE int
+ucg_builtin_step_has_credit(const ucg_builtin_op_step_t *step)
+{
+    return step->credits != 0; /* always true for UCG_BUILTIN_CREDITS_OFF */
+}
+
+static UCS_F_ALWAYS_INLINE void
+ucg_builtin_step_use_credit(ucg_builtin_op_step_t *step, int is_sent)
+{
+    if (ucs_unlikely(step->credits != UCG_BUILTIN_CREDITS_OFF) && is_sent) {
+        step->credits--;
+    }
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucg_builtin_step_am_short_max(ucg_builtin_request_t *req,
                               ucg_builtin_op_step_t *step,
@@ -96,8 +117,7 @@ ucg_builtin_step_am_short_max(ucg_builtin_request_t *req,
                                     (UCT_COLL_DTYPE_MODE_BITS * is_packed));
     uint8_t *sbuf                = step->send_buffer;
     uint8_t *buffer_iter         = sbuf + step->iter_offset;
-    size_t buffer_length         = frag_size * step->fragments_total;
-    uint8_t *buffer_iter_limit   = sbuf + buffer_length - frag_size;
+    uint8_t *buffer_iter_limit   = sbuf + step->buffer_length - frag_size;
     am_iter.remote_offset        = (is_pipelined) ? step->iter_offset :
                                    am_iter.remote_offset + step->iter_offset;
 
@@ -114,12 +134,15 @@ ucg_builtin_step_am_short_max(ucg_builtin_request_t *req,
     uct_ep_am_short_func_t ep_am_short = step->uct_send;
     if (ucs_likely(buffer_iter < buffer_iter_limit)) {
         do {
-            status = ep_am_short(ep, am_id, am_iter.header, buffer_iter, frag_size);
+            status = ucs_likely(ucg_builtin_step_has_credit(step)) ?
+                     ep_am_short(ep, am_id, am_iter.header, buffer_iter,
+                                 frag_size) : UCS_ERR_NO_RESOURCE;
 
             if (is_pipelined) {
                 return status;
             }
 
+            ucg_builtin_step_use_credit(step, status == UCS_OK);
             buffer_iter           += frag_size;
             am_iter.remote_offset += frag_size;
         } while ((status == UCS_OK) && (buffer_iter < buffer_iter_limit));
@@ -135,9 +158,14 @@ ucg_builtin_step_am_short_max(ucg_builtin_request_t *req,
         }
     }
 
-    status = ep_am_short(ep, am_id, am_iter.header, buffer_iter,
-                         sbuf + step->buffer_length - buffer_iter);
-    step->iter_offset = (status == UCS_OK) ? 0 : buffer_iter - sbuf;
+    status = ucs_likely(ucg_builtin_step_has_credit(step)) ?
+             ep_am_short(ep, am_id, am_iter.header, buffer_iter,
+                         sbuf + step->buffer_length - buffer_iter) :
+             UCS_ERR_NO_RESOURCE;
+    ucg_builtin_step_use_credit(step, status == UCS_OK);
+    if (!is_pipelined) {
+        step->iter_offset = (status == UCS_OK) ? 0 : buffer_iter - sbuf;
+    }
     return status;
 }
 
@@ -200,12 +228,15 @@ ucg_builtin_step_am_bcopy_max(ucg_builtin_request_t *req,
     if (ucs_likely(step->iter_offset < iter_limit)) {
         /* send every fragment but the last */
         do {
-            len = send_func(ep, am_id, step->bcopy.pack_full_cb, req, uct_flags);
+            len = ucs_likely(ucg_builtin_step_has_credit(step)) ?
+                  send_func(ep, am_id, step->bcopy.pack_full_cb, req,
+                            uct_flags) : UCS_ERR_NO_RESOURCE;
 
             if (is_pipelined) {
                 return ucs_unlikely(len < 0) ? (ucs_status_t)len : UCS_OK;
             }
 
+            ucg_builtin_step_use_credit(step, len >= 0);
             step->am_header.remote_offset += frag_size;
             step->iter_offset             += frag_size;
         } while ((len >= 0) && (step->iter_offset < iter_limit));
@@ -223,11 +254,15 @@ ucg_builtin_step_am_bcopy_max(ucg_builtin_request_t *req,
     }
 
     /* Send last fragment of the message */
-    len = send_func(ep, am_id, step->bcopy.pack_part_cb, req, uct_flags);
+    len = ucs_likely(ucg_builtin_step_has_credit(step)) ?
+          send_func(ep, am_id, step->bcopy.pack_part_cb, req, uct_flags) :
+          UCS_ERR_NO_RESOURCE;
     if (ucs_unlikely(len < 0)) {
         return (ucs_status_t)len;
     }
 
+    ucg_builtin_step_use_credit(step, 1);
+
     /* iter_offset can not set to be zero for pipelining */
     if (!is_pipelined) {
         step->am_header.remote_offset = step->iter_offset = 0;
@@ -247,14 +282,24 @@ ucg_builtin_step_zcopy_common(ucg_builtin_request_t *req,
     uct_ep_am_zcopy_func_t ep_am_zcopy;
     uct_ep_put_zcopy_func_t ep_put_zcopy;
     uct_ep_get_zcopy_func_t ep_get_zcopy;
+    uint64_t am_header[2];
+    size_t iovcnt = 1;
 
-    uct_iov_t iov = {
+    uct_iov_t iov[UCG_BUILTIN_DT_VECTOR_MAX_IOV] = {{
             .buffer = buffer,
             .length = length,
             .memh   = step->zcopy.memh,
             .stride = 0,
             .count  = 1
-    };
+    }};
+
+    if (ucs_unlikely(step->zcopy.vector.blocklen != 0)) {
+        ucs_assert(type != UCG_BUILTIN_OP_STEP_FLAG_SEND_GET_ZCOPY);
+        iovcnt = ucg_builtin_dt_vector_iov(&step->zcopy.vector,
+                                           step->send_buffer,
+                                           buffer - step->send_buffer, length,
+                                           step->zcopy.memh, iov);
+    }
 
     ucg_builtin_zcomp_t *zcomp = &step->zcopy.zcomp;
     zcomp->req = req;
@@ -262,20 +307,22 @@ ucg_builtin_step_zcopy_common(ucg_builtin_request_t *req,
     ucs_status_t status;
     switch (type) {
     case UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY:
-        ep_am_zcopy = step->uct_send;
-        status = ep_am_zcopy(ep, am_id, &header, sizeof(header),
-                             &iov, 1, 0, &zcomp->comp);
+        ep_am_zcopy  = step->uct_send;
+        am_header[0] = header.header;
+        am_header[1] = ucg_builtin_step_header_ext(req, step);
+        status = ep_am_zcopy(ep, am_id, am_header, ucg_builtin_header_length(req),
+                             iov, iovcnt, 0, &zcomp->comp);
         break;
 
     case UCG_BUILTIN_OP_STEP_FLAG_SEND_PUT_ZCOPY:
         ep_put_zcopy = step->uct_send;
-        status = ep_put_zcopy(ep, &iov, 1, step->zcopy.raddr,
+        status = ep_put_zcopy(ep, iov, iovcnt, step->zcopy.raddr,
                               step->zcopy.rkey.rkey, &zcomp->comp);
         break;
 
     case UCG_BUILTIN_OP_STEP_FLAG_SEND_GET_ZCOPY:
         ep_get_zcopy = step->uct_send;
-        status = ep_get_zcopy(ep, &iov, 1, step->zcopy.raddr,
+        status = ep_get_zcopy(ep, iov, iovcnt, step->zcopy.raddr,
                               step->zcopy.rkey.rkey, &zcomp->comp);
         break;
 
@@ -286,6 +333,200 @@ ucg_builtin_step_zcopy_common(ucg_builtin_request_t *req,
     return ucs_unlikely(status != UCS_INPROGRESS) ? status : UCS_OK;
 }
 
+/* The key is kept unpacked for as long as the peer sends the same one */
+static ucs_status_t ucg_builtin_step_rma_take_rkey(ucg_builtin_step_rma_t *rma,
+                                                   const uint8_t *packed)
+{
+    ucs_status_t status;
+    uint8_t *peer_packed = rma->rkeys + rma->rkey_size;
+
+    if (rma->has_peer_rkey && !memcmp(peer_packed, packed, rma->rkey_size)) {
+        return UCS_OK;
+    }
+
+    if (rma->has_peer_rkey) {
+        uct_rkey_release(rma->cmpt, &rma->peer_rkey);
+        rma->has_peer_rkey = 0;
+    }
+
+    status = uct_rkey_unpack(rma->cmpt, packed, &rma->peer_rkey);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    memcpy(peer_packed, packed, rma->rkey_size);
+    rma->has_peer_rkey = 1;
+    return UCS_OK;
+}
+
+/*
+ * Take the peer's advertised receive buffer (see ucg_builtin_step_rma_advertise),
+ * replacing any it advertised before - or none, if it sent neither an address
+ * nor a key, so it is no longer written into.
+ */
+void ucg_builtin_step_rma_accept(ucg_builtin_op_step_t *step,
+                                 const uint8_t *info, size_t length)
+{
+    uint64_t peer_addr;
+    ucg_builtin_step_rma_t *rma = step->rma;
+
+    if (!rma->can_put) {
+        return;
+    }
+
+    if (length != sizeof(peer_addr) + rma->rkey_size) {
+        if (rma->has_peer_rkey) {
+            uct_rkey_release(rma->cmpt, &rma->peer_rkey);
+            rma->has_peer_rkey = 0;
+        }
+        return;
+    }
+
+    memcpy(&peer_addr, info, sizeof(peer_addr));
+    info += sizeof(peer_addr);
+
+    if (ucg_builtin_step_rma_take_rkey(rma, info) == UCS_OK) {
+        rma->peer_addr = peer_addr;
+    }
+}
+
+/*
+ * The peer's receive buffer may only be written once the peer has started this
+ * step of this collective - which is known from its own data for this step
+ * having arrived, either stored (along with any advert of a new buffer, which
+ * always precedes it) or already written in place (see
+ * @ref ucg_builtin_step_place_early ). Otherwise the data is sent as usual.
+ */
+static UCS_F_NOINLINE int
+ucg_builtin_step_rma_is_ready(ucg_builtin_request_t *req,
+                              ucg_builtin_op_step_t *step,
+                              ucg_builtin_header_t header)
+{
+    khiter_t iter;
+    uint32_t msg_key;
+    int has_peer_data;
+    ucp_recv_desc_t *rdesc;
+    ucs_queue_iter_t qiter;
+    ucs_queue_head_t *queue;
+    ucg_builtin_header_t *stored;
+    ucg_builtin_header_step_t msg_hi;
+    ucg_builtin_comp_slot_t *slot = ucs_container_of(req, ucg_builtin_comp_slot_t,
+                                                     req);
+    ucg_builtin_step_rma_t *rma   = step->rma;
+    int is_ext                    = req->flags &
+                                    UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT;
+    size_t header_length          = ucg_builtin_header_length(req);
+
+    msg_hi.coll_id  = req->expecting_hi.coll_id;
+    msg_hi.step_idx = step->am_header_ext.msg_hi.step_idx;
+    msg_key         = UCG_BUILTIN_MSG_KEY(header.msg.local_id,
+                                          is_ext ? msg_hi.local_id : 0);
+    if (rma->ready_key == msg_key) {
+        return 1; /* resending, after the put has already been sent */
+    }
+
+    has_peer_data = (step->early_arrivals != 0);
+
+    iter = kh_get(ucg_builtin_msg, &slot->messages, msg_key);
+    if (iter != kh_end(&slot->messages)) {
+        queue = &kh_val(&slot->messages, iter);
+        ucs_queue_for_each_safe(rdesc, qiter, queue, tag_frag_queue) {
+            stored = (ucg_builtin_header_t*)(rdesc + 1);
+            if (!ucg_builtin_header_is_rma_ready(stored->remote_offset, is_ext,
+                    !is_ext ? 0 :
+                    ((ucg_builtin_header_ext_t*)(stored + 1))->remote_offset_hi)) {
+                has_peer_data = 1;
+                continue;
+            }
+
+            ucs_queue_del_iter(queue, qiter);
+            ucg_builtin_step_rma_accept(step,
+                    (uint8_t*)UCS_PTR_BYTE_OFFSET(stored, header_length),
+                    rdesc->length - header_length);
+            ucg_builtin_release_comp_desc(UCG_BUILTIN_OP_GET_WINDOW(req->op->gctx),
+                                          rdesc, step->uct_iface);
+        }
+
+        if (ucs_queue_is_empty(queue)) {
+            kh_del(ucg_builtin_msg, &slot->messages, iter);
+        }
+    }
+
+    if (!has_peer_data || !rma->can_put || !rma->has_peer_rkey) {
+        return 0;
+    }
+
+    rma->ready_key = msg_key;
+    return 1;
+}
+
+/*
+ * Write the data directly into the peer's receive buffer, followed by an empty
+ * message (with the same header) to let the peer know it's there. If only the
+ * latter fails to be sent - the resend only repeats that part.
+ */
+static UCS_F_NOINLINE ucs_status_t
+ucg_builtin_step_rma_put(ucg_builtin_request_t *req,
+                         ucg_builtin_op_step_t *step,
+                         uct_ep_h ep, uint8_t am_id,
+                         ucg_builtin_header_t header,
+                         uint8_t *buffer, size_t length)
+{
+    uint64_t remote_offset;
+    ucs_status_t status;
+    uint64_t header_ext;
+    size_t iovcnt               = 1;
+    ucg_builtin_step_rma_t *rma = step->rma;
+
+    uct_iov_t iov[UCG_BUILTIN_DT_VECTOR_MAX_IOV] = {{
+            .buffer = buffer,
+            .length = length,
+            .memh   = step->zcopy.memh,
+            .stride = 0,
+            .count  = 1
+    }};
+
+    if (step->zcopy.vector.blocklen != 0) {
+        iovcnt = ucg_builtin_dt_vector_iov(&step->zcopy.vector,
+                                           step->send_buffer,
+                                           buffer - step->send_buffer, length,
+                                           step->zcopy.memh, iov);
+    }
+
+    header_ext    = ucg_builtin_step_header_ext(req, step);
+    remote_offset = header.remote_offset;
+    if (req->flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT) {
+        remote_offset |= (uint64_t)step->am_header_ext.remote_offset_hi << 32;
+    }
+
+    if (!rma->is_put_done) {
+        step->zcopy.zcomp.req = req;
+        status = uct_ep_put_zcopy(ep, iov, iovcnt, rma->peer_addr + remote_offset,
+                                  rma->peer_rkey.rkey, &step->zcopy.zcomp.comp);
+        if (UCS_STATUS_IS_ERR(status)) {
+            return status;
+        }
+
+        rma->is_put_done = 1;
+    }
+
+    /* The notification must not overtake the data it refers to */
+    status = uct_ep_fence(ep, 0);
+    if (ucs_likely(status == UCS_OK)) {
+        status = uct_ep_am_short(ep, am_id, header.header, &header_ext,
+                                 ucg_builtin_header_length(req) -
+                                 sizeof(header));
+    }
+
+    if (ucs_unlikely(status == UCS_ERR_NO_RESOURCE)) {
+        return status;
+    }
+
+    rma->is_put_done = 0;
+    rma->ready_key   = 0; /* the next collective needs the peer's data again */
+    return status;
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucg_builtin_step_am_zcopy_one(ucg_builtin_request_t *req,
                               ucg_builtin_op_step_t *step,
@@ -299,6 +540,12 @@ ucg_builtin_step_am_zcopy_one(ucg_builtin_request_t *req,
 
     UCG_BUILTIN_ASSERT_SEND(step, AM_ZCOPY);
 
+    if (ucs_unlikely(step->rma != NULL) &&
+        ucg_builtin_step_rma_is_ready(req, step, header)) {
+        return ucg_builtin_step_rma_put(req, step, ep, am_id, header, buffer,
+                                        length);
+    }
+
     return ucg_builtin_step_zcopy_common(req, step, ep, am_id, header, buffer, length,
                                          UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY);
 }
@@ -356,6 +603,147 @@ ucg_builtin_step_get_zcopy_one(ucg_builtin_request_t *req,
                                          UCG_BUILTIN_OP_STEP_FLAG_SEND_GET_ZCOPY);
 }
 
+/*
+ * Send the fragments over several lanes to this peer, each fragment over the
+ * lane picked by its index (see @ref ucg_builtin_step_rails_t ). The receiver
+ * places each fragment by its offset, regardless of the lane it came through.
+ */
+static UCS_F_NOINLINE ucs_status_t
+ucg_builtin_step_am_zcopy_striped(ucg_builtin_request_t *req,
+                                  ucg_builtin_op_step_t *step,
+                                  uct_ep_h ep, uint8_t am_id,
+                                  ucg_builtin_header_t header,
+                                  int is_pipelined)
+{
+    unsigned lane;
+    uct_ep_h lane_ep;
+    uct_ep_h *lane_eps;
+    ucs_status_t status;
+    ucg_builtin_step_rails_t *rails    = step->rails;
+    ucg_builtin_plan_phase_t *phase    = step->phase;
+    ucg_offset_t frag_size             = step->fragment_length;
+    uint8_t *sbuf                      = step->send_buffer;
+    uint8_t *sbuf_end                  = sbuf + step->buffer_length;
+    ucg_builtin_zcomp_t *zcomp         = &step->zcopy.zcomp;
+    size_t header_length               = ucg_builtin_header_length(req);
+    uint64_t am_header[2]              = {0, ucg_builtin_step_header_ext(req, step)};
+    uct_ep_am_zcopy_func_t ep_am_zcopy = step->uct_send;
+    step->am_header.remote_offset      = (is_pipelined) ? step->iter_offset :
+                                         step->am_header.remote_offset;
+
+    uct_iov_t iov = {
+            .buffer = sbuf + step->iter_offset,
+            .stride = 0,
+            .count  = 1
+    };
+
+    UCG_BUILTIN_ASSERT_SEND(step, AM_ZCOPY);
+    ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_READY);
+    ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_PENDING);
+
+    /* Find the other lanes to the same peer */
+    lane_eps = rails->eps;
+    if (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT)) {
+        for (lane = 0; phase->multi_eps[lane] != ep; lane++) {
+            ucs_assert(lane < phase->ep_cnt);
+        }
+        lane_eps += lane * (rails->cnt - 1);
+    }
+
+    zcomp->req = req;
+    do {
+        lane         = rails->schedule[(((uint8_t*)iov.buffer - sbuf) /
+                                        frag_size) % UCG_BUILTIN_RAIL_SCHEDULE];
+        iov.length   = ucs_min(frag_size, sbuf_end - (uint8_t*)iov.buffer);
+        am_header[0] = header.header;
+        if (lane == 0) {
+            iov.memh = step->zcopy.memh;
+            status   = ep_am_zcopy(ep, am_id, am_header, header_length,
+                                   &iov, 1, 0, &zcomp->comp);
+        } else {
+            lane_ep  = lane_eps[lane - 1];
+            iov.memh = rails->memh[lane];
+            status   = uct_ep_am_zcopy(lane_ep, am_id, am_header,
+                                       header_length, &iov, 1, 0, &zcomp->comp);
+        }
+
+        if (ucs_unlikely(status != UCS_INPROGRESS)) {
+            /* assuming UCS_ERR_NO_RESOURCE, restore the state for re-entry */
+            step->iter_offset = (uint8_t*)iov.buffer - sbuf;
+            step->am_header   = header;
+            return status;
+        }
+
+        header.remote_offset += iov.length;
+        iov.buffer            = (uint8_t*)iov.buffer + iov.length;
+    } while (!is_pipelined && ((uint8_t*)iov.buffer < sbuf_end));
+
+    if (!is_pipelined) {
+        step->am_header.remote_offset = 0;
+    }
+
+    return UCS_OK;
+}
+
+/*
+ * Send the fragments of a vector datatype (see @ref ucg_builtin_dt_vector_t ),
+ * each gathered from the blocks holding its part of the packed data. The
+ * fragments are the same as for contiguous data, so the receiver can't tell.
+ */
+static UCS_F_NOINLINE ucs_status_t
+ucg_builtin_step_am_zcopy_vector(ucg_builtin_request_t *req,
+                                 ucg_builtin_op_step_t *step,
+                                 uct_ep_h ep, uint8_t am_id,
+                                 ucg_builtin_header_t header,
+                                 int is_pipelined)
+{
+    size_t length;
+    unsigned iovcnt;
+    ucs_status_t status;
+    uct_iov_t iov[UCG_BUILTIN_DT_VECTOR_MAX_IOV];
+    ucg_offset_t frag_size             = step->fragment_length;
+    size_t offset                      = step->iter_offset;
+    ucg_builtin_zcomp_t *zcomp         = &step->zcopy.zcomp;
+    size_t header_length               = ucg_builtin_header_length(req);
+    uint64_t am_header[2]              = {0, ucg_builtin_step_header_ext(req, step)};
+    uct_ep_am_zcopy_func_t ep_am_zcopy = step->uct_send;
+
+    UCG_BUILTIN_ASSERT_SEND(step, AM_ZCOPY);
+    ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_READY);
+    ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_PENDING);
+
+    if (is_pipelined) {
+        header.remote_offset = step->iter_offset;
+    }
+
+    zcomp->req = req;
+    do {
+        length       = ucs_min(frag_size, step->buffer_length - offset);
+        iovcnt       = ucg_builtin_dt_vector_iov(&step->zcopy.vector,
+                                                 step->send_buffer, offset,
+                                                 length, step->zcopy.memh, iov);
+        am_header[0] = header.header;
+        status       = ep_am_zcopy(ep, am_id, am_header, header_length, iov,
+                                   iovcnt, 0, &zcomp->comp);
+        if (ucs_unlikely(status != UCS_INPROGRESS)) {
+            /* assuming UCS_ERR_NO_RESOURCE, restore the state for re-entry */
+            step->iter_offset = offset;
+            step->am_header   = header;
+            return status;
+        }
+
+        header.remote_offset += length;
+        offset               += length;
+    } while (!is_pipelined && (offset < step->buffer_length));
+
+    if (!is_pipelined) {
+        step->am_header.remote_offset = 0;
+        step->iter_offset             = 0;
+    }
+
+    return UCS_OK;
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
                               ucg_builtin_op_step_t *step,
@@ -368,6 +756,8 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
     uint8_t *sbuf                 = step->send_buffer;
     void* iov_buffer_limit        = sbuf + step->buffer_length - frag_size;
     ucg_builtin_zcomp_t *zcomp    = &step->zcopy.zcomp;
+    size_t header_length          = ucg_builtin_header_length(req);
+    uint64_t am_header[2]         = {0, ucg_builtin_step_header_ext(req, step)};
     step->am_header.remote_offset = (is_pipelined) ? step->iter_offset :
                                     step->am_header.remote_offset;
 
@@ -379,6 +769,16 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
             .count  = 1
     };
 
+    if (ucs_unlikely(step->rails != NULL)) {
+        return ucg_builtin_step_am_zcopy_striped(req, step, ep, am_id, header,
+                                                 is_pipelined);
+    }
+
+    if (ucs_unlikely(step->zcopy.vector.blocklen != 0)) {
+        return ucg_builtin_step_am_zcopy_vector(req, step, ep, am_id, header,
+                                                is_pipelined);
+    }
+
     UCG_BUILTIN_ASSERT_SEND(step, AM_ZCOPY);
     ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_READY);
     ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_PENDING);
@@ -388,7 +788,8 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
     if (ucs_likely(iov.buffer < iov_buffer_limit)) {
         /* send every fragment but the last */
         do {
-            status = ep_am_zcopy(ep, am_id, &header, sizeof(header),
+            am_header[0] = header.header;
+            status = ep_am_zcopy(ep, am_id, am_header, header_length,
                                  &iov, 1, 0, &zcomp->comp);
             (zcomp++)->req = req;
 
@@ -408,10 +809,11 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
     }
 
     /* Send last fragment of the message */
-    zcomp->req = req;
-    iov.length = sbuf + step->buffer_length - (uint8_t*)iov.buffer;
-    status     = ep_am_zcopy(ep, am_id, &header, sizeof(header),
-                             &iov, 1, 0, &zcomp->comp);
+    zcomp->req   = req;
+    iov.length   = sbuf + step->buffer_length - (uint8_t*)iov.buffer;
+    am_header[0] = header.header;
+    status       = ep_am_zcopy(ep, am_id, am_header, header_length,
+                               &iov, 1, 0, &zcomp->comp);
     if (ucs_unlikely(status != UCS_INPROGRESS)) {
         step->iter_offset = (uint8_t*)iov.buffer - sbuf;
         step->am_header = header;
@@ -427,6 +829,82 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
  * step->flags in the switch-case inside @ref ucg_builtin_step_execute() .
  */
 
+/*
+ * A step sending the same data to several peers, in a datatype which is not
+ * contiguous, packs it only once - into a buffer of its own - before sending to
+ * the first of them. From there it is sent to each peer like contiguous data
+ * would be, be it buffer-copied or zero-copied, rather than packed per peer.
+ */
+static UCS_F_NOINLINE void
+ucg_builtin_step_pack_once(ucg_builtin_request_t *req,
+                           ucg_builtin_op_step_t *step)
+{
+    ucg_builtin_op_t *op     = req->op;
+    ucp_dt_generic_t *dt_gen = ucp_dt_to_generic(op->send_dt);
+    void *dt_state           = dt_gen->ops.start_pack(dt_gen->context,
+                                                      step->pack_source,
+                                                      op->super.params.send.count);
+
+    dt_gen->ops.pack(dt_state, 0, step->send_buffer, step->buffer_length);
+    dt_gen->ops.finish(dt_state);
+}
+
+/*
+ * Take the grants for more fragments sent by the parent of this step (see
+ * @ref ucg_builtin_step_grant_credits ), which arrived before this step has
+ * started waiting for them - so they were stored like any early message.
+ * Returns whether any were found.
+ */
+static UCS_F_NOINLINE int
+ucg_builtin_step_take_grants(ucg_builtin_request_t *req,
+                             ucg_builtin_op_step_t *step,
+                             ucg_builtin_header_t header)
+{
+    int is_granted;
+    khiter_t iter;
+    uint32_t msg_key;
+    ucp_recv_desc_t *rdesc;
+    ucs_queue_iter_t qiter;
+    ucs_queue_head_t *queue;
+    ucg_builtin_header_t *stored;
+    ucg_builtin_header_step_t msg_hi;
+    ucg_builtin_comp_slot_t *slot = ucs_container_of(req, ucg_builtin_comp_slot_t,
+                                                     req);
+    int is_ext                    = req->flags &
+                                    UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT;
+
+    msg_hi.coll_id  = req->expecting_hi.coll_id;
+    msg_hi.step_idx = step->am_header_ext.msg_hi.step_idx;
+    msg_key         = UCG_BUILTIN_MSG_KEY(header.msg.local_id,
+                                          is_ext ? msg_hi.local_id : 0);
+
+    iter = kh_get(ucg_builtin_msg, &slot->messages, msg_key);
+    if (iter == kh_end(&slot->messages)) {
+        return 0;
+    }
+
+    is_granted = 0;
+    queue      = &kh_val(&slot->messages, iter);
+    ucs_queue_for_each_safe(rdesc, qiter, queue, tag_frag_queue) {
+        stored = (ucg_builtin_header_t*)(rdesc + 1);
+        if (ucg_builtin_header_is_credit_grant(stored->remote_offset, is_ext,
+                !is_ext ? 0 :
+                ((ucg_builtin_header_ext_t*)(stored + 1))->remote_offset_hi)) {
+            ucs_queue_del_iter(queue, qiter);
+            ucg_builtin_release_comp_desc(UCG_BUILTIN_OP_GET_WINDOW(req->op->gctx),
+                                          rdesc, step->uct_iface);
+            step->credits += step->credit_window;
+            is_granted     = 1;
+        }
+    }
+
+    if (ucs_queue_is_empty(queue)) {
+        kh_del(ucg_builtin_msg, &slot->messages, iter);
+    }
+
+    return is_granted;
+}
+
 #define case_send_full(req, step, phase, _is_last, _is_1ep, _fixed_stride,\
                        _var_stride, _is_pipelined, _is_recv, _is_rs1, _is_r1s, \
                        _send_flag, _send_func)                                 \
@@ -450,11 +928,11 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
             uint32_t new_cnt = step->iter_ep = _is_r1s ? 1 : phase->ep_cnt - 1;\
             if (_is_pipelined) {                                               \
                 memset((void*)step->fragment_pending, new_cnt, frags_per_ep);  \
-            }                                                                  \
-            if (!is_zcopy) {                                                   \
-                if (!_is_pipelined) {                                          \
-                    frags_per_ep = step->fragments_total / step->ep_cnt;       \
-                }                                                              \
+                step->iter_offset = UCG_BUILTIN_OFFSET_PIPELINE_READY;         \
+                /* Count the fragments left to forward, not to receive */      \
+                req->pending      = frags_per_ep;                              \
+            } else if (!is_zcopy) {                                            \
+                frags_per_ep = step->fragments_total / step->ep_cnt;           \
                 req->pending = new_cnt * frags_per_ep;                         \
             } /* Otherwise default init of ep_cnt*num_fragments is correct */  \
             break; /* Beyond the switch-case we fall-back to receiving */      \
@@ -475,6 +953,7 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
             if (!(_is_pipelined || _var_stride)) {                             \
                 step->iter_offset = 0;                                         \
             }                                                                  \
+            step->credits = step->credit_window; /* for the next time */       \
         } else {                                                               \
             if ((_is_pipelined) && (ucs_unlikely(step->iter_offset ==          \
                                     UCG_BUILTIN_OFFSET_PIPELINE_PENDING))) {   \
@@ -489,6 +968,11 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
                 step->iter_offset = frag_idx * step->fragment_length;          \
             }                                                                  \
                                                                                \
+            if (ucs_unlikely(step->pack_source != NULL) &&                     \
+                (step->iter_offset == 0) && (step->iter_ep == _is_r1s)) {      \
+                ucg_builtin_step_pack_once(req, step);                         \
+            }                                                                  \
+                                                                               \
             ep_iter = ep_last = phase->multi_eps;                              \
             ep_iter += step->iter_ep;                                          \
             ep_last += phase->ep_cnt;                                          \
@@ -513,6 +997,10 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
             } while (++ep_iter < ep_last);                                     \
                                                                                \
             if (_is_pipelined) {                                               \
+                /* This fragment has now been forwarded to every child */      \
+                ucs_assert(req->pending > 0);                                  \
+                req->pending--;                                                \
+                                                                               \
                 /* Reset the iterator for the next pipelined incoming packet */\
                 step->iter_ep = _is_r1s ? 1 : phase->ep_cnt - 1;               \
                 ucs_assert(_is_r1s + _is_rs1 > 0);                             \
@@ -539,6 +1027,7 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
                 step->iter_offset = UCG_BUILTIN_OFFSET_PIPELINE_READY;         \
             } else {                                                           \
                 step->iter_ep = 0; /* Reset the per-step endpoint iterator */  \
+                step->credits = step->credit_window;                           \
                 if (_fixed_stride) {                                           \
                     step->iter_offset = 0;                                     \
                 }                                                              \
@@ -546,8 +1035,13 @@ ucg_builtin_step_am_zcopy_max(ucg_builtin_request_t *req,
         }                                                                      \
                                                                                \
         /* Potential completions (the operation may have finished by now) */   \
-        if ((!_is_recv && !is_zcopy) || (req->pending == 0)) {                 \
+        if ((!_is_recv && !is_zcopy && !_is_pipelined) ||                      \
+            (req->pending == 0)) {                                             \
             /* Nothing else to do - complete this step */                      \
+            if (_is_pipelined) {                                               \
+                step->iter_ep     = 0;                                         \
+                step->iter_offset = 0;                                         \
+            }                                                                  \
             if (_is_last) {                                                    \
                 ucg_builtin_comp_last_step_cb(req, UCS_OK);                    \
                 return UCS_OK;                                                 \
@@ -614,6 +1108,14 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_step_execute, (req, header),
     ucg_builtin_plan_phase_t *phase = step->phase;
     ucg_builtin_comp_slot_t *slot   = ucs_container_of(req, ucg_builtin_comp_slot_t, req);
 
+    /* The peer must have our current receive buffer before our data */
+    if (ucs_unlikely(step->rma != NULL) && !step->rma->is_advertised) {
+        status = ucg_builtin_step_rma_advertise(req, step, header);
+        if (ucs_unlikely(status != UCS_OK)) {
+            goto step_execute_error;
+        }
+    }
+
     /* This step either starts by sending or contains no send operations */
     switch (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SWITCH_MASK) {
     /* Single-send operations (only one fragment passed to UCT) */
@@ -668,6 +1170,21 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_step_execute, (req, header),
     /************************** Error flows ***********************************/
 step_execute_error:
     if (status == UCS_ERR_NO_RESOURCE) {
+        /* Set the collective operation ID */
+        step->am_header.msg.local_id = header.msg.local_id;
+
+        if (ucs_unlikely(step->credits == 0)) {
+            if (ucg_builtin_step_take_grants(req, step, header)) {
+                /* The parent has already granted more - carry on sending */
+                return ucg_builtin_step_execute(req, step->am_header);
+            }
+
+            /* Have the next grant handed to this step (rather than stored),
+             * so it resends as soon as that arrives - see recv_cb() */
+            slot->req.expecting.local_id    = header.msg.local_id;
+            slot->req.expecting_hi.step_idx = step->am_header_ext.msg_hi.step_idx;
+        }
+
         /* Special case: send incomplete - enqueue for resend upon progress */
         if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) {
             step->fragment_pending[step->iter_offset / step->fragment_length] =
@@ -675,11 +1192,10 @@ step_execute_error:
             step->iter_offset = UCG_BUILTIN_OFFSET_PIPELINE_PENDING;
         }
 
-        /* Set the collective operation ID */
-        step->am_header.msg.local_id = header.msg.local_id;
-
-        /* Add this request to the resend-queue */
-        ucg_builtin_req_enqueue_resend(req->op->gctx, req);
+        /* Add this request to the resend-queue (and the endpoint's) */
+        ucg_builtin_req_enqueue_resend(req->op->gctx, req,
+                (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT) ?
+                phase->single_ep : phase->multi_eps[step->iter_ep]);
 
         return UCS_INPROGRESS;
     }
@@ -688,3 +1204,452 @@ step_execute_error:
     ucg_builtin_comp_last_step_cb(req, status);
     return status;
 }
+
+/*
+ * Each step of a ring sends on the chunk received by the step before it, so
+ * rather than waiting for that whole chunk - every fragment is sent as soon as
+ * it has been reduced (or written), while the following ones are still being
+ * received. Only fragments arriving in order are sent ahead, and never the
+ * last one: once the next step starts, it sends whatever is left from
+ * "iter_offset" on (see @ref ucg_builtin_comp_step_cb ). A failed attempt is
+ * not retried - it only means more is left for the next step to send.
+ */
+void ucg_builtin_step_send_ahead(ucg_builtin_request_t *req,
+                                 ucg_offset_t offset)
+{
+    ssize_t len;
+    ucs_status_t status;
+    ucg_builtin_op_step_t *step = req->step;
+    ucg_builtin_op_step_t *next = step + 1;
+    ucg_offset_t frag_size      = next->fragment_length;
+    ucg_builtin_header_t header = next->am_header;
+    uct_ep_h ep                 = next->phase->single_ep;
+
+    ucs_assert(!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+    ucs_assert(next->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED);
+    ucs_assert(next->flags & UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT);
+
+    if ((offset != next->iter_offset) ||
+        (next->iter_offset + frag_size >= next->buffer_length)) {
+        return;
+    }
+
+    header.msg.coll_id = step->am_header.msg.coll_id;
+    if (next->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_SHORT) {
+        /* short sends add "iter_offset" to the offset in the header */
+        header.remote_offset = offset;
+        status = ucg_builtin_step_am_short_common(req, next, ep, req->am_id,
+                                                  header, next->send_buffer +
+                                                  offset, frag_size);
+        if (status == UCS_OK) {
+            next->iter_offset += frag_size;
+        }
+        return;
+    }
+
+    UCG_BUILTIN_ASSERT_SEND(next, AM_BCOPY);
+    ucs_assert(next->am_header.remote_offset == offset);
+
+    unsigned uct_flags;
+    if (ucs_unlikely(next->flags & UCG_BUILTIN_OP_STEP_FLAG_BCOPY_PACK_LOCK)) {
+        uct_flags = UCT_SEND_FLAG_PACK_LOCK;
+    } else {
+        uct_flags = 0;
+    }
+
+    /* the packing callbacks take the step (and its header) from the request */
+    packed_send_t send_func = next->uct_send;
+    next->am_header         = header;
+    req->step               = next;
+    len                     = send_func(ep, req->am_id,
+                                        next->bcopy.pack_full_cb, req,
+                                        uct_flags);
+    req->step               = step;
+
+    if (len >= 0) {
+        next->am_header.remote_offset += frag_size;
+        next->iter_offset             += frag_size;
+    }
+}
+
+/*
+ * An empty message (only a header) the peer waits for, so it must not be
+ * dropped if it cannot be sent right away: it waits on the endpoint instead.
+ */
+typedef struct ucg_builtin_notice {
+    uct_pending_req_t super;
+    uct_ep_h          ep;
+    uint64_t          header[2];
+    uint8_t           am_id;
+    uint8_t           ext_length;
+} ucg_builtin_notice_t;
+
+static ucs_status_t ucg_builtin_notice_resend(uct_pending_req_t *self)
+{
+    ucg_builtin_notice_t *notice = ucs_container_of(self, ucg_builtin_notice_t,
+                                                    super);
+    ucs_status_t status = uct_ep_am_short(notice->ep, notice->am_id,
+                                          notice->header[0], &notice->header[1],
+                                          notice->ext_length);
+    if (status == UCS_ERR_NO_RESOURCE) {
+        return status; /* stay on this endpoint's queue */
+    }
+
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucs_error("failed to notify a collective peer: %s",
+                  ucs_status_string(status));
+    }
+
+    ucs_free(notice);
+    return UCS_OK;
+}
+
+static void ucg_builtin_step_send_notice(uct_ep_h ep, uint8_t am_id,
+                                         const uint64_t *header,
+                                         unsigned ext_length)
+{
+    ucs_status_t status;
+    ucg_builtin_notice_t *notice;
+
+    status = uct_ep_am_short(ep, am_id, header[0], &header[1], ext_length);
+    if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) {
+        goto out;
+    }
+
+    notice = ucs_malloc(sizeof(*notice), "ucg_builtin_notice");
+    if (notice == NULL) {
+        status = UCS_ERR_NO_MEMORY;
+        goto out;
+    }
+
+    notice->super.func = ucg_builtin_notice_resend;
+    notice->ep         = ep;
+    notice->header[0]  = header[0];
+    notice->header[1]  = header[1];
+    notice->am_id      = am_id;
+    notice->ext_length = ext_length;
+
+    for (;;) {
+        status = uct_ep_pending_add(ep, &notice->super, 0);
+        if (status != UCS_ERR_BUSY) {
+            break;
+        }
+
+        /* The endpoint can already send again */
+        if (ucg_builtin_notice_resend(&notice->super) == UCS_OK) {
+            return;
+        }
+    }
+
+    if (status != UCS_OK) {
+        ucs_free(notice);
+    }
+
+out:
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucs_error("failed to notify a collective peer: %s",
+                  ucs_status_string(status));
+    }
+}
+
+/*
+ * A fan-in parent lets its children send more, each time it has consumed as
+ * many fragments as all of them may have in flight (see
+ * @ref ucg_builtin_set_phase_credits ). Every child sends as many fragments in
+ * this step, so by now each has sent all it may - and since no grant is sent
+ * once the last fragment has arrived, none is left behind for a later
+ * collective to find. A grant is an empty message, with the header of this
+ * step (the children's too) and a reserved offset.
+ */
+void ucg_builtin_step_grant_credits(ucg_builtin_request_t *req,
+                                    ucg_builtin_header_t header)
+{
+    uint8_t peer_idx;
+    uint64_t grant[2];
+    ucg_builtin_op_step_t *step     = req->step;
+    ucg_builtin_plan_phase_t *phase = step->phase;
+    unsigned ext_length             = ucg_builtin_header_length(req) -
+                                      sizeof(header);
+    uint8_t peer_cnt                = step->ep_cnt - ((step->flags &
+                                      UCG_BUILTIN_OP_STEP_FLAG_RECV_BEFORE_SEND1)
+                                      != 0); /* not the parent of a waypoint */
+
+    header.remote_offset = UCG_BUILTIN_OFFSET_CREDIT_GRANT;
+    grant[0]             = header.header;
+    grant[1]             = ucg_builtin_step_header_ext(req, step);
+    ((ucg_builtin_header_ext_t*)&grant[1])->remote_offset_hi = UINT32_MAX;
+
+    if (phase->ep_cnt == 1) {
+        ucg_builtin_step_send_notice(phase->single_ep, req->am_id, grant,
+                                     ext_length);
+        return;
+    }
+
+    for (peer_idx = 0; peer_idx < peer_cnt; peer_idx++) {
+        ucg_builtin_step_send_notice(phase->multi_eps[peer_idx], req->am_id,
+                                     grant, ext_length);
+    }
+}
+
+/*
+ * A member reading the data its parent offered (see
+ * @ref ucg_builtin_step_rndv_offer_prep ), in as many reads as the transport
+ * requires - any of which may have to wait for resources on the endpoint.
+ * The data is read into the receive buffer as it is, unless the receive
+ * datatype is not contiguous: then it is read into a temporary ("staging")
+ * buffer first, and unpacked from there once it has all been read.
+ */
+typedef struct ucg_builtin_rndv_get {
+    uct_pending_req_t      super;
+    uct_completion_t       comp;       /* reads in flight, +1 while issuing */
+    ucg_builtin_request_t *req;
+    uct_ep_h               ep;         /* to the parent */
+    uint64_t               address;    /* of the offered data */
+    size_t                 length;
+    size_t                 offset;     /* of the next read to issue */
+    uint8_t               *buffer;     /* to read into */
+    uct_mem_h              memh;       /* of that buffer */
+    ucs_rcache_region_t   *region;     /* of that buffer, if a staging one */
+    ucs_status_t           status;
+    uint64_t               report[2];  /* header of the reply, once read */
+    uint8_t                am_id;
+    uint8_t                ext_length;
+    uint8_t                is_staged;
+} ucg_builtin_rndv_get_t;
+
+static void ucg_builtin_rndv_get_done(ucg_builtin_rndv_get_t *get)
+{
+    ucg_builtin_request_t *req      = get->req;
+    ucg_builtin_op_step_t *step     = req->step;
+    ucg_builtin_plan_phase_t *phase = step->phase;
+    ucs_status_t status             = get->status;
+    ucg_builtin_header_t header     = { .remote_offset = 0 };
+
+    if (ucs_likely(status == UCS_OK)) {
+        ucg_builtin_step_send_notice(get->ep, get->am_id, get->report,
+                                     get->ext_length);
+    }
+
+    if (get->is_staged) {
+        if (status == UCS_OK) {
+            status = ucg_builtin_step_recv_handle_chunk(
+                    UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE, step->recv_buffer,
+                    get->buffer, get->length, header, 0, 0, 1, req);
+        }
+
+        ucg_builtin_mem_dereg(phase->md, phase->rcache, get->memh,
+                              get->region);
+        ucs_free(get->buffer);
+    }
+
+    ucs_free(get);
+
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucg_builtin_comp_last_step_cb(req, status);
+        return;
+    }
+
+    /* As if every fragment has arrived (zero-copy sends still count theirs) */
+    req->pending = (step->comp_criteria ==
+                    UCG_BUILTIN_OP_STEP_COMP_CRITERIA_MULTIPLE_MESSAGES_ZCOPY) ?
+                   step->fragments_total : 0;
+    ucg_builtin_step_recv_comp_action(req, step);
+}
+
+static void ucg_builtin_rndv_get_comp_cb(uct_completion_t *self
+#ifdef HAVE_UCT_COMP_CB_STATUS_ARG
+                                         , ucs_status_t status)
+#else
+                                         )
+#endif
+{
+    ucg_builtin_rndv_get_t *get = ucs_container_of(self, ucg_builtin_rndv_get_t,
+                                                   comp);
+#ifdef HAVE_UCT_COMP_CB_STATUS_ARG
+    if (ucs_unlikely(status != UCS_OK)) {
+        get->status = status;
+    }
+#endif
+
+    ucg_builtin_rndv_get_done(get);
+}
+
+/*
+ * Issue the remaining reads, and return UCS_INPROGRESS if some are still in
+ * flight, UCS_OK once all are done (and the step has moved on), or
+ * UCS_ERR_NO_RESOURCE if the rest has to wait.
+ */
+static ucs_status_t ucg_builtin_rndv_get_progress(ucg_builtin_rndv_get_t *get)
+{
+    size_t chunk;
+    ucs_status_t status;
+    ucg_builtin_op_step_t *step = get->req->step;
+    ucg_builtin_step_rma_t *rma = step->rma;
+    size_t max_get              = step->phase->iface_attr->cap.get.max_zcopy;
+    uct_iov_t iov               = {
+            .memh   = get->memh,
+            .stride = 0,
+            .count  = 1
+    };
+
+    while (get->offset < get->length) {
+        chunk      = ucs_min(max_get, get->length - get->offset);
+        iov.buffer = get->buffer + get->offset;
+        iov.length = chunk;
+
+        get->comp.count++;
+        status = uct_ep_get_zcopy(get->ep, &iov, 1, get->address + get->offset,
+                                  rma->peer_rkey.rkey, &get->comp);
+        if (status != UCS_INPROGRESS) {
+            get->comp.count--;
+            if (status == UCS_ERR_NO_RESOURCE) {
+                return status;
+            }
+
+            if (ucs_unlikely(status != UCS_OK)) {
+                get->status = status;
+                break; /* those already in flight still complete */
+            }
+        }
+
+        get->offset += chunk;
+    }
+
+    if (--get->comp.count > 0) {
+        return UCS_INPROGRESS;
+    }
+
+    ucg_builtin_rndv_get_done(get);
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_builtin_rndv_get_resume(uct_pending_req_t *self)
+{
+    ucg_builtin_rndv_get_t *get = ucs_container_of(self, ucg_builtin_rndv_get_t,
+                                                   super);
+    ucs_status_t status         = ucg_builtin_rndv_get_progress(get);
+
+    return (status == UCS_ERR_NO_RESOURCE) ? status : UCS_OK;
+}
+
+/*
+ * Take the parent's offer to read the data of this step, rather than have it
+ * sent: each member does so at its own pace, and reports back to the parent
+ * (with an empty message carrying this step's header) once it has. Returns
+ * whether this step is done by now, like @ref ucg_builtin_step_recv_cb .
+ */
+int ucg_builtin_step_rndv_get(ucg_builtin_request_t *req,
+                              ucg_builtin_header_t header,
+                              const uint8_t *offer, size_t length)
+{
+    int is_staged;
+    ucs_status_t status;
+    ucg_builtin_rndv_get_t *get;
+    ucg_builtin_header_ext_t ext;
+    ucg_builtin_rndv_offer_t info;
+    ucg_builtin_op_step_t *step     = req->step;
+    ucg_builtin_plan_phase_t *phase = step->phase;
+    ucg_builtin_step_rma_t *rma     = step->rma;
+
+    /* The data is written into the receive buffer (maybe unpacked) */
+    if ((length != sizeof(info) + phase->md_attr->rkey_packed_size) ||
+        (step->comp_aggregation != UCG_BUILTIN_OP_STEP_COMP_AGGREGATE_WRITE) ||
+        !(phase->iface_attr->cap.flags & UCT_IFACE_FLAG_GET_ZCOPY)) {
+        status = UCS_ERR_UNSUPPORTED;
+        goto rndv_get_error;
+    }
+
+    memcpy(&info, offer, sizeof(info));
+    if (ucs_unlikely(info.length > step->buffer_length)) {
+        status = UCS_ERR_MESSAGE_TRUNCATED;
+        goto rndv_get_error;
+    }
+
+    if (rma == NULL) {
+        rma = ucg_builtin_step_rma_create(step, 0);
+    }
+
+    is_staged = (step->comp_flags &
+                 UCG_BUILTIN_OP_STEP_COMP_FLAG_PACKED_DATATYPE) != 0;
+    if (!is_staged && (rma->recv_memh == UCT_MEM_HANDLE_NULL)) {
+        status = ucg_builtin_mem_reg(phase->md, phase->rcache,
+                                     step->recv_buffer, step->buffer_length,
+                                     PROT_READ | PROT_WRITE, &rma->recv_memh,
+                                     &rma->recv_region);
+        if (status != UCS_OK) {
+            goto rndv_get_error;
+        }
+    }
+
+    status = ucg_builtin_step_rma_take_rkey(rma, offer + sizeof(info));
+    if (status != UCS_OK) {
+        goto rndv_get_error;
+    }
+
+    get = ucs_malloc(sizeof(*get), "ucg_builtin_rndv_get");
+    if (get == NULL) {
+        status = UCS_ERR_NO_MEMORY;
+        goto rndv_get_error;
+    }
+
+    if (is_staged) {
+        get->buffer = ucs_malloc(ucs_max(info.length, 1), "ucg_rndv_staging");
+        status      = (get->buffer == NULL) ? UCS_ERR_NO_MEMORY :
+                      ucg_builtin_mem_reg(phase->md, phase->rcache, get->buffer,
+                                          ucs_max(info.length, 1),
+                                          PROT_READ | PROT_WRITE, &get->memh,
+                                          &get->region);
+        if (status != UCS_OK) {
+            ucs_free(get->buffer);
+            ucs_free(get);
+            goto rndv_get_error;
+        }
+    } else {
+        get->buffer = step->recv_buffer;
+        get->memh   = rma->recv_memh;
+    }
+
+    header.remote_offset = 0;
+    ext.header           = ucg_builtin_step_header_ext(req, step);
+    ext.remote_offset_hi = 0;
+
+    get->is_staged       = is_staged;
+    get->super.func      = ucg_builtin_rndv_get_resume;
+    get->comp.func       = ucg_builtin_rndv_get_comp_cb;
+    get->comp.count      = 1;
+    get->req             = req;
+    get->ep              = (phase->ep_cnt == 1) ? phase->single_ep :
+                                                  phase->multi_eps[0];
+    get->address         = info.address;
+    get->length          = info.length;
+    get->offset          = 0;
+    get->status          = UCS_OK;
+    get->report[0]       = header.header;
+    get->report[1]       = ext.header;
+    get->am_id           = req->am_id;
+    get->ext_length      = ucg_builtin_header_length(req) - sizeof(header);
+
+    for (;;) {
+        status = ucg_builtin_rndv_get_progress(get);
+        if (status != UCS_ERR_NO_RESOURCE) {
+            return status == UCS_OK;
+        }
+
+        status = uct_ep_pending_add(get->ep, &get->super, 0);
+        if (status == UCS_OK) {
+            return 0;
+        }
+
+        if (status != UCS_ERR_BUSY) {
+            /* Fail once the reads already in flight have completed */
+            get->status = status;
+            get->offset = get->length;
+        }
+    }
+
+rndv_get_error:
+    ucs_error("failed to read the data offered for step #%u: %s",
+              step->am_header.msg.step_idx, ucs_status_string(status));
+    ucg_builtin_comp_last_step_cb(req, status);
+    return 1;
+}
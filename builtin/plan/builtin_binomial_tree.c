@@ -563,6 +563,12 @@ static ucs_status_t ucg_builtin_tree_inter_fanin_connect(const ucg_builtin_binom
         down_fanin_cnt = down_fanin_cnt + up_fanin_cnt;
         status = ucg_builtin_binomial_tree_connect_phase((*phase)++, params, tree->phs_cnt, eps, down_fanin,
                                                          down_fanin_cnt, fanin_method, 0);
+    } else {
+        return status;
+    }
+
+    if (status == UCS_OK) {
+        ucg_builtin_set_phase_credits(params->ctx, *phase - 1);
     }
     return status;
 }
@@ -610,6 +616,9 @@ static ucs_status_t ucg_builtin_tree_inter_fanout_connect(const ucg_builtin_bino
                                                          fanout_method, 0);
     }
 
+    if ((up_cnt + down_cnt > 0) && (status == UCS_OK)) {
+        ucg_builtin_set_phase_pull(params->ctx, phase);
+    }
     return status;
 }
 
@@ -715,6 +724,10 @@ static ucs_status_t ucg_builtin_binomial_tree_inter_fanout_connect(const ucg_bui
         up_cnt = up_cnt + down_cnt;
         status = ucg_builtin_binomial_tree_connect_phase(phase, params, 0, eps, up, up_cnt, fanout_method, 0);
     }
+
+    if ((up_cnt + down_cnt > 0) && (status == UCS_OK)) {
+        ucg_builtin_set_phase_pull(params->ctx, phase);
+    }
     return status;
 }
 
@@ -986,6 +999,7 @@ static ucs_status_t ucg_builtin_binomial_tree_connect_fanin(ucg_builtin_plan_t *
         if (status != UCS_OK) {
             return status;
         }
+        ucg_builtin_set_phase_credits(params->ctx, &tree->phss[tree->phs_cnt - 1]);
     }
 
     /* only send (send_terminal) */
@@ -997,6 +1011,7 @@ static ucs_status_t ucg_builtin_binomial_tree_connect_fanin(ucg_builtin_plan_t *
         if (status != UCS_OK) {
             return status;
         }
+        ucg_builtin_set_phase_credits(params->ctx, &tree->phss[tree->phs_cnt - 1]);
     }
 
     /* first recv then send (waypoint) */
@@ -1009,6 +1024,9 @@ static ucs_status_t ucg_builtin_binomial_tree_connect_fanin(ucg_builtin_plan_t *
         down_fanin_cnt = down_fanin_cnt + up_fanin_cnt;
         status = ucg_builtin_binomial_tree_connect_phase(&tree->phss[tree->phs_cnt++], params, 0, eps, down_fanin,
             down_fanin_cnt, fanin_method, 0);
+        if (status == UCS_OK) {
+            ucg_builtin_set_phase_credits(params->ctx, &tree->phss[tree->phs_cnt - 1]);
+        }
     }
 
     return status;
@@ -1060,6 +1078,9 @@ static ucs_status_t ucg_builtin_tree_connect_fanout(unsigned step_inc_cnt,
             up, up_cnt, fanout_method, 0);
     }
 
+    if ((up_cnt + down_cnt > 0) && (status == UCS_OK)) {
+        ucg_builtin_set_phase_pull(params->ctx, &tree->phss[tree->phs_cnt - 1]);
+    }
     return status;
 }
 static ucs_status_t ucg_builtin_binomial_tree_connect_fanin_fanout(ucg_builtin_plan_t *tree,
@@ -10,6 +10,7 @@
 #include <ucs/datastruct/mpool.inl>
 #include <ucp/core/ucp_types.h> /* for ucp_rsc_index_t */
 #include <ucs/sys/math.h>
+#include <ucs/memory/rcache.h>
 #include <uct/api/uct.h>
 
 enum UCS_S_PACKED ucg_builtin_algorithm_feature {
@@ -148,12 +149,34 @@ typedef struct ucg_builtin_tl_threshold {
     size_t                            max_bcopy_one; /* max single bcopy message */
     size_t                            max_bcopy_max; /* max length to use bcopy */
     size_t                            max_zcopy_one; /* max single zcopy message */
+    size_t                            zcopy_thresh;  /* min length to use zcopy */
     size_t                            md_attr_cap_max_reg;
+    unsigned                          credits;       /* fan-in window, or 0 */
+    size_t                            get_thresh;    /* min length to pull */
 } ucg_builtin_tl_threshold_t;
 
 /* for large step number */
 typedef uint16_t ucg_step_idx_ext_t;
 
+/*
+ * Additional lanes to a peer, besides the phase's endpoint to it, over which
+ * large fragments may be striped (see @ref ucg_builtin_connect ).
+ */
+#define UCG_BUILTIN_MAX_RAILS (4)
+typedef struct ucg_builtin_plan_rail {
+    uct_ep_h                          ep;            /* endpoint of this lane */
+    uct_md_h                          md;            /* memory (registration) domain */
+    ucs_rcache_t                     *rcache;        /* registration cache, or NULL */
+    const uct_md_attr_t              *md_attr;       /* memory domain attributes */
+    const uct_iface_attr_t           *iface_attr;    /* interface attributes */
+} ucg_builtin_plan_rail_t;
+
+typedef struct ucg_builtin_plan_rails {
+    uct_ep_h                          ep;            /* the phase's own endpoint */
+    unsigned                          cnt;           /* number of lanes below */
+    ucg_builtin_plan_rail_t           lanes[UCG_BUILTIN_MAX_RAILS - 1];
+} ucg_builtin_plan_rails_t;
+
 typedef struct ucg_builtin_plan_phase {
     /* Parameters for buffer send/recv action */
     union {
@@ -172,6 +195,7 @@ typedef struct ucg_builtin_plan_phase {
     ucg_builtin_tl_threshold_t        recv_thresh;   /* threshold for receiver */
 
     uct_md_h                          md;            /* memory (registration) domain */
+    ucs_rcache_t                     *rcache;        /* registration cache, or NULL */
     const uct_md_attr_t              *md_attr;       /* memory domain attributes */
     const uct_iface_attr_t           *iface_attr;    /* interface attributes */
 
@@ -184,6 +208,7 @@ typedef struct ucg_builtin_plan_phase {
 
 typedef struct ucg_builtin_config ucg_builtin_config_t;
 typedef struct ucg_builtin_group_ctx ucg_builtin_group_ctx_t;
+typedef struct ucg_builtin_reduce_pool ucg_builtin_reduce_pool_t;
 typedef struct ucg_builtin_plan {
     ucg_plan_t               super;
     ucg_builtin_group_ctx_t *gctx;    /* builtin-group context pointer */
@@ -194,7 +219,9 @@ typedef struct ucg_builtin_plan {
     ucg_step_idx_t           step_cnt; /* number of steps in the normal flow */
     uint8_t                  ep_cnt;  /* total endpoint count */
     uint16_t                 am_id;   /* active message ID */
+    uint8_t                  header_length; /* incl. the extended header */
     ucg_builtin_config_t    *config;  /* configured settings */
+    ucg_builtin_reduce_pool_t *reduce_pool; /* reduction threads, or NULL */
     size_t                   non_power_of_two; /* number of processes is power of two or not */
 #if ENABLE_DEBUG_DATA
 #define UCG_BUILTIN_PLANNER_NAME_MAX_LENGTH (10)
@@ -219,6 +246,12 @@ ucs_status_t ucg_builtin_single_connection_phase(ucg_builtin_group_ctx_t *ctx,
         ucg_builtin_plan_phase_t *phase,
         int is_mock);
 
+void ucg_builtin_set_phase_credits(ucg_builtin_group_ctx_t *ctx,
+                                   ucg_builtin_plan_phase_t *phase);
+
+void ucg_builtin_set_phase_pull(ucg_builtin_group_ctx_t *ctx,
+                                ucg_builtin_plan_phase_t *phase);
+
 typedef struct ucg_builtin_config ucg_builtin_config_t;
 
 typedef struct ucg_builtin_binomial_tree_config {
@@ -324,6 +357,20 @@ struct ucg_builtin_config {
     unsigned                       large_datatype_threshold;
 
     unsigned                       bcopy_to_zcopy_opt;
+    size_t                         zcopy_thresh;
+    int                            zcopy_calibrate;
+    int                            reg_cache;
+    size_t                         reg_cache_max_size;
+    unsigned                       max_rails;
+    size_t                         bcast_segment;
+    size_t                         ring_segment;
+    unsigned                       incast_credits;
+    size_t                         rndv_get_thresh;
+    int                            reduce_widen;
+    unsigned                       reduce_threads;
+    size_t                         reduce_threads_thresh;
+    size_t                         reduce_threads_chunk;
+    size_t                         stream_copy_thresh;
     double                         bcast_algorithm;
     double                         allreduce_algorithm;
     double                         barrier_algorithm;
@@ -331,6 +378,11 @@ struct ucg_builtin_config {
     unsigned                       pipelining;
 
     unsigned                       max_msg_list_size;
+
+    unsigned                       concurrent_ops;
+    unsigned                       max_concurrent_ops;
+    unsigned                       max_retained_descs;
+    ucs_on_off_auto_value_t        header_ext;
 };
 
 ucs_status_t choose_distance_from_topo_aware_level(enum ucg_group_member_distance *domain_distance);
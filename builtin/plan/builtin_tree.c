@@ -144,6 +144,11 @@ ucs_status_t ucg_builtin_tree_connect(ucg_builtin_plan_t *tree,
             if (status != UCS_OK) {
                 break;
             }
+
+            /* Concatenation ends at a GATHER_FOR_PAGG root, granting nothing */
+            if (!(mod & UCG_GROUP_COLLECTIVE_MODIFIER_CONCATENATE)) {
+                ucg_builtin_set_phase_credits(params->ctx, phase - 1);
+            }
         }
 
         /* Create a phase for intra-node communication ("up the tree") */
@@ -174,6 +179,13 @@ ucs_status_t ucg_builtin_tree_connect(ucg_builtin_plan_t *tree,
             status = ucg_builtin_tree_connect_phase(phase++, params, step_offset + 1,
                     &iter_eps, net_down, net_down_cnt, fanin_method, flags);
             (*phs_cnt)++;
+
+            /* ... and so does a concatenation to all (GATHER_A2A_ROOT) */
+            if ((status == UCS_OK) &&
+                (!(mod & UCG_GROUP_COLLECTIVE_MODIFIER_CONCATENATE) ||
+                 (mod & UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_DESTINATION))) {
+                ucg_builtin_set_phase_credits(params->ctx, phase - 1);
+            }
         }
 
         if ((topo_type == UCG_PLAN_TREE_FANIN) || (status != UCS_OK)) {
@@ -215,6 +227,8 @@ ucs_status_t ucg_builtin_tree_connect(ucg_builtin_plan_t *tree,
             if (status != UCS_OK) {
                 break;
             }
+
+            ucg_builtin_set_phase_pull(params->ctx, phase - 1);
         }
 
         /* Create a phase for intra-node communication ("down the tree") */
@@ -243,6 +257,9 @@ ucs_status_t ucg_builtin_tree_connect(ucg_builtin_plan_t *tree,
                                                     fanout_method, (ppn == 2) ? 0 :
                                                                                 flags);
             (*phs_cnt)++;
+            if (status == UCS_OK) {
+                ucg_builtin_set_phase_pull(params->ctx, phase - 1);
+            }
         }
         break;
     default:
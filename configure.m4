@@ -45,12 +45,32 @@ AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include "ucs/config/parser.h"]],
                              [Does UCS_CONFIG_REGISTER_TABLE have a "_list" argument])],
                   [AC_MSG_RESULT([UCS_CONFIG_REGISTER_TABLE has no _list argument])])
 
+#
+# Detect UCS registration cache API differences across UCX versions
+#
+AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include "ucs/memory/rcache.h"]],
+                                   [[ucs_rcache_params_t params;]
+                                    [params.max_size = 0;]])],
+                  [AC_MSG_RESULT([ucs_rcache_params_t has a size limit])
+                   AC_DEFINE([HAVE_UCS_RCACHE_MAX_SIZE], [],
+                             [Does ucs_rcache_params_t have a "max_size" field])],
+                  [AC_MSG_RESULT([ucs_rcache_params_t has no size limit])])
+
+AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include "ucs/memory/rcache.h"]],
+                                   [[ucs_rcache_region_t *region;]
+                                    [ucs_rcache_get(NULL, NULL, 0, 0, 0, NULL, &region);]])],
+                  [AC_MSG_RESULT([ucs_rcache_get has an alignment argument])
+                   AC_DEFINE([HAVE_UCS_RCACHE_GET_ALIGNMENT], [],
+                             [Does ucs_rcache_get have an "alignment" argument])],
+                  [AC_MSG_RESULT([ucs_rcache_get has no alignment argument])])
+
 CPPFLAGS="$SAVE_CPPFLAGS"
 
 ucg_modules=":builtin"
 m4_include([src/ucg/base/configure.m4])
 m4_include([src/ucg/builtin/configure.m4])
 m4_include([src/ucg/hicoll/configure.m4])
+m4_include([src/ucg/test/configure.m4])
 AC_DEFINE_UNQUOTED([ucg_MODULES], ["${ucg_modules}"], [UCG loadable modules])
 
 AC_CONFIG_FILES([src/ucg/Makefile
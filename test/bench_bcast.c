@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Loopback benchmark of large broadcasts down a tree, with and without
+ * segmenting (see BUILTIN_BCAST_SEGMENT_SIZE): every message size is run once
+ * with segmenting off ("inf") and once with the given segment size (by default
+ * "auto"), on a group of members all progressed by this thread. The tree is
+ * chosen as usual, e.g. by BUILTIN_BCAST_ALGORITHM (1 for a binomial tree, 4
+ * for a k-nomial one) and BUILTIN_BMTREE_DEGREE_INTRA_FANOUT - or by -a / -k.
+ *
+ * Usage: bench_bcast [-n <members>] [-s <max. size>] [-i <iterations>]
+ *                    [-a <bcast algorithm>] [-k <k-nomial degree>]
+ *                    [-S <segment size>]
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define BENCH_BCAST_MIN_SIZE (64 * UCS_KBYTE)
+#define BENCH_BCAST_WARMUP   (10)
+
+static double bench_bcast_run(const char *segment, unsigned member_cnt,
+                              size_t size, unsigned iters)
+{
+    ucg_collective_params_t *params;
+    ucs_time_t start = 0;
+    ucs_status_t status;
+    uint8_t **buffers;
+    test_loopback_t lb;
+    unsigned idx, iter;
+
+    /* the configuration is read once per context, so before it is created */
+    setenv("UCX_BUILTIN_BCAST_SEGMENT_SIZE", segment, 1);
+
+    status = test_loopback_init(&lb, member_cnt, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    params  = calloc(member_cnt, sizeof(*params));
+    buffers = calloc(member_cnt, sizeof(*buffers));
+    TEST_CHECK((params != NULL) && (buffers != NULL), "out of memory");
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        buffers[idx] = malloc(size);
+        TEST_CHECK(buffers[idx] != NULL, "out of memory");
+        memset(buffers[idx], (idx == 0) ? 0x5a : 0, size);
+
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+        UCG_PARAM_TYPE(&params[idx]).root = 0;
+        params[idx].send.buffer           = buffers[idx];
+        params[idx].send.count            = size;
+        params[idx].recv.buffer           = buffers[idx];
+        params[idx].recv.count            = size;
+    }
+
+    for (iter = 0; iter < iters + BENCH_BCAST_WARMUP; iter++) {
+        if (iter == BENCH_BCAST_WARMUP) {
+            start = ucs_get_time();
+        }
+
+        status = test_loopback_collective(&lb, params);
+        TEST_CHECK(status == UCS_OK, "bcast: %s", ucs_status_string(status));
+    }
+
+    start = ucs_get_time() - start;
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        TEST_CHECK(!memcmp(buffers[0], buffers[idx], size),
+                   "member #%u: wrong data (segment size %s)", idx, segment);
+        free(buffers[idx]);
+    }
+
+    free(buffers);
+    free(params);
+    test_loopback_cleanup(&lb);
+    return ucs_time_to_usec(start) / iters;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned member_cnt = 8;
+    size_t max_size     = 16 * UCS_MBYTE;
+    unsigned iters      = 100;
+    const char *segment = "auto";
+    char degree[16];
+    double plain, segmented;
+    size_t size;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:i:a:k:S:")) != -1) {
+        switch (c) {
+        case 'n':
+            member_cnt = atoi(optarg);
+            break;
+        case 's':
+            max_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        case 'a':
+            setenv("UCX_BUILTIN_BCAST_ALGORITHM", optarg, 1);
+            break;
+        case 'k':
+            snprintf(degree, sizeof(degree), "%d", atoi(optarg));
+            setenv("UCX_BUILTIN_BMTREE_DEGREE_INTRA_FANOUT", degree, 1);
+            setenv("UCX_BUILTIN_BMTREE_DEGREE_INTER_FANOUT", degree, 1);
+            break;
+        case 'S':
+            segment = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n <members>] [-s <max. size>] "
+                    "[-i <iterations>] [-a <bcast algorithm>] "
+                    "[-k <k-nomial degree>] [-S <segment size>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((member_cnt < 2) || (iters == 0) || (max_size < BENCH_BCAST_MIN_SIZE)) {
+        fprintf(stderr, "at least 2 members, 1 iteration and %zu bytes\n",
+                (size_t)BENCH_BCAST_MIN_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u members, algorithm %s, degree %s\n", member_cnt,
+           getenv("UCX_BUILTIN_BCAST_ALGORITHM") ?: "(default)",
+           getenv("UCX_BUILTIN_BMTREE_DEGREE_INTRA_FANOUT") ?: "(default)");
+    printf("%12s %14s %14s %8s\n", "size", "unsegmented", "segmented",
+           "speedup");
+
+    for (size = BENCH_BCAST_MIN_SIZE; size <= max_size; size *= 4) {
+        plain     = bench_bcast_run("inf", member_cnt, size, iters);
+        segmented = bench_bcast_run(segment, member_cnt, size, iters);
+        printf("%12zu %11.1f us %11.1f us %7.2fx\n", size, plain, segmented,
+               plain / segmented);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Loopback benchmark of the cached-op lookup: the time of
+ * ucg_collective_create() and of ucg_collective_start() on a group whose cache
+ * holds a growing number of ops (1 to -n), each of a distinct "shape" (see
+ * @ref ucg_plan_op_params_hash ) - first as each op is created, and then as
+ * they are picked from the cache in a random order. The cache is sized (by
+ * GROUP_OP_CACHE_SIZE) to keep all of them, so that none is evicted.
+ *
+ * Usage: bench_op_cache [-n <max. cached ops>] [-m <members>] [-i <iterations>]
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+typedef struct bench_op_cache_time {
+    ucs_time_t create;
+    ucs_time_t start;
+} bench_op_cache_time_t;
+
+/* Run the broadcast of "count" bytes on every member, timing the calls */
+static void bench_op_cache_bcast(test_loopback_t *lb, uint8_t **buffers,
+                                 uint64_t count, ucg_coll_h *colls,
+                                 test_loopback_req_t *reqs,
+                                 bench_op_cache_time_t *time)
+{
+    ucg_collective_params_t params;
+    ucg_group_member_index_t idx;
+    ucs_status_t status;
+    ucs_time_t start;
+
+    memset(&params, 0, sizeof(params));
+    UCG_PARAM_TYPE(&params).modifiers = UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                                        UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+    UCG_PARAM_TYPE(&params).root      = 0;
+    params.send.count                 = count;
+    params.recv.count                 = count;
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        params.send.buffer = buffers[idx];
+        params.recv.buffer = buffers[idx];
+
+        start         = ucs_get_time();
+        status        = ucg_collective_create(lb->members[idx].group, &params,
+                                              &colls[idx]);
+        time->create += ucs_get_time() - start;
+        TEST_CHECK(status == UCS_OK, "create on member #%u: %s", idx,
+                   ucs_status_string(status));
+    }
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        reqs[idx]    = 0;
+        start        = ucs_get_time();
+        status       = ucg_collective_start(colls[idx], (void*)&reqs[idx]);
+        time->start += ucs_get_time() - start;
+        TEST_CHECK((status == UCS_OK) || (status == UCS_INPROGRESS),
+                   "start on member #%u: %s", idx, ucs_status_string(status));
+        if (status == UCS_OK) {
+            reqs[idx] = 1;
+        }
+    }
+
+    test_loopback_wait(lb, reqs, lb->member_cnt);
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        ucg_collective_destroy(colls[idx]);
+    }
+}
+
+static void bench_op_cache_run(unsigned member_cnt, unsigned op_cnt,
+                               unsigned iters, uint8_t **buffers)
+{
+    bench_op_cache_time_t created = {0}, cached = {0};
+    char cache_size[16];
+    test_loopback_req_t *reqs;
+    ucs_status_t status;
+    test_loopback_t lb;
+    unsigned idx, seed;
+    ucg_coll_h *colls;
+    double calls;
+
+    /* the configuration is read once per context, so before it is created */
+    snprintf(cache_size, sizeof(cache_size), "%u", op_cnt);
+    setenv("UCX_GROUP_OP_CACHE_SIZE", cache_size, 1);
+
+    status = test_loopback_init(&lb, member_cnt, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    reqs  = calloc(member_cnt, sizeof(*reqs));
+    colls = calloc(member_cnt, sizeof(*colls));
+    TEST_CHECK((reqs != NULL) && (colls != NULL), "out of memory");
+
+    /* a distinct count is a distinct shape - one cached op each */
+    for (idx = 0; idx < op_cnt; idx++) {
+        bench_op_cache_bcast(&lb, buffers, idx + 1, colls, reqs, &created);
+    }
+
+    for (idx = 0, seed = 1; idx < iters; idx++) {
+        seed = (seed * 1103515245) + 12345;
+        bench_op_cache_bcast(&lb, buffers, (seed % op_cnt) + 1, colls, reqs,
+                             &cached);
+    }
+
+    for (idx = 1; idx < member_cnt; idx++) {
+        TEST_CHECK(!memcmp(buffers[0], buffers[idx], op_cnt),
+                   "member #%u: wrong data", idx);
+    }
+
+    calls = (double)op_cnt * member_cnt;
+    printf("%10u %12.0f %12.0f", op_cnt,
+           ucs_time_to_nsec(created.create) / calls,
+           ucs_time_to_nsec(created.start) / calls);
+
+    calls = (double)iters * member_cnt;
+    printf(" %12.0f %12.0f\n", ucs_time_to_nsec(cached.create) / calls,
+           ucs_time_to_nsec(cached.start) / calls);
+
+    free(colls);
+    free(reqs);
+    test_loopback_cleanup(&lb);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_cnt    = 10000;
+    unsigned member_cnt = 2;
+    unsigned iters      = 100000;
+    uint8_t **buffers;
+    unsigned op_cnt;
+    unsigned idx;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:m:i:")) != -1) {
+        switch (c) {
+        case 'n':
+            max_cnt = atoi(optarg);
+            break;
+        case 'm':
+            member_cnt = atoi(optarg);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n <max. cached ops>] [-m <members>] "
+                    "[-i <iterations>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((max_cnt == 0) || (member_cnt < 2) || (iters == 0)) {
+        fprintf(stderr, "at least 1 op, 2 members and 1 iteration\n");
+        return EXIT_FAILURE;
+    }
+
+    buffers = calloc(member_cnt, sizeof(*buffers));
+    TEST_CHECK(buffers != NULL, "out of memory");
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        buffers[idx] = malloc(max_cnt);
+        TEST_CHECK(buffers[idx] != NULL, "out of memory");
+        memset(buffers[idx], (idx == 0) ? 0x5a : 0, max_cnt);
+    }
+
+    printf("%u members, ns per call (and member):\n", member_cnt);
+    printf("%10s %12s %12s %12s %12s\n", "cached ops", "create (new)",
+           "start (new)", "create", "start");
+
+    for (op_cnt = 1; op_cnt < max_cnt; op_cnt *= 10) {
+        bench_op_cache_run(member_cnt, op_cnt, iters, buffers);
+    }
+
+    bench_op_cache_run(member_cnt, max_cnt, iters, buffers);
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        free(buffers[idx]);
+    }
+
+    free(buffers);
+    return EXIT_SUCCESS;
+}
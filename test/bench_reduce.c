@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Micro-benchmark of the native reducers (see builtin_reduce.c), in every
+ * instruction-set variant this CPU supports, against the reduce_cb_f path
+ * they replace: a callback (as an MPI library would provide) which finds the
+ * operation and the datatype, and then loops over the elements - called once
+ * per fragment through a function pointer, as ucg_builtin_mpi_reduce_fragment
+ * does. The buffers are reused across iterations, so the smaller sizes measure
+ * the reduction itself, and the larger ones the memory bandwidth as well.
+ *
+ * Usage: bench_reduce [-s <max. size>] [-f <fragment size>] [-i <iterations>]
+ */
+
+#include <ucg/api/ucg_plan_component.h>
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define BENCH_REDUCE_MIN_SIZE (UCS_KBYTE)
+#define BENCH_REDUCE_WARMUP   (10)
+
+typedef enum bench_reduce_dtype {
+    BENCH_REDUCE_INT32,
+    BENCH_REDUCE_FLOAT,
+    BENCH_REDUCE_DOUBLE,
+    BENCH_REDUCE_BFLOAT16,
+    BENCH_REDUCE_LAST
+} bench_reduce_dtype_t;
+
+static const char *bench_reduce_dtype_names[BENCH_REDUCE_LAST] = {
+    [BENCH_REDUCE_INT32]    = "int32",
+    [BENCH_REDUCE_FLOAT]    = "float",
+    [BENCH_REDUCE_DOUBLE]   = "double",
+    [BENCH_REDUCE_BFLOAT16] = "bf16"
+};
+
+static const size_t bench_reduce_dtype_sizes[BENCH_REDUCE_LAST] = {
+    [BENCH_REDUCE_INT32]    = sizeof(int32_t),
+    [BENCH_REDUCE_FLOAT]    = sizeof(float),
+    [BENCH_REDUCE_DOUBLE]   = sizeof(double),
+    [BENCH_REDUCE_BFLOAT16] = sizeof(uint16_t)
+};
+
+static const struct {
+    const char *name;
+    int         op;
+} bench_reduce_ops[] = {
+    {"sum", UCG_REDUCE_OP_SUM},
+    {"max", UCG_REDUCE_OP_MAX}
+};
+
+/* The opaque handles passed to the library point to these */
+static bench_reduce_dtype_t bench_reduce_dtypes[BENCH_REDUCE_LAST] = {
+    BENCH_REDUCE_INT32, BENCH_REDUCE_FLOAT, BENCH_REDUCE_DOUBLE,
+    BENCH_REDUCE_BFLOAT16
+};
+static int bench_reduce_op_types[UCG_REDUCE_OP_LAST];
+
+static int bench_reduce_is_integer(void *datatype, int *is_signed)
+{
+    *is_signed = 1;
+    return *(bench_reduce_dtype_t*)datatype == BENCH_REDUCE_INT32;
+}
+
+static int bench_reduce_is_floating_point(void *datatype)
+{
+    return *(bench_reduce_dtype_t*)datatype != BENCH_REDUCE_INT32;
+}
+
+static int bench_reduce_is_bfloat16(void *datatype)
+{
+    return *(bench_reduce_dtype_t*)datatype == BENCH_REDUCE_BFLOAT16;
+}
+
+static int bench_reduce_get_type(void *reduce_op)
+{
+    return (int*)reduce_op - bench_reduce_op_types;
+}
+
+static int bench_reduce_is_sum(void *reduce_op)
+{
+    return bench_reduce_get_type(reduce_op) == UCG_REDUCE_OP_SUM;
+}
+
+static inline float bench_reduce_bf16_load(uint16_t b)
+{
+    uint32_t u = (uint32_t)b << 16;
+    float f;
+
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline uint16_t bench_reduce_bf16_store(float f)
+{
+    uint32_t u;
+
+    memcpy(&u, &f, sizeof(u));
+    return (u + 0x7fff + ((u >> 16) & 1)) >> 16; /* no NaNs here */
+}
+
+#define BENCH_REDUCE_LOOP(_type, _expr) { \
+    const _type *s = (const _type*)src; \
+    _type *d       = (_type*)dst; \
+    unsigned i; \
+    for (i = 0; i < count; i++) { \
+        d[i] = (_expr); \
+    } \
+}
+
+/* What an MPI library would do for its predefined operations */
+static int bench_reduce_cb(void *reduce_op, char *src, char *dst,
+                           unsigned count, void *datatype)
+{
+    int is_sum = (bench_reduce_get_type(reduce_op) == UCG_REDUCE_OP_SUM);
+
+    switch (*(bench_reduce_dtype_t*)datatype) {
+    case BENCH_REDUCE_INT32:
+        if (is_sum) {
+            BENCH_REDUCE_LOOP(int32_t, d[i] + s[i])
+        } else {
+            BENCH_REDUCE_LOOP(int32_t, (s[i] > d[i]) ? s[i] : d[i])
+        }
+        break;
+
+    case BENCH_REDUCE_FLOAT:
+        if (is_sum) {
+            BENCH_REDUCE_LOOP(float, d[i] + s[i])
+        } else {
+            BENCH_REDUCE_LOOP(float, (s[i] > d[i]) ? s[i] : d[i])
+        }
+        break;
+
+    case BENCH_REDUCE_DOUBLE:
+        if (is_sum) {
+            BENCH_REDUCE_LOOP(double, d[i] + s[i])
+        } else {
+            BENCH_REDUCE_LOOP(double, (s[i] > d[i]) ? s[i] : d[i])
+        }
+        break;
+
+    default:
+        if (is_sum) {
+            BENCH_REDUCE_LOOP(uint16_t, bench_reduce_bf16_store(
+                              bench_reduce_bf16_load(d[i]) +
+                              bench_reduce_bf16_load(s[i])))
+        } else {
+            BENCH_REDUCE_LOOP(uint16_t, bench_reduce_bf16_store(
+                              (bench_reduce_bf16_load(s[i]) >
+                               bench_reduce_bf16_load(d[i])) ?
+                              bench_reduce_bf16_load(s[i]) :
+                              bench_reduce_bf16_load(d[i])))
+        }
+        break;
+    }
+
+    return 0;
+}
+
+/* The reduce_cb_f path, as ucg_builtin_mpi_reduce_fragment would take it */
+static int (*volatile bench_reduce_cb_p)(void*, char*, char*, unsigned, void*) =
+        bench_reduce_cb;
+
+static double bench_reduce_run(ucg_op_reduce_frag_f frag_f, void *reduce_op,
+                               void *dtype, size_t dtype_len, uint8_t *dst,
+                               uint8_t *src, size_t size, size_t frag_size,
+                               unsigned iters, ucg_op_t *coll)
+{
+    ucs_time_t start = 0;
+    size_t offset, length;
+    unsigned iter;
+
+    for (iter = 0; iter < iters + BENCH_REDUCE_WARMUP; iter++) {
+        if (iter == BENCH_REDUCE_WARMUP) {
+            start = ucs_get_time();
+        }
+
+        for (offset = 0; offset < size; offset += length) {
+            length = ucs_min(frag_size, size - offset);
+            if (frag_f != NULL) {
+                frag_f(dst + offset, src + offset, length, coll);
+            } else {
+                bench_reduce_cb_p(reduce_op, (char*)src + offset,
+                                  (char*)dst + offset, length / dtype_len,
+                                  dtype);
+            }
+        }
+    }
+
+    return ucs_time_to_usec(ucs_get_time() - start) / iters;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_size  = 4 * UCS_MBYTE;
+    size_t frag_size = 8 * UCS_KBYTE;
+    unsigned iters   = 1000;
+    ucg_op_reduce_full_f full_f;
+    ucg_op_reduce_frag_f frag_f;
+    unsigned isa, op_idx, dt;
+    const char *isa_name;
+    uint8_t *dst, *src;
+    double cb_time, time;
+    ucg_op_t *coll;
+    size_t size;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:f:i:")) != -1) {
+        switch (c) {
+        case 's':
+            max_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            frag_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s <max. size>] [-f <fragment size>] "
+                    "[-i <iterations>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((iters == 0) || (max_size < BENCH_REDUCE_MIN_SIZE) ||
+        (frag_size < sizeof(double)) || (frag_size % sizeof(double))) {
+        fprintf(stderr, "at least 1 iteration, %zu bytes and a fragment of "
+                "whole doubles\n", (size_t)BENCH_REDUCE_MIN_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    ucg_global_params.datatype.is_integer_f        = bench_reduce_is_integer;
+    ucg_global_params.datatype.is_floating_point_f = bench_reduce_is_floating_point;
+    ucg_global_params.datatype.is_bfloat16_f       = bench_reduce_is_bfloat16;
+    ucg_global_params.reduce_op.get_type_f         = bench_reduce_get_type;
+    ucg_global_params.reduce_op.is_sum_f           = bench_reduce_is_sum;
+    ucg_global_params.reduce_op.reduce_cb_f        = bench_reduce_cb;
+
+    if (posix_memalign((void**)&dst, UCS_SYS_CACHE_LINE_SIZE, max_size) ||
+        posix_memalign((void**)&src, UCS_SYS_CACHE_LINE_SIZE, max_size) ||
+        posix_memalign((void**)&coll, UCS_SYS_CACHE_LINE_SIZE, sizeof(*coll))) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    /* small values, so that repeated sums stay finite */
+    memset(dst, 0, max_size);
+    memset(src, 1, max_size);
+    memset(coll, 0, sizeof(*coll));
+
+    printf("%-6s %-6s %10s %12s", "op", "dtype", "size", "reduce_cb_f");
+    for (isa = 0; ; isa++) {
+        isa_name = ucg_builtin_reduce_select_isa(isa, &bench_reduce_dtypes[0],
+                                                 &bench_reduce_op_types[0], 0,
+                                                 &full_f, &frag_f);
+        if (isa_name == NULL) {
+            break;
+        }
+
+        printf(" %20s", isa_name);
+    }
+    printf("\n");
+
+    for (op_idx = 0; op_idx < ucs_static_array_size(bench_reduce_ops); op_idx++) {
+        for (dt = 0; dt < BENCH_REDUCE_LAST; dt++) {
+            for (size = BENCH_REDUCE_MIN_SIZE; size <= max_size; size *= 4) {
+                cb_time = bench_reduce_run(NULL,
+                        &bench_reduce_op_types[bench_reduce_ops[op_idx].op],
+                        &bench_reduce_dtypes[dt], bench_reduce_dtype_sizes[dt],
+                        dst, src, size, frag_size, iters, coll);
+                printf("%-6s %-6s %10zu %9.2f us", bench_reduce_ops[op_idx].name,
+                       bench_reduce_dtype_names[dt], size, cb_time);
+
+                for (isa = 0; ; isa++) {
+                    isa_name = ucg_builtin_reduce_select_isa(isa,
+                            &bench_reduce_dtypes[dt],
+                            &bench_reduce_op_types[bench_reduce_ops[op_idx].op],
+                            bench_reduce_dtype_sizes[dt], &full_f, &frag_f);
+                    if (isa_name == NULL) {
+                        break;
+                    }
+
+                    if (frag_f == NULL) {
+                        printf(" %20s", "(reduce_cb_f)");
+                        continue;
+                    }
+
+                    time = bench_reduce_run(frag_f, NULL, NULL,
+                                            bench_reduce_dtype_sizes[dt], dst,
+                                            src, size, frag_size, iters, coll);
+                    printf(" %9.2f us %6.2fx", time, cb_time / time);
+                }
+
+                printf("\n");
+            }
+        }
+    }
+
+    free(coll);
+    free(src);
+    free(dst);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Scaling benchmark of the reduction helper threads (see BUILTIN_REDUCE_THREADS
+ * and builtin_reduce_pool.c): a large summation of doubles, by the best native
+ * reducer this CPU supports, done inline and then split among the calling
+ * thread and a growing number of helpers - pinned as they would be in UCG.
+ * Each row reports the time per reduction, the rate at which the destination
+ * is reduced, and the speedup over the inline reduction.
+ *
+ * Usage: bench_reduce_threads [-t <max. helpers>] [-s <size>] [-c <chunk>]
+ *                             [-i <iterations>]
+ */
+
+#include <ucg/api/ucg_plan_component.h>
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define BENCH_THREADS_WARMUP (3)
+
+static int bench_threads_dtype; /* the opaque handle points here */
+
+static int bench_threads_is_integer(void *datatype, int *is_signed)
+{
+    return 0;
+}
+
+static int bench_threads_is_floating_point(void *datatype)
+{
+    return 1;
+}
+
+static int bench_threads_is_sum(void *reduce_op)
+{
+    return 1;
+}
+
+static double bench_threads_run(unsigned helper_cnt, ucg_op_reduce_frag_f frag_f,
+                                uint8_t *dst, uint8_t *src, size_t size,
+                                size_t chunk, unsigned iters)
+{
+    ucg_builtin_reduce_pool_t *pool = NULL;
+    ucs_time_t start                = 0;
+    ucs_status_t status;
+    unsigned iter;
+
+    if (helper_cnt > 0) {
+        status = ucg_builtin_reduce_pool_create(helper_cnt, chunk, 0, &pool);
+        if (status != UCS_OK) {
+            fprintf(stderr, "pool create: %s\n", ucs_status_string(status));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (iter = 0; iter < iters + BENCH_THREADS_WARMUP; iter++) {
+        if (iter == BENCH_THREADS_WARMUP) {
+            start = ucs_get_time();
+        }
+
+        if ((pool == NULL) ||
+            !ucg_builtin_reduce_pool_run(pool, frag_f, NULL, dst, src, size,
+                                         sizeof(double))) {
+            frag_f(dst, src, size, NULL);
+        }
+    }
+
+    start = ucs_get_time() - start;
+
+    if (pool != NULL) {
+        ucg_builtin_reduce_pool_destroy(pool);
+    }
+
+    return ucs_time_to_usec(start) / iters;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_helpers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    size_t size          = 256 * UCS_MBYTE;
+    size_t chunk         = 256 * UCS_KBYTE;
+    unsigned iters       = 10;
+    ucg_op_reduce_full_f full_f, best_full_f;
+    ucg_op_reduce_frag_f frag_f, best_frag_f;
+    const char *isa_name, *best_isa = NULL;
+    double inline_time, time;
+    unsigned isa, helpers;
+    uint8_t *dst, *src;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:s:c:i:")) != -1) {
+        switch (c) {
+        case 't':
+            max_helpers = atoi(optarg);
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            chunk = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t <max. helpers>] [-s <size>] "
+                    "[-c <chunk>] [-i <iterations>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size -= size % sizeof(double);
+    if ((iters == 0) || (size == 0) || (chunk == 0)) {
+        fprintf(stderr, "at least 1 iteration, a double and a chunk byte\n");
+        return EXIT_FAILURE;
+    }
+
+    ucg_global_params.datatype.is_integer_f        = bench_threads_is_integer;
+    ucg_global_params.datatype.is_floating_point_f = bench_threads_is_floating_point;
+    ucg_global_params.reduce_op.is_sum_f           = bench_threads_is_sum;
+
+    best_full_f = NULL;
+    best_frag_f = NULL;
+    for (isa = 0; ; isa++) {
+        isa_name = ucg_builtin_reduce_select_isa(isa, &bench_threads_dtype,
+                                                 NULL, sizeof(double), &full_f,
+                                                 &frag_f);
+        if (isa_name == NULL) {
+            break;
+        }
+
+        best_isa    = isa_name;
+        best_full_f = full_f;
+        best_frag_f = frag_f;
+    }
+
+    if ((best_full_f == NULL) || (best_frag_f == NULL)) {
+        fprintf(stderr, "no native reducer for a summation of doubles\n");
+        return EXIT_FAILURE;
+    }
+
+    if (posix_memalign((void**)&dst, UCS_SYS_CACHE_LINE_SIZE, size) ||
+        posix_memalign((void**)&src, UCS_SYS_CACHE_LINE_SIZE, size)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    /* touched by this thread, as a receive buffer would usually be */
+    memset(dst, 0, size);
+    memset(src, 0, size);
+
+    printf("%zu bytes of doubles, %s reducer, chunks of %zu bytes\n", size,
+           best_isa, chunk);
+    printf("%8s %12s %12s %8s\n", "helpers", "time", "rate", "speedup");
+
+    inline_time = bench_threads_run(0, best_frag_f, dst, src, size, chunk,
+                                    iters);
+    printf("%8s %9.0f us %7.2f GB/s %7.2fx\n", "inline", inline_time,
+           size / (inline_time * 1e3), 1.0);
+
+    /* 1, 2, 4, ... helpers, and then all of them */
+    for (helpers = 1; helpers <= max_helpers;
+         helpers = (helpers == max_helpers) ? (helpers + 1) :
+                   ucs_min(helpers * 2, max_helpers)) {
+        time = bench_threads_run(helpers, best_frag_f, dst, src, size, chunk,
+                                 iters);
+        printf("%8u %9.0f us %7.2f GB/s %7.2fx\n", helpers, time,
+               size / (time * 1e3), inline_time / time);
+    }
+
+    free(src);
+    free(dst);
+    return EXIT_SUCCESS;
+}
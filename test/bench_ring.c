@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Loopback benchmark of the ring allreduce segment size (see
+ * BUILTIN_RING_SEGMENT_SIZE): a sum of doubles over the ring algorithm, for
+ * every message size (by 4, up to -s) and every segment size (by 2, from -f up
+ * to -F) - next to "auto", which is the largest buffer-copy message of the
+ * transport (and also the cap on any segment size given). This is where the
+ * default comes from: the optimum, about sqrt(C * o * B) for chunks of C bytes
+ * (o being the per-message overhead and B the bandwidth), is typically at or
+ * above that cap - so a smaller segment should not be faster here.
+ *
+ * Usage: bench_ring [-n <members>] [-s <max. size>] [-i <iterations>]
+ *                   [-f <min. segment size>] [-F <max. segment size>]
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/api/ucg_mpi.h>
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define BENCH_RING_ALGORITHM "4" /* UCG_ALGORITHM_ALLREDUCE_RING */
+#define BENCH_RING_MIN_SIZE  (64 * UCS_KBYTE)
+#define BENCH_RING_WARMUP    (10)
+#define BENCH_RING_MAX_RUNS  (32)
+
+/* The opaque datatype and operation handles, only compared by address */
+static int bench_ring_double;
+static int bench_ring_sum;
+
+static int bench_ring_convert(void *datatype, ucp_datatype_t *ucp_datatype)
+{
+    *ucp_datatype = ucp_dt_make_contig(sizeof(double));
+    return 0;
+}
+
+static int bench_ring_get_span(void *datatype, int count, ptrdiff_t *span,
+                               ptrdiff_t *gap)
+{
+    *span = count * sizeof(double);
+    *gap  = 0;
+    return 0;
+}
+
+static int bench_ring_is_integer(void *datatype, int *is_signed)
+{
+    *is_signed = 0;
+    return 0;
+}
+
+static int bench_ring_is_floating_point(void *datatype)
+{
+    return 1;
+}
+
+/* Only called if the native reducers are not used */
+static int bench_ring_reduce(void *reduce_op, char *src, char *dst,
+                             unsigned count, void *datatype)
+{
+    const double *s = (const double*)src;
+    double *d       = (double*)dst;
+    unsigned idx;
+
+    for (idx = 0; idx < count; idx++) {
+        d[idx] += s[idx];
+    }
+
+    return 0;
+}
+
+static int bench_ring_is_sum(void *reduce_op)
+{
+    return 1;
+}
+
+static int bench_ring_is_loc_expected(void *reduce_op)
+{
+    return 0;
+}
+
+static int bench_ring_is_commutative(void *reduce_op)
+{
+    return 1;
+}
+
+static int bench_ring_get_type(void *reduce_op)
+{
+    return UCG_REDUCE_OP_SUM;
+}
+
+static double bench_ring_run(const char *segment, unsigned member_cnt,
+                             size_t size, unsigned iters)
+{
+    ucg_params_t ucg_params = {
+        .field_mask = UCG_PARAM_FIELD_DATATYPE_CB |
+                      UCG_PARAM_FIELD_REDUCE_OP_CB,
+        .datatype   = {
+            .convert_f           = bench_ring_convert,
+            .get_span_f          = bench_ring_get_span,
+            .is_integer_f        = bench_ring_is_integer,
+            .is_floating_point_f = bench_ring_is_floating_point
+        },
+        .reduce_op  = {
+            .reduce_cb_f         = bench_ring_reduce,
+            .is_sum_f            = bench_ring_is_sum,
+            .is_loc_expected_f   = bench_ring_is_loc_expected,
+            .is_commutative_f    = bench_ring_is_commutative,
+            .get_type_f          = bench_ring_get_type
+        }
+    };
+    double expected         = (double)member_cnt * (member_cnt + 1) / 2;
+    size_t count            = size / sizeof(double);
+    ucg_collective_params_t *params;
+    double **sbufs, **rbufs;
+    ucs_time_t start = 0;
+    ucs_status_t status;
+    test_loopback_t lb;
+    unsigned idx, iter;
+    size_t elem;
+
+    /* the configuration is read once per context, so before it is created */
+    setenv("UCX_BUILTIN_RING_SEGMENT_SIZE", segment, 1);
+
+    status = test_loopback_init(&lb, member_cnt, &ucg_params);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    params = calloc(member_cnt, sizeof(*params));
+    sbufs  = calloc(member_cnt, sizeof(*sbufs));
+    rbufs  = calloc(member_cnt, sizeof(*rbufs));
+    TEST_CHECK((params != NULL) && (sbufs != NULL) && (rbufs != NULL),
+               "out of memory");
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        sbufs[idx] = malloc(count * sizeof(double));
+        rbufs[idx] = malloc(count * sizeof(double));
+        TEST_CHECK((sbufs[idx] != NULL) && (rbufs[idx] != NULL),
+                   "out of memory");
+
+        for (elem = 0; elem < count; elem++) {
+            sbufs[idx][elem] = idx + 1;
+        }
+
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE];
+        UCG_PARAM_TYPE(&params[idx]).root = 0;
+        params[idx].send.buffer           = sbufs[idx];
+        params[idx].send.count            = count;
+        params[idx].send.dtype            = &bench_ring_double;
+        UCG_PARAM_OP(&params[idx])        = &bench_ring_sum;
+        params[idx].recv.buffer           = rbufs[idx];
+        params[idx].recv.count            = count;
+        params[idx].recv.dtype            = &bench_ring_double;
+    }
+
+    for (iter = 0; iter < iters + BENCH_RING_WARMUP; iter++) {
+        if (iter == BENCH_RING_WARMUP) {
+            start = ucs_get_time();
+        }
+
+        status = test_loopback_collective(&lb, params);
+        TEST_CHECK(status == UCS_OK, "allreduce: %s", ucs_status_string(status));
+    }
+
+    start = ucs_get_time() - start;
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        for (elem = 0; elem < count; elem++) {
+            TEST_CHECK(rbufs[idx][elem] == expected, "member #%u: element "
+                       "#%zu is %g, not %g (segment size %s)", idx, elem,
+                       rbufs[idx][elem], expected, segment);
+        }
+
+        free(rbufs[idx]);
+        free(sbufs[idx]);
+    }
+
+    free(rbufs);
+    free(sbufs);
+    free(params);
+    test_loopback_cleanup(&lb);
+    return ucs_time_to_usec(start) / iters;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned member_cnt = 4;
+    size_t max_size     = 16 * UCS_MBYTE;
+    unsigned iters      = 100;
+    size_t min_segment  = UCS_KBYTE;
+    size_t max_segment  = 64 * UCS_KBYTE;
+    char segments[BENCH_RING_MAX_RUNS][16];
+    unsigned run, run_cnt;
+    double time, reference;
+    size_t size, segment;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:i:f:F:")) != -1) {
+        switch (c) {
+        case 'n':
+            member_cnt = atoi(optarg);
+            break;
+        case 's':
+            max_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        case 'f':
+            min_segment = strtoul(optarg, NULL, 0);
+            break;
+        case 'F':
+            max_segment = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n <members>] [-s <max. size>] "
+                    "[-i <iterations>] [-f <min. segment size>] "
+                    "[-F <max. segment size>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((member_cnt < 2) || (iters == 0) || (max_size < BENCH_RING_MIN_SIZE) ||
+        (min_segment < sizeof(double)) || (max_segment < min_segment)) {
+        fprintf(stderr, "at least 2 members, 1 iteration, %zu bytes and a "
+                "segment of %zu\n", (size_t)BENCH_RING_MIN_SIZE,
+                sizeof(double));
+        return EXIT_FAILURE;
+    }
+
+    setenv("UCX_BUILTIN_ALLREDUCE_ALGORITHM", BENCH_RING_ALGORITHM, 1);
+
+    /* "auto" first, as the reference for the others */
+    run_cnt = 0;
+    snprintf(segments[run_cnt++], sizeof(segments[0]), "auto");
+    for (segment = min_segment;
+         (segment <= max_segment) && (run_cnt < BENCH_RING_MAX_RUNS);
+         segment *= 2) {
+        snprintf(segments[run_cnt++], sizeof(segments[0]), "%zu", segment);
+    }
+
+    printf("%u members, us per allreduce (and vs. \"auto\"):\n", member_cnt);
+    printf("%12s", "size");
+    for (run = 0; run < run_cnt; run++) {
+        printf(" %16s", segments[run]);
+    }
+    printf("\n");
+
+    for (size = BENCH_RING_MIN_SIZE; size <= max_size; size *= 4) {
+        printf("%12zu", size);
+        for (run = 0, reference = 0; run < run_cnt; run++) {
+            time = bench_ring_run(segments[run], member_cnt, size, iters);
+            if (run == 0) {
+                reference = time;
+                printf(" %13.1f   ", time);
+            } else {
+                printf(" %9.1f %5.2fx", time, reference / time);
+            }
+        }
+        printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Micro-benchmark of the local copies of the builtin ops (see
+ * BUILTIN_STREAM_COPY_THRESH), with regular and with streaming stores: the
+ * time of a large copy, and then the time to read a smaller "application"
+ * working set, which was in the cache before that copy - and is still there
+ * afterwards only if the copy has not evicted it.
+ *
+ * Usage: bench_stream_copy [-s <copy size>] [-w <working set>] [-i <iterations>]
+ */
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+/* Read, so that the reads of the working set are not optimized out */
+static volatile uint64_t bench_stream_sum;
+
+static void bench_stream_read(const uint64_t *set, size_t size)
+{
+    uint64_t sum = 0;
+    size_t i;
+
+    for (i = 0; i < size / sizeof(*set); i += UCS_SYS_CACHE_LINE_SIZE /
+                                               sizeof(*set)) {
+        sum += set[i];
+    }
+
+    bench_stream_sum += sum;
+}
+
+static void bench_stream_run(ucg_builtin_op_t *op, uint8_t *dst,
+                             const uint8_t *src, size_t size, uint64_t *set,
+                             size_t set_size, unsigned iters,
+                             double *copy_time, double *read_time)
+{
+    ucs_time_t copy = 0, read = 0, start;
+    unsigned iter;
+
+    for (iter = 0; iter < iters; iter++) {
+        bench_stream_read(set, set_size); /* warm it up */
+
+        start = ucs_get_time();
+        ucg_builtin_memcpy(op, dst, src, size);
+        copy += ucs_get_time() - start;
+
+        start = ucs_get_time();
+        bench_stream_read(set, set_size);
+        read += ucs_get_time() - start;
+    }
+
+    *copy_time = ucs_time_to_usec(copy) / iters;
+    *read_time = ucs_time_to_usec(read) / iters;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size     = 64 * UCS_MBYTE;
+    size_t set_size = 4 * UCS_MBYTE;
+    unsigned iters  = 20;
+    double copy_time, read_time;
+    ucg_builtin_op_t *op;
+    uint8_t *dst, *src;
+    uint64_t *set;
+    int is_stream;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:w:i:")) != -1) {
+        switch (c) {
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            set_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s <copy size>] [-w <working set>] "
+                    "[-i <iterations>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((iters == 0) || (size == 0) || (set_size < sizeof(*set))) {
+        fprintf(stderr, "at least 1 iteration, a byte and a working set\n");
+        return EXIT_FAILURE;
+    }
+
+    op = calloc(1, sizeof(*op));
+    if ((op == NULL) ||
+        posix_memalign((void**)&dst, UCS_SYS_CACHE_LINE_SIZE, size) ||
+        posix_memalign((void**)&src, UCS_SYS_CACHE_LINE_SIZE, size) ||
+        posix_memalign((void**)&set, UCS_SYS_CACHE_LINE_SIZE, set_size)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(dst, 0, size);
+    memset(src, 1, size);
+    memset(set, 2, set_size);
+
+    printf("copies of %zu bytes, then a read of %zu bytes\n", size, set_size);
+    printf("%-10s %12s %12s %12s\n", "stores", "copy", "rate", "read after");
+
+    for (is_stream = 0; is_stream <= 1; is_stream++) {
+        op->flags = is_stream ? UCG_BUILTIN_OP_FLAG_STREAM_COPY : 0;
+        bench_stream_run(op, dst, src, size, set, set_size, iters, &copy_time,
+                         &read_time);
+        printf("%-10s %9.0f us %7.2f GB/s %9.1f us\n",
+               is_stream ? "streaming" : "regular", copy_time,
+               size / (copy_time * 1e3), read_time);
+    }
+
+    free(set);
+    free(src);
+    free(dst);
+    free(op);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Loopback benchmark of the zero-copy threshold (see BUILTIN_ZCOPY_THRESH):
+ * broadcasts of every power of two up to -s, once only with buffer-copy
+ * ("inf") and once only with zero-copy ("0") - to find where the latter
+ * actually starts winning on this host, next to the threshold the "auto" model
+ * picks from the transports' reported costs, and from measured ones (with
+ * BUILTIN_ZCOPY_CALIBRATE). The buffers are re-used by every iteration, as an
+ * application typically does, so registrations are mostly cache hits.
+ *
+ * Usage: bench_zcopy_thresh [-n <members>] [-s <max. size>] [-i <iterations>]
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+#include <ucs/time/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define BENCH_ZCOPY_MIN_SIZE (256)
+#define BENCH_ZCOPY_WARMUP   (10)
+
+static void bench_zcopy_params(ucg_collective_params_t *params,
+                               uint8_t **buffers, unsigned member_cnt,
+                               size_t size)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        memset(&params[idx], 0, sizeof(params[idx]));
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+        UCG_PARAM_TYPE(&params[idx]).root = 0;
+        params[idx].send.buffer           = buffers[idx];
+        params[idx].send.count            = size;
+        params[idx].recv.buffer           = buffers[idx];
+        params[idx].recv.count            = size;
+    }
+}
+
+/* The threshold picked for the root's first step, as the ops use it */
+static size_t bench_zcopy_picked(test_loopback_t *lb,
+                                 ucg_collective_params_t *params)
+{
+    ucg_builtin_op_step_t *step;
+    ucs_status_t status;
+    size_t thresh;
+    ucg_coll_h coll;
+
+    status = ucg_collective_create(lb->members[0].group, &params[0], &coll);
+    TEST_CHECK(status == UCS_OK, "create: %s", ucs_status_string(status));
+
+    step   = ucs_derived_of(coll, ucg_builtin_op_t)->steps;
+    thresh = step->phase->send_thresh.zcopy_thresh;
+
+    ucg_collective_destroy(coll);
+    return thresh;
+}
+
+/* Time every size with the given threshold, in us per broadcast */
+static size_t bench_zcopy_run(const char *thresh, int calibrate,
+                              unsigned member_cnt, size_t max_size,
+                              unsigned iters, uint8_t **buffers,
+                              double *times)
+{
+    ucg_collective_params_t *params;
+    ucs_time_t start = 0;
+    ucs_status_t status;
+    test_loopback_t lb;
+    unsigned idx, iter;
+    size_t size, picked;
+
+    /* the configuration is read once per context, so before it is created */
+    setenv("UCX_BUILTIN_ZCOPY_THRESH", thresh, 1);
+    setenv("UCX_BUILTIN_ZCOPY_CALIBRATE", calibrate ? "y" : "n", 1);
+
+    status = test_loopback_init(&lb, member_cnt, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    params = calloc(member_cnt, sizeof(*params));
+    TEST_CHECK(params != NULL, "out of memory");
+
+    bench_zcopy_params(params, buffers, member_cnt, max_size);
+    picked = bench_zcopy_picked(&lb, params);
+
+    for (size = BENCH_ZCOPY_MIN_SIZE; (times != NULL) && (size <= max_size);
+         size *= 2, times++) {
+        bench_zcopy_params(params, buffers, member_cnt, size);
+        for (iter = 0; iter < iters + BENCH_ZCOPY_WARMUP; iter++) {
+            if (iter == BENCH_ZCOPY_WARMUP) {
+                start = ucs_get_time();
+            }
+
+            status = test_loopback_collective(&lb, params);
+            TEST_CHECK(status == UCS_OK, "bcast: %s",
+                       ucs_status_string(status));
+        }
+
+        *times = ucs_time_to_usec(ucs_get_time() - start) / iters;
+
+        for (idx = 1; idx < member_cnt; idx++) {
+            TEST_CHECK(!memcmp(buffers[0], buffers[idx], size),
+                       "member #%u: wrong data (threshold %s)", idx, thresh);
+        }
+    }
+
+    free(params);
+    test_loopback_cleanup(&lb);
+    return picked;
+}
+
+static void bench_zcopy_print_thresh(const char *name, size_t thresh)
+{
+    if (thresh == UCS_MEMUNITS_INF) {
+        printf("%-28s %12s\n", name, "inf");
+    } else {
+        printf("%-28s %12zu\n", name, thresh);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned member_cnt = 2;
+    size_t max_size     = 4 * UCS_MBYTE;
+    unsigned iters      = 1000;
+    size_t size, crossover, reported, calibrated;
+    double *bcopy, *zcopy;
+    unsigned idx, cnt;
+    uint8_t **buffers;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:i:")) != -1) {
+        switch (c) {
+        case 'n':
+            member_cnt = atoi(optarg);
+            break;
+        case 's':
+            max_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n <members>] [-s <max. size>] "
+                    "[-i <iterations>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((member_cnt < 2) || (iters == 0) || (max_size < BENCH_ZCOPY_MIN_SIZE)) {
+        fprintf(stderr, "at least 2 members, 1 iteration and %zu bytes\n",
+                (size_t)BENCH_ZCOPY_MIN_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    for (cnt = 0, size = BENCH_ZCOPY_MIN_SIZE; size <= max_size; size *= 2) {
+        cnt++;
+    }
+
+    bcopy   = calloc(cnt, sizeof(*bcopy));
+    zcopy   = calloc(cnt, sizeof(*zcopy));
+    buffers = calloc(member_cnt, sizeof(*buffers));
+    TEST_CHECK((bcopy != NULL) && (zcopy != NULL) && (buffers != NULL),
+               "out of memory");
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        buffers[idx] = malloc(max_size);
+        TEST_CHECK(buffers[idx] != NULL, "out of memory");
+        memset(buffers[idx], (idx == 0) ? 0x5a : 0, max_size);
+    }
+
+    bench_zcopy_run("inf", 0, member_cnt, max_size, iters, buffers, bcopy);
+    bench_zcopy_run("0", 0, member_cnt, max_size, iters, buffers, zcopy);
+    reported   = bench_zcopy_run("auto", 0, member_cnt, max_size, iters,
+                                 buffers, NULL);
+    calibrated = bench_zcopy_run("auto", 1, member_cnt, max_size, iters,
+                                 buffers, NULL);
+
+    printf("%u members, us per broadcast:\n", member_cnt);
+    printf("%12s %12s %12s %8s\n", "size", "bcopy", "zcopy", "speedup");
+
+    crossover = UCS_MEMUNITS_INF;
+    for (idx = 0, size = BENCH_ZCOPY_MIN_SIZE; idx < cnt; idx++, size *= 2) {
+        printf("%12zu %12.2f %12.2f %7.2fx\n", size, bcopy[idx], zcopy[idx],
+               bcopy[idx] / zcopy[idx]);
+        if ((crossover == UCS_MEMUNITS_INF) && (zcopy[idx] < bcopy[idx])) {
+            crossover = size;
+        }
+    }
+
+    bench_zcopy_print_thresh("measured crossover", crossover);
+    bench_zcopy_print_thresh("auto (reported costs)", reported);
+    bench_zcopy_print_thresh("auto (calibrated costs)", calibrated);
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        free(buffers[idx]);
+    }
+
+    free(buffers);
+    free(zcopy);
+    free(bcopy);
+    return EXIT_SUCCESS;
+}
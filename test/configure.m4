@@ -0,0 +1,42 @@
+#
+# Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+# See file LICENSE for terms.
+#
+
+#
+# Detect ThreadSanitizer support (for test_reduce_threads_tsan)
+#
+AC_MSG_CHECKING([for ThreadSanitizer support])
+SAVE_CFLAGS="$CFLAGS"
+SAVE_LDFLAGS="$LDFLAGS"
+CFLAGS="$CFLAGS -fsanitize=thread"
+LDFLAGS="$LDFLAGS -fsanitize=thread"
+AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <pthread.h>]],
+                                [[return pthread_self() == 0;]])],
+               [AC_MSG_RESULT([yes])
+                ucg_have_tsan=yes],
+               [AC_MSG_RESULT([no])
+                ucg_have_tsan=no])
+CFLAGS="$SAVE_CFLAGS"
+LDFLAGS="$SAVE_LDFLAGS"
+AM_CONDITIONAL([HAVE_TSAN], [test "x$ucg_have_tsan" = xyes])
+
+#
+# Detect UndefinedBehaviorSanitizer support (for test_reduce_ubsan)
+#
+AC_MSG_CHECKING([for UndefinedBehaviorSanitizer support])
+SAVE_CFLAGS="$CFLAGS"
+SAVE_LDFLAGS="$LDFLAGS"
+CFLAGS="$CFLAGS -fsanitize=undefined"
+LDFLAGS="$LDFLAGS -fsanitize=undefined"
+AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <stdint.h>]],
+                                [[volatile uint16_t x = 1; return x * x;]])],
+               [AC_MSG_RESULT([yes])
+                ucg_have_ubsan=yes],
+               [AC_MSG_RESULT([no])
+                ucg_have_ubsan=no])
+CFLAGS="$SAVE_CFLAGS"
+LDFLAGS="$SAVE_LDFLAGS"
+AM_CONDITIONAL([HAVE_UBSAN], [test "x$ucg_have_ubsan" = xyes])
+
+AC_CONFIG_FILES([src/ucg/test/Makefile])
@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_TEST_CHECK_H_
+#define UCG_TEST_CHECK_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Fail the test (with a printf-like message) unless the condition holds */
+#define TEST_CHECK(_cond, ...) \
+    do { \
+        if (!(_cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #_cond); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+#endif
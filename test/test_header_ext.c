@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the extended message headers (see ucg_builtin_header_ext_t), beyond
+ * the limits of the compact one:
+ *
+ * 1. The 16-bit local_id: more broadcasts outstanding at once than the 8-bit
+ *    coll_id can tell apart - ops 256 apart share the same coll_id, and only
+ *    the upper bits (msg_hi) tell their messages apart.
+ *
+ * 2. The 32-bit remote_offset: a gather whose last member's chunk starts at
+ *    4GB into the root's buffer, so that it is only placed right by way of
+ *    remote_offset_hi. This needs some 8GB of memory, so it is skipped on
+ *    smaller hosts.
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+#include <ucg/api/ucg_mpi.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define TEST_HEADER_EXT_OPS        300 /* > 256, all outstanding together */
+#define TEST_HEADER_EXT_WINDOW     512
+#define TEST_HEADER_EXT_MSG_SIZE   64
+#define TEST_HEADER_EXT_ROOT       0
+#define TEST_HEADER_EXT_MEMBER     1
+
+#define TEST_HEADER_EXT_GATHER_MEMBERS 3
+#define TEST_HEADER_EXT_GATHER_CHUNK   (2 * UCS_GBYTE) /* the last at 4GB */
+
+static void test_header_ext_bcast_start(test_loopback_t *lb,
+                                        ucg_group_member_index_t index,
+                                        uint8_t *buffer, ucg_coll_h *coll,
+                                        test_loopback_req_t *req)
+{
+    ucg_collective_params_t params;
+    ucs_status_t status;
+
+    memset(&params, 0, sizeof(params));
+    UCG_PARAM_TYPE(&params).modifiers =
+            ucg_predefined_modifiers[UCG_PRIMITIVE_BCAST];
+    UCG_PARAM_TYPE(&params).root      = TEST_HEADER_EXT_ROOT;
+    params.send.buffer                = buffer;
+    params.send.count                 = TEST_HEADER_EXT_MSG_SIZE;
+    params.recv.buffer                = buffer;
+    params.recv.count                 = TEST_HEADER_EXT_MSG_SIZE;
+
+    status = ucg_collective_create(lb->members[index].group, &params, coll);
+    TEST_CHECK(status == UCS_OK, "create on member #%u: %s", index,
+               ucs_status_string(status));
+
+    *req   = 0;
+    status = ucg_collective_start(*coll, (void*)req);
+    TEST_CHECK((status == UCS_OK) || (status == UCS_INPROGRESS),
+               "start on member #%u: %s", index, ucs_status_string(status));
+    if (status == UCS_OK) {
+        *req = 1;
+    }
+}
+
+static void test_header_ext_coll_ids(void)
+{
+    static uint8_t buffers[2][TEST_HEADER_EXT_OPS][TEST_HEADER_EXT_MSG_SIZE];
+    static test_loopback_req_t reqs[2][TEST_HEADER_EXT_OPS];
+    static ucg_coll_h colls[2][TEST_HEADER_EXT_OPS];
+    ucg_builtin_comp_window_t *window;
+    test_loopback_t lb;
+    ucs_status_t status;
+    unsigned idx;
+
+    status = test_loopback_init(&lb, 2, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    /* The receiver starts them all first, so all of them are outstanding */
+    for (idx = 0; idx < TEST_HEADER_EXT_OPS; idx++) {
+        memset(buffers[TEST_HEADER_EXT_ROOT][idx], (uint8_t)(idx + 1),
+               TEST_HEADER_EXT_MSG_SIZE);
+        test_header_ext_bcast_start(&lb, TEST_HEADER_EXT_MEMBER,
+                                    buffers[TEST_HEADER_EXT_MEMBER][idx],
+                                    &colls[TEST_HEADER_EXT_MEMBER][idx],
+                                    &reqs[TEST_HEADER_EXT_MEMBER][idx]);
+    }
+
+    window = UCG_BUILTIN_OP_GET_WINDOW(ucs_derived_of(
+                     colls[TEST_HEADER_EXT_MEMBER][0], ucg_builtin_op_t)->gctx);
+    TEST_CHECK(window->slot_flags & UCG_BUILTIN_REQUEST_FLAG_HEADER_EXT,
+               "extended headers are not used");
+    TEST_CHECK(window->mask + 1 > UINT8_MAX, "only %u slots for %u ops",
+               window->mask + 1, TEST_HEADER_EXT_OPS);
+
+    for (idx = 0; idx < TEST_HEADER_EXT_OPS; idx++) {
+        test_header_ext_bcast_start(&lb, TEST_HEADER_EXT_ROOT,
+                                    buffers[TEST_HEADER_EXT_ROOT][idx],
+                                    &colls[TEST_HEADER_EXT_ROOT][idx],
+                                    &reqs[TEST_HEADER_EXT_ROOT][idx]);
+    }
+
+    test_loopback_wait(&lb, reqs[TEST_HEADER_EXT_ROOT], TEST_HEADER_EXT_OPS);
+    test_loopback_wait(&lb, reqs[TEST_HEADER_EXT_MEMBER], TEST_HEADER_EXT_OPS);
+
+    for (idx = 0; idx < TEST_HEADER_EXT_OPS; idx++) {
+        TEST_CHECK(!memcmp(buffers[TEST_HEADER_EXT_ROOT][idx],
+                           buffers[TEST_HEADER_EXT_MEMBER][idx],
+                           TEST_HEADER_EXT_MSG_SIZE),
+                   "op #%u (coll_id %u): wrong data", idx, idx & UINT8_MAX);
+        ucg_collective_destroy(colls[TEST_HEADER_EXT_ROOT][idx]);
+        ucg_collective_destroy(colls[TEST_HEADER_EXT_MEMBER][idx]);
+    }
+
+    test_loopback_cleanup(&lb);
+}
+
+static int test_header_ext_gather_fits(void)
+{
+    /* the root's buffer, one send buffer (shared by all) - and some spare */
+    size_t needed = (TEST_HEADER_EXT_GATHER_MEMBERS + 2) *
+                    TEST_HEADER_EXT_GATHER_CHUNK;
+
+    return ((size_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE)) >= needed;
+}
+
+static uint8_t test_header_ext_pattern(size_t offset)
+{
+    /* never 0, which the root's buffer starts as */
+    return (uint8_t)((offset * 7) + (offset >> 12)) | 1;
+}
+
+static void test_header_ext_offsets(void)
+{
+    ucg_collective_params_t params[TEST_HEADER_EXT_GATHER_MEMBERS];
+    ucg_group_member_index_t idx;
+    uint8_t *send_buffer, *recv_buffer;
+    test_loopback_t lb;
+    ucs_status_t status;
+    size_t offset;
+    char fanin[16];
+
+    /* one level, so that every member sends its chunk to the root directly */
+    snprintf(fanin, sizeof(fanin), "%u", TEST_HEADER_EXT_GATHER_MEMBERS);
+    setenv("UCX_BUILTIN_BMTREE_DEGREE_INTRA_FANIN", fanin, 1);
+    setenv("UCX_BUILTIN_BMTREE_DEGREE_INTER_FANIN", fanin, 1);
+
+    status = test_loopback_init(&lb, TEST_HEADER_EXT_GATHER_MEMBERS, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    send_buffer = malloc(TEST_HEADER_EXT_GATHER_CHUNK);
+    recv_buffer = calloc(TEST_HEADER_EXT_GATHER_MEMBERS,
+                         TEST_HEADER_EXT_GATHER_CHUNK);
+    TEST_CHECK((send_buffer != NULL) && (recv_buffer != NULL), "out of memory");
+
+    for (offset = 0; offset < TEST_HEADER_EXT_GATHER_CHUNK; offset++) {
+        send_buffer[offset] = test_header_ext_pattern(offset);
+    }
+
+    /*
+     * Every member sends the same data, so a chunk placed at the wrong offset
+     * (e.g. without its upper bits, on top of the root's own) leaves its own
+     * place in the root's buffer zeroed.
+     */
+    for (idx = 0; idx < TEST_HEADER_EXT_GATHER_MEMBERS; idx++) {
+        memset(&params[idx], 0, sizeof(params[idx]));
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                ucg_predefined_modifiers[UCG_PRIMITIVE_GATHER];
+        UCG_PARAM_TYPE(&params[idx]).root = TEST_HEADER_EXT_ROOT;
+        params[idx].send.buffer           = send_buffer;
+        params[idx].send.count            = TEST_HEADER_EXT_GATHER_CHUNK;
+        params[idx].recv.buffer           = (idx == TEST_HEADER_EXT_ROOT) ?
+                                            recv_buffer : NULL;
+        params[idx].recv.count            = TEST_HEADER_EXT_GATHER_CHUNK;
+    }
+
+    status = test_loopback_collective(&lb, params);
+    TEST_CHECK(status == UCS_OK, "gather: %s", ucs_status_string(status));
+
+    for (idx = 0; idx < TEST_HEADER_EXT_GATHER_MEMBERS; idx++) {
+        TEST_CHECK(!memcmp(recv_buffer + (idx * TEST_HEADER_EXT_GATHER_CHUNK),
+                           send_buffer, TEST_HEADER_EXT_GATHER_CHUNK),
+                   "the chunk of member #%u (at %zu bytes) is wrong", idx,
+                   (size_t)(idx * TEST_HEADER_EXT_GATHER_CHUNK));
+    }
+
+    free(recv_buffer);
+    free(send_buffer);
+    test_loopback_cleanup(&lb);
+}
+
+int main(int argc, char **argv)
+{
+    /* the configuration is read once per context, so before any is created */
+    setenv("UCX_BUILTIN_HEADER_EXT", "on", 1);
+    setenv("UCX_BUILTIN_MAX_CONCURRENT_OPS",
+           UCS_PP_QUOTE(TEST_HEADER_EXT_WINDOW), 1);
+
+    test_header_ext_coll_ids();
+    printf("header ext: %u broadcasts outstanding at once\n",
+           TEST_HEADER_EXT_OPS);
+
+    if (test_header_ext_gather_fits()) {
+        test_header_ext_offsets();
+        printf("header ext: a gather of %u chunks of %zu bytes\n",
+               TEST_HEADER_EXT_GATHER_MEMBERS,
+               (size_t)TEST_HEADER_EXT_GATHER_CHUNK);
+    } else {
+        printf("header ext: not enough memory for the 4GB offset, skipped\n");
+    }
+
+    return EXIT_SUCCESS;
+}
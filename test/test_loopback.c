@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "test_loopback.h"
+
+#include <ucs/debug/log.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int test_loopback_lookup(void *cb_group_context,
+                                ucg_group_member_index_t index,
+                                ucp_address_t **addr, size_t *addr_len)
+{
+    test_loopback_t *lb = cb_group_context;
+
+    if (index >= lb->member_cnt) {
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    *addr     = lb->members[index].address;
+    *addr_len = lb->members[index].address_length;
+    return UCS_OK;
+}
+
+static void test_loopback_release(ucp_address_t *addr)
+{
+    /* the addresses are kept until test_loopback_cleanup() */
+}
+
+static ucs_status_t test_loopback_member_init(test_loopback_member_t *member,
+                                              const ucg_params_t *params)
+{
+    ucs_status_t status;
+    ucg_config_t *config;
+    ucp_worker_params_t worker_params = {0};
+
+    status = ucg_config_read(NULL, NULL, &config);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    status = ucg_init(params, config, &member->context);
+    ucg_config_release(config);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    status = ucp_worker_create(ucg_context_get_ucp(member->context),
+                               &worker_params, &member->worker);
+    if (status != UCS_OK) {
+        goto err_cleanup_context;
+    }
+
+    status = ucp_worker_get_address(member->worker, &member->address,
+                                    &member->address_length);
+    if (status != UCS_OK) {
+        goto err_destroy_worker;
+    }
+
+    return UCS_OK;
+
+err_destroy_worker:
+    ucp_worker_destroy(member->worker);
+err_cleanup_context:
+    ucg_cleanup(member->context);
+    return status;
+}
+
+static void test_loopback_member_cleanup(test_loopback_member_t *member)
+{
+    if (member->group != NULL) {
+        ucg_group_destroy(member->group);
+    }
+
+    ucp_worker_release_address(member->worker, member->address);
+    ucp_worker_destroy(member->worker);
+    ucg_cleanup(member->context);
+}
+
+ucs_status_t test_loopback_init(test_loopback_t *lb,
+                                ucg_group_member_index_t member_cnt,
+                                const ucg_params_t *params)
+{
+    ucs_status_t status;
+    ucg_group_member_index_t idx;
+    ucp_params_t ucp_params   = {
+        .field_mask           = UCP_PARAM_FIELD_FEATURES,
+        .features             = UCP_FEATURE_GROUPS
+    };
+    ucg_params_t ucg_params   = {0};
+    ucg_group_params_t group_params = {
+        .field_mask           = UCG_GROUP_PARAM_FIELD_ID           |
+                                UCG_GROUP_PARAM_FIELD_MEMBER_COUNT |
+                                UCG_GROUP_PARAM_FIELD_MEMBER_INDEX |
+                                UCG_GROUP_PARAM_FIELD_CB_CONTEXT   |
+                                UCG_GROUP_PARAM_FIELD_DISTANCES,
+        .id                   = TEST_LOOPBACK_GROUP_ID,
+        .member_count         = member_cnt,
+        .cb_context           = lb,
+        .distance_type        = UCG_GROUP_DISTANCE_TYPE_FIXED,
+        .distance_value       = UCG_GROUP_MEMBER_DISTANCE_SOCKET
+    };
+
+    if (params != NULL) {
+        ucg_params = *params;
+    }
+
+    if (ucg_params.super == NULL) {
+        ucg_params.super = &ucp_params;
+    }
+
+    ucg_params.field_mask        |= UCG_PARAM_FIELD_ADDRESS_CB;
+    ucg_params.address.lookup_f   = test_loopback_lookup;
+    ucg_params.address.release_f  = test_loopback_release;
+
+    lb->member_cnt = member_cnt;
+    lb->members    = calloc(member_cnt, sizeof(*lb->members));
+    if (lb->members == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    /* all the addresses are needed before any group is created */
+    for (idx = 0; idx < member_cnt; idx++) {
+        status = test_loopback_member_init(&lb->members[idx], &ucg_params);
+        if (status != UCS_OK) {
+            goto err_cleanup;
+        }
+    }
+
+    for (idx = 0; idx < member_cnt; idx++) {
+        group_params.member_index = idx;
+        status = ucg_group_create(lb->members[idx].worker, &group_params,
+                                  &lb->members[idx].group);
+        if (status != UCS_OK) {
+            lb->members[idx].group = NULL;
+            idx                    = member_cnt;
+            goto err_cleanup;
+        }
+    }
+
+    return UCS_OK;
+
+err_cleanup:
+    while (idx--) {
+        test_loopback_member_cleanup(&lb->members[idx]);
+    }
+    free(lb->members);
+    return status;
+}
+
+void test_loopback_cleanup(test_loopback_t *lb)
+{
+    ucg_group_member_index_t idx;
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        test_loopback_member_cleanup(&lb->members[idx]);
+    }
+
+    free(lb->members);
+}
+
+unsigned test_loopback_progress(test_loopback_t *lb)
+{
+    ucg_group_member_index_t idx;
+    unsigned count = 0;
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        count += ucp_worker_progress(lb->members[idx].worker);
+    }
+
+    return count;
+}
+
+void test_loopback_wait(test_loopback_t *lb, test_loopback_req_t *reqs,
+                        unsigned req_cnt)
+{
+    unsigned idx = 0;
+
+    while (idx < req_cnt) {
+        if (reqs[idx]) {
+            idx++;
+        } else {
+            test_loopback_progress(lb);
+        }
+    }
+}
+
+ucs_status_t test_loopback_collective(test_loopback_t *lb,
+                                      const ucg_collective_params_t *params)
+{
+    ucg_group_member_index_t idx;
+    test_loopback_req_t *reqs;
+    ucs_status_t status;
+    ucg_coll_h *colls;
+
+    reqs  = calloc(lb->member_cnt, sizeof(*reqs));
+    colls = calloc(lb->member_cnt, sizeof(*colls));
+    if ((reqs == NULL) || (colls == NULL)) {
+        status = UCS_ERR_NO_MEMORY;
+        goto out;
+    }
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        status = ucg_collective_create(lb->members[idx].group, &params[idx],
+                                       &colls[idx]);
+        if (status != UCS_OK) {
+            ucs_error("member #%u failed to create a collective: %s", idx,
+                      ucs_status_string(status));
+            goto out_destroy;
+        }
+    }
+
+    for (idx = 0; idx < lb->member_cnt; idx++) {
+        status = ucg_collective_start(colls[idx], (void*)&reqs[idx]);
+        if (status == UCS_OK) {
+            reqs[idx] = 1;
+        } else if (status != UCS_INPROGRESS) {
+            ucs_error("member #%u failed to start a collective: %s", idx,
+                      ucs_status_string(status));
+            /* the others may never complete without it */
+            abort();
+        }
+    }
+
+    test_loopback_wait(lb, reqs, lb->member_cnt);
+    status = UCS_OK;
+    idx    = lb->member_cnt;
+
+out_destroy:
+    while (idx--) {
+        ucg_collective_destroy(colls[idx]);
+    }
+out:
+    free(colls);
+    free((void*)reqs);
+    return status;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_TEST_LOOPBACK_H_
+#define UCG_TEST_LOOPBACK_H_
+
+#include <ucg/api/ucg.h>
+
+BEGIN_C_DECLS
+
+/*
+ * All the members of a group, inside this process: each member has its own
+ * UCG context (the builtin planner keeps one group per ID in a context) and
+ * worker, and all of them are progressed by the calling thread. The default
+ * completion is used, so a request is a single byte, set once it completes.
+ */
+typedef struct test_loopback_member {
+    ucg_context_h  context;
+    ucp_worker_h   worker;
+    ucp_address_t *address;
+    size_t         address_length;
+    ucg_group_h    group;
+} test_loopback_member_t;
+
+typedef struct test_loopback {
+    ucg_group_member_index_t member_cnt;
+    test_loopback_member_t  *members;
+} test_loopback_t;
+
+typedef volatile uint8_t test_loopback_req_t;
+
+#define TEST_LOOPBACK_GROUP_ID (2) /* any ID - each member has its own context */
+
+/*
+ * Create the members of the group. The given UCG parameters (may be NULL)
+ * are passed to every context, except for the address callbacks.
+ */
+ucs_status_t test_loopback_init(test_loopback_t *lb,
+                                ucg_group_member_index_t member_cnt,
+                                const ucg_params_t *params);
+
+void test_loopback_cleanup(test_loopback_t *lb);
+
+/* Progress every member once */
+unsigned test_loopback_progress(test_loopback_t *lb);
+
+/* Progress every member until all the given requests are completed */
+void test_loopback_wait(test_loopback_t *lb, test_loopback_req_t *reqs,
+                        unsigned req_cnt);
+
+/*
+ * Run one collective operation on every member (with params[i] for member i),
+ * from creation to completion and destruction.
+ */
+ucs_status_t test_loopback_collective(test_loopback_t *lb,
+                                      const ucg_collective_params_t *params);
+
+END_C_DECLS
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the striping of large zero-copy sends across the lanes to a peer (see
+ * @ref ucg_builtin_step_rails_t ): broadcasts over two rails - of a size which
+ * neither the fragment length nor the rail schedule divide evenly, so that the
+ * lanes take a different number of fragments, and the last one is shorter.
+ * Every byte should be placed where it belongs, whichever lane carried it.
+ *
+ * The two lanes come from UCP (see @ref ucg_plan_connect_rails ), so this needs
+ * a transport configuration which offers two of them to a loopback peer - if
+ * there is only one, the test still checks the data, but says it was skipped.
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_RAILS_MEMBERS 2
+#define TEST_RAILS_ROUNDS  4
+#define TEST_RAILS_SIZE    ((4 * UCS_MBYTE) + 13) /* not a multiple of either */
+
+static uint8_t test_rails_pattern(size_t offset, unsigned round)
+{
+    /* never 0, which the receivers' buffers start as */
+    return (uint8_t)((offset * 13) + (offset >> 8) + round) | 1;
+}
+
+static void test_rails_params(ucg_collective_params_t *params,
+                              uint8_t **buffers, ucg_group_member_index_t root)
+{
+    ucg_group_member_index_t idx;
+
+    for (idx = 0; idx < TEST_RAILS_MEMBERS; idx++) {
+        memset(&params[idx], 0, sizeof(params[idx]));
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+        UCG_PARAM_TYPE(&params[idx]).root = root;
+        params[idx].send.buffer           = buffers[idx];
+        params[idx].send.count            = TEST_RAILS_SIZE;
+        params[idx].recv.buffer           = buffers[idx];
+        params[idx].recv.count            = TEST_RAILS_SIZE;
+    }
+}
+
+/* The lanes of the root's send step - 1 unless it is striped */
+static unsigned test_rails_count(test_loopback_t *lb,
+                                 ucg_collective_params_t *params,
+                                 ucg_group_member_index_t root,
+                                 size_t *fragment_length)
+{
+    ucg_builtin_op_step_t *step;
+    ucs_status_t status;
+    unsigned rail_cnt;
+    ucg_coll_h coll;
+
+    status = ucg_collective_create(lb->members[root].group, &params[root],
+                                   &coll);
+    TEST_CHECK(status == UCS_OK, "create on member #%u: %s", root,
+               ucs_status_string(status));
+
+    rail_cnt         = 1;
+    *fragment_length = 0;
+    step             = ucs_derived_of(coll, ucg_builtin_op_t)->steps;
+    do {
+        if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
+            (step->rails != NULL)) {
+            rail_cnt         = step->rails->cnt;
+            *fragment_length = step->fragment_length;
+        }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
+    ucg_collective_destroy(coll);
+    return rail_cnt;
+}
+
+int main(int argc, char **argv)
+{
+    ucg_collective_params_t params[TEST_RAILS_MEMBERS];
+    uint8_t *buffers[TEST_RAILS_MEMBERS];
+    ucg_group_member_index_t root, idx;
+    size_t offset, fragment_length;
+    unsigned round, rail_cnt;
+    test_loopback_t lb;
+    ucs_status_t status;
+
+    /* the configuration is read once per context, so before any is created */
+    setenv("UCX_MAX_EAGER_RAILS", "2", 0);
+    setenv("UCX_MAX_RNDV_RAILS", "2", 0);
+    setenv("UCX_BUILTIN_MAX_RAILS", "2", 1);
+    setenv("UCX_BUILTIN_ZCOPY_THRESH", "0", 1);
+
+    status = test_loopback_init(&lb, TEST_RAILS_MEMBERS, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    for (idx = 0; idx < TEST_RAILS_MEMBERS; idx++) {
+        buffers[idx] = malloc(TEST_RAILS_SIZE);
+        TEST_CHECK(buffers[idx] != NULL, "out of memory");
+    }
+
+    test_rails_params(params, buffers, 0);
+    rail_cnt = test_rails_count(&lb, params, 0, &fragment_length);
+
+    for (round = 0; round < TEST_RAILS_ROUNDS; round++) {
+        root = round % TEST_RAILS_MEMBERS;
+        for (idx = 0; idx < TEST_RAILS_MEMBERS; idx++) {
+            if (idx != root) {
+                memset(buffers[idx], 0, TEST_RAILS_SIZE);
+                continue;
+            }
+
+            for (offset = 0; offset < TEST_RAILS_SIZE; offset++) {
+                buffers[idx][offset] = test_rails_pattern(offset, round);
+            }
+        }
+
+        test_rails_params(params, buffers, root);
+        status = test_loopback_collective(&lb, params);
+        TEST_CHECK(status == UCS_OK, "bcast from root #%u: %s", root,
+                   ucs_status_string(status));
+
+        for (idx = 0; idx < TEST_RAILS_MEMBERS; idx++) {
+            for (offset = 0; offset < TEST_RAILS_SIZE; offset++) {
+                TEST_CHECK(buffers[idx][offset] ==
+                           test_rails_pattern(offset, round),
+                           "round #%u: byte #%zu on member #%u is 0x%x "
+                           "(fragment #%zu)", round, offset, idx,
+                           buffers[idx][offset], fragment_length ?
+                           (offset / fragment_length) : 0);
+            }
+        }
+    }
+
+    for (idx = 0; idx < TEST_RAILS_MEMBERS; idx++) {
+        free(buffers[idx]);
+    }
+
+    test_loopback_cleanup(&lb);
+
+    if (rail_cnt < 2) {
+        printf("rails: only one lane to the peer, striping skipped\n");
+    } else {
+        printf("rails: %u rounds of %zu bytes, in fragments of %zu over %u "
+               "lanes\n", TEST_RAILS_ROUNDS, (size_t)TEST_RAILS_SIZE,
+               fragment_length, rail_cnt);
+    }
+
+    return EXIT_SUCCESS;
+}
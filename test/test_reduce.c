@@ -0,0 +1,485 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check every native reducer (see builtin_reduce.c) against a plain scalar
+ * reference, in every instruction-set variant this CPU supports: for each
+ * fragment length up to a few vectors (so every tail length is covered), from
+ * aligned and unaligned buffers, and for the full-message reducers as well.
+ * Integers are also checked with extreme values (e.g. 0xFFFF * 0xFFFF), whose
+ * results overflow - this test is built under UndefinedBehaviorSanitizer too,
+ * as test_reduce_ubsan, which fails if any of those is computed as an int.
+ * Operations a variant leaves for reduce_cb_f are skipped.
+ */
+
+#include "test_check.h"
+
+#include <ucg/api/ucg_plan_component.h>
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#define TEST_REDUCE_MAX_COUNT (3 * 64 + 7) /* 512-bit vectors of int8, +tail */
+#define TEST_REDUCE_MAX_SIZE  (16) /* of an element, e.g. double_int */
+#define TEST_REDUCE_SEED      (12345)
+
+typedef enum test_reduce_kind {
+    TEST_REDUCE_INT,
+    TEST_REDUCE_FLOAT,
+    TEST_REDUCE_HALF,
+    TEST_REDUCE_BFLOAT16,
+    TEST_REDUCE_PAIR
+} test_reduce_kind_t;
+
+typedef struct { float  value; int index; } test_reduce_float_int_t;
+typedef struct { double value; int index; } test_reduce_double_int_t;
+typedef struct { long   value; int index; } test_reduce_long_int_t;
+typedef struct { short  value; int index; } test_reduce_short_int_t;
+typedef struct { int    value; int index; } test_reduce_2int_t;
+
+/* The opaque datatype handles passed to the library point to these */
+typedef struct test_reduce_dtype {
+    const char         *name;
+    test_reduce_kind_t  kind;
+    size_t              size;         /* of an element (or pair) */
+    size_t              value_size;   /* of the value, within a pair */
+    size_t              index_offset; /* of the index, within a pair */
+    int                 is_signed;
+    int                 pair;         /* enum ucg_datatype_pair, for pairs */
+} test_reduce_dtype_t;
+
+#define TEST_REDUCE_PAIR_DTYPE(_name, _value_type, _PAIR) \
+    {#_name, TEST_REDUCE_PAIR, sizeof(test_reduce_##_name##_t), \
+     sizeof(_value_type), offsetof(test_reduce_##_name##_t, index), 1, \
+     UCG_DATATYPE_PAIR_##_PAIR}
+
+static const test_reduce_dtype_t test_reduce_dtypes[] = {
+    {"int8",       TEST_REDUCE_INT,      1, 1, 0, 1, 0},
+    {"int16",      TEST_REDUCE_INT,      2, 2, 0, 1, 0},
+    {"int32",      TEST_REDUCE_INT,      4, 4, 0, 1, 0},
+    {"int64",      TEST_REDUCE_INT,      8, 8, 0, 1, 0},
+    {"uint8",      TEST_REDUCE_INT,      1, 1, 0, 0, 0},
+    {"uint16",     TEST_REDUCE_INT,      2, 2, 0, 0, 0},
+    {"uint32",     TEST_REDUCE_INT,      4, 4, 0, 0, 0},
+    {"uint64",     TEST_REDUCE_INT,      8, 8, 0, 0, 0},
+    {"float",      TEST_REDUCE_FLOAT,    4, 4, 0, 1, 0},
+    {"double",     TEST_REDUCE_FLOAT,    8, 8, 0, 1, 0},
+    {"half",       TEST_REDUCE_HALF,     2, 2, 0, 1, 0},
+    {"bfloat16",   TEST_REDUCE_BFLOAT16, 2, 2, 0, 1, 0},
+    TEST_REDUCE_PAIR_DTYPE(float_int,  float,  FLOAT_INT),
+    TEST_REDUCE_PAIR_DTYPE(double_int, double, DOUBLE_INT),
+    TEST_REDUCE_PAIR_DTYPE(long_int,   long,   LONG_INT),
+    TEST_REDUCE_PAIR_DTYPE(short_int,  short,  SHORT_INT),
+    TEST_REDUCE_PAIR_DTYPE(2int,       int,    2INT)
+};
+
+static const char *test_reduce_op_names[UCG_REDUCE_OP_LAST] = {
+    [UCG_REDUCE_OP_SUM]    = "sum",
+    [UCG_REDUCE_OP_PROD]   = "prod",
+    [UCG_REDUCE_OP_MIN]    = "min",
+    [UCG_REDUCE_OP_MAX]    = "max",
+    [UCG_REDUCE_OP_LAND]   = "land",
+    [UCG_REDUCE_OP_LOR]    = "lor",
+    [UCG_REDUCE_OP_LXOR]   = "lxor",
+    [UCG_REDUCE_OP_BAND]   = "band",
+    [UCG_REDUCE_OP_BOR]    = "bor",
+    [UCG_REDUCE_OP_BXOR]   = "bxor",
+    [UCG_REDUCE_OP_MINLOC] = "minloc",
+    [UCG_REDUCE_OP_MAXLOC] = "maxloc"
+};
+
+/* The opaque operation handles are these, one per operation */
+static int test_reduce_ops[UCG_REDUCE_OP_LAST];
+
+static int test_reduce_is_integer(void *datatype, int *is_signed)
+{
+    const test_reduce_dtype_t *dt = datatype;
+
+    *is_signed = dt->is_signed;
+    return dt->kind == TEST_REDUCE_INT;
+}
+
+static int test_reduce_is_floating_point(void *datatype)
+{
+    const test_reduce_dtype_t *dt = datatype;
+
+    return (dt->kind == TEST_REDUCE_FLOAT) || (dt->kind == TEST_REDUCE_HALF) ||
+           (dt->kind == TEST_REDUCE_BFLOAT16);
+}
+
+static int test_reduce_is_bfloat16(void *datatype)
+{
+    return ((const test_reduce_dtype_t*)datatype)->kind == TEST_REDUCE_BFLOAT16;
+}
+
+static int test_reduce_get_pair(void *datatype)
+{
+    return ((const test_reduce_dtype_t*)datatype)->pair;
+}
+
+static int test_reduce_get_type(void *reduce_op)
+{
+    return (int*)reduce_op - test_reduce_ops;
+}
+
+static int test_reduce_is_sum(void *reduce_op)
+{
+    return test_reduce_get_type(reduce_op) == UCG_REDUCE_OP_SUM;
+}
+
+/* Exact for the small integers used here, which is all the reference needs */
+static float test_reduce_half_load(uint16_t h)
+{
+    int exp = (h >> 10) & 0x1f;
+    float f = (exp == 0) ? 0.0f : (float)(0x400 | (h & 0x3ff)) *
+              ((exp >= 25) ? (float)(1 << (exp - 25)) :
+                             1.0f / (float)(1 << (25 - exp)));
+
+    return (h & 0x8000) ? -f : f;
+}
+
+static uint16_t test_reduce_half_store(float f)
+{
+    uint16_t sign = signbit(f) ? 0x8000 : 0;
+    int exp       = 15;
+
+    f = fabsf(f);
+    if (f == 0) {
+        return sign;
+    }
+
+    while (f >= 2.0f) {
+        f /= 2;
+        exp++;
+    }
+
+    while (f < 1.0f) {
+        f *= 2;
+        exp--;
+    }
+
+    return sign | (exp << 10) | (uint16_t)((f - 1.0f) * 1024);
+}
+
+static float test_reduce_bfloat16_load(uint16_t b)
+{
+    uint32_t u = (uint32_t)b << 16;
+    float f;
+
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+/* Round to nearest even (there are no NaNs here) */
+static uint16_t test_reduce_bfloat16_store(float f)
+{
+    uint32_t u;
+
+    memcpy(&u, &f, sizeof(u));
+    return (u + 0x7fff + ((u >> 16) & 1)) >> 16;
+}
+
+static uint64_t test_reduce_load_int(const uint8_t *ptr, size_t size,
+                                     int is_signed)
+{
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+
+    switch (size) {
+    case 1: memcpy(&i8,  ptr, 1); return is_signed ? (uint64_t)i8  : (uint8_t)i8;
+    case 2: memcpy(&i16, ptr, 2); return is_signed ? (uint64_t)i16 : (uint16_t)i16;
+    case 4: memcpy(&i32, ptr, 4); return is_signed ? (uint64_t)i32 : (uint32_t)i32;
+    default: memcpy(&i64, ptr, 8); return (uint64_t)i64;
+    }
+}
+
+/* Compare as the (signed or unsigned) type of the given size would */
+static int test_reduce_int_less(uint64_t a, uint64_t b, int is_signed)
+{
+    return is_signed ? ((int64_t)a < (int64_t)b) : (a < b);
+}
+
+static uint64_t test_reduce_ref_int(int op, uint64_t d, uint64_t s,
+                                    int is_signed)
+{
+    switch (op) {
+    case UCG_REDUCE_OP_SUM:  return d + s;
+    case UCG_REDUCE_OP_PROD: return d * s;
+    case UCG_REDUCE_OP_MIN:  return test_reduce_int_less(s, d, is_signed) ? s : d;
+    case UCG_REDUCE_OP_MAX:  return test_reduce_int_less(d, s, is_signed) ? s : d;
+    case UCG_REDUCE_OP_LAND: return d && s;
+    case UCG_REDUCE_OP_LOR:  return d || s;
+    case UCG_REDUCE_OP_LXOR: return !d != !s;
+    case UCG_REDUCE_OP_BAND: return d & s;
+    case UCG_REDUCE_OP_BOR:  return d | s;
+    default:                 return d ^ s;
+    }
+}
+
+static double test_reduce_ref_float(int op, double d, double s)
+{
+    switch (op) {
+    case UCG_REDUCE_OP_SUM:  return d + s;
+    case UCG_REDUCE_OP_PROD: return d * s;
+    case UCG_REDUCE_OP_MIN:  return (s < d) ? s : d;
+    default:                 return (s > d) ? s : d;
+    }
+}
+
+/* Reduce one element (or pair) the way MPI defines it */
+static void test_reduce_ref(const test_reduce_dtype_t *dt, int op,
+                            uint8_t *dst, const uint8_t *src)
+{
+    uint64_t d, s, r;
+    uint16_t h;
+    double f;
+    float g;
+    int di, si, take;
+
+    switch (dt->kind) {
+    case TEST_REDUCE_INT:
+        d = test_reduce_load_int(dst, dt->size, dt->is_signed);
+        s = test_reduce_load_int(src, dt->size, dt->is_signed);
+        r = test_reduce_ref_int(op, d, s, dt->is_signed);
+        memcpy(dst, &r, dt->size); /* little-endian: the low bytes */
+        break;
+
+    case TEST_REDUCE_FLOAT:
+        if (dt->size == sizeof(float)) {
+            g = test_reduce_ref_float(op, *(float*)dst, *(float*)src);
+            memcpy(dst, &g, sizeof(g));
+        } else {
+            f = test_reduce_ref_float(op, *(double*)dst, *(double*)src);
+            memcpy(dst, &f, sizeof(f));
+        }
+        break;
+
+    case TEST_REDUCE_HALF:
+        h = test_reduce_half_store(test_reduce_ref_float(op,
+                test_reduce_half_load(*(uint16_t*)dst),
+                test_reduce_half_load(*(uint16_t*)src)));
+        memcpy(dst, &h, sizeof(h));
+        break;
+
+    case TEST_REDUCE_BFLOAT16:
+        h = test_reduce_bfloat16_store(test_reduce_ref_float(op,
+                test_reduce_bfloat16_load(*(uint16_t*)dst),
+                test_reduce_bfloat16_load(*(uint16_t*)src)));
+        memcpy(dst, &h, sizeof(h));
+        break;
+
+    case TEST_REDUCE_PAIR:
+        /* the values are small integers, so comparing them as such will do */
+        if (dt->pair == UCG_DATATYPE_PAIR_FLOAT_INT) {
+            d = (int64_t)*(float*)dst;
+            s = (int64_t)*(float*)src;
+        } else if (dt->pair == UCG_DATATYPE_PAIR_DOUBLE_INT) {
+            d = (int64_t)*(double*)dst;
+            s = (int64_t)*(double*)src;
+        } else {
+            d = test_reduce_load_int(dst, dt->value_size, 1);
+            s = test_reduce_load_int(src, dt->value_size, 1);
+        }
+
+        memcpy(&di, dst + dt->index_offset, sizeof(int));
+        memcpy(&si, src + dt->index_offset, sizeof(int));
+        take = (op == UCG_REDUCE_OP_MINLOC) ?
+               test_reduce_int_less(s, d, 1) : test_reduce_int_less(d, s, 1);
+        if (take || ((d == s) && (si < di))) {
+            memcpy(dst, src, dt->size);
+        }
+        break;
+    }
+}
+
+/*
+ * Small values, so that floating-point results are exact (and ties occur) -
+ * but no zeros, since MIN and MAX may pick either of -0.0 and +0.0. Some of
+ * the bfloat16 values are tiny, so that rounding them back is checked too.
+ * Extreme integers are all-ones, or the lowest or highest signed values.
+ */
+static void test_reduce_fill(const test_reduce_dtype_t *dt, uint8_t *buffer,
+                             size_t count, int is_extreme)
+{
+    size_t i, j;
+    uint16_t h;
+    int value, index;
+    float g;
+    double f;
+
+    for (i = 0; i < count; i++, buffer += dt->size) {
+        value = (rand() % 16) - 8;
+        value = (value >= 0) ? value + 1 : value;
+        switch (dt->kind) {
+        case TEST_REDUCE_INT:
+            if (is_extreme) {
+                index = rand() % 3;
+                memset(buffer, (index == 1) ? 0 : 0xff, dt->size);
+                if (index > 0) {
+                    buffer[dt->size - 1] = (index == 1) ? 0x80 : 0x7f;
+                }
+                break;
+            }
+
+            for (j = 0; j < dt->size; j++) {
+                buffer[j] = rand(); /* any bits - integers wrap around */
+            }
+            if ((rand() % 4) == 0) {
+                memset(buffer, 0, dt->size); /* for the logical operations */
+            }
+            break;
+
+        case TEST_REDUCE_FLOAT:
+            g = value;
+            f = value;
+            memcpy(buffer, (dt->size == sizeof(float)) ? (void*)&g : (void*)&f,
+                   dt->size);
+            break;
+
+        case TEST_REDUCE_HALF:
+        case TEST_REDUCE_BFLOAT16:
+            h = (dt->kind == TEST_REDUCE_HALF) ? test_reduce_half_store(value) :
+                                                 test_reduce_bfloat16_store(value);
+            if ((dt->kind == TEST_REDUCE_BFLOAT16) && ((rand() % 8) == 0)) {
+                /* sub-normal, which AVX-512 BF16 conversions flush to zero */
+                h = (rand() & 0x8000) | (1 + (rand() % 0x7f));
+            }
+            memcpy(buffer, &h, sizeof(h));
+            break;
+
+        case TEST_REDUCE_PAIR:
+            memset(buffer, 0, dt->size); /* padding included */
+            index = rand() % 4;
+            if (dt->pair == UCG_DATATYPE_PAIR_FLOAT_INT) {
+                g = value;
+                memcpy(buffer, &g, sizeof(g));
+            } else if (dt->pair == UCG_DATATYPE_PAIR_DOUBLE_INT) {
+                f = value;
+                memcpy(buffer, &f, sizeof(f));
+            } else {
+                memcpy(buffer, &value, dt->value_size); /* little-endian */
+                if (value < 0) {
+                    memset(buffer + sizeof(value), 0xff,
+                           (dt->value_size > sizeof(value)) ?
+                           dt->value_size - sizeof(value) : 0);
+                }
+            }
+            memcpy(buffer + dt->index_offset, &index, sizeof(index));
+            break;
+        }
+    }
+}
+
+static void test_reduce_check(const char *isa, const test_reduce_dtype_t *dt,
+                              int op, ucg_op_reduce_full_f full_f,
+                              ucg_op_reduce_frag_f frag_f, ucg_op_t *coll)
+{
+    /* one element more than needed, to start off an unaligned address */
+    static uint8_t dst[(TEST_REDUCE_MAX_COUNT + 1) *
+                       TEST_REDUCE_MAX_SIZE] UCS_V_ALIGNED(64);
+    static uint8_t src[(TEST_REDUCE_MAX_COUNT + 1) *
+                       TEST_REDUCE_MAX_SIZE] UCS_V_ALIGNED(64);
+    static uint8_t ref[(TEST_REDUCE_MAX_COUNT + 1) *
+                       TEST_REDUCE_MAX_SIZE] UCS_V_ALIGNED(64);
+    uint8_t *d, *s, *r;
+    size_t count, i, misalign;
+    int pass, is_extreme;
+
+    for (pass = 0; pass < 3; pass++) {
+        misalign   = pass % 2;
+        is_extreme = (pass == 2);
+        if (is_extreme && (dt->kind != TEST_REDUCE_INT)) {
+            break;
+        }
+
+        for (count = 0; count <= TEST_REDUCE_MAX_COUNT; count++) {
+            d = dst + (misalign * dt->size);
+            s = src + (misalign * dt->size);
+            r = ref;
+
+            test_reduce_fill(dt, d, count, is_extreme);
+            test_reduce_fill(dt, s, count, is_extreme);
+            memcpy(r, d, count * dt->size);
+            for (i = 0; i < count; i++) {
+                test_reduce_ref(dt, op, r + (i * dt->size), s + (i * dt->size));
+            }
+
+            if (count == coll->params.recv.count) {
+                full_f(d, s, coll);
+            } else {
+                frag_f(d, s, count * dt->size, coll);
+            }
+
+            for (i = 0; i < count * dt->size; i++) {
+                TEST_CHECK(d[i] == r[i], "%s %s on %s: %zu element(s)%s, "
+                           "byte #%zu is 0x%02x instead of 0x%02x", isa,
+                           test_reduce_op_names[op], dt->name, count,
+                           is_extreme ? " (extreme)" :
+                           misalign ? " (unaligned)" : "", i, d[i], r[i]);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ucg_op_reduce_full_f full_f;
+    ucg_op_reduce_frag_f frag_f;
+    const test_reduce_dtype_t *dt;
+    unsigned isa, dt_idx, checked;
+    const char *isa_name;
+    ucg_op_t *coll;
+    int op;
+
+    ucg_global_params.datatype.is_integer_f        = test_reduce_is_integer;
+    ucg_global_params.datatype.is_floating_point_f = test_reduce_is_floating_point;
+    ucg_global_params.datatype.is_bfloat16_f       = test_reduce_is_bfloat16;
+    ucg_global_params.datatype.get_pair_f          = test_reduce_get_pair;
+    ucg_global_params.reduce_op.get_type_f         = test_reduce_get_type;
+    ucg_global_params.reduce_op.is_sum_f           = test_reduce_is_sum;
+
+    /* the full-message reducers take the count from the op (aligned) */
+    TEST_CHECK(!posix_memalign((void**)&coll, UCS_SYS_CACHE_LINE_SIZE,
+                               sizeof(*coll)), "out of memory");
+    memset(coll, 0, sizeof(*coll));
+    coll->params.recv.count = TEST_REDUCE_MAX_COUNT - 1;
+
+    srand(TEST_REDUCE_SEED);
+    checked = 0;
+    for (isa = 0; ; isa++) {
+        for (dt_idx = 0; dt_idx < ucs_static_array_size(test_reduce_dtypes);
+             dt_idx++) {
+            dt = &test_reduce_dtypes[dt_idx];
+            for (op = UCG_REDUCE_OP_SUM; op < UCG_REDUCE_OP_LAST; op++) {
+                isa_name = ucg_builtin_reduce_select_isa(isa, (void*)dt,
+                                                         &test_reduce_ops[op],
+                                                         dt->size, &full_f,
+                                                         &frag_f);
+                if (isa_name == NULL) {
+                    goto out;
+                }
+
+                if (full_f != NULL) {
+                    test_reduce_check(isa_name, dt, op, full_f, frag_f, coll);
+                    checked++;
+                }
+            }
+        }
+
+        printf("reduce: %s kernels match the reference\n", isa_name);
+    }
+
+out:
+    TEST_CHECK(isa > 0, "no kernels at all");
+    printf("reduce: checked %u kernel(s) in %u variant(s)\n", checked, isa);
+    free(coll);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the reduction helper threads (see builtin_reduce_pool.c): reductions
+ * split among them should give the same result as done inline, for any length
+ * and chunk size (including chunks of partial elements), also while several
+ * threads share the same helpers - those which find them busy should be told
+ * to reduce alone. Pools are also destroyed right after being created, before
+ * their helpers are even waiting. This test is built twice: once against
+ * libucg, and (if the compiler supports it) once with the helper threads
+ * built in under ThreadSanitizer, as test_reduce_threads_tsan.
+ */
+
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_THREADS_HELPERS  3
+#define TEST_THREADS_CALLERS  4
+#define TEST_THREADS_ROUNDS   200
+#define TEST_THREADS_THRESH   (4096)
+#define TEST_THREADS_CHUNK    (1001) /* not a multiple of the element size */
+#define TEST_THREADS_MAX_CNT  (16 * 1024)
+#define TEST_THREADS_CYCLES   20
+
+typedef struct test_threads_caller {
+    ucg_builtin_reduce_pool_t *pool;
+    pthread_t                  thread;
+    unsigned                   seed;
+    unsigned                   split_cnt; /* reductions the helpers took */
+} test_threads_caller_t;
+
+static void test_threads_sum(uint8_t *dst, uint8_t *src, size_t frag_len,
+                             ucg_op_t *op)
+{
+    uint64_t *d       = (uint64_t*)dst;
+    const uint64_t *s = (const uint64_t*)src;
+    size_t i;
+
+    TEST_CHECK((frag_len % sizeof(uint64_t)) == 0,
+               "a chunk of %zu bytes, with a partial element", frag_len);
+
+    for (i = 0; i < frag_len / sizeof(uint64_t); i++) {
+        d[i] += s[i];
+    }
+}
+
+/* Reduce "count" elements, and check the result - returns whether it split */
+static int test_threads_reduce(ucg_builtin_reduce_pool_t *pool, size_t count,
+                               uint64_t *dst, uint64_t *src, uint64_t base)
+{
+    size_t length = count * sizeof(uint64_t);
+    int is_split;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        dst[i] = base + i;
+        src[i] = i * 3;
+    }
+
+    is_split = ucg_builtin_reduce_pool_run(pool, test_threads_sum, NULL,
+                                           (uint8_t*)dst, (uint8_t*)src,
+                                           length, sizeof(uint64_t));
+    if (is_split) {
+        TEST_CHECK(length >= TEST_THREADS_THRESH,
+                   "a reduction of %zu bytes was split", length);
+    } else {
+        test_threads_sum((uint8_t*)dst, (uint8_t*)src, length, NULL);
+    }
+
+    for (i = 0; i < count; i++) {
+        TEST_CHECK(dst[i] == base + (i * 4), "element #%zu of %zu is %lu "
+                   "instead of %lu", i, count, (unsigned long)dst[i],
+                   (unsigned long)(base + (i * 4)));
+    }
+
+    return is_split;
+}
+
+static void* test_threads_caller(void *arg)
+{
+    test_threads_caller_t *caller = arg;
+    uint64_t *dst                 = malloc(TEST_THREADS_MAX_CNT *
+                                           sizeof(uint64_t));
+    uint64_t *src                 = malloc(TEST_THREADS_MAX_CNT *
+                                           sizeof(uint64_t));
+    unsigned round;
+    size_t count;
+
+    TEST_CHECK((dst != NULL) && (src != NULL), "out of memory");
+
+    for (round = 0; round < TEST_THREADS_ROUNDS; round++) {
+        count              = 1 + (rand_r(&caller->seed) % TEST_THREADS_MAX_CNT);
+        caller->split_cnt += test_threads_reduce(caller->pool, count, dst, src,
+                                                 round);
+    }
+
+    free(src);
+    free(dst);
+    return NULL;
+}
+
+static ucg_builtin_reduce_pool_t *test_threads_create(unsigned helper_cnt)
+{
+    ucg_builtin_reduce_pool_t *pool;
+    ucs_status_t status;
+
+    status = ucg_builtin_reduce_pool_create(helper_cnt, TEST_THREADS_CHUNK,
+                                            TEST_THREADS_THRESH, &pool);
+    TEST_CHECK(status == UCS_OK, "pool create: %s", ucs_status_string(status));
+    TEST_CHECK(ucg_builtin_reduce_pool_thresh(pool) == TEST_THREADS_THRESH,
+               "threshold is %zu", ucg_builtin_reduce_pool_thresh(pool));
+    return pool;
+}
+
+int main(int argc, char **argv)
+{
+    test_threads_caller_t callers[TEST_THREADS_CALLERS];
+    ucg_builtin_reduce_pool_t *pool;
+    unsigned idx, split_cnt;
+    uint64_t *dst, *src;
+    size_t count;
+
+    dst = malloc(TEST_THREADS_MAX_CNT * sizeof(uint64_t));
+    src = malloc(TEST_THREADS_MAX_CNT * sizeof(uint64_t));
+    TEST_CHECK((dst != NULL) && (src != NULL), "out of memory");
+
+    /* One caller: every length around the threshold and the chunk size */
+    pool = test_threads_create(TEST_THREADS_HELPERS);
+    for (count = 1; count <= 4 * TEST_THREADS_THRESH / sizeof(uint64_t);
+         count++) {
+        (void)test_threads_reduce(pool, count, dst, src, count);
+    }
+    TEST_CHECK(test_threads_reduce(pool, TEST_THREADS_MAX_CNT, dst, src, 0),
+               "a reduction of %zu bytes was not split",
+               TEST_THREADS_MAX_CNT * sizeof(uint64_t));
+
+    /* Several callers sharing the helpers */
+    for (idx = 0; idx < TEST_THREADS_CALLERS; idx++) {
+        callers[idx].pool      = pool;
+        callers[idx].seed      = idx;
+        callers[idx].split_cnt = 0;
+        TEST_CHECK(!pthread_create(&callers[idx].thread, NULL,
+                                   test_threads_caller, &callers[idx]),
+                   "failed to create caller #%u", idx);
+    }
+
+    split_cnt = 0;
+    for (idx = 0; idx < TEST_THREADS_CALLERS; idx++) {
+        pthread_join(callers[idx].thread, NULL);
+        split_cnt += callers[idx].split_cnt;
+    }
+
+    printf("reduce threads: %u of %u concurrent reductions were split\n",
+           split_cnt, TEST_THREADS_CALLERS * TEST_THREADS_ROUNDS);
+    TEST_CHECK(split_cnt > 0, "no concurrent reduction was split");
+    ucg_builtin_reduce_pool_destroy(pool);
+
+    /* Destroyed right away, and with more helpers than cores (unbound) */
+    for (idx = 0; idx < TEST_THREADS_CYCLES; idx++) {
+        pool = test_threads_create(1 + (idx % 4) * 16);
+        if (idx % 2) {
+            (void)test_threads_reduce(pool, TEST_THREADS_MAX_CNT, dst, src,
+                                      idx);
+        }
+        ucg_builtin_reduce_pool_destroy(pool);
+    }
+
+    free(src);
+    free(dst);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the resend of a step which ran out of resources: the root's transport
+ * is replaced by a mock, which fails every send on a "blocked" endpoint with
+ * UCS_ERR_NO_RESOURCE, and keeps the requests added to the pending queue of
+ * such an endpoint (so they are only dispatched here). The request should wait
+ * on the endpoint it ran out on, move to another endpoint if that one runs out
+ * next, complete once no endpoint is blocked - and still be released if the
+ * group is destroyed while the transport holds on to it.
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_RESEND_MEMBERS  3
+#define TEST_RESEND_MSG_SIZE 64
+#define TEST_RESEND_ROOT     0
+#define TEST_RESEND_MAX_EPS  (TEST_RESEND_MEMBERS - 1)
+#define TEST_RESEND_MAX_REQS (16)
+
+static struct {
+    uct_iface_ops_t    orig_ops;
+    uct_ep_h           blocked[TEST_RESEND_MAX_EPS];
+    unsigned           blocked_cnt;
+    struct {
+        uct_ep_h           ep;
+        uct_pending_req_t *req;
+    }                  pending[TEST_RESEND_MAX_REQS];
+    unsigned           pending_cnt;
+    unsigned           no_resource_cnt;
+} test_resend_mock;
+
+static int test_resend_is_blocked(uct_ep_h ep)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < test_resend_mock.blocked_cnt; idx++) {
+        if (test_resend_mock.blocked[idx] == ep) {
+            test_resend_mock.no_resource_cnt++;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static ucs_status_t test_resend_am_short(uct_ep_h ep, uint8_t id,
+                                         uint64_t header, const void *payload,
+                                         unsigned length)
+{
+    return test_resend_is_blocked(ep) ? UCS_ERR_NO_RESOURCE :
+           test_resend_mock.orig_ops.ep_am_short(ep, id, header, payload,
+                                                 length);
+}
+
+static ssize_t test_resend_am_bcopy(uct_ep_h ep, uint8_t id,
+                                    uct_pack_callback_t pack_cb, void *arg,
+                                    unsigned flags)
+{
+    return test_resend_is_blocked(ep) ? UCS_ERR_NO_RESOURCE :
+           test_resend_mock.orig_ops.ep_am_bcopy(ep, id, pack_cb, arg, flags);
+}
+
+static ucs_status_t test_resend_am_zcopy(uct_ep_h ep, uint8_t id,
+                                         const void *header,
+                                         unsigned header_length,
+                                         const uct_iov_t *iov, size_t iovcnt,
+                                         unsigned flags, uct_completion_t *comp)
+{
+    return test_resend_is_blocked(ep) ? UCS_ERR_NO_RESOURCE :
+           test_resend_mock.orig_ops.ep_am_zcopy(ep, id, header, header_length,
+                                                 iov, iovcnt, flags, comp);
+}
+
+static ucs_status_t test_resend_pending_add(uct_ep_h ep, uct_pending_req_t *n,
+                                            unsigned flags)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < test_resend_mock.blocked_cnt; idx++) {
+        if (test_resend_mock.blocked[idx] == ep) {
+            break;
+        }
+    }
+
+    if (idx == test_resend_mock.blocked_cnt) {
+        return UCS_ERR_BUSY; /* as a transport which could send right away */
+    }
+
+    TEST_CHECK(test_resend_mock.pending_cnt < TEST_RESEND_MAX_REQS,
+               "too many pending requests");
+    idx                                 = test_resend_mock.pending_cnt++;
+    test_resend_mock.pending[idx].ep  = ep;
+    test_resend_mock.pending[idx].req = n;
+    return UCS_OK;
+}
+
+/* How many requests wait on the pending queue of the given endpoint */
+static unsigned test_resend_pending_cnt(uct_ep_h ep)
+{
+    unsigned idx, count = 0;
+
+    for (idx = 0; idx < test_resend_mock.pending_cnt; idx++) {
+        count += (test_resend_mock.pending[idx].ep == ep);
+    }
+
+    return count;
+}
+
+/* Dispatch the pending queue of an endpoint, as its transport would */
+static void test_resend_dispatch(uct_ep_h ep)
+{
+    unsigned idx = 0, last;
+    uct_pending_req_t *req;
+
+    while (idx < test_resend_mock.pending_cnt) {
+        if (test_resend_mock.pending[idx].ep != ep) {
+            idx++;
+            continue;
+        }
+
+        /* remove it first - the callback may add requests of its own */
+        req  = test_resend_mock.pending[idx].req;
+        last = --test_resend_mock.pending_cnt;
+        memmove(&test_resend_mock.pending[idx], &test_resend_mock.pending[idx + 1],
+                (last - idx) * sizeof(test_resend_mock.pending[0]));
+
+        if (req->func(req) == UCS_ERR_NO_RESOURCE) {
+            /* still blocked - it stays first in line, and so do the rest */
+            memmove(&test_resend_mock.pending[idx + 1], &test_resend_mock.pending[idx],
+                    (test_resend_mock.pending_cnt - idx) *
+                    sizeof(test_resend_mock.pending[0]));
+            test_resend_mock.pending[idx].ep  = ep;
+            test_resend_mock.pending[idx].req = req;
+            test_resend_mock.pending_cnt++;
+            return;
+        }
+    }
+}
+
+static void test_resend_params(ucg_collective_params_t *params, void *buffer,
+                               size_t length)
+{
+    memset(params, 0, sizeof(*params));
+    UCG_PARAM_TYPE(params).modifiers = UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                                       UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+    UCG_PARAM_TYPE(params).root      = TEST_RESEND_ROOT;
+    params->send.buffer              = buffer;
+    params->send.count               = length;
+    params->recv.buffer              = buffer;
+    params->recv.count               = length;
+}
+
+/*
+ * The steps keep the send functions of their interface (see step->uct_send),
+ * so the mock has to be in place before the root's operation is created: an
+ * operation of another size is created (but never started) just to find the
+ * interface of the root's first step.
+ */
+static void test_resend_mock_install(test_loopback_t *lb)
+{
+    ucg_collective_params_t params;
+    uint8_t buffer[1];
+    ucg_builtin_op_t *op;
+    ucs_status_t status;
+    uct_iface_h iface;
+    ucg_coll_h coll;
+
+    test_resend_params(&params, buffer, sizeof(buffer));
+    status = ucg_collective_create(lb->members[TEST_RESEND_ROOT].group, &params,
+                                   &coll);
+    TEST_CHECK(status == UCS_OK, "create: %s", ucs_status_string(status));
+
+    op    = ucs_derived_of(coll, ucg_builtin_op_t);
+    iface = op->steps[0].uct_iface;
+    ucg_collective_destroy(coll);
+
+    test_resend_mock.orig_ops       = iface->ops;
+    iface->ops.ep_am_short          = test_resend_am_short;
+    iface->ops.ep_am_bcopy          = test_resend_am_bcopy;
+    iface->ops.ep_am_zcopy          = test_resend_am_zcopy;
+    iface->ops.ep_pending_add       = test_resend_pending_add;
+}
+
+/* Create the broadcast on every member, and return the root's endpoints */
+static unsigned test_resend_create(test_loopback_t *lb,
+                                   uint8_t (*buffers)[TEST_RESEND_MSG_SIZE],
+                                   ucg_coll_h *colls, uct_ep_h *eps)
+{
+    ucg_collective_params_t params;
+    ucg_builtin_op_step_t *step;
+    ucg_group_member_index_t idx;
+    ucs_status_t status;
+    unsigned ep_cnt;
+
+    for (idx = 0; idx < TEST_RESEND_MEMBERS; idx++) {
+        test_resend_params(&params, buffers[idx], TEST_RESEND_MSG_SIZE);
+        status = ucg_collective_create(lb->members[idx].group, &params,
+                                       &colls[idx]);
+        TEST_CHECK(status == UCS_OK, "create on member #%u: %s", idx,
+                   ucs_status_string(status));
+    }
+
+    step = &ucs_derived_of(colls[TEST_RESEND_ROOT], ucg_builtin_op_t)->steps[0];
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT) {
+        eps[0] = step->phase->single_ep;
+        return 1;
+    }
+
+    ep_cnt = ucs_min(step->ep_cnt, TEST_RESEND_MAX_EPS);
+    memcpy(eps, step->phase->multi_eps, ep_cnt * sizeof(*eps));
+    return ep_cnt;
+}
+
+static void test_resend_start(test_loopback_t *lb, ucg_coll_h *colls,
+                              test_loopback_req_t *reqs,
+                              ucs_status_t root_status)
+{
+    ucg_group_member_index_t idx;
+    ucs_status_t status;
+
+    /* the root last, so that nothing is progressed after it ran out */
+    for (idx = TEST_RESEND_MEMBERS; idx-- > 0;) {
+        reqs[idx] = 0;
+        status    = ucg_collective_start(colls[idx], (void*)&reqs[idx]);
+        if (idx == TEST_RESEND_ROOT) {
+            TEST_CHECK(status == root_status, "root start: %s",
+                       ucs_status_string(status));
+        } else {
+            TEST_CHECK(status == UCS_INPROGRESS, "start on member #%u: %s", idx,
+                       ucs_status_string(status));
+        }
+
+        if (status == UCS_OK) {
+            reqs[idx] = 1;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buffers[TEST_RESEND_MEMBERS][TEST_RESEND_MSG_SIZE];
+    test_loopback_req_t reqs[TEST_RESEND_MEMBERS];
+    ucg_coll_h colls[TEST_RESEND_MEMBERS];
+    uct_ep_h eps[TEST_RESEND_MAX_EPS];
+    ucg_group_member_index_t idx;
+    unsigned ep_cnt, moved = 0;
+    test_loopback_t lb;
+    ucs_status_t status;
+
+    status = test_loopback_init(&lb, TEST_RESEND_MEMBERS, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    test_resend_mock_install(&lb);
+    memset(buffers[TEST_RESEND_ROOT], 0x5a, TEST_RESEND_MSG_SIZE);
+
+    ep_cnt = test_resend_create(&lb, buffers, colls, eps);
+
+    /* every endpoint is blocked - the root waits on the first one */
+    memcpy(test_resend_mock.blocked, eps, ep_cnt * sizeof(*eps));
+    test_resend_mock.blocked_cnt = ep_cnt;
+    test_resend_start(&lb, colls, reqs, UCS_INPROGRESS);
+    TEST_CHECK(test_resend_mock.no_resource_cnt > 0, "nothing was blocked");
+    TEST_CHECK(test_resend_pending_cnt(eps[0]) == 1,
+               "%u request(s) wait on the first endpoint",
+               test_resend_pending_cnt(eps[0]));
+
+    if (ep_cnt > 1) {
+        /* the first endpoint frees up, but the next one is still blocked */
+        test_resend_mock.blocked[0]  = eps[1];
+        test_resend_mock.blocked_cnt = 1;
+        test_resend_dispatch(eps[0]);
+        TEST_CHECK(test_resend_pending_cnt(eps[0]) == 0,
+                   "the request was left on the first endpoint");
+        TEST_CHECK(test_resend_pending_cnt(eps[1]) == 1,
+                   "the request did not move to the next endpoint");
+        moved = 1;
+    }
+
+    /* nothing is blocked anymore - the request completes from the callback */
+    test_resend_mock.blocked_cnt = 0;
+    test_resend_dispatch(eps[moved]);
+    TEST_CHECK(test_resend_mock.pending_cnt == 0, "requests left pending");
+
+    test_loopback_wait(&lb, reqs, TEST_RESEND_MEMBERS);
+    for (idx = 0; idx < TEST_RESEND_MEMBERS; idx++) {
+        TEST_CHECK(!memcmp(buffers[TEST_RESEND_ROOT], buffers[idx],
+                           TEST_RESEND_MSG_SIZE), "member #%u: wrong data", idx);
+    }
+
+    /*
+     * Block the root again and destroy the groups while the request waits on
+     * the endpoint: the slot is released, and the callback (as it would be on
+     * a purge of the pending queue) only releases what the transport held.
+     */
+    test_resend_mock.blocked[0]  = eps[0];
+    test_resend_mock.blocked_cnt = 1;
+    test_resend_start(&lb, colls, reqs, UCS_INPROGRESS);
+    TEST_CHECK(test_resend_pending_cnt(eps[0]) == 1,
+               "the request does not wait on the endpoint");
+
+    for (idx = 0; idx < TEST_RESEND_MEMBERS; idx++) {
+        ucg_collective_destroy(colls[idx]);
+    }
+    test_loopback_cleanup(&lb);
+
+    TEST_CHECK(test_resend_mock.pending[0].req->func(
+                   test_resend_mock.pending[0].req) == UCS_OK,
+               "an orphaned resend was not released");
+
+    printf("resend: %u send(s) ran out of resources, moved between endpoints: "
+           "%s\n", test_resend_mock.no_resource_cnt, moved ? "yes" : "n/a");
+    return EXIT_SUCCESS;
+}
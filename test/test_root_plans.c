@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the cap on the plans of rooted collectives with a non-zero root (one
+ * key per modifiers, message size level and root - see
+ * @ref UCG_GROUP_ROOT_PLAN_KEY ): broadcasts from every root in turn, of small
+ * and large messages, with fewer keys allowed (by GROUP_OP_CACHE_SIZE) than
+ * there are - so that the least-recently-used ones are discarded over and
+ * over. The data should still arrive intact, the number of keys should never
+ * exceed the limit, and the plan of an op which is held (created and not yet
+ * destroyed) should be left alone - so the op can still be started again.
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/base/ucg_group.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_ROOT_PLANS_MEMBERS    6
+#define TEST_ROOT_PLANS_CACHE      2
+#define TEST_ROOT_PLANS_ROUNDS     3
+#define TEST_ROOT_PLANS_HELD_ROOT  1
+#define TEST_ROOT_PLANS_SMALL_SIZE 64
+#define TEST_ROOT_PLANS_LARGE_SIZE (UCG_GROUP_MED_MSG_SIZE + 1)
+
+static uint8_t test_root_plans_buffers[TEST_ROOT_PLANS_MEMBERS]
+                                      [TEST_ROOT_PLANS_LARGE_SIZE];
+
+static void test_root_plans_params(ucg_collective_params_t *params,
+                                   ucg_group_member_index_t root, size_t size,
+                                   uint8_t pattern)
+{
+    ucg_group_member_index_t idx;
+
+    for (idx = 0; idx < TEST_ROOT_PLANS_MEMBERS; idx++) {
+        memset(test_root_plans_buffers[idx], (idx == root) ? pattern : 0, size);
+
+        memset(&params[idx], 0, sizeof(params[idx]));
+        UCG_PARAM_TYPE(&params[idx]).modifiers =
+                UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+        UCG_PARAM_TYPE(&params[idx]).root = root;
+        params[idx].send.buffer           = test_root_plans_buffers[idx];
+        params[idx].send.count            = size;
+        params[idx].recv.buffer           = test_root_plans_buffers[idx];
+        params[idx].recv.count            = size;
+    }
+}
+
+static void test_root_plans_verify(test_loopback_t *lb,
+                                   ucg_group_member_index_t root, size_t size,
+                                   uint8_t pattern)
+{
+    ucg_group_member_index_t idx;
+    size_t offset;
+
+    for (idx = 0; idx < TEST_ROOT_PLANS_MEMBERS; idx++) {
+        for (offset = 0; offset < size; offset++) {
+            TEST_CHECK(test_root_plans_buffers[idx][offset] == pattern,
+                       "root #%u, %zu bytes: byte #%zu on member #%u is 0x%x",
+                       root, size, offset, idx,
+                       test_root_plans_buffers[idx][offset]);
+        }
+
+        TEST_CHECK(lb->members[idx].group->root_plan_cnt <=
+                   TEST_ROOT_PLANS_CACHE, "member #%u has %u root plan keys "
+                   "(of up to %u)", idx, lb->members[idx].group->root_plan_cnt,
+                   TEST_ROOT_PLANS_CACHE);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ucg_collective_params_t params[TEST_ROOT_PLANS_MEMBERS];
+    test_loopback_req_t reqs[TEST_ROOT_PLANS_MEMBERS];
+    ucg_coll_h held[TEST_ROOT_PLANS_MEMBERS];
+    ucg_group_member_index_t root, idx;
+    unsigned round, is_large, run = 0;
+    test_loopback_t lb;
+    ucs_status_t status;
+    size_t size;
+
+    setenv("UCX_GROUP_OP_CACHE_SIZE", UCS_PP_QUOTE(TEST_ROOT_PLANS_CACHE), 1);
+
+    status = test_loopback_init(&lb, TEST_ROOT_PLANS_MEMBERS, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    /* Hold one op per member, so that its plan may not be discarded */
+    test_root_plans_params(params, TEST_ROOT_PLANS_HELD_ROOT,
+                           TEST_ROOT_PLANS_SMALL_SIZE, 0xff);
+    for (idx = 0; idx < TEST_ROOT_PLANS_MEMBERS; idx++) {
+        status = ucg_collective_create(lb.members[idx].group, &params[idx],
+                                       &held[idx]);
+        TEST_CHECK(status == UCS_OK, "create on member #%u: %s", idx,
+                   ucs_status_string(status));
+    }
+
+    for (round = 0; round < TEST_ROOT_PLANS_ROUNDS; round++) {
+        for (root = 1; root < TEST_ROOT_PLANS_MEMBERS; root++) {
+            for (is_large = 0; is_large <= 1; is_large++) {
+                size = is_large ? TEST_ROOT_PLANS_LARGE_SIZE :
+                                  TEST_ROOT_PLANS_SMALL_SIZE;
+                test_root_plans_params(params, root, size, (uint8_t)++run);
+
+                status = test_loopback_collective(&lb, params);
+                TEST_CHECK(status == UCS_OK, "bcast from root #%u: %s", root,
+                           ucs_status_string(status));
+                test_root_plans_verify(&lb, root, size, (uint8_t)run);
+            }
+        }
+    }
+
+    /* The held ops still have their plans, and can run */
+    test_root_plans_params(params, TEST_ROOT_PLANS_HELD_ROOT,
+                           TEST_ROOT_PLANS_SMALL_SIZE, 0xff);
+    for (idx = 0; idx < TEST_ROOT_PLANS_MEMBERS; idx++) {
+        reqs[idx] = 0;
+        status    = ucg_collective_start(held[idx], (void*)&reqs[idx]);
+        TEST_CHECK((status == UCS_OK) || (status == UCS_INPROGRESS),
+                   "start on member #%u: %s", idx, ucs_status_string(status));
+        if (status == UCS_OK) {
+            reqs[idx] = 1;
+        }
+    }
+
+    test_loopback_wait(&lb, reqs, TEST_ROOT_PLANS_MEMBERS);
+    test_root_plans_verify(&lb, TEST_ROOT_PLANS_HELD_ROOT,
+                           TEST_ROOT_PLANS_SMALL_SIZE, 0xff);
+
+    for (idx = 0; idx < TEST_ROOT_PLANS_MEMBERS; idx++) {
+        ucg_collective_destroy(held[idx]);
+    }
+
+    test_loopback_cleanup(&lb);
+    printf("root plans: %u rounds over %u roots, with up to %u keys\n",
+           TEST_ROOT_PLANS_ROUNDS, TEST_ROOT_PLANS_MEMBERS - 1,
+           TEST_ROOT_PLANS_CACHE);
+    return EXIT_SUCCESS;
+}
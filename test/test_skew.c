@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the messages stored for collectives (and steps) which have not been
+ * started yet - in the hash of each slot of the window, by step key:
+ *
+ * 1. Directly: many keys per slot, several messages per key, where the hash of
+ *    a slot could not grow for one of them (as if out of memory). Those go to
+ *    the window's overflow queue - and so do all later ones, until the retry
+ *    moves them to their slots, each slot and key in the order of arrival.
+ *
+ * 2. With skewed arrival: the root runs a long series of broadcasts before any
+ *    other member starts even the first of them, so that every member has the
+ *    messages of all those future collectives stored when it finally does -
+ *    some of them fragmented, and more than may be kept in the transport's
+ *    descriptors (see BUILTIN_MAX_RETAINED_DESCS).
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_SKEW_SLOTS       4
+#define TEST_SKEW_COLLS       64   /* distinct coll_id values stored */
+#define TEST_SKEW_STEPS       4    /* distinct steps per coll_id */
+#define TEST_SKEW_MSGS        3    /* messages per coll_id and step */
+#define TEST_SKEW_STUCK       101  /* the message the hash "fails" to take */
+
+#define TEST_SKEW_MEMBERS     5
+#define TEST_SKEW_ROOT        0
+#define TEST_SKEW_OPS         100  /* ahead of the other members */
+#define TEST_SKEW_ROUNDS      3
+#define TEST_SKEW_SMALL_SIZE  64
+#define TEST_SKEW_LARGE_SIZE  (40 * 1024 + 3) /* fragmented, not a multiple */
+
+typedef struct test_skew_desc {
+    ucp_recv_desc_t      super;
+    ucg_builtin_header_t header;
+} test_skew_desc_t;
+
+static void test_skew_store(void)
+{
+    static test_skew_desc_t descs[TEST_SKEW_COLLS * TEST_SKEW_STEPS *
+                                  TEST_SKEW_MSGS];
+    ucg_builtin_comp_window_t window;
+    ucg_builtin_comp_slot_t *slot;
+    test_skew_desc_t *desc, *prev;
+    ucs_queue_head_t *queue;
+    ucs_queue_iter_t qiter;
+    unsigned idx, found;
+    khiter_t iter;
+
+    memset(&window, 0, sizeof(window));
+    window.mask  = TEST_SKEW_SLOTS - 1;
+    window.slots = calloc(TEST_SKEW_SLOTS, sizeof(*window.slots));
+    TEST_CHECK(window.slots != NULL, "out of memory");
+    ucs_queue_head_init(&window.pending);
+    ucs_queue_head_init(&window.overflow);
+
+    for (idx = 0; idx < TEST_SKEW_SLOTS; idx++) {
+        window.slots[idx] = calloc(1, sizeof(*window.slots[idx]));
+        TEST_CHECK(window.slots[idx] != NULL, "out of memory");
+        kh_init_inplace(ucg_builtin_msg, &window.slots[idx]->messages);
+    }
+
+    /* Messages arrive interleaved, the remote offset tells their order */
+    for (idx = 0; idx < ucs_static_array_size(descs); idx++) {
+        desc                              = &descs[idx];
+        desc->header.group_id             = 1;
+        desc->header.msg.coll_id          = idx % TEST_SKEW_COLLS;
+        desc->header.msg.step_idx         = (idx / TEST_SKEW_COLLS) %
+                                            TEST_SKEW_STEPS;
+        desc->header.remote_offset        = idx;
+
+        slot  = ucg_builtin_comp_window_slot(&window,
+                                             desc->header.msg.coll_id);
+        queue = (idx == TEST_SKEW_STUCK) ? &window.overflow : /* kh_put failed */
+                ucg_builtin_comp_window_queue(&window, slot,
+                        ucg_builtin_header_msg_key(&desc->header, 0));
+        TEST_CHECK((queue == &window.overflow) == (idx >= TEST_SKEW_STUCK),
+                   "message #%u was %squeued in the overflow", idx,
+                   (idx >= TEST_SKEW_STUCK) ? "not " : "");
+        ucs_queue_push(queue, &desc->super.tag_frag_queue);
+    }
+
+    ucg_builtin_comp_window_retry(&window);
+    TEST_CHECK(ucs_queue_is_empty(&window.overflow), "overflow left over");
+
+    /* Every message should be found under its own key, in arrival order */
+    found = 0;
+    for (idx = 0; idx < TEST_SKEW_SLOTS; idx++) {
+        slot = window.slots[idx];
+        TEST_CHECK(kh_size(&slot->messages) ==
+                   TEST_SKEW_COLLS / TEST_SKEW_SLOTS * TEST_SKEW_STEPS,
+                   "slot #%u has %u keys", idx, kh_size(&slot->messages));
+
+        for (iter = kh_begin(&slot->messages);
+             iter != kh_end(&slot->messages); iter++) {
+            if (!kh_exist(&slot->messages, iter)) {
+                continue;
+            }
+
+            prev = NULL;
+            ucs_queue_for_each_safe(desc, qiter, &kh_val(&slot->messages, iter),
+                                    super.tag_frag_queue) {
+                TEST_CHECK(ucg_builtin_header_msg_key(&desc->header, 0) ==
+                           kh_key(&slot->messages, iter), "message #%u is "
+                           "under the wrong key",
+                           (unsigned)desc->header.remote_offset);
+                TEST_CHECK((desc->header.msg.coll_id & window.mask) == idx,
+                           "message #%u is in slot #%u",
+                           (unsigned)desc->header.remote_offset, idx);
+                TEST_CHECK((prev == NULL) || (prev->header.remote_offset <
+                                              desc->header.remote_offset),
+                           "message #%u is queued after #%u",
+                           (unsigned)desc->header.remote_offset,
+                           (unsigned)prev->header.remote_offset);
+                prev = desc;
+                found++;
+            }
+        }
+
+        kh_destroy_inplace(ucg_builtin_msg, &slot->messages);
+        free(slot);
+    }
+
+    TEST_CHECK(found == ucs_static_array_size(descs), "found %u messages of "
+               "%zu", found, ucs_static_array_size(descs));
+    free(window.slots);
+}
+
+static size_t test_skew_size(unsigned op_idx)
+{
+    return (op_idx % 3) ? TEST_SKEW_SMALL_SIZE : TEST_SKEW_LARGE_SIZE;
+}
+
+static void test_skew_start(test_loopback_t *lb,
+                            ucg_group_member_index_t index, uint8_t *buffer,
+                            size_t size, ucg_coll_h *coll,
+                            test_loopback_req_t *req)
+{
+    ucg_collective_params_t params;
+    ucs_status_t status;
+
+    memset(&params, 0, sizeof(params));
+    UCG_PARAM_TYPE(&params).modifiers = UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                                        UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+    UCG_PARAM_TYPE(&params).root      = TEST_SKEW_ROOT;
+    params.send.buffer                = buffer;
+    params.send.count                 = size;
+    params.recv.buffer                = buffer;
+    params.recv.count                 = size;
+
+    status = ucg_collective_create(lb->members[index].group, &params, coll);
+    TEST_CHECK(status == UCS_OK, "create on member #%u: %s", index,
+               ucs_status_string(status));
+
+    *req   = 0;
+    status = ucg_collective_start(*coll, (void*)req);
+    TEST_CHECK((status == UCS_OK) || (status == UCS_INPROGRESS),
+               "start on member #%u: %s", index, ucs_status_string(status));
+    if (status == UCS_OK) {
+        *req = 1;
+    }
+}
+
+static void test_skew_broadcasts(test_loopback_t *lb, uint8_t **buffers,
+                                 unsigned round)
+{
+    test_loopback_req_t reqs[TEST_SKEW_MEMBERS][TEST_SKEW_OPS];
+    ucg_coll_h colls[TEST_SKEW_MEMBERS][TEST_SKEW_OPS];
+    ucg_group_member_index_t member;
+    unsigned op_idx;
+    uint8_t *buffer;
+    size_t size;
+
+    /* The root runs all of them first - the others store what arrives */
+    for (op_idx = 0; op_idx < TEST_SKEW_OPS; op_idx++) {
+        size   = test_skew_size(op_idx);
+        buffer = buffers[TEST_SKEW_ROOT] + (op_idx * TEST_SKEW_LARGE_SIZE);
+        memset(buffer, (uint8_t)(round * TEST_SKEW_OPS + op_idx + 1), size);
+        test_skew_start(lb, TEST_SKEW_ROOT, buffer, size,
+                        &colls[TEST_SKEW_ROOT][op_idx],
+                        &reqs[TEST_SKEW_ROOT][op_idx]);
+        test_loopback_wait(lb, &reqs[TEST_SKEW_ROOT][op_idx], 1);
+    }
+
+    /* ... and only then start theirs, one at a time, each a different one */
+    for (op_idx = 0; op_idx < TEST_SKEW_OPS; op_idx++) {
+        for (member = 0; member < TEST_SKEW_MEMBERS; member++) {
+            if (member == TEST_SKEW_ROOT) {
+                continue;
+            }
+
+            buffer = buffers[member] + (op_idx * TEST_SKEW_LARGE_SIZE);
+            memset(buffer, 0, TEST_SKEW_LARGE_SIZE);
+            test_skew_start(lb, member, buffer, test_skew_size(op_idx),
+                            &colls[member][op_idx], &reqs[member][op_idx]);
+        }
+    }
+
+    for (member = 0; member < TEST_SKEW_MEMBERS; member++) {
+        test_loopback_wait(lb, reqs[member], TEST_SKEW_OPS);
+    }
+
+    for (op_idx = 0; op_idx < TEST_SKEW_OPS; op_idx++) {
+        for (member = 0; member < TEST_SKEW_MEMBERS; member++) {
+            TEST_CHECK(!memcmp(buffers[member] + (op_idx * TEST_SKEW_LARGE_SIZE),
+                               buffers[TEST_SKEW_ROOT] +
+                               (op_idx * TEST_SKEW_LARGE_SIZE),
+                               test_skew_size(op_idx)),
+                       "round #%u, op #%u: wrong data on member #%u", round,
+                       op_idx, member);
+            ucg_collective_destroy(colls[member][op_idx]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t *buffers[TEST_SKEW_MEMBERS];
+    ucg_group_member_index_t member;
+    test_loopback_t lb;
+    ucs_status_t status;
+    unsigned round;
+
+    test_skew_store();
+    printf("skew: %u keys in %u slots, stored in order past a failed insert\n",
+           TEST_SKEW_COLLS * TEST_SKEW_STEPS, TEST_SKEW_SLOTS);
+
+    /* Every op of the receivers has its own slot, so none is deferred */
+    setenv("UCX_BUILTIN_MAX_CONCURRENT_OPS", UCS_PP_QUOTE(TEST_SKEW_OPS), 1);
+
+    status = test_loopback_init(&lb, TEST_SKEW_MEMBERS, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    for (member = 0; member < TEST_SKEW_MEMBERS; member++) {
+        buffers[member] = malloc(TEST_SKEW_OPS * TEST_SKEW_LARGE_SIZE);
+        TEST_CHECK(buffers[member] != NULL, "out of memory");
+    }
+
+    for (round = 0; round < TEST_SKEW_ROUNDS; round++) {
+        test_skew_broadcasts(&lb, buffers, round);
+    }
+
+    for (member = 0; member < TEST_SKEW_MEMBERS; member++) {
+        free(buffers[member]);
+    }
+
+    test_loopback_cleanup(&lb);
+    printf("skew: %u rounds of %u broadcasts, to %u members starting late\n",
+           TEST_SKEW_ROUNDS, TEST_SKEW_OPS, TEST_SKEW_MEMBERS - 1);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2021.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the local copies of the builtin ops (see ucg_builtin_memcpy): with and
+ * without UCG_BUILTIN_OP_FLAG_STREAM_COPY set on the op, the destination should
+ * hold exactly the source - for every alignment of either buffer (so that the
+ * streaming copy has every possible unaligned head and tail), and every length
+ * around its 64-byte loop - and the bytes around it should not be touched.
+ */
+
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_STREAM_ALIGN    (64)
+#define TEST_STREAM_MAX_LEN  (5 * 64 + 17)
+#define TEST_STREAM_LARGE    (3 * UCS_MBYTE + 5)
+#define TEST_STREAM_GUARD    (0xa5)
+
+static void test_stream_copy(ucg_builtin_op_t *op, uint8_t *dst,
+                             const uint8_t *src, size_t dst_align,
+                             size_t src_align, size_t length)
+{
+    size_t buffer_len = dst_align + length + TEST_STREAM_ALIGN;
+    size_t i;
+
+    memset(dst, TEST_STREAM_GUARD, buffer_len);
+    ucg_builtin_memcpy(op, dst + dst_align, src + src_align, length);
+
+    for (i = 0; i < buffer_len; i++) {
+        if ((i >= dst_align) && (i < dst_align + length)) {
+            TEST_CHECK(dst[i] == src[src_align + i - dst_align],
+                       "byte #%zu of %zu differs (alignments %zu/%zu, %s)",
+                       i - dst_align, length, dst_align, src_align,
+                       (op->flags & UCG_BUILTIN_OP_FLAG_STREAM_COPY) ?
+                       "streaming" : "regular");
+        } else {
+            TEST_CHECK(dst[i] == TEST_STREAM_GUARD, "byte %zd outside the copy "
+                       "of %zu was written (alignments %zu/%zu)",
+                       (ssize_t)i - (ssize_t)dst_align, length, dst_align,
+                       src_align);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t dst_align, src_align, length, i;
+    ucg_builtin_op_t *op;
+    uint8_t *dst, *src;
+    int is_stream;
+
+    op = calloc(1, sizeof(*op));
+    TEST_CHECK(op != NULL, "out of memory");
+
+    TEST_CHECK(!posix_memalign((void**)&dst, TEST_STREAM_ALIGN,
+                               TEST_STREAM_LARGE + 2 * TEST_STREAM_ALIGN) &&
+               !posix_memalign((void**)&src, TEST_STREAM_ALIGN,
+                               TEST_STREAM_LARGE + TEST_STREAM_ALIGN),
+               "out of memory");
+
+    for (i = 0; i < TEST_STREAM_LARGE + TEST_STREAM_ALIGN; i++) {
+        src[i] = (uint8_t)((i * 7) + (i >> 8)); /* no period of 64 bytes */
+    }
+
+    for (is_stream = 0; is_stream <= 1; is_stream++) {
+        op->flags = is_stream ? UCG_BUILTIN_OP_FLAG_STREAM_COPY : 0;
+
+        for (dst_align = 0; dst_align < TEST_STREAM_ALIGN; dst_align++) {
+            for (src_align = 0; src_align < TEST_STREAM_ALIGN; src_align++) {
+                for (length = 0; length <= TEST_STREAM_MAX_LEN; length++) {
+                    test_stream_copy(op, dst, src, dst_align, src_align,
+                                     length);
+                }
+            }
+        }
+
+        /* A few copies larger than the prefetch distance and the caches */
+        for (dst_align = 0; dst_align < 2; dst_align++) {
+            test_stream_copy(op, dst, src, dst_align * 13, dst_align * 3,
+                             TEST_STREAM_LARGE);
+        }
+    }
+
+    printf("stream copy: all alignments of up to %zu bytes, and %zu bytes\n",
+           (size_t)TEST_STREAM_MAX_LEN, (size_t)TEST_STREAM_LARGE);
+
+    free(src);
+    free(dst);
+    free(op);
+    return EXIT_SUCCESS;
+}
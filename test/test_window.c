@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+/*
+ * Check the window of slots for outstanding collectives (per group): it
+ * should grow from BUILTIN_CONCURRENT_OPS up to BUILTIN_MAX_CONCURRENT_OPS
+ * slots while triggers find their slot taken, and once it is at its largest
+ * such triggers should be deferred - and still complete.
+ */
+
+#include "test_loopback.h"
+#include "test_check.h"
+
+#include <ucg/builtin/ops/builtin_ops.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_WINDOW_INITIAL  2
+#define TEST_WINDOW_MAX      8
+#define TEST_WINDOW_OPS      (TEST_WINDOW_MAX + 1)
+#define TEST_WINDOW_MSG_SIZE 64
+#define TEST_WINDOW_ROOT     0
+#define TEST_WINDOW_MEMBER   1
+
+static void test_window_params(ucg_collective_params_t *params, void *buffer)
+{
+    memset(params, 0, sizeof(*params));
+    UCG_PARAM_TYPE(params).modifiers = UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST |
+                                       UCG_GROUP_COLLECTIVE_MODIFIER_SINGLE_SOURCE;
+    UCG_PARAM_TYPE(params).root      = TEST_WINDOW_ROOT;
+    params->send.buffer              = buffer;
+    params->send.count               = TEST_WINDOW_MSG_SIZE;
+    params->recv.buffer              = buffer;
+    params->recv.count               = TEST_WINDOW_MSG_SIZE;
+}
+
+static ucg_builtin_comp_window_t *test_window_get(ucg_coll_h coll)
+{
+    ucg_builtin_op_t *op = ucs_derived_of(coll, ucg_builtin_op_t);
+
+    return UCG_BUILTIN_OP_GET_WINDOW(op->gctx);
+}
+
+static ucs_status_t test_window_start(test_loopback_t *lb,
+                                      ucg_group_member_index_t index,
+                                      uint8_t (*buffers)[TEST_WINDOW_MSG_SIZE],
+                                      ucg_coll_h *colls,
+                                      test_loopback_req_t *reqs,
+                                      unsigned op_idx)
+{
+    ucg_collective_params_t params;
+    ucs_status_t status;
+
+    test_window_params(&params, buffers[op_idx]);
+    status = ucg_collective_create(lb->members[index].group, &params,
+                                   &colls[op_idx]);
+    TEST_CHECK(status == UCS_OK, "create #%u on member #%u: %s", op_idx,
+               index, ucs_status_string(status));
+
+    status = ucg_collective_start(colls[op_idx], (void*)&reqs[op_idx]);
+    if (status == UCS_OK) {
+        reqs[op_idx] = 1;
+    }
+
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buffers[2][TEST_WINDOW_OPS][TEST_WINDOW_MSG_SIZE];
+    test_loopback_req_t reqs[2][TEST_WINDOW_OPS] = {{0}};
+    ucg_coll_h colls[2][TEST_WINDOW_OPS];
+    ucg_builtin_comp_window_t *window;
+    ucg_builtin_op_t *op;
+    test_loopback_t lb;
+    ucs_status_t status;
+    unsigned idx;
+
+    /* the window is configured per context, so before any is created */
+    setenv("UCX_BUILTIN_CONCURRENT_OPS", UCS_PP_QUOTE(TEST_WINDOW_INITIAL), 1);
+    setenv("UCX_BUILTIN_MAX_CONCURRENT_OPS", UCS_PP_QUOTE(TEST_WINDOW_MAX), 1);
+
+    status = test_loopback_init(&lb, 2, NULL);
+    TEST_CHECK(status == UCS_OK, "loopback init: %s", ucs_status_string(status));
+
+    for (idx = 0; idx < TEST_WINDOW_OPS; idx++) {
+        memset(buffers[TEST_WINDOW_ROOT][idx], idx + 1, TEST_WINDOW_MSG_SIZE);
+    }
+
+    /*
+     * Start all the broadcasts on the receiving member first: none of them
+     * can complete before the root starts, so each one keeps its slot.
+     */
+    for (idx = 0; idx < TEST_WINDOW_OPS; idx++) {
+        status = test_window_start(&lb, TEST_WINDOW_MEMBER,
+                                   buffers[TEST_WINDOW_MEMBER],
+                                   colls[TEST_WINDOW_MEMBER],
+                                   reqs[TEST_WINDOW_MEMBER], idx);
+        TEST_CHECK(status == UCS_INPROGRESS, "start #%u: %s", idx,
+                   ucs_status_string(status));
+
+        window = test_window_get(colls[TEST_WINDOW_MEMBER][idx]);
+        op     = ucs_derived_of(colls[TEST_WINDOW_MEMBER][idx],
+                                ucg_builtin_op_t);
+        if (idx < TEST_WINDOW_MAX) {
+            /* should have grown just enough to hold every op started so far */
+            TEST_CHECK(window->mask + 1 ==
+                       ucs_max(TEST_WINDOW_INITIAL, ucs_roundup_pow2(idx + 1)),
+                       "op #%u: %u slots", idx, window->mask + 1);
+            TEST_CHECK(op->current != NULL, "op #%u was deferred", idx);
+        } else {
+            /* no more room - the last one is deferred rather than rejected */
+            TEST_CHECK(window->mask + 1 == TEST_WINDOW_MAX,
+                       "op #%u: %u slots", idx, window->mask + 1);
+            TEST_CHECK(op->current == NULL, "op #%u was not deferred", idx);
+            TEST_CHECK(!ucs_queue_is_empty(&window->pending),
+                       "op #%u is not pending", idx);
+        }
+    }
+
+    for (idx = 0; idx < TEST_WINDOW_OPS; idx++) {
+        status = test_window_start(&lb, TEST_WINDOW_ROOT,
+                                   buffers[TEST_WINDOW_ROOT],
+                                   colls[TEST_WINDOW_ROOT],
+                                   reqs[TEST_WINDOW_ROOT], idx);
+        TEST_CHECK((status == UCS_OK) || (status == UCS_INPROGRESS),
+                   "root start #%u: %s", idx, ucs_status_string(status));
+    }
+
+    test_loopback_wait(&lb, reqs[TEST_WINDOW_ROOT], TEST_WINDOW_OPS);
+    test_loopback_wait(&lb, reqs[TEST_WINDOW_MEMBER], TEST_WINDOW_OPS);
+
+    window = test_window_get(colls[TEST_WINDOW_MEMBER][0]);
+    TEST_CHECK(ucs_queue_is_empty(&window->pending), "ops left pending");
+
+    for (idx = 0; idx < TEST_WINDOW_OPS; idx++) {
+        TEST_CHECK(!memcmp(buffers[TEST_WINDOW_ROOT][idx],
+                           buffers[TEST_WINDOW_MEMBER][idx],
+                           TEST_WINDOW_MSG_SIZE), "op #%u: wrong data", idx);
+
+        ucg_collective_destroy(colls[TEST_WINDOW_ROOT][idx]);
+        ucg_collective_destroy(colls[TEST_WINDOW_MEMBER][idx]);
+    }
+
+    test_loopback_cleanup(&lb);
+    printf("window: grew from %u to %u slots, deferred %u op(s)\n",
+           TEST_WINDOW_INITIAL, TEST_WINDOW_MAX,
+           TEST_WINDOW_OPS - TEST_WINDOW_MAX);
+    return EXIT_SUCCESS;
+}